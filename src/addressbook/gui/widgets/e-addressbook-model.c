@@ -76,6 +76,8 @@ enum {
 	CONTACT_CHANGED,
 	MODEL_CHANGED,
 	STOP_STATE_CHANGED,
+	BEGIN_CHANGES,
+	END_CHANGES,
 	LAST_SIGNAL
 };
 
@@ -269,6 +271,8 @@ view_modify_contact_cb (EBookClientView *client_view,
 
 	array = model->priv->contacts;
 
+	g_signal_emit (model, signals[BEGIN_CHANGES], 0);
+
 	while (contact_list != NULL) {
 		EContact *new_contact = contact_list->data;
 		const gchar *target_uid;
@@ -288,12 +292,14 @@ view_modify_contact_cb (EBookClientView *client_view,
 			const gchar *uid;
 
 			old_contact = array->pdata[ii];
-			g_return_if_fail (old_contact != NULL);
+			g_warn_if_fail (old_contact != NULL);
+			if (!old_contact)
+				continue;
 
 			uid = e_contact_get_const (old_contact, E_CONTACT_UID);
-			g_return_if_fail (uid != NULL);
+			g_warn_if_fail (uid != NULL);
 
-			if (strcmp (uid, target_uid) != 0)
+			if (!uid || strcmp (uid, target_uid) != 0)
 				continue;
 
 			g_object_unref (old_contact);
@@ -306,6 +312,8 @@ view_modify_contact_cb (EBookClientView *client_view,
 
 		contact_list = contact_list->next;
 	}
+
+	g_signal_emit (model, signals[END_CHANGES], 0);
 }
 
 static void
@@ -763,6 +771,24 @@ e_addressbook_model_class_init (EAddressbookModelClass *class)
 		G_TYPE_NONE, 0);
 }
 
+	signals[BEGIN_CHANGES] = g_signal_new (
+		"begin_changes",
+		G_OBJECT_CLASS_TYPE (object_class),
+		G_SIGNAL_RUN_LAST,
+		G_STRUCT_OFFSET (EAddressbookModelClass, begin_changes),
+		NULL, NULL,
+		g_cclosure_marshal_VOID__VOID,
+		G_TYPE_NONE, 0);
+
+	signals[END_CHANGES] = g_signal_new (
+		"end_changes",
+		G_OBJECT_CLASS_TYPE (object_class),
+		G_SIGNAL_RUN_LAST,
+		G_STRUCT_OFFSET (EAddressbookModelClass, end_changes),
+		NULL, NULL,
+		g_cclosure_marshal_VOID__VOID,
+		G_TYPE_NONE, 0);
+
 static void
 e_addressbook_model_init (EAddressbookModel *model)
 {
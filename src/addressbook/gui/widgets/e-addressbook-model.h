@@ -77,6 +77,8 @@ struct _EAddressbookModelClass {
 						 gint index);
 	void		(*model_changed)	(EAddressbookModel *model);
 	void		(*stop_state_changed)	(EAddressbookModel *model);
+	void		(*begin_changes)	(EAddressbookModel *model);
+	void		(*end_changes)		(EAddressbookModel *model);
 };
 
 GType		e_addressbook_model_get_type	(void);
@@ -42,6 +42,7 @@ struct _EAddressbookTableAdapterPrivate {
 	EAddressbookModel *model;
 
 	gint create_contact_id, remove_contact_id, modify_contact_id, model_changed_id;
+	gint begin_changes_id, end_changes_id;
 
 	GHashTable *emails;
 };
@@ -67,11 +68,15 @@ unlink_model (EAddressbookTableAdapter *adapter)
 	g_signal_handler_disconnect (priv->model, priv->remove_contact_id);
 	g_signal_handler_disconnect (priv->model, priv->modify_contact_id);
 	g_signal_handler_disconnect (priv->model, priv->model_changed_id);
+	g_signal_handler_disconnect (priv->model, priv->begin_changes_id);
+	g_signal_handler_disconnect (priv->model, priv->end_changes_id);
 
 	priv->create_contact_id = 0;
 	priv->remove_contact_id = 0;
 	priv->modify_contact_id = 0;
 	priv->model_changed_id = 0;
+	priv->begin_changes_id = 0;
+	priv->end_changes_id = 0;
 
 	g_object_unref (priv->model);
 
@@ -442,6 +447,20 @@ model_changed (EAddressbookModel *model,
 	e_table_model_changed (E_TABLE_MODEL (adapter));
 }
 
+static void
+begin_changes (EAddressbookModel *model,
+               EAddressbookTableAdapter *adapter)
+{
+	e_table_model_begin_changes (E_TABLE_MODEL (adapter));
+}
+
+static void
+end_changes (EAddressbookModel *model,
+             EAddressbookTableAdapter *adapter)
+{
+	e_table_model_end_changes (E_TABLE_MODEL (adapter));
+}
+
 void
 e_addressbook_table_adapter_construct (EAddressbookTableAdapter *adapter,
                                        EAddressbookModel *model)
@@ -467,6 +486,14 @@ e_addressbook_table_adapter_construct (EAddressbookTableAdapter *adapter,
 		priv->model, "model_changed",
 		G_CALLBACK (model_changed), adapter);
 
+	priv->begin_changes_id = g_signal_connect (
+		priv->model, "begin_changes",
+		G_CALLBACK (begin_changes), adapter);
+
+	priv->end_changes_id = g_signal_connect (
+		priv->model, "end_changes",
+		G_CALLBACK (end_changes), adapter);
+
 	priv->emails = g_hash_table_new_full (
 		g_str_hash, g_str_equal,
 		(GDestroyNotify) g_free,
@@ -2066,19 +2066,15 @@ e_cal_model_data_subscriber_component_removed (ECalDataModelSubscriber *subscrib
 static void
 e_cal_model_data_subscriber_freeze (ECalDataModelSubscriber *subscriber)
 {
-	/* No freeze/thaw, the ETableModel doesn't notify about changes when frozen */
-
-	/* ETableModel *table_model = E_TABLE_MODEL (subscriber);
-	e_table_model_freeze (table_model); */
+	/* Not e_table_model_freeze(), the ETableModel doesn't notify about
+	   changes when frozen; a batch only merges the modified rows. */
+	e_table_model_begin_changes (E_TABLE_MODEL (subscriber));
 }
 
 static void
 e_cal_model_data_subscriber_thaw (ECalDataModelSubscriber *subscriber)
 {
-	/* No freeze/thaw, the ETableModel doesn't notify about changes when frozen */
-
-	/* ETableModel *table_model = E_TABLE_MODEL (subscriber);
-	e_table_model_thaw (table_model); */
+	e_table_model_end_changes (E_TABLE_MODEL (subscriber));
 }
 
 static void
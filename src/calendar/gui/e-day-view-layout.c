@@ -35,21 +35,6 @@ static void e_day_view_layout_long_event (EDayViewEvent	  *event,
 					  time_t	  *day_starts,
 					  gint		  *rows_in_top_display);
 
-static void e_day_view_layout_day_event (EDayViewEvent    *event,
-					 EBitArray       **grid,
-					 guint16	  *group_starts,
-					 guint8		  *cols_per_row,
-					 gint		   rows,
-					 gint		   mins_per_row,
-					 gint              max_cols);
-static void e_day_view_expand_day_event (EDayViewEvent    *event,
-					 EBitArray       **grid,
-					 guint8		  *cols_per_row,
-					 gint		   mins_per_row);
-static void e_day_view_recalc_cols_per_row (gint           rows,
-					    guint8	  *cols_per_row,
-					    guint16       *group_starts);
-
 void
 e_day_view_layout_long_events (GArray *events,
                                gint days_shown,
@@ -125,209 +110,244 @@ e_day_view_layout_long_event (EDayViewEvent *event,
 	*rows_in_top_display = MAX (*rows_in_top_display, free_row + 1);
 }
 
-/* returns maximum number of columns among all rows */
-gint
-e_day_view_layout_day_events (GArray *events,
-                              gint rows,
-                              gint mins_per_row,
-                              guint8 *cols_per_row,
-                              gint max_cols)
+/* A binary min-heap of 64-bit keys, used by the day events layout. */
+static void
+layout_heap_push (GArray *heap,
+                  guint64 key)
 {
-	EDayViewEvent *event;
-	gint row, event_num, res;
-	EBitArray **grid;
+	guint64 *keys;
+	guint ii;
 
-	/* This is a temporary array which keeps track of rows which are
-	 * connected. When an appointment spans multiple rows then the number
-	 * of columns in each of these rows must be the same (i.e. the maximum
-	 * of all of them). Each element in the array corresponds to one row
-	 * and contains the index of the first row in the group of connected
-	 * rows. */
-	guint16 group_starts[12 * 24];
+	g_array_append_val (heap, key);
+	keys = (guint64 *) heap->data;
 
-	/* This is a temporary 2-d grid which is used to place events.
-	 * Each element is 0 if the position is empty, or 1 if occupied. */
-	grid = g_new0 (EBitArray *, rows);
-
-	/* Reset the cols_per_row array, and initialize the connected rows so
-	 * that all rows are not connected - each row is the start of a new
-	 * group. */
-	for (row = 0; row < rows; row++) {
-		cols_per_row[row] = 0;
-		group_starts[row] = row;
-
-		/* row doesn't contain any event at the moment */
-		grid[row] = e_bit_array_new (0);
-	}
+	for (ii = heap->len - 1; ii > 0 && keys[(ii - 1) / 2] > key; ii = (ii - 1) / 2)
+		keys[ii] = keys[(ii - 1) / 2];
 
-	/* Iterate over the events, finding which rows they cover, and putting
-	 * them in the first free column available. Increment the number of
-	 * events in each of the rows it covers, and make sure they are all
-	 * in one group. */
-	for (event_num = 0; event_num < events->len; event_num++) {
-		event = &g_array_index (events, EDayViewEvent, event_num);
+	keys[ii] = key;
+}
 
-		e_day_view_layout_day_event (
-			event, grid, group_starts,
-			cols_per_row, rows, mins_per_row, max_cols);
-	}
+static guint64
+layout_heap_pop (GArray *heap)
+{
+	guint64 *keys, top, last;
+	guint ii, child;
 
-	/* Recalculate the number of columns needed in each row. */
-	e_day_view_recalc_cols_per_row (rows, cols_per_row, group_starts);
+	g_return_val_if_fail (heap->len > 0, 0);
 
-	/* Iterate over the events again, trying to expand events horizontally
-	 * if there is enough space. */
-	for (event_num = 0; event_num < events->len; event_num++) {
-		event = &g_array_index (events, EDayViewEvent, event_num);
-		e_day_view_expand_day_event (
-			event, grid, cols_per_row,
-			mins_per_row);
-	}
+	keys = (guint64 *) heap->data;
+	top = keys[0];
+	last = keys[heap->len - 1];
+	g_array_set_size (heap, heap->len - 1);
 
-	/* Free the grid and compute maximum number of columns used. */
-	res = 0;
-	for (row = 0; row < rows; row++) {
-		res = MAX (res, e_bit_array_bit_count (grid[row]));
-		g_object_unref (grid[row]);
+	for (ii = 0; (child = 2 * ii + 1) < heap->len; ii = child) {
+		if (child + 1 < heap->len && keys[child + 1] < keys[child])
+			child++;
+		if (keys[child] >= last)
+			break;
+		keys[ii] = keys[child];
 	}
-	g_free (grid);
 
-	return res;
+	if (heap->len > 0)
+		keys[ii] = last;
+
+	return top;
 }
 
-/* Finds the first free position to place the event in.
- * Increments the number of events in each of the rows it covers, and makes
- * sure they are all in one group. */
-static void
-e_day_view_layout_day_event (EDayViewEvent *event,
-                             EBitArray **grid,
-                             guint16 *group_starts,
-                             guint8 *cols_per_row,
-                             gint rows,
-                             gint mins_per_row,
-                             gint max_cols)
+static gboolean
+layout_day_event_rows (EDayViewEvent *event,
+                       gint rows,
+                       gint mins_per_row,
+                       gint *start_row_return,
+                       gint *end_row_return)
 {
-	gint start_row, end_row, free_col, col, row, group_start;
+	gint start_row, end_row;
 
 	start_row = event->start_minute / mins_per_row;
 	end_row = (event->end_minute - 1) / mins_per_row;
 	if (end_row < start_row)
 		end_row = start_row;
 
-	event->num_columns = 0;
-
 	/* If the event can't currently be seen, just return. */
 	if (start_row >= rows || end_row < 0)
-		return;
+		return FALSE;
 
 	/* Make sure we don't go outside the visible times. */
-	start_row = CLAMP (start_row, 0, rows - 1);
-	end_row = CLAMP (end_row, 0, rows - 1);
-
-	/* Try each column until we find a free one. */
-	for (col = 0; max_cols <= 0 || col < max_cols; col++) {
-		free_col = col;
-		for (row = start_row; row <= end_row; row++) {
-			if (e_bit_array_bit_count (grid[row]) > col &&
-			    e_bit_array_value_at (grid[row], col)) {
-				free_col = -1;
-				break;
-			}
-		}
+	*start_row_return = CLAMP (start_row, 0, rows - 1);
+	*end_row_return = CLAMP (end_row, 0, rows - 1);
 
-		if (free_col != -1)
-			break;
-	}
+	return TRUE;
+}
 
-	/* If we can't find space for the event, just return. */
-	if (free_col == -1)
-		return;
+/* Whether any of the events in the column, given as start and end row
+ * pairs in row order, covers any of the rows start_row to end_row. */
+static gboolean
+layout_column_clashes (GArray *column,
+                       gint start_row,
+                       gint end_row)
+{
+	gint *pairs = (gint *) column->data;
+	guint low = 0, high = column->len / 2;
 
-	/* The event is assigned 1 col initially, but may be expanded later. */
-	event->start_row_or_col = free_col;
-	event->num_columns = 1;
+	/* Find the first event ending at or after start_row */
+	while (low < high) {
+		guint mid = (low + high) / 2;
 
-	/* Determine the start index of the group. */
-	group_start = group_starts[start_row];
-
-	/* Increment number of events in each of the rows the event covers.
-	 * We use the cols_per_row array for this. It will be sorted out after
-	 * all the events have been layed out. Also make sure all the rows that
-	 * the event covers are in one group. */
-	for (row = start_row; row <= end_row; row++) {
-		/* resize the array if necessary */
-		if (e_bit_array_bit_count (grid[row]) <= free_col)
-			e_bit_array_insert (
-				grid[row], e_bit_array_bit_count (grid[row]),
-				free_col - e_bit_array_bit_count (grid[row]) + 1);
-
-		e_bit_array_change_one_row (grid[row], free_col, TRUE);
-		cols_per_row[row]++;
-		group_starts[row] = group_start;
+		if (pairs[2 * mid + 1] < start_row)
+			low = mid + 1;
+		else
+			high = mid;
 	}
 
-	/* If any following rows should be in the same group, add them. */
-	for (row = end_row + 1; row < rows; row++) {
-		if (group_starts[row] > end_row)
-			break;
-		group_starts[row] = group_start;
-	}
+	return low < column->len / 2 && pairs[2 * low] <= end_row;
 }
 
-/* For each group of rows, find the max number of events in all the
- * rows, and set the number of cols in each of the rows to that. */
-static void
-e_day_view_recalc_cols_per_row (gint rows,
-                                guint8 *cols_per_row,
-                                guint16 *group_starts)
+static gint
+layout_compare_start_rows (gconstpointer a,
+                           gconstpointer b,
+                           gpointer user_data)
 {
-	gint start_row = 0, row, next_start_row, max_events;
+	const gint *start_rows = user_data;
 
-	while (start_row < rows) {
-		max_events = 0;
-		for (row = start_row; row < rows && group_starts[row] == start_row; row++)
-			max_events = MAX (max_events, cols_per_row[row]);
+	return start_rows[*(const gint *) a] - start_rows[*(const gint *) b];
+}
+
+/* Lays out the events in one sweep over their start rows. Each event goes
+ * to the first column free at its start row, where a column gets free once
+ * its last event ended. With the events sorted by their start time, as the
+ * callers do, this gives the same columns as trying each column in each
+ * row the event covers. Returns maximum number of columns among all rows. */
+gint
+e_day_view_layout_day_events (GArray *events,
+                              gint rows,
+                              gint mins_per_row,
+                              guint8 *cols_per_row,
+                              gint max_cols)
+{
+	EDayViewEvent *event;
+	GArray *free_cols, *busy_cols;
+	GPtrArray *columns;
+	gint *order, *start_rows, *end_rows, *covering, *connecting;
+	gint row, group_end, event_num, col, n_events = 0, ii, res;
+
+	order = g_new (gint, events->len);
+	start_rows = g_new (gint, events->len);
+	end_rows = g_new (gint, events->len);
 
-		next_start_row = row;
+	/* How many events cover each row, and how many events cover each
+	 * row and the next one, first as differences to the previous row. */
+	covering = g_new0 (gint, rows + 1);
+	connecting = g_new0 (gint, rows + 1);
 
-		for (row = start_row; row < next_start_row; row++)
-			cols_per_row[row] = max_events;
+	for (event_num = 0; event_num < events->len; event_num++) {
+		event = &g_array_index (events, EDayViewEvent, event_num);
+
+		event->num_columns = 0;
 
-		start_row = next_start_row;
+		if (layout_day_event_rows (event, rows, mins_per_row,
+		    &start_rows[event_num], &end_rows[event_num]))
+			order[n_events++] = event_num;
 	}
-}
 
-/* Expands the event horizontally to fill any free space. */
-static void
-e_day_view_expand_day_event (EDayViewEvent *event,
-                             EBitArray **grid,
-                             guint8 *cols_per_row,
-                             gint mins_per_row)
-{
-	gint start_row, end_row, col, row;
-	gboolean clashed;
+	/* This is a stable sort, it keeps the order of the events
+	 * starting in the same row. */
+	g_qsort_with_data (order, n_events, sizeof (gint), layout_compare_start_rows, start_rows);
+
+	/* The free column indexes, and the busy column indexes with the end
+	 * row of their last event in the upper 32 bits, as min-heaps. */
+	free_cols = g_array_new (FALSE, FALSE, sizeof (guint64));
+	busy_cols = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+	/* The start and end rows of the events in each column */
+	columns = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+
+	for (ii = 0; ii < n_events; ii++) {
+		gint start_row = start_rows[order[ii]];
+		gint end_row = end_rows[order[ii]];
+
+		event = &g_array_index (events, EDayViewEvent, order[ii]);
+
+		/* Free the columns whose last event ended before this one. */
+		while (busy_cols->len > 0 &&
+		       (gint) (g_array_index (busy_cols, guint64, 0) >> 32) < start_row)
+			layout_heap_push (free_cols, layout_heap_pop (busy_cols) & G_MAXUINT32);
+
+		if (free_cols->len > 0) {
+			col = layout_heap_pop (free_cols);
+		} else if (max_cols <= 0 || columns->len < (guint) max_cols) {
+			col = columns->len;
+			g_ptr_array_add (columns, g_array_new (FALSE, FALSE, sizeof (gint)));
+		} else {
+			/* If we can't find space for the event, just skip it. */
+			continue;
+		}
 
-	start_row = event->start_minute / mins_per_row;
-	end_row = (event->end_minute - 1) / mins_per_row;
-	if (end_row < start_row)
-		end_row = start_row;
+		layout_heap_push (busy_cols, (((guint64) end_row) << 32) | col);
+		g_array_append_val (columns->pdata[col], start_row);
+		g_array_append_val (columns->pdata[col], end_row);
 
-	/* Try each column until we find a free one. */
-	clashed = FALSE;
-	for (col = event->start_row_or_col + 1; col < cols_per_row[start_row]; col++) {
-		for (row = start_row; row <= end_row; row++) {
-			if (e_bit_array_bit_count (grid[row]) > col &&
-			    e_bit_array_value_at (grid[row], col)) {
-				clashed = TRUE;
+		/* The event is assigned 1 col initially, but may be expanded later. */
+		event->start_row_or_col = col;
+		event->num_columns = 1;
+
+		covering[start_row]++;
+		covering[end_row + 1]--;
+		connecting[start_row]++;
+		connecting[end_row]--;
+	}
+
+	for (row = 1; row < rows; row++) {
+		covering[row] += covering[row - 1];
+		connecting[row] += connecting[row - 1];
+	}
+
+	/* When an appointment spans multiple rows then the number of columns
+	 * in each of these rows must be the same (i.e. the maximum of all of
+	 * them). Find the groups of connected rows and set that for each. */
+	for (row = 0; row < rows; row = group_end + 1) {
+		gint max_events = 0;
+
+		for (group_end = row; ; group_end++) {
+			max_events = MAX (max_events, covering[group_end]);
+
+			if (group_end == rows - 1 || connecting[group_end] == 0)
 				break;
-			}
 		}
 
-		if (clashed)
-			break;
+		for (ii = row; ii <= group_end; ii++)
+			cols_per_row[ii] = max_events;
+	}
 
-		event->num_columns++;
+	/* Iterate over the events again, trying to expand events horizontally
+	 * if there is enough space. */
+	for (ii = 0; ii < n_events; ii++) {
+		gint start_row = start_rows[order[ii]];
+		gint end_row = end_rows[order[ii]];
+
+		event = &g_array_index (events, EDayViewEvent, order[ii]);
+		if (event->num_columns == 0)
+			continue;
+
+		for (col = event->start_row_or_col + 1; col < cols_per_row[start_row]; col++) {
+			if (layout_column_clashes (columns->pdata[col], start_row, end_row))
+				break;
+
+			event->num_columns++;
+		}
 	}
+
+	res = columns->len;
+
+	g_ptr_array_unref (columns);
+	g_array_free (busy_cols, TRUE);
+	g_array_free (free_cols, TRUE);
+	g_free (connecting);
+	g_free (covering);
+	g_free (end_rows);
+	g_free (start_rows);
+	g_free (order);
+
+	return res;
 }
 
 /* Find the start and end days for the event. */
@@ -116,6 +116,7 @@ struct _EDayViewPrivate {
 	gulong time_range_changed_handler_id;
 	gulong model_row_changed_handler_id;
 	gulong model_cell_changed_handler_id;
+	gulong model_rows_changed_handler_id;
 	gulong model_rows_inserted_handler_id;
 	gulong comps_deleted_handler_id;
 	gulong timezone_changed_handler_id;
@@ -1058,6 +1059,7 @@ day_view_dispose (GObject *object)
 	disconnect_model_handler (day_view->priv->time_range_changed_handler_id);
 	disconnect_model_handler (day_view->priv->model_row_changed_handler_id);
 	disconnect_model_handler (day_view->priv->model_cell_changed_handler_id);
+	disconnect_model_handler (day_view->priv->model_rows_changed_handler_id);
 	disconnect_model_handler (day_view->priv->model_rows_inserted_handler_id);
 	disconnect_model_handler (day_view->priv->comps_deleted_handler_id);
 	disconnect_model_handler (day_view->priv->timezone_changed_handler_id);
@@ -2745,6 +2747,25 @@ model_cell_changed_cb (ETableModel *etm,
 	update_row (day_view, row, FALSE);
 }
 
+static void
+model_rows_changed_cb (ETableModel *etm,
+                       gint row,
+                       gint count,
+                       gpointer user_data)
+{
+	EDayView *day_view = E_DAY_VIEW (user_data);
+	gint i;
+
+	if (!E_CALENDAR_VIEW (day_view)->in_focus) {
+		e_day_view_free_events (day_view);
+		day_view->requires_update = TRUE;
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+		update_row (day_view, row + i, FALSE);
+}
+
 static void
 model_rows_inserted_cb (ETableModel *etm,
                         gint row,
@@ -2880,6 +2901,11 @@ init_model (EDayView *day_view,
 		G_CALLBACK (model_cell_changed_cb), day_view);
 	day_view->priv->model_cell_changed_handler_id = handler_id;
 
+	handler_id = g_signal_connect (
+		model, "model_rows_changed",
+		G_CALLBACK (model_rows_changed_cb), day_view);
+	day_view->priv->model_rows_changed_handler_id = handler_id;
+
 	handler_id = g_signal_connect (
 		model, "model_rows_inserted",
 		G_CALLBACK (model_rows_inserted_cb), day_view);
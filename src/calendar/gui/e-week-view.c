@@ -343,6 +343,23 @@ week_view_model_row_changed_cb (EWeekView *week_view,
 	week_view_update_row (week_view, row);
 }
 
+static void
+week_view_model_rows_changed_cb (EWeekView *week_view,
+                                 gint row,
+                                 gint count)
+{
+	gint i;
+
+	if (!E_CALENDAR_VIEW (week_view)->in_focus) {
+		e_week_view_free_events (week_view);
+		week_view->requires_update = TRUE;
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+		week_view_update_row (week_view, row + i);
+}
+
 static void
 week_view_model_rows_inserted_cb (EWeekView *week_view,
                                   gint row,
@@ -951,6 +968,10 @@ week_view_constructed (GObject *object)
 		model, "model-row-changed",
 		G_CALLBACK (week_view_model_row_changed_cb), object);
 
+	g_signal_connect_swapped (
+		model, "model-rows-changed",
+		G_CALLBACK (week_view_model_rows_changed_cb), object);
+
 	g_signal_connect_swapped (
 		model, "model-rows-inserted",
 		G_CALLBACK (week_view_model_rows_inserted_cb), object);
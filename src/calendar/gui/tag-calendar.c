@@ -31,6 +31,9 @@
 #include "e-cal-data-model-subscriber.h"
 #include "tag-calendar.h"
 
+/* How many days around the shown range are counted as well */
+#define COVERED_DAYS_MARGIN 62
+
 struct _ETagCalendarPrivate
 {
 	ECalendar *calendar;	/* weak-referenced */
@@ -39,7 +42,8 @@ struct _ETagCalendarPrivate
 	gboolean recur_events_italic;
 
 	GHashTable *objects;	/* ObjectInfo ~> 1 (unused) */
-	GHashTable *dates;	/* julian date ~> DateInfo */
+	GArray *dates;		/* DateInfo, one for each julian date from dates_start_julian */
+	guint32 dates_start_julian;	/* the dates cover the shown range and a margin around it */
 
 	guint32 range_start_julian;
 	guint32 range_end_julian;
@@ -112,7 +116,7 @@ object_info_data_equal (ObjectInfo *o1,
 		return FALSE;
 
 	return (o1->is_transparent ? 1: 0) == (o2->is_transparent ? 1 : 0) &&
-	       (o1->start_julian ? 1: 0) == (o2->is_recurring ? 1 : 0) &&
+	       (o1->is_recurring ? 1: 0) == (o2->is_recurring ? 1 : 0) &&
 	       (o1->start_julian == o2->start_julian) &&
 	       (o1->end_julian == o2->end_julian);
 }
@@ -152,21 +156,6 @@ object_info_free (gpointer ptr)
 	}
 }
 
-static DateInfo *
-date_info_new (void)
-{
-	return g_new0 (DateInfo, 1);
-}
-
-static void
-date_info_free (gpointer ptr)
-{
-	DateInfo *dinfo = ptr;
-
-	if (dinfo)
-		g_free (dinfo);
-}
-
 static gboolean
 date_info_update (DateInfo *dinfo,
 		  ObjectInfo *oinfo,
@@ -258,30 +247,77 @@ decode_julian (guint32 julian,
 	*day = g_date_get_day (&dt);
 }
 
+/* Returns NULL when no component covers the julian date */
+static DateInfo *
+e_tag_calendar_get_date_info (ETagCalendar *tag_calendar,
+			      guint32 julian)
+{
+	GArray *dates = tag_calendar->priv->dates;
+
+	if (julian < tag_calendar->priv->dates_start_julian ||
+	    julian - tag_calendar->priv->dates_start_julian >= dates->len)
+		return NULL;
+
+	return &g_array_index (dates, DateInfo, julian - tag_calendar->priv->dates_start_julian);
+}
+
+/* Makes the dates array cover the julian dates from start_julian to end_julian
+ * and counts the components on them again. The dates are not grown with
+ * the components, thus any long lasting component does not make them huge. */
 static void
-tag_calendar_date_cb (gpointer key,
-		      gpointer value,
-		      gpointer user_data)
+e_tag_calendar_cover_dates (ETagCalendar *tag_calendar,
+			    guint32 start_julian,
+			    guint32 end_julian)
 {
-	ETagCalendar *tag_calendar = user_data;
-	DateInfo *dinfo = value;
-	gint year, month, day;
+	GArray *dates = tag_calendar->priv->dates;
+	GHashTableIter iter;
+	gpointer key;
+
+	g_array_set_size (dates, 0);
+	g_array_set_size (dates, end_julian - start_julian + 1);
+	tag_calendar->priv->dates_start_julian = start_julian;
+
+	g_hash_table_iter_init (&iter, tag_calendar->priv->objects);
 
-	decode_julian (GPOINTER_TO_UINT (key), &year, &month, &day);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		ObjectInfo *oinfo = key;
+		guint32 dt;
 
-	e_calendar_item_mark_day (tag_calendar->priv->calitem, year, month - 1, day,
-		date_info_get_style (dinfo, tag_calendar->priv->recur_events_italic), FALSE);
+		for (dt = MAX (oinfo->start_julian, start_julian); dt <= MIN (oinfo->end_julian, end_julian); dt++) {
+			date_info_update (e_tag_calendar_get_date_info (tag_calendar, dt), oinfo, TRUE);
+		}
+	}
 }
 
+/* Marks only the shown dates, the dates array covers also the dates around
+ * them, thus it's not walked when the shown months change. */
 static void
 e_tag_calendar_remark_days (ETagCalendar *tag_calendar)
 {
+	guint32 dt;
+
 	g_return_if_fail (E_IS_TAG_CALENDAR (tag_calendar));
 	g_return_if_fail (tag_calendar->priv->calitem != NULL);
 
 	e_calendar_item_clear_marks (tag_calendar->priv->calitem);
 
-	g_hash_table_foreach (tag_calendar->priv->dates, tag_calendar_date_cb, tag_calendar);
+	for (dt = tag_calendar->priv->range_start_julian; dt && dt <= tag_calendar->priv->range_end_julian; dt++) {
+		DateInfo *dinfo;
+		guint8 style;
+		gint year, month, day;
+
+		dinfo = e_tag_calendar_get_date_info (tag_calendar, dt);
+		if (!dinfo)
+			continue;
+
+		style = date_info_get_style (dinfo, tag_calendar->priv->recur_events_italic);
+		if (!style)
+			continue;
+
+		decode_julian (dt, &year, &month, &day);
+
+		e_calendar_item_mark_day (tag_calendar->priv->calitem, year, month - 1, day, style, FALSE);
+	}
 }
 
 static time_t
@@ -331,6 +367,13 @@ e_tag_calendar_date_range_changed_cb (ETagCalendar *tag_calendar)
 	tag_calendar->priv->range_start_julian = encode_ymd_to_julian (start_year, start_month, start_day);
 	tag_calendar->priv->range_end_julian = encode_ymd_to_julian (end_year, end_month, end_day);
 
+	if (!e_tag_calendar_get_date_info (tag_calendar, tag_calendar->priv->range_start_julian) ||
+	    !e_tag_calendar_get_date_info (tag_calendar, tag_calendar->priv->range_end_julian)) {
+		e_tag_calendar_cover_dates (tag_calendar,
+			tag_calendar->priv->range_start_julian - MIN (tag_calendar->priv->range_start_julian, COVERED_DAYS_MARGIN),
+			tag_calendar->priv->range_end_julian + COVERED_DAYS_MARGIN);
+	}
+
 	/* Range change causes removal of marks in the calendar */
 	e_tag_calendar_remark_days (tag_calendar);
 
@@ -360,7 +403,7 @@ e_tag_calendar_query_tooltip_cb (ECalendar *calendar,
 		return FALSE;
 
 	julian = encode_ymd_to_julian (g_date_get_year (&date), g_date_get_month (&date), g_date_get_day (&date));
-	date_info = g_hash_table_lookup (tag_calendar->priv->dates, GINT_TO_POINTER (julian));
+	date_info = e_tag_calendar_get_date_info (tag_calendar, julian);
 
 	if (!date_info)
 		return FALSE;
@@ -415,32 +458,23 @@ e_tag_calendar_update_by_oinfo (ETagCalendar *tag_calendar,
 	calitem = tag_calendar->priv->calitem;
 	g_return_if_fail (calitem != NULL);
 
-	if (!oinfo)
+	if (!oinfo || oinfo->end_julian < oinfo->start_julian || !tag_calendar->priv->dates->len)
 		return;
 
-	start_julian = oinfo->start_julian;
-	end_julian = oinfo->end_julian;
-
-	if (inc) {
-		if (start_julian < tag_calendar->priv->range_start_julian)
-			start_julian = tag_calendar->priv->range_start_julian;
-
-		if (end_julian > tag_calendar->priv->range_end_julian)
-			end_julian = tag_calendar->priv->range_end_julian;
-	}
+	/* All the covered dates of the component are counted, not only
+	 * the shown, thus the counts are still right when the shown months
+	 * change within the covered dates, while the data model keeps
+	 * the component. */
+	start_julian = MAX (oinfo->start_julian, tag_calendar->priv->dates_start_julian);
+	end_julian = MIN (oinfo->end_julian, tag_calendar->priv->dates_start_julian + tag_calendar->priv->dates->len - 1);
 
 	for (dt = start_julian; dt <= end_julian; dt++) {
-		dinfo = g_hash_table_lookup (tag_calendar->priv->dates, GUINT_TO_POINTER (dt));
+		dinfo = e_tag_calendar_get_date_info (tag_calendar, dt);
 
-		if (!dinfo) {
-			if (!inc)
-				continue;
-
-			dinfo = date_info_new ();
-			g_hash_table_insert (tag_calendar->priv->dates, GUINT_TO_POINTER (dt), dinfo);
-		}
-
-		if (date_info_update (dinfo, oinfo, inc)) {
+		/* Only the shown dates need to be marked */
+		if (date_info_update (dinfo, oinfo, inc) &&
+		    dt >= tag_calendar->priv->range_start_julian &&
+		    dt <= tag_calendar->priv->range_end_julian) {
 			gint year, month, day;
 			guint8 style;
 
@@ -448,9 +482,6 @@ e_tag_calendar_update_by_oinfo (ETagCalendar *tag_calendar,
 			style = date_info_get_style (dinfo, tag_calendar->priv->recur_events_italic);
 
 			e_calendar_item_mark_day (calitem, year, month - 1, day, style, FALSE);
-
-			if (!style && !inc)
-				g_hash_table_remove (tag_calendar->priv->dates, GUINT_TO_POINTER (dt));
 		}
 	}
 }
@@ -712,7 +743,7 @@ e_tag_calendar_finalize (GObject *object)
 	g_warn_if_fail (tag_calendar->priv->data_model == NULL);
 
 	g_hash_table_destroy (tag_calendar->priv->objects);
-	g_hash_table_destroy (tag_calendar->priv->dates);
+	g_array_free (tag_calendar->priv->dates, TRUE);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_tag_calendar_parent_class)->finalize (object);
@@ -775,11 +806,7 @@ e_tag_calendar_init (ETagCalendar *tag_calendar)
 		object_info_free,
 		NULL);
 
-	tag_calendar->priv->dates = g_hash_table_new_full (
-		g_direct_hash,
-		g_direct_equal,
-		NULL,
-		date_info_free);
+	tag_calendar->priv->dates = g_array_new (FALSE, TRUE, sizeof (DateInfo));
 }
 
 ETagCalendar *
@@ -857,7 +884,7 @@ e_tag_calendar_unsubscribe (ETagCalendar *tag_calendar,
 		e_calendar_item_clear_marks (tag_calendar->priv->calitem);
 
 	g_hash_table_remove_all (tag_calendar->priv->objects);
-	g_hash_table_remove_all (tag_calendar->priv->dates);
+	g_array_set_size (tag_calendar->priv->dates, 0);
 }
 
 struct calendar_tag_closure {
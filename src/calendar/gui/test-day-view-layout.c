@@ -0,0 +1,328 @@
+/*
+ * test-day-view-layout.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Compares e_day_view_layout_day_events() with the grid layout it replaced,
+ * which is kept below as the reference, on random sets of events. */
+
+#include "evolution-config.h"
+
+#include <string.h>
+
+#include "e-day-view-layout.h"
+
+#define N_ITERATIONS 20000
+#define DAY_MINUTES (24 * 60)
+
+/* Finds the first free position to place the event in.
+ * Increments the number of events in each of the rows it covers, and makes
+ * sure they are all in one group. */
+static void
+reference_layout_day_event (EDayViewEvent *event,
+                            EBitArray **grid,
+                            guint16 *group_starts,
+                            guint8 *cols_per_row,
+                            gint rows,
+                            gint mins_per_row,
+                            gint max_cols)
+{
+	gint start_row, end_row, free_col, col, row, group_start;
+
+	start_row = event->start_minute / mins_per_row;
+	end_row = (event->end_minute - 1) / mins_per_row;
+	if (end_row < start_row)
+		end_row = start_row;
+
+	event->num_columns = 0;
+
+	/* If the event can't currently be seen, just return. */
+	if (start_row >= rows || end_row < 0)
+		return;
+
+	/* Make sure we don't go outside the visible times. */
+	start_row = CLAMP (start_row, 0, rows - 1);
+	end_row = CLAMP (end_row, 0, rows - 1);
+
+	/* Try each column until we find a free one. */
+	for (col = 0; max_cols <= 0 || col < max_cols; col++) {
+		free_col = col;
+		for (row = start_row; row <= end_row; row++) {
+			if (e_bit_array_bit_count (grid[row]) > col &&
+			    e_bit_array_value_at (grid[row], col)) {
+				free_col = -1;
+				break;
+			}
+		}
+
+		if (free_col != -1)
+			break;
+	}
+
+	/* If we can't find space for the event, just return. */
+	if (free_col == -1)
+		return;
+
+	/* The event is assigned 1 col initially, but may be expanded later. */
+	event->start_row_or_col = free_col;
+	event->num_columns = 1;
+
+	/* Determine the start index of the group. */
+	group_start = group_starts[start_row];
+
+	/* Increment number of events in each of the rows the event covers.
+	 * We use the cols_per_row array for this. It will be sorted out after
+	 * all the events have been layed out. Also make sure all the rows that
+	 * the event covers are in one group. */
+	for (row = start_row; row <= end_row; row++) {
+		/* resize the array if necessary */
+		if (e_bit_array_bit_count (grid[row]) <= free_col)
+			e_bit_array_insert (
+				grid[row], e_bit_array_bit_count (grid[row]),
+				free_col - e_bit_array_bit_count (grid[row]) + 1);
+
+		e_bit_array_change_one_row (grid[row], free_col, TRUE);
+		cols_per_row[row]++;
+		group_starts[row] = group_start;
+	}
+
+	/* If any following rows should be in the same group, add them. */
+	for (row = end_row + 1; row < rows; row++) {
+		if (group_starts[row] > end_row)
+			break;
+		group_starts[row] = group_start;
+	}
+}
+
+/* For each group of rows, find the max number of events in all the
+ * rows, and set the number of cols in each of the rows to that. */
+static void
+reference_recalc_cols_per_row (gint rows,
+                               guint8 *cols_per_row,
+                               guint16 *group_starts)
+{
+	gint start_row = 0, row, next_start_row, max_events;
+
+	while (start_row < rows) {
+		max_events = 0;
+		for (row = start_row; row < rows && group_starts[row] == start_row; row++)
+			max_events = MAX (max_events, cols_per_row[row]);
+
+		next_start_row = row;
+
+		for (row = start_row; row < next_start_row; row++)
+			cols_per_row[row] = max_events;
+
+		start_row = next_start_row;
+	}
+}
+
+/* Expands the event horizontally to fill any free space. */
+static void
+reference_expand_day_event (EDayViewEvent *event,
+                            EBitArray **grid,
+                            guint8 *cols_per_row,
+                            gint mins_per_row)
+{
+	gint start_row, end_row, col, row;
+	gboolean clashed;
+
+	start_row = event->start_minute / mins_per_row;
+	end_row = (event->end_minute - 1) / mins_per_row;
+	if (end_row < start_row)
+		end_row = start_row;
+
+	/* Try each column until we find a free one. */
+	clashed = FALSE;
+	for (col = event->start_row_or_col + 1; col < cols_per_row[start_row]; col++) {
+		for (row = start_row; row <= end_row; row++) {
+			if (e_bit_array_bit_count (grid[row]) > col &&
+			    e_bit_array_value_at (grid[row], col)) {
+				clashed = TRUE;
+				break;
+			}
+		}
+
+		if (clashed)
+			break;
+
+		event->num_columns++;
+	}
+}
+
+static gint
+reference_layout_day_events (GArray *events,
+                             gint rows,
+                             gint mins_per_row,
+                             guint8 *cols_per_row,
+                             gint max_cols)
+{
+	EDayViewEvent *event;
+	gint row, event_num, res;
+	EBitArray **grid;
+	guint16 group_starts[12 * 24];
+
+	grid = g_new0 (EBitArray *, rows);
+
+	for (row = 0; row < rows; row++) {
+		cols_per_row[row] = 0;
+		group_starts[row] = row;
+		grid[row] = e_bit_array_new (0);
+	}
+
+	for (event_num = 0; event_num < events->len; event_num++) {
+		event = &g_array_index (events, EDayViewEvent, event_num);
+
+		reference_layout_day_event (
+			event, grid, group_starts,
+			cols_per_row, rows, mins_per_row, max_cols);
+	}
+
+	reference_recalc_cols_per_row (rows, cols_per_row, group_starts);
+
+	for (event_num = 0; event_num < events->len; event_num++) {
+		event = &g_array_index (events, EDayViewEvent, event_num);
+		reference_expand_day_event (
+			event, grid, cols_per_row,
+			mins_per_row);
+	}
+
+	res = 0;
+	for (row = 0; row < rows; row++) {
+		res = MAX (res, e_bit_array_bit_count (grid[row]));
+		g_object_unref (grid[row]);
+	}
+	g_free (grid);
+
+	return res;
+}
+
+/* The same order as e_day_view_event_sort_func(), in which the day view
+ * lays out its events. */
+static gint
+compare_events (gconstpointer arg1,
+                gconstpointer arg2)
+{
+	const EDayViewEvent *event1 = arg1, *event2 = arg2;
+
+	if (event1->start < event2->start)
+		return -1;
+	if (event1->start > event2->start)
+		return 1;
+
+	if (event1->end > event2->end)
+		return -1;
+	if (event1->end < event2->end)
+		return 1;
+
+	return 0;
+}
+
+static GArray *
+create_events (GRand *rand,
+               gint n_events)
+{
+	GArray *events;
+	gint ii;
+
+	events = g_array_new (FALSE, TRUE, sizeof (EDayViewEvent));
+
+	for (ii = 0; ii < n_events; ii++) {
+		EDayViewEvent event;
+		gint length;
+
+		memset (&event, 0, sizeof (EDayViewEvent));
+
+		/* Mostly short events, some long and some without duration */
+		if (g_rand_int_range (rand, 0, 4) == 0)
+			length = 0;
+		else if (g_rand_boolean (rand))
+			length = g_rand_int_range (rand, 1, 60);
+		else
+			length = g_rand_int_range (rand, 1, 400);
+
+		event.start_minute = g_rand_int_range (rand, 0, DAY_MINUTES);
+		event.end_minute = MIN (event.start_minute + length, DAY_MINUTES);
+		event.start = event.start_minute * 60;
+		event.end = event.end_minute * 60;
+
+		/* Left from a previous layout */
+		event.start_row_or_col = g_rand_int_range (rand, 0, 3);
+
+		g_array_append_val (events, event);
+	}
+
+	g_array_sort (events, compare_events);
+
+	return events;
+}
+
+static void
+test_layout_day_events (void)
+{
+	const gint mins_per_rows[] = { 5, 10, 15, 30, 60 };
+	GRand *rand;
+	gint iter;
+
+	rand = g_rand_new_with_seed (20181019);
+
+	for (iter = 0; iter < N_ITERATIONS; iter++) {
+		GArray *expected, *events;
+		guint8 expected_cols_per_row[12 * 24], cols_per_row[12 * 24];
+		gint mins_per_row, rows, max_cols, expected_res, res;
+		guint ii;
+
+		mins_per_row = mins_per_rows[g_rand_int_range (rand, 0, G_N_ELEMENTS (mins_per_rows))];
+		rows = DAY_MINUTES / mins_per_row;
+		max_cols = g_rand_int_range (rand, 0, 3) == 0 ? -1 : g_rand_int_range (rand, 1, 7);
+
+		expected = create_events (rand, g_rand_int_range (rand, 0, (iter % 10) == 0 ? 300 : 40));
+
+		events = g_array_new (FALSE, TRUE, sizeof (EDayViewEvent));
+		g_array_append_vals (events, expected->data, expected->len);
+
+		expected_res = reference_layout_day_events (expected, rows, mins_per_row, expected_cols_per_row, max_cols);
+		res = e_day_view_layout_day_events (events, rows, mins_per_row, cols_per_row, max_cols);
+
+		g_assert_cmpint (res, ==, expected_res);
+		g_assert_cmpmem (cols_per_row, rows, expected_cols_per_row, rows);
+
+		for (ii = 0; ii < events->len; ii++) {
+			EDayViewEvent *expected_event = &g_array_index (expected, EDayViewEvent, ii);
+			EDayViewEvent *event = &g_array_index (events, EDayViewEvent, ii);
+
+			g_assert_cmpint (event->num_columns, ==, expected_event->num_columns);
+
+			if (event->num_columns)
+				g_assert_cmpint (event->start_row_or_col, ==, expected_event->start_row_or_col);
+		}
+
+		g_array_free (expected, TRUE);
+		g_array_free (events, TRUE);
+	}
+
+	g_rand_free (rand);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/EDayViewLayout/DayEvents", test_layout_day_events);
+
+	return g_test_run ();
+}
@@ -63,6 +63,7 @@ struct _EAttachmentPrivate {
 	GFile *file;
 	GIcon *icon;
 	GFileInfo *file_info;
+	GFile *thumbnail_file;
 	GCancellable *cancellable;
 	CamelMimePart *mime_part;
 	guint emblem_timeout_id;
@@ -122,62 +123,275 @@ G_DEFINE_TYPE (
 	e_attachment,
 	G_TYPE_OBJECT)
 
-static gboolean
-create_system_thumbnail (EAttachment *attachment,
-                         GIcon **icon)
-{
+static void attachment_update_icon_column (EAttachment *attachment);
+
+#ifdef HAVE_GNOME_DESKTOP
+
+/* Thumbnails of the attachments are created by a few worker threads shared
+ * by all the attachments. They are kept in a cache keyed by the file URI,
+ * modification time and size, like in the freedesktop.org thumbnail spec,
+ * thus the same file shown again does not run the thumbnailer again and
+ * its content is never read only to look the thumbnail up. */
+#define THUMBNAIL_MAX_THREADS		2
+#define THUMBNAIL_CACHE_MAX_AGE		(30 * 24 * 60 * 60)
+
+typedef struct _ThumbnailData {
+	GWeakRef *attachment_weak_ref;
 	GFile *file;
-	GFile *icon_file;
-	gchar *file_path = NULL;
-	gchar *thumbnail = NULL;
+	gchar *thumbnail_path;
+} ThumbnailData;
+
+static GMutex thumbnails_lock;
+static GCond thumbnails_cond;
+static GHashTable *thumbnails_cache = NULL;	/* gchar *key ~> gchar *path; "" when failed */
+static GHashTable *thumbnails_running = NULL;	/* gchar *key */
+
+static const gchar *
+attachment_get_thumbnails_dir (void)
+{
+	static gchar *thumbnails_dir = NULL;
+
+	if (g_once_init_enter (&thumbnails_dir)) {
+		gchar *dir;
+
+		dir = g_build_filename (e_get_user_cache_dir (), "attachment-thumbnails", NULL);
+		g_mkdir_with_parents (dir, 0700);
+
+		g_once_init_leave (&thumbnails_dir, dir);
+	}
+
+	return thumbnails_dir;
+}
+
+static void
+attachment_prune_thumbnails_dir (void)
+{
+	const gchar *thumbnails_dir;
+	const gchar *name;
+	GDir *dir;
+	gint64 now;
+
+	thumbnails_dir = attachment_get_thumbnails_dir ();
+
+	dir = g_dir_open (thumbnails_dir, 0, NULL);
+	if (!dir)
+		return;
+
+	now = g_get_real_time () / G_USEC_PER_SEC;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		GStatBuf st;
+		gchar *filename;
+
+		filename = g_build_filename (thumbnails_dir, name, NULL);
+
+		if (g_stat (filename, &st) == 0 && now - st.st_mtime > THUMBNAIL_CACHE_MAX_AGE)
+			g_unlink (filename);
+
+		g_free (filename);
+	}
+
+	g_dir_close (dir);
+}
+
+static gchar *
+attachment_get_thumbnail_key (GFile *file)
+{
+	GFileInfo *file_info;
+	gchar *uri, *data, *key;
+
+	file_info = g_file_query_info (
+		file,
+		G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+		G_FILE_ATTRIBUTE_STANDARD_SIZE,
+		G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (!file_info)
+		return NULL;
+
+	uri = g_file_get_uri (file);
+	data = g_strdup_printf (
+		"%s\n%" G_GUINT64_FORMAT "\n%" G_GOFFSET_FORMAT, uri,
+		g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+		g_file_info_get_size (file_info));
+
+	key = g_compute_checksum_for_string (G_CHECKSUM_SHA256, data, -1);
+
+	g_object_unref (file_info);
+	g_free (data);
+	g_free (uri);
+
+	return key;
+}
+
+/* Returns path to the cached thumbnail for the key, or NULL,
+ * when the file cannot be thumbnailed. */
+static gchar *
+attachment_create_cached_thumbnail (const gchar *file_path,
+				    const gchar *key)
+{
+	gchar *cache_path, *thumbnail;
+	gchar *contents = NULL;
+	gsize length = 0;
 	gboolean success = FALSE;
 
-	g_return_val_if_fail (E_IS_ATTACHMENT (attachment), FALSE);
-	g_return_val_if_fail (icon != NULL, FALSE);
+	cache_path = g_strconcat (attachment_get_thumbnails_dir (), G_DIR_SEPARATOR_S, key, ".png", NULL);
 
-	file = e_attachment_ref_file (attachment);
-	if (file != NULL)
-		file_path = g_file_get_path (file);
+	if (g_file_test (cache_path, G_FILE_TEST_IS_REGULAR)) {
+		/* The cache is pruned by the last use, not by the creation */
+		g_utime (cache_path, NULL);
 
-	if (file_path != NULL) {
-		thumbnail = e_icon_factory_create_thumbnail (file_path);
-		g_free (file_path);
+		return cache_path;
 	}
 
-	if (thumbnail == NULL)
-		goto exit;
+	/* The system thumbnail is stored for the file path, which is
+	 * usually a temporary file, thus copy it to the own cache. */
+	thumbnail = e_icon_factory_create_thumbnail (file_path);
 
-	icon_file = g_file_new_for_path (thumbnail);
+	if (thumbnail && g_file_get_contents (thumbnail, &contents, &length, NULL))
+		success = g_file_set_contents (cache_path, contents, length, NULL);
 
-	if (*icon != NULL)
-		g_object_unref (*icon);
+	g_free (contents);
+	g_free (thumbnail);
 
-	*icon = g_file_icon_new (icon_file);
+	if (!success)
+		g_clear_pointer (&cache_path, g_free);
 
-	g_object_unref (icon_file);
+	return cache_path;
+}
 
-	if (file != NULL) {
+static gboolean
+attachment_thumbnail_done_idle_cb (gpointer user_data)
+{
+	ThumbnailData *td = user_data;
+	EAttachment *attachment;
+
+	attachment = g_weak_ref_get (td->attachment_weak_ref);
+
+	if (attachment && td->thumbnail_path) {
+		GFile *file;
 		GFileInfo *file_info;
-		const gchar *attribute;
 
+		file = e_attachment_ref_file (attachment);
 		file_info = e_attachment_ref_file_info (attachment);
-		attribute = G_FILE_ATTRIBUTE_THUMBNAIL_PATH;
 
-		if (file_info != NULL) {
+		/* The attachment could change its file meanwhile */
+		if (file && file_info && g_file_equal (file, td->file)) {
 			g_file_info_set_attribute_byte_string (
-				file_info, attribute, thumbnail);
-			g_object_unref (file_info);
+				file_info, G_FILE_ATTRIBUTE_THUMBNAIL_PATH,
+				td->thumbnail_path);
+
+			attachment_update_icon_column (attachment);
 		}
+
+		g_clear_object (&file_info);
+		g_clear_object (&file);
 	}
 
-	g_free (thumbnail);
+	g_clear_object (&attachment);
 
-	success = TRUE;
+	e_weak_ref_free (td->attachment_weak_ref);
+	g_object_unref (td->file);
+	g_free (td->thumbnail_path);
+	g_slice_free (ThumbnailData, td);
 
-exit:
-	g_clear_object (&file);
+	return FALSE;
+}
 
-	return success;
+static void
+attachment_thumbnail_thread (gpointer data,
+			     gpointer user_data)
+{
+	static gsize pruned = 0;
+	ThumbnailData *td = data;
+	gchar *file_path;
+	gchar *key = NULL;
+
+	if (g_once_init_enter (&pruned)) {
+		attachment_prune_thumbnails_dir ();
+		g_once_init_leave (&pruned, 1);
+	}
+
+	/* Check for the thumbnailer first, before anything is looked up */
+	file_path = g_file_get_path (td->file);
+	if (file_path && e_icon_factory_can_thumbnail (file_path))
+		key = attachment_get_thumbnail_key (td->file);
+
+	if (key) {
+		const gchar *cached;
+
+		g_mutex_lock (&thumbnails_lock);
+
+		/* The same file can be thumbnailed for another attachment
+		 * right now, then wait for it and use its result. */
+		while (g_hash_table_contains (thumbnails_running, key))
+			g_cond_wait (&thumbnails_cond, &thumbnails_lock);
+
+		cached = g_hash_table_lookup (thumbnails_cache, key);
+		if (!cached)
+			g_hash_table_add (thumbnails_running, g_strdup (key));
+		else if (*cached)
+			td->thumbnail_path = g_strdup (cached);
+
+		g_mutex_unlock (&thumbnails_lock);
+
+		if (!cached) {
+			td->thumbnail_path = attachment_create_cached_thumbnail (file_path, key);
+
+			g_mutex_lock (&thumbnails_lock);
+			g_hash_table_insert (thumbnails_cache, g_strdup (key), g_strdup (td->thumbnail_path ? td->thumbnail_path : ""));
+			g_hash_table_remove (thumbnails_running, key);
+			g_cond_broadcast (&thumbnails_cond);
+			g_mutex_unlock (&thumbnails_lock);
+		}
+	}
+
+	g_free (key);
+	g_free (file_path);
+
+	g_idle_add (attachment_thumbnail_done_idle_cb, td);
+}
+
+#endif /* HAVE_GNOME_DESKTOP */
+
+static void
+attachment_request_thumbnail (EAttachment *attachment)
+{
+#ifndef HAVE_GNOME_DESKTOP
+	/* There is no system thumbnailer */
+#else
+	static GThreadPool *thread_pool = NULL;
+	ThumbnailData *td;
+	GFile *file;
+
+	file = e_attachment_ref_file (attachment);
+
+	/* Only local files can be thumbnailed, and each only once */
+	if (!file || !g_file_is_native (file) ||
+	    (attachment->priv->thumbnail_file && g_file_equal (file, attachment->priv->thumbnail_file))) {
+		g_clear_object (&file);
+		return;
+	}
+
+	if (g_once_init_enter (&thread_pool)) {
+		GThreadPool *pool;
+
+		thumbnails_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		thumbnails_running = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+		pool = g_thread_pool_new (attachment_thumbnail_thread, NULL, THUMBNAIL_MAX_THREADS, FALSE, NULL);
+
+		g_once_init_leave (&thread_pool, pool);
+	}
+
+	g_clear_object (&attachment->priv->thumbnail_file);
+	attachment->priv->thumbnail_file = g_object_ref (file);
+
+	td = g_slice_new0 (ThumbnailData);
+	td->attachment_weak_ref = e_weak_ref_new (attachment);
+	td->file = file;
+
+	g_thread_pool_push (thread_pool, td, NULL);
+#endif /* HAVE_GNOME_DESKTOP */
 }
 
 static gchar *
@@ -343,7 +557,6 @@ attachment_update_icon_column_idle_cb (gpointer weak_ref)
 
 	if (file_info != NULL) {
 		icon = g_file_info_get_icon (file_info);
-		/* add the reference here, thus the create_system_thumbnail() can unref the *icon. */
 		if (icon)
 			g_object_ref (icon);
 		thumbnail_path = g_file_info_get_attribute_byte_string (
@@ -362,13 +575,10 @@ attachment_update_icon_column_idle_cb (gpointer weak_ref)
 		icon = g_file_icon_new (file);
 		g_object_unref (file);
 
-	/* Try the system thumbnailer. */
-	} else if (create_system_thumbnail (attachment, &icon)) {
-		/* Nothing to do, just use the icon. */
-
-	/* Else use the standard icon for the content type. */
+	/* Else use the standard icon for the content type, until
+	 * the system thumbnailer has a thumbnail for it, if ever. */
 	} else if (icon != NULL) {
-		/* Nothing to do, just use the already reffed icon. */
+		attachment_request_thumbnail (attachment);
 
 	/* Last ditch fallback.  (GFileInfo not yet loaded?) */
 	} else
@@ -782,6 +992,7 @@ attachment_dispose (GObject *object)
 	g_clear_object (&priv->file);
 	g_clear_object (&priv->icon);
 	g_clear_object (&priv->file_info);
+	g_clear_object (&priv->thumbnail_file);
 	g_clear_object (&priv->cancellable);
 	g_clear_object (&priv->mime_part);
 
@@ -68,27 +68,93 @@ static gint special_chars[] = {
 #define is_trailing_garbage(c) (c > 127 || (special_chars[c] & 2))
 #define is_domain_name_char(c) (c < 128 && (special_chars[c] & 4))
 
+/* Classes of the characters for the e_text_to_html_full() main loop:
+ *
+ * 1 = plain chars, copied to the output as they are
+ * 2 = letters a recognized URL can start with; plain, unless URLs are converted
+ *
+ * Everything else, including all non-ASCII, needs a closer look.
+ */
+#define TEXT_CHAR_PLAIN		1
+#define TEXT_CHAR_URL_START	2
+
+static const guchar text_chars[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0,    /*  nul - 0x0f */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,    /* 0x10 - 0x1f */
+	0, 1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1,    /*   sp - /    */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1,    /*    0 - ?    */
+	0, 1, 1, 2, 1, 1, 2, 1, 2, 1, 1, 1, 1, 2, 2, 1,    /*    @ - O    */
+	1, 1, 1, 2, 2, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1,    /*    P - _    */
+	1, 1, 1, 2, 1, 1, 2, 1, 2, 1, 1, 1, 1, 2, 2, 1,    /*    ` - o    */
+	1, 1, 1, 2, 2, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1     /*    p - del  */
+};
+
+/* Keep in sync with the TEXT_CHAR_URL_START letters above */
+static const struct {
+	const gchar *prefix;
+	gsize len;
+} url_schemes[] = {
+	{ "http://", 7 },
+	{ "https://", 8 },
+	{ "ftp://", 6 },
+	{ "nntp://", 7 },
+	{ "mailto:", 7 },
+	{ "news:", 5 },
+	{ "file:", 5 },
+	{ "callto:", 7 },
+	{ "h323:", 5 },
+	{ "sip:", 4 },
+	{ "tel:", 4 },
+	{ "webcal:", 7 }
+};
+
+static gboolean
+is_url_scheme (const guchar *text)
+{
+	guchar first = g_ascii_tolower (*text);
+	guint ii;
+
+	for (ii = 0; ii < G_N_ELEMENTS (url_schemes); ii++) {
+		if (url_schemes[ii].prefix[0] == first &&
+		    !g_ascii_strncasecmp ((const gchar *) text, url_schemes[ii].prefix, url_schemes[ii].len))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* The end of the run of URL chars the URL candidates are in, and the end
+ * without the trailing garbage.  Every candidate within the same run ends
+ * at the same place, thus the run is scanned only once, not once for each
+ * candidate in it. */
+typedef struct _UrlRun {
+	const guchar *run_end;
+	const guchar *end;
+} UrlRun;
+
 /* (http|https|ftp|nntp)://[^ "|/]+\.([^ "|]*[^ ,.!?;:>)\]}`'"|_-])+ */
 /* www\.[A-Za-z0-9.-]+(/([^ "|]*[^ ,.!?;:>)\]}`'"|_-])+)             */
 
 static gchar *
 url_extract (const guchar **text,
              gboolean full_url,
-	     gboolean use_whole_text)
+             UrlRun *run)
 {
-	const guchar *end = *text, *p;
+	const guchar *end, *p;
 	gchar *out;
 
-	if (use_whole_text) {
-		end = (*text) + strlen ((const gchar *) (*text));
-	} else {
-		while (*end && is_url_char (*end))
-			end++;
+	if (run->run_end <= *text) {
+		for (end = *text; *end && is_url_char (*end); end++)
+			;
+		run->run_end = end;
+
+		/* Back up if we probably went too far. */
+		while (end > *text && is_trailing_garbage (*(end - 1)))
+			end--;
+		run->end = end;
 	}
 
-	/* Back up if we probably went too far. */
-	while (end > *text && is_trailing_garbage (*(end - 1)))
-		end--;
+	end = MAX (run->end, *text);
 
 	if (full_url) {
 		/* Make sure this really looks like a URL. */
@@ -110,16 +176,19 @@ url_extract (const guchar **text,
 	return out;
 }
 
+/* The local-part cannot reach before @addr_floor, which is past the previous
+ * '@' or the line start, thus every char is looked at only once. */
 static gchar *
 email_address_extract (const guchar **cur,
                        gchar **out,
-                       const guchar *linestart)
+                       const guchar *linestart,
+                       const guchar *addr_floor)
 {
 	const guchar *start, *end, *dot;
 	gchar *addr;
 
 	/* *cur points to the '@'. Look backward for a valid local-part */
-	for (start = *cur; start - 1 >= linestart && is_addr_char (*(start - 1)); start--)
+	for (start = *cur; start - 1 >= addr_floor && is_addr_char (*(start - 1)); start--)
 		;
 	if (start == *cur)
 		return NULL;
@@ -238,23 +307,43 @@ e_text_to_html_full (const gchar *input,
                      guint flags,
                      guint32 color)
 {
-	const guchar *cur, *next, *linestart;
+	const guchar *cur, *next, *linestart, *addr_floor;
 	gchar *buffer = NULL;
 	gchar *out = NULL;
 	gint buffer_size = 0, col;
+	gsize input_len;
 	gboolean colored = FALSE, saw_citation = FALSE;
+	guchar plain_mask;
+	UrlRun url_run;
+
+	input_len = strlen (input);
 
 	/* Allocate a translation buffer.  */
-	buffer_size = strlen (input) * 2 + 5;
+	buffer_size = input_len * 2 + 6;
 	buffer = g_malloc (buffer_size);
 
+	/* The whole text is one URL, up to its trailing garbage */
+	url_run.run_end = (const guchar *) input;
+	url_run.end = (const guchar *) input;
+	if (flags & E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT) {
+		url_run.run_end += input_len;
+		url_run.end += input_len;
+
+		while (url_run.end > (const guchar *) input && is_trailing_garbage (*(url_run.end - 1)))
+			url_run.end--;
+	}
+
 	out = buffer;
 	if (flags & E_TEXT_TO_HTML_PRE)
 		out += sprintf (out, "<PRE>");
 
 	col = 0;
 
-	for (cur = linestart = (const guchar *) input; cur && *cur; cur = next) {
+	plain_mask = TEXT_CHAR_PLAIN;
+	if (!(flags & E_TEXT_TO_HTML_CONVERT_URLS))
+		plain_mask |= TEXT_CHAR_URL_START;
+
+	for (cur = linestart = addr_floor = (const guchar *) input; cur && *cur; cur = next) {
 		gunichar u;
 
 		if (flags & E_TEXT_TO_HTML_MARK_CITATION && col == 0) {
@@ -285,24 +374,26 @@ e_text_to_html_full (const gchar *input,
 			out += sprintf (out, "&gt; ");
 		}
 
+		/* Copy the run of plain characters at once; it never
+		 * spans lines, thus the above is done for each line. */
+		for (next = cur; *next < 128 && (text_chars[*next] & plain_mask) != 0; next++)
+			;
+
+		if (next != cur) {
+			out = check_size (&buffer, &buffer_size, out, next - cur);
+			memcpy (out, cur, next - cur);
+			out += next - cur;
+			col += next - cur;
+			continue;
+		}
+
 		u = g_utf8_get_char ((gchar *) cur);
 		if (g_unichar_isalpha (u) &&
 		    (flags & E_TEXT_TO_HTML_CONVERT_URLS)) {
 			gchar *tmpurl = NULL, *refurl = NULL, *dispurl = NULL;
 
-			if (!g_ascii_strncasecmp ((gchar *) cur, "http://", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "https://", 8) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "ftp://", 6) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "nntp://", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "mailto:", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "news:", 5) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "file:", 5) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "callto:", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "h323:", 5) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "sip:", 4) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "tel:", 4) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "webcal:", 7)) {
-				tmpurl = url_extract (&cur, TRUE, (flags & E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT) != 0);
+			if (is_url_scheme (cur)) {
+				tmpurl = url_extract (&cur, TRUE, &url_run);
 				if (tmpurl) {
 					refurl = e_text_to_html (tmpurl, 0);
 					if ((flags & E_TEXT_TO_HTML_HIDE_URL_SCHEME) != 0) {
@@ -325,7 +416,7 @@ e_text_to_html_full (const gchar *input,
 				}
 			} else if (!g_ascii_strncasecmp ((gchar *) cur, "www.", 4) &&
 				   is_url_char (*(cur + 4))) {
-				tmpurl = url_extract (&cur, FALSE, (flags & E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT) != 0);
+				tmpurl = url_extract (&cur, FALSE, &url_run);
 				if (tmpurl) {
 					dispurl = e_text_to_html (tmpurl, 0);
 					refurl = g_strdup_printf (
@@ -365,9 +456,11 @@ e_text_to_html_full (const gchar *input,
 		}
 
 		if (u == '@' && (flags & E_TEXT_TO_HTML_CONVERT_ADDRESSES)) {
+			const guchar *at = cur;
 			gchar *addr, *dispaddr, *outaddr;
 
-			addr = email_address_extract (&cur, &out, linestart);
+			addr = email_address_extract (&cur, &out, linestart, addr_floor);
+			addr_floor = at + 1;
 			if (addr) {
 				dispaddr = e_text_to_html (addr, 0);
 				outaddr = g_strdup_printf (
@@ -428,7 +521,7 @@ e_text_to_html_full (const gchar *input,
 				out += 4;
 			}
 			*out++ = *cur;
-			linestart = cur;
+			linestart = addr_floor = cur;
 			col = 0;
 			break;
 
@@ -154,6 +154,94 @@ e_icon_factory_pixbuf_scale (GdkPixbuf *pixbuf,
 	return gdk_pixbuf_scale_simple (pixbuf, width, height, GDK_INTERP_BILINEAR);
 }
 
+#ifdef HAVE_GNOME_DESKTOP
+static GnomeDesktopThumbnailFactory *
+icon_factory_get_thumbnail_factory (void)
+{
+	static GnomeDesktopThumbnailFactory *thumbnail_factory = NULL;
+
+	/* Can be called from multiple threads at once */
+	if (g_once_init_enter (&thumbnail_factory)) {
+		GnomeDesktopThumbnailFactory *factory;
+
+		factory = gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_NORMAL);
+
+		g_once_init_leave (&thumbnail_factory, factory);
+	}
+
+	return thumbnail_factory;
+}
+
+/* Returns the URI and the MIME type of a regular file, or FALSE */
+static gboolean
+icon_factory_get_thumbnail_source (const gchar *filename,
+                                   gchar **out_uri,
+                                   gchar **out_mime,
+                                   time_t *out_mtime)
+{
+	struct stat file_stat;
+	gchar *content_type, *mime = NULL;
+	gboolean uncertain = FALSE;
+
+	if (g_stat (filename, &file_stat) == -1 || !S_ISREG (file_stat.st_mode))
+		return FALSE;
+
+	content_type = g_content_type_guess (filename, NULL, 0, &uncertain);
+	if (content_type)
+		mime = g_content_type_get_mime_type (content_type);
+	g_free (content_type);
+
+	if (!mime)
+		return FALSE;
+
+	*out_uri = g_filename_to_uri (filename, NULL, NULL);
+	if (!*out_uri) {
+		g_free (mime);
+		return FALSE;
+	}
+
+	*out_mime = mime;
+	*out_mtime = file_stat.st_mtime;
+
+	return TRUE;
+}
+#endif /* HAVE_GNOME_DESKTOP */
+
+/**
+ * e_icon_factory_can_thumbnail
+ * @filename: the file name to check
+ *
+ * Checks whether a system thumbnailer exists for the type of @filename,
+ * without reading its content.
+ *
+ * Returns: Whether e_icon_factory_create_thumbnail() can create
+ *          a thumbnail for @filename.
+ **/
+gboolean
+e_icon_factory_can_thumbnail (const gchar *filename)
+{
+#ifdef HAVE_GNOME_DESKTOP
+	gchar *uri = NULL, *mime = NULL;
+	time_t mtime = 0;
+	gboolean can_thumbnail;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	if (!icon_factory_get_thumbnail_source (filename, &uri, &mime, &mtime))
+		return FALSE;
+
+	can_thumbnail = gnome_desktop_thumbnail_factory_can_thumbnail (
+		icon_factory_get_thumbnail_factory (), uri, mime, mtime);
+
+	g_free (uri);
+	g_free (mime);
+
+	return can_thumbnail;
+#else
+	return FALSE;
+#endif /* HAVE_GNOME_DESKTOP */
+}
+
 /**
  * e_icon_factory_create_thumbnail
  * @filename: the file name to create the thumbnail for
@@ -167,47 +255,31 @@ gchar *
 e_icon_factory_create_thumbnail (const gchar *filename)
 {
 #ifdef HAVE_GNOME_DESKTOP
-	static GnomeDesktopThumbnailFactory *thumbnail_factory = NULL;
-	struct stat file_stat;
+	GnomeDesktopThumbnailFactory *thumbnail_factory;
+	gchar *uri = NULL, *mime = NULL;
+	time_t mtime = 0;
 	gchar *thumbnail = NULL;
 
 	g_return_val_if_fail (filename != NULL, NULL);
 
-	if (thumbnail_factory == NULL) {
-		thumbnail_factory = gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_NORMAL);
-	}
+	thumbnail_factory = icon_factory_get_thumbnail_factory ();
 
-	if (g_stat (filename, &file_stat) != -1 && S_ISREG (file_stat.st_mode)) {
-		gchar *content_type, *mime = NULL;
-		gboolean uncertain = FALSE;
+	if (icon_factory_get_thumbnail_source (filename, &uri, &mime, &mtime)) {
+		thumbnail = gnome_desktop_thumbnail_factory_lookup (thumbnail_factory, uri, mtime);
+		if (!thumbnail && gnome_desktop_thumbnail_factory_can_thumbnail (thumbnail_factory, uri, mime, mtime)) {
+			GdkPixbuf *pixbuf;
 
-		content_type = g_content_type_guess (filename, NULL, 0, &uncertain);
-		if (content_type)
-			mime = g_content_type_get_mime_type (content_type);
+			pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory, uri, mime);
 
-		if (mime) {
-			gchar *uri = g_filename_to_uri (filename, NULL, NULL);
+			if (pixbuf) {
+				gnome_desktop_thumbnail_factory_save_thumbnail (thumbnail_factory, pixbuf, uri, mtime);
+				g_object_unref (pixbuf);
 
-			g_return_val_if_fail (uri != NULL, NULL);
-
-			thumbnail = gnome_desktop_thumbnail_factory_lookup (thumbnail_factory, uri, file_stat.st_mtime);
-			if (!thumbnail && gnome_desktop_thumbnail_factory_can_thumbnail (thumbnail_factory, uri, mime, file_stat.st_mtime)) {
-				GdkPixbuf *pixbuf;
-
-				pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory, uri, mime);
-
-				if (pixbuf) {
-					gnome_desktop_thumbnail_factory_save_thumbnail (thumbnail_factory, pixbuf, uri, file_stat.st_mtime);
-					g_object_unref (pixbuf);
-
-					thumbnail = gnome_desktop_thumbnail_factory_lookup (thumbnail_factory, uri, file_stat.st_mtime);
-				}
+				thumbnail = gnome_desktop_thumbnail_factory_lookup (thumbnail_factory, uri, mtime);
 			}
-
-			g_free (uri);
 		}
 
-		g_free (content_type);
+		g_free (uri);
 		g_free (mime);
 	}
 
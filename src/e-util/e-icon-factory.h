@@ -37,6 +37,7 @@ GdkPixbuf *	e_icon_factory_pixbuf_scale	(GdkPixbuf *pixbuf,
 						 gint width,
 						 gint height);
 
+gboolean	e_icon_factory_can_thumbnail	(const gchar *filename);
 gchar *		e_icon_factory_create_thumbnail (const gchar *filename);
 
 #endif /* _E_ICON_FACTORY_H_ */
@@ -0,0 +1,326 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* An in-memory pipe: what's written to the output stream in one thread
+ * can be read from the input stream in another thread as soon as it's
+ * written. The writer blocks while too much data is waiting for the reader,
+ * the reader blocks while there's nothing to read and the writer is open.
+ * Unlike an OS pipe, closing the reader never raises SIGPIPE, it only makes
+ * the writes fail and cancels the writer's cancellable. */
+
+#include "evolution-config.h"
+
+#include <string.h>
+
+#include <glib/gi18n-lib.h>
+
+#include "e-pipe-stream.h"
+
+typedef struct _PipeBuffer {
+	volatile gint ref_count;
+
+	GMutex lock;
+	GCond cond;
+
+	GByteArray *data;
+	gsize max_buffered;
+	gboolean writer_closed;
+	gboolean reader_closed;
+
+	GCancellable *writer_cancellable;
+} PipeBuffer;
+
+static PipeBuffer *
+pipe_buffer_ref (PipeBuffer *pipe)
+{
+	g_atomic_int_inc (&pipe->ref_count);
+
+	return pipe;
+}
+
+static void
+pipe_buffer_unref (PipeBuffer *pipe)
+{
+	if (!pipe || !g_atomic_int_dec_and_test (&pipe->ref_count))
+		return;
+
+	g_byte_array_unref (pipe->data);
+	g_clear_object (&pipe->writer_cancellable);
+	g_mutex_clear (&pipe->lock);
+	g_cond_clear (&pipe->cond);
+
+	g_slice_free (PipeBuffer, pipe);
+}
+
+static void
+pipe_buffer_cancelled_cb (GCancellable *cancellable,
+			  gpointer user_data)
+{
+	PipeBuffer *pipe = user_data;
+
+	/* Wake up the waiting side, to notice the cancellation */
+	g_mutex_lock (&pipe->lock);
+	g_cond_broadcast (&pipe->cond);
+	g_mutex_unlock (&pipe->lock);
+}
+
+typedef struct _EPipeInputStream {
+	GInputStream parent;
+	PipeBuffer *pipe;
+} EPipeInputStream;
+
+typedef struct _EPipeInputStreamClass {
+	GInputStreamClass parent_class;
+} EPipeInputStreamClass;
+
+typedef struct _EPipeOutputStream {
+	GOutputStream parent;
+	PipeBuffer *pipe;
+} EPipeOutputStream;
+
+typedef struct _EPipeOutputStreamClass {
+	GOutputStreamClass parent_class;
+} EPipeOutputStreamClass;
+
+GType e_pipe_input_stream_get_type (void) G_GNUC_CONST;
+GType e_pipe_output_stream_get_type (void) G_GNUC_CONST;
+
+G_DEFINE_TYPE (EPipeInputStream, e_pipe_input_stream, G_TYPE_INPUT_STREAM)
+G_DEFINE_TYPE (EPipeOutputStream, e_pipe_output_stream, G_TYPE_OUTPUT_STREAM)
+
+static gssize
+pipe_input_stream_read (GInputStream *stream,
+			gpointer buffer,
+			gsize count,
+			GCancellable *cancellable,
+			GError **error)
+{
+	PipeBuffer *pipe = ((EPipeInputStream *) stream)->pipe;
+	gulong handler_id = 0;
+	gssize n_read = -1;
+
+	if (cancellable)
+		handler_id = g_cancellable_connect (cancellable, G_CALLBACK (pipe_buffer_cancelled_cb), pipe, NULL);
+
+	g_mutex_lock (&pipe->lock);
+
+	while (!pipe->data->len && !pipe->writer_closed && !g_cancellable_is_cancelled (cancellable))
+		g_cond_wait (&pipe->cond, &pipe->lock);
+
+	if (!g_cancellable_set_error_if_cancelled (cancellable, error)) {
+		n_read = MIN (count, pipe->data->len);
+
+		if (n_read > 0) {
+			memcpy (buffer, pipe->data->data, n_read);
+			g_byte_array_remove_range (pipe->data, 0, n_read);
+
+			/* Wake up the writer, there's a free space now */
+			g_cond_broadcast (&pipe->cond);
+		}
+	}
+
+	g_mutex_unlock (&pipe->lock);
+
+	if (handler_id)
+		g_cancellable_disconnect (cancellable, handler_id);
+
+	return n_read;
+}
+
+static gboolean
+pipe_input_stream_close (GInputStream *stream,
+			 GCancellable *cancellable,
+			 GError **error)
+{
+	PipeBuffer *pipe = ((EPipeInputStream *) stream)->pipe;
+
+	g_mutex_lock (&pipe->lock);
+	pipe->reader_closed = TRUE;
+	g_byte_array_set_size (pipe->data, 0);
+	g_cond_broadcast (&pipe->cond);
+	g_mutex_unlock (&pipe->lock);
+
+	/* Nobody reads the rest, thus no need to produce it */
+	if (pipe->writer_cancellable)
+		g_cancellable_cancel (pipe->writer_cancellable);
+
+	return TRUE;
+}
+
+static void
+pipe_input_stream_finalize (GObject *object)
+{
+	pipe_buffer_unref (((EPipeInputStream *) object)->pipe);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (e_pipe_input_stream_parent_class)->finalize (object);
+}
+
+static void
+e_pipe_input_stream_class_init (EPipeInputStreamClass *class)
+{
+	GObjectClass *object_class;
+	GInputStreamClass *input_stream_class;
+
+	object_class = G_OBJECT_CLASS (class);
+	object_class->finalize = pipe_input_stream_finalize;
+
+	input_stream_class = G_INPUT_STREAM_CLASS (class);
+	input_stream_class->read_fn = pipe_input_stream_read;
+	input_stream_class->close_fn = pipe_input_stream_close;
+}
+
+static void
+e_pipe_input_stream_init (EPipeInputStream *stream)
+{
+}
+
+static gssize
+pipe_output_stream_write (GOutputStream *stream,
+			  gconstpointer buffer,
+			  gsize count,
+			  GCancellable *cancellable,
+			  GError **error)
+{
+	PipeBuffer *pipe = ((EPipeOutputStream *) stream)->pipe;
+	gulong handler_id = 0;
+	gssize n_written = -1;
+
+	if (cancellable)
+		handler_id = g_cancellable_connect (cancellable, G_CALLBACK (pipe_buffer_cancelled_cb), pipe, NULL);
+
+	g_mutex_lock (&pipe->lock);
+
+	while (pipe->data->len >= pipe->max_buffered && !pipe->reader_closed && !g_cancellable_is_cancelled (cancellable))
+		g_cond_wait (&pipe->cond, &pipe->lock);
+
+	if (pipe->reader_closed) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE,
+			_("The reading side of the pipe is closed"));
+	} else if (!g_cancellable_set_error_if_cancelled (cancellable, error)) {
+		n_written = MIN (count, pipe->max_buffered - pipe->data->len);
+
+		g_byte_array_append (pipe->data, buffer, n_written);
+
+		/* Wake up the reader, there's something to read now */
+		g_cond_broadcast (&pipe->cond);
+	}
+
+	g_mutex_unlock (&pipe->lock);
+
+	if (handler_id)
+		g_cancellable_disconnect (cancellable, handler_id);
+
+	return n_written;
+}
+
+static gboolean
+pipe_output_stream_close (GOutputStream *stream,
+			  GCancellable *cancellable,
+			  GError **error)
+{
+	PipeBuffer *pipe = ((EPipeOutputStream *) stream)->pipe;
+
+	g_mutex_lock (&pipe->lock);
+	pipe->writer_closed = TRUE;
+	g_cond_broadcast (&pipe->cond);
+	g_mutex_unlock (&pipe->lock);
+
+	return TRUE;
+}
+
+static void
+pipe_output_stream_finalize (GObject *object)
+{
+	pipe_buffer_unref (((EPipeOutputStream *) object)->pipe);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (e_pipe_output_stream_parent_class)->finalize (object);
+}
+
+static void
+e_pipe_output_stream_class_init (EPipeOutputStreamClass *class)
+{
+	GObjectClass *object_class;
+	GOutputStreamClass *output_stream_class;
+
+	object_class = G_OBJECT_CLASS (class);
+	object_class->finalize = pipe_output_stream_finalize;
+
+	output_stream_class = G_OUTPUT_STREAM_CLASS (class);
+	output_stream_class->write_fn = pipe_output_stream_write;
+	output_stream_class->close_fn = pipe_output_stream_close;
+}
+
+static void
+e_pipe_output_stream_init (EPipeOutputStream *stream)
+{
+}
+
+/**
+ * e_pipe_stream_new:
+ * @max_buffered: how many bytes can wait for the reader, before the writer blocks
+ * @writer_cancellable: (nullable): a #GCancellable used by the writer, or %NULL
+ * @out_input_stream: (out) (transfer full): return location for the reading side
+ * @out_output_stream: (out) (transfer full): return location for the writing side
+ *
+ * Creates an in-memory pipe, where the data written to the @out_output_stream
+ * can be read from the @out_input_stream. Each side is meant to be used
+ * from a different thread; the reads block until there's something to read
+ * or the @out_output_stream is closed, which means the end of the data.
+ * The writes block while @max_buffered bytes wait to be read.
+ *
+ * When the @out_input_stream is closed, or freed, the writes fail
+ * and the @writer_cancellable, if any, is cancelled.
+ *
+ * Free both streams with g_object_unref(), when no longer needed.
+ *
+ * Since: 3.32
+ **/
+void
+e_pipe_stream_new (gsize max_buffered,
+		   GCancellable *writer_cancellable,
+		   GInputStream **out_input_stream,
+		   GOutputStream **out_output_stream)
+{
+	PipeBuffer *pipe;
+	EPipeInputStream *input_stream;
+	EPipeOutputStream *output_stream;
+
+	g_return_if_fail (max_buffered > 0);
+	g_return_if_fail (out_input_stream != NULL);
+	g_return_if_fail (out_output_stream != NULL);
+
+	pipe = g_slice_new0 (PipeBuffer);
+	pipe->ref_count = 1;
+	pipe->data = g_byte_array_new ();
+	pipe->max_buffered = max_buffered;
+
+	if (writer_cancellable)
+		pipe->writer_cancellable = g_object_ref (writer_cancellable);
+
+	g_mutex_init (&pipe->lock);
+	g_cond_init (&pipe->cond);
+
+	input_stream = g_object_new (e_pipe_input_stream_get_type (), NULL);
+	input_stream->pipe = pipe_buffer_ref (pipe);
+
+	output_stream = g_object_new (e_pipe_output_stream_get_type (), NULL);
+	output_stream->pipe = pipe_buffer_ref (pipe);
+
+	pipe_buffer_unref (pipe);
+
+	*out_input_stream = G_INPUT_STREAM (input_stream);
+	*out_output_stream = G_OUTPUT_STREAM (output_stream);
+}
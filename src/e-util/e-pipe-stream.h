@@ -0,0 +1,33 @@
+/*
+ * This library is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined (__E_UTIL_H_INSIDE__) && !defined (LIBEUTIL_COMPILATION)
+#error "Only <e-util/e-util.h> should be included directly."
+#endif
+
+#ifndef E_PIPE_STREAM_H
+#define E_PIPE_STREAM_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+void		e_pipe_stream_new		(gsize max_buffered,
+						 GCancellable *writer_cancellable,
+						 GInputStream **out_input_stream,
+						 GOutputStream **out_output_stream);
+
+G_END_DECLS
+
+#endif /* E_PIPE_STREAM_H */
@@ -71,10 +71,8 @@ static GSList *ep_disabled;
 /* All classes which implement EPluginHooks, by class.id */
 static GHashTable *eph_types;
 
+/* A parsed .eplug file, kept for all the load levels */
 struct _plugin_doc {
-	struct _plugin_doc *next;
-	struct _plugin_doc *prev;
-
 	gchar *filename;
 	xmlDocPtr doc;
 };
@@ -358,30 +356,52 @@ ep_load_plugin (xmlNodePtr root,
 	return ep;
 }
 
-static gint
-ep_load (const gchar *filename,
-         gint load_level)
+static struct _plugin_doc *
+ep_load_doc (const gchar *filename)
 {
 	xmlDocPtr doc;
 	xmlNodePtr root;
-	EPlugin *ep = NULL;
 	struct _plugin_doc *pdoc;
 
 	doc = e_xml_parse_file (filename);
 	if (doc == NULL)
-		return -1;
+		return NULL;
 
 	root = xmlDocGetRootElement (doc);
 	if (strcmp ((gchar *) root->name, "e-plugin-list") != 0) {
 		g_warning ("No <e-plugin-list> root element: %s", filename);
 		xmlFreeDoc (doc);
-		return -1;
+		return NULL;
 	}
 
 	pdoc = g_malloc0 (sizeof (*pdoc));
 	pdoc->doc = doc;
 	pdoc->filename = g_strdup (filename);
 
+	return pdoc;
+}
+
+static void
+ep_free_doc (gpointer ptr)
+{
+	struct _plugin_doc *pdoc = ptr;
+
+	if (pdoc) {
+		xmlFreeDoc (pdoc->doc);
+		g_free (pdoc->filename);
+		g_free (pdoc);
+	}
+}
+
+static void
+ep_load (struct _plugin_doc *pdoc,
+         gint load_level)
+{
+	xmlNodePtr root;
+	EPlugin *ep = NULL;
+
+	root = xmlDocGetRootElement (pdoc->doc);
+
 	for (root = root->children; root; root = root->next) {
 		if (strcmp ((gchar *) root->name, "e-plugin") == 0) {
 			gchar *plugin_load_level, *is_system_plugin;
@@ -417,12 +437,6 @@ ep_load (const gchar *filename,
 			}
 		}
 	}
-
-	xmlFreeDoc (pdoc->doc);
-	g_free (pdoc->filename);
-	g_free (pdoc);
-
-	return 0;
 }
 
 static void
@@ -484,6 +498,8 @@ gint
 e_plugin_load_plugins (void)
 {
 	GSettings *settings;
+	GDir *dir;
+	GSList *pdocs = NULL, *link;
 	gchar **strv;
 	gint i;
 
@@ -511,25 +527,23 @@ e_plugin_load_plugins (void)
 	g_strfreev (strv);
 	g_object_unref (settings);
 
-	for (i = 0; i < 3; i++) {
-		GDir *dir;
-		const gchar *d;
-		const gchar *path = EVOLUTION_PLUGINDIR;
-
-		pd (printf ("scanning plugin dir '%s'\n", path));
+	pd (printf ("scanning plugin dir '%s'\n", EVOLUTION_PLUGINDIR));
 
-		dir = g_dir_open (path, 0, NULL);
-		if (dir == NULL) {
-			/*g_warning("Could not find plugin path: %s", path);*/
-			continue;
-		}
+	/* Each file is read and parsed only once, then its plugins
+	 * are loaded in the order of their load levels. */
+	dir = g_dir_open (EVOLUTION_PLUGINDIR, 0, NULL);
+	if (dir != NULL) {
+		const gchar *d;
 
 		while ((d = g_dir_read_name (dir))) {
 			if (g_str_has_suffix  (d, ".eplug")) {
+				struct _plugin_doc *pdoc;
 				gchar *name;
 
-				name = g_build_filename (path, d, NULL);
-				ep_load (name, i);
+				name = g_build_filename (EVOLUTION_PLUGINDIR, d, NULL);
+				pdoc = ep_load_doc (name);
+				if (pdoc)
+					pdocs = g_slist_prepend (pdocs, pdoc);
 				g_free (name);
 			}
 		}
@@ -537,6 +551,16 @@ e_plugin_load_plugins (void)
 		g_dir_close (dir);
 	}
 
+	pdocs = g_slist_reverse (pdocs);
+
+	for (i = 0; i < 3; i++) {
+		for (link = pdocs; link; link = g_slist_next (link)) {
+			ep_load (link->data, i);
+		}
+	}
+
+	g_slist_free_full (pdocs, ep_free_doc);
+
 	return 0;
 }
 
@@ -47,6 +47,64 @@ e_stock_request_can_process_uri (EContentRequest *request,
 	return g_ascii_strncasecmp (uri, "gtk-stock:", 10) == 0;
 }
 
+typedef struct _StockCacheEntry {
+	GBytes *bytes;
+	gchar *mime_type;
+} StockCacheEntry;
+
+/* Encoded icons by "icon-name:size", shared by all requests;
+ * it's accessed only from the main thread, thus no lock */
+static GHashTable *stock_cache = NULL;
+
+static void
+stock_cache_entry_free (gpointer ptr)
+{
+	StockCacheEntry *entry = ptr;
+
+	if (entry) {
+		g_bytes_unref (entry->bytes);
+		g_free (entry->mime_type);
+		g_slice_free (StockCacheEntry, entry);
+	}
+}
+
+static void
+stock_request_icon_theme_changed_cb (GtkIconTheme *icon_theme,
+				     gpointer user_data)
+{
+	g_hash_table_remove_all (stock_cache);
+}
+
+static void
+stock_request_gtk_theme_changed_cb (GtkSettings *settings,
+				    GParamSpec *param,
+				    gpointer user_data)
+{
+	g_hash_table_remove_all (stock_cache);
+}
+
+static GHashTable *
+stock_request_get_cache (void)
+{
+	if (!stock_cache) {
+		GtkSettings *settings;
+
+		stock_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, stock_cache_entry_free);
+
+		/* The icons depend on both the icon theme and the GTK+ theme */
+		g_signal_connect (gtk_icon_theme_get_default (), "changed",
+			G_CALLBACK (stock_request_icon_theme_changed_cb), NULL);
+
+		settings = gtk_settings_get_default ();
+		if (settings) {
+			g_signal_connect (settings, "notify::gtk-theme-name",
+				G_CALLBACK (stock_request_gtk_theme_changed_cb), NULL);
+		}
+	}
+
+	return stock_cache;
+}
+
 typedef struct _StockIdleData
 {
 	EContentRequest *request;
@@ -71,8 +129,10 @@ process_stock_request_idle_cb (gpointer user_data)
 	GtkStyleContext *context;
 	GtkWidgetPath *path;
 	GtkIconSet *icon_set;
+	StockCacheEntry *entry;
 	gssize size = GTK_ICON_SIZE_BUTTON;
 	gchar *a_size;
+	gchar *cache_key;
 	gchar *buffer = NULL, *mime_type = NULL;
 	gsize buff_len = 0;
 	GError *local_error = NULL;
@@ -102,6 +162,24 @@ process_stock_request_idle_cb (gpointer user_data)
 		g_hash_table_destroy (query);
 	}
 
+	cache_key = g_strdup_printf ("%s:%" G_GSSIZE_FORMAT, suri->host, size);
+
+	entry = g_hash_table_lookup (stock_request_get_cache (), cache_key);
+	if (entry) {
+		*sid->out_stream = g_memory_input_stream_new_from_bytes (entry->bytes);
+		*sid->out_stream_length = g_bytes_get_size (entry->bytes);
+		*sid->out_mime_type = g_strdup (entry->mime_type);
+
+		sid->success = TRUE;
+
+		g_free (cache_key);
+		soup_uri_free (suri);
+
+		e_flag_set (sid->flag);
+
+		return FALSE;
+	}
+
 	/* Try style context first */
 	context = gtk_style_context_new ();
 	path = gtk_widget_path_new ();
@@ -211,9 +289,16 @@ process_stock_request_idle_cb (gpointer user_data)
 		mime_type = g_strdup ("image/png");
 
 	if (buffer != NULL) {
-		*sid->out_stream = g_memory_input_stream_new_from_data (buffer, buff_len, g_free);;
+		entry = g_slice_new0 (StockCacheEntry);
+		entry->bytes = g_bytes_new_take (buffer, buff_len);
+		entry->mime_type = mime_type;
+
+		*sid->out_stream = g_memory_input_stream_new_from_bytes (entry->bytes);
 		*sid->out_stream_length = buff_len;
-		*sid->out_mime_type = mime_type;
+		*sid->out_mime_type = g_strdup (mime_type);
+
+		g_hash_table_insert (stock_request_get_cache (), cache_key, entry);
+		cache_key = NULL;
 
 		sid->success = TRUE;
 	} else {
@@ -225,6 +310,7 @@ process_stock_request_idle_cb (gpointer user_data)
 		sid->success = FALSE;
 	}
 
+	g_free (cache_key);
 	soup_uri_free (suri);
 	g_object_unref (context);
 
@@ -23,6 +23,8 @@
 
 #include "e-table-group-container.h"
 
+#include <string.h>
+
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include <gdk/gdkkeysyms.h>
@@ -39,6 +41,19 @@
 
 #define TITLE_HEIGHT         16
 
+#define E_TABLE_GROUP_CONTAINER_GET_PRIVATE(obj) \
+	(G_TYPE_INSTANCE_GET_PRIVATE \
+	((obj), E_TYPE_TABLE_GROUP_CONTAINER, ETableGroupContainerPrivate))
+
+struct _ETableGroupContainerPrivate {
+	/* The links of the children list, in the same order, for
+	 * a binary search by the group value and an insert in place */
+	GPtrArray *children_index;
+
+	/* The child node each model row was added to */
+	GPtrArray *row_children;
+};
+
 G_DEFINE_TYPE (
 	ETableGroupContainer,
 	e_table_group_container,
@@ -93,6 +108,11 @@ e_table_group_container_list_free (ETableGroupContainer *etgc)
 
 	g_list_free (etgc->children);
 	etgc->children = NULL;
+
+	if (etgc->priv->children_index)
+		g_ptr_array_set_size (etgc->priv->children_index, 0);
+	if (etgc->priv->row_children)
+		g_ptr_array_set_size (etgc->priv->row_children, 0);
 }
 
 static void
@@ -103,6 +123,9 @@ etgc_dispose (GObject *object)
 	if (etgc->children)
 		e_table_group_container_list_free (etgc);
 
+	g_clear_pointer (&etgc->priv->children_index, g_ptr_array_unref);
+	g_clear_pointer (&etgc->priv->row_children, g_ptr_array_unref);
+
 	if (etgc->font_desc)
 		pango_font_description_free (etgc->font_desc);
 	etgc->font_desc = NULL;
@@ -523,67 +546,167 @@ create_child_node (ETableGroupContainer *etgc,
 	return child_node;
 }
 
+/*
+ * Looks up the child node with the group value @val by a binary search
+ * in etgc->priv->children_index and sets @position to its index.  When
+ * there is none, returns NULL and sets @position to the index where
+ * a new child node for @val belongs.
+ */
+static ETableGroupContainerChildNode *
+etgc_lookup_child_node (ETableGroupContainer *etgc,
+                        gconstpointer val,
+                        gpointer cmp_cache,
+                        guint *position)
+{
+	GCompareDataFunc comp = etgc->ecol->compare;
+	guint low = 0, high = etgc->priv->children_index->len;
+
+	while (low < high) {
+		guint middle = low + (high - low) / 2;
+		ETableGroupContainerChildNode *child_node;
+		gint comp_val;
+
+		child_node = ((GList *) g_ptr_array_index (etgc->priv->children_index, middle))->data;
+		comp_val = (*comp)(child_node->key, val, cmp_cache);
+		if (comp_val == 0) {
+			if (position)
+				*position = middle;
+			return child_node;
+		}
+
+		if ((comp_val > 0 && etgc->ascending) ||
+		    (comp_val < 0 && (!etgc->ascending)))
+			high = middle;
+		else
+			low = middle + 1;
+	}
+
+	if (position)
+		*position = low;
+
+	return NULL;
+}
+
+static void
+etgc_set_row_child (ETableGroupContainer *etgc,
+                    gint row,
+                    ETableGroupContainerChildNode *child_node)
+{
+	if ((guint) row >= etgc->priv->row_children->len)
+		g_ptr_array_set_size (etgc->priv->row_children, row + 1);
+
+	g_ptr_array_index (etgc->priv->row_children, row) = child_node;
+}
+
+/* Inserts the child node at @position of both the children list and index */
+static void
+etgc_insert_child_node (ETableGroupContainer *etgc,
+                        guint position,
+                        ETableGroupContainerChildNode *child_node)
+{
+	GPtrArray *children_index = etgc->priv->children_index;
+	GList *link;
+
+	if (position < children_index->len) {
+		GList *sibling = g_ptr_array_index (children_index, position);
+
+		etgc->children = g_list_insert_before (etgc->children, sibling, child_node);
+		link = sibling->prev;
+	} else if (children_index->len > 0) {
+		GList *last = g_ptr_array_index (children_index, children_index->len - 1);
+
+		last = g_list_append (last, child_node);
+		link = last->next;
+	} else {
+		etgc->children = g_list_prepend (etgc->children, child_node);
+		link = etgc->children;
+	}
+
+	g_ptr_array_insert (children_index, position, link);
+}
+
+static void
+etgc_remove_child_node (ETableGroupContainer *etgc,
+                        ETableGroupContainerChildNode *child_node)
+{
+	gpointer cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+	GList *link;
+	guint position = 0;
+
+	if (etgc_lookup_child_node (etgc, child_node->key, cmp_cache, &position) == child_node) {
+		link = g_ptr_array_index (etgc->priv->children_index, position);
+	} else {
+		/* Should not happen, the group values are unique */
+		link = g_list_find (etgc->children, child_node);
+		position = g_list_position (etgc->children, link);
+	}
+
+	e_table_sorting_utils_free_cmp_cache (cmp_cache);
+
+	g_return_if_fail (link != NULL);
+
+	etgc->children = g_list_delete_link (etgc->children, link);
+	g_ptr_array_remove_index (etgc->priv->children_index, position);
+}
+
 static void
 etgc_add (ETableGroup *etg,
           gint row)
 {
 	ETableGroupContainer *etgc = E_TABLE_GROUP_CONTAINER (etg);
-	GCompareDataFunc comp = etgc->ecol->compare;
 	gpointer cmp_cache = e_table_sorting_utils_create_cmp_cache ();
-	GList *list = etgc->children;
 	ETableGroup *child;
 	ETableGroupContainerChildNode *child_node;
 	gpointer val;
-	gint i = 0;
+	guint position = 0;
 
 	val = e_table_model_value_at (
 		etg->model, etgc->ecol->spec->model_col, row);
 
-	for (; list; list = g_list_next (list), i++) {
-		gint comp_val;
+	child_node = etgc_lookup_child_node (etgc, val, cmp_cache, &position);
+	e_table_sorting_utils_free_cmp_cache (cmp_cache);
 
-		child_node = list->data;
-		comp_val = (*comp)(child_node->key, val, cmp_cache);
-		if (comp_val == 0) {
-			e_table_sorting_utils_free_cmp_cache (cmp_cache);
-			child = child_node->child;
-			child_node->count++;
-			e_table_group_add (child, row);
-			compute_text (etgc, child_node);
-			return;
-		}
-		if ((comp_val > 0 && etgc->ascending) ||
-		    (comp_val < 0 && (!etgc->ascending)))
-			break;
+	if (child_node) {
+		child = child_node->child;
+		child_node->count++;
+		e_table_group_add (child, row);
+		etgc_set_row_child (etgc, row, child_node);
+		compute_text (etgc, child_node);
+		return;
 	}
-	e_table_sorting_utils_free_cmp_cache (cmp_cache);
+
 	child_node = create_child_node (etgc, val);
 	child = child_node->child;
 	child_node->count = 1;
 	e_table_group_add (child, row);
+	etgc_set_row_child (etgc, row, child_node);
 
-	if (list)
-		etgc->children = g_list_insert (etgc->children, child_node, i);
-	else
-		etgc->children = g_list_append (etgc->children, child_node);
+	etgc_insert_child_node (etgc, position, child_node);
 
 	compute_text (etgc, child_node);
 	e_canvas_item_request_reflow (GNOME_CANVAS_ITEM (etgc));
 }
 
+/*
+ * Partitions the rows into the groups in one pass.  The array is usually
+ * sorted by the group value already, thus the group is looked up only
+ * where the value changes, but rows of one group which are not next to
+ * each other still end up in the same group.
+ */
 static void
 etgc_add_array (ETableGroup *etg,
                 const gint *array,
                 gint count)
 {
 	gint i;
+	guint ii;
 	ETableGroupContainer *etgc = E_TABLE_GROUP_CONTAINER (etg);
 	gpointer lastval = NULL;
-	gint laststart = 0;
 	GCompareDataFunc comp = etgc->ecol->compare;
 	gpointer cmp_cache;
-	ETableGroupContainerChildNode *child_node;
-	ETableGroup *child;
+	ETableGroupContainerChildNode *child_node = NULL;
+	GHashTable *rows_by_node;
+	GArray *rows = NULL;
 
 	if (count <= 0)
 		return;
@@ -591,42 +714,50 @@ etgc_add_array (ETableGroup *etg,
 	e_table_group_container_list_free (etgc);
 	etgc->children = NULL;
 	cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+	rows_by_node = g_hash_table_new_full (
+		g_direct_hash, g_direct_equal,
+		NULL, (GDestroyNotify) g_array_unref);
 
-	lastval = e_table_model_value_at (
-		etg->model, etgc->ecol->spec->model_col, array[0]);
-
-	for (i = 1; i < count; i++) {
+	for (i = 0; i < count; i++) {
 		gpointer val;
-		gint comp_val;
 
 		val = e_table_model_value_at (
 			etg->model, etgc->ecol->spec->model_col, array[i]);
 
-		comp_val = (*comp)(lastval, val, cmp_cache);
-		if (comp_val != 0) {
-			child_node = create_child_node (etgc, lastval);
-			child = child_node->child;
+		if (!child_node || (*comp)(lastval, val, cmp_cache) != 0) {
+			guint position = 0;
+
+			child_node = etgc_lookup_child_node (etgc, val, cmp_cache, &position);
+			if (child_node) {
+				rows = g_hash_table_lookup (rows_by_node, child_node);
+			} else {
+				child_node = create_child_node (etgc, val);
+				etgc_insert_child_node (etgc, position, child_node);
 
-			e_table_group_add_array (child, array + laststart, i - laststart);
-			child_node->count = i - laststart;
+				rows = g_array_new (FALSE, FALSE, sizeof (gint));
+				g_hash_table_insert (rows_by_node, child_node, rows);
+			}
 
-			etgc->children = g_list_append (etgc->children, child_node);
-			compute_text (etgc, child_node);
-			laststart = i;
 			lastval = val;
 		}
+
+		g_array_append_vals (rows, array + i, 1);
+		etgc_set_row_child (etgc, array[i], child_node);
 	}
 
 	e_table_sorting_utils_free_cmp_cache (cmp_cache);
 
-	child_node = create_child_node (etgc, lastval);
-	child = child_node->child;
+	for (ii = 0; ii < etgc->priv->children_index->len; ii++) {
+		child_node = ((GList *) g_ptr_array_index (etgc->priv->children_index, ii))->data;
+		rows = g_hash_table_lookup (rows_by_node, child_node);
 
-	e_table_group_add_array (child, array + laststart, i - laststart);
-	child_node->count = i - laststart;
+		e_table_group_add_array (child_node->child, (const gint *) rows->data, rows->len);
+		child_node->count = rows->len;
 
-	etgc->children = g_list_append (etgc->children, child_node);
-	compute_text (etgc, child_node);
+		compute_text (etgc, child_node);
+	}
+
+	g_hash_table_destroy (rows_by_node);
 
 	e_canvas_item_request_reflow (GNOME_CANVAS_ITEM (etgc));
 }
@@ -644,28 +775,49 @@ etgc_add_all (ETableGroup *etg)
 	etgc_add_array (etg, array, count);
 }
 
+static void
+etgc_child_node_row_removed (ETableGroupContainer *etgc,
+                             ETableGroupContainerChildNode *child_node,
+                             gint row)
+{
+	if ((guint) row < etgc->priv->row_children->len)
+		g_ptr_array_index (etgc->priv->row_children, row) = NULL;
+
+	child_node->count--;
+	if (child_node->count == 0) {
+		etgc_remove_child_node (etgc, child_node);
+		e_table_group_container_child_node_free (etgc, child_node);
+		g_free (child_node);
+	} else
+		compute_text (etgc, child_node);
+
+	e_canvas_item_request_reflow (GNOME_CANVAS_ITEM (etgc));
+}
+
 static gboolean
 etgc_remove (ETableGroup *etg,
              gint row)
 {
 	ETableGroupContainer *etgc = E_TABLE_GROUP_CONTAINER (etg);
+	ETableGroupContainerChildNode *row_child = NULL;
 	GList *list;
 
+	/* The value at the row can be already changed or gone, thus
+	 * find the group by the row it was added with. */
+	if ((guint) row < etgc->priv->row_children->len)
+		row_child = g_ptr_array_index (etgc->priv->row_children, row);
+
+	if (row_child && e_table_group_remove (row_child->child, row)) {
+		etgc_child_node_row_removed (etgc, row_child, row);
+		return TRUE;
+	}
+
 	for (list = etgc->children; list; list = g_list_next (list)) {
 		ETableGroupContainerChildNode *child_node = list->data;
 		ETableGroup                   *child = child_node->child;
 
-		if (e_table_group_remove (child, row)) {
-			child_node->count--;
-			if (child_node->count == 0) {
-				e_table_group_container_child_node_free (etgc, child_node);
-				etgc->children = g_list_remove (etgc->children, child_node);
-				g_free (child_node);
-			} else
-				compute_text (etgc, child_node);
-
-			e_canvas_item_request_reflow (GNOME_CANVAS_ITEM (etgc));
-
+		if (child_node != row_child && e_table_group_remove (child, row)) {
+			etgc_child_node_row_removed (etgc, child_node, row);
 			return TRUE;
 		}
 	}
@@ -698,6 +850,19 @@ etgc_increment (ETableGroup *etg,
 		e_table_group_increment (
 			((ETableGroupContainerChildNode *) list->data)->child,
 			position, amount);
+
+	if ((guint) position < etgc->priv->row_children->len) {
+		guint len = etgc->priv->row_children->len;
+
+		g_ptr_array_set_size (etgc->priv->row_children, len + amount);
+		memmove (
+			etgc->priv->row_children->pdata + position + amount,
+			etgc->priv->row_children->pdata + position,
+			(len - position) * sizeof (gpointer));
+		memset (
+			etgc->priv->row_children->pdata + position, 0,
+			amount * sizeof (gpointer));
+	}
 }
 
 static void
@@ -712,6 +877,18 @@ etgc_decrement (ETableGroup *etg,
 		e_table_group_decrement (
 			((ETableGroupContainerChildNode *) list->data)->child,
 			position, amount);
+
+	if ((guint) (position + amount) < etgc->priv->row_children->len) {
+		guint len = etgc->priv->row_children->len;
+
+		memmove (
+			etgc->priv->row_children->pdata + position,
+			etgc->priv->row_children->pdata + position + amount,
+			(len - position - amount) * sizeof (gpointer));
+		g_ptr_array_set_size (etgc->priv->row_children, len - amount);
+	} else if ((guint) position < etgc->priv->row_children->len) {
+		g_ptr_array_set_size (etgc->priv->row_children, position);
+	}
 }
 
 static void
@@ -1030,6 +1207,8 @@ e_table_group_container_class_init (ETableGroupContainerClass *class)
 	GObjectClass *object_class = G_OBJECT_CLASS (class);
 	ETableGroupClass *e_group_class = E_TABLE_GROUP_CLASS (class);
 
+	g_type_class_add_private (class, sizeof (ETableGroupContainerPrivate));
+
 	object_class->dispose = etgc_dispose;
 	object_class->set_property = etgc_set_property;
 	object_class->get_property = etgc_get_property;
@@ -1280,7 +1459,11 @@ etgc_reflow (GnomeCanvasItem *item,
 static void
 e_table_group_container_init (ETableGroupContainer *container)
 {
+	container->priv = E_TABLE_GROUP_CONTAINER_GET_PRIVATE (container);
+
 	container->children = NULL;
+	container->priv->children_index = g_ptr_array_new ();
+	container->priv->row_children = g_ptr_array_new ();
 
 	e_canvas_item_set_reflow_callback (GNOME_CANVAS_ITEM (container), etgc_reflow);
 
@@ -57,6 +57,7 @@ G_BEGIN_DECLS
 
 typedef struct _ETableGroupContainer ETableGroupContainer;
 typedef struct _ETableGroupContainerClass ETableGroupContainerClass;
+typedef struct _ETableGroupContainerPrivate ETableGroupContainerPrivate;
 
 typedef struct _ETableGroupContainerChildNode ETableGroupContainerChildNode;
 
@@ -100,6 +101,8 @@ struct _ETableGroupContainer {
 	 * State: the ETableGroup is open or closed
 	 */
 	guint open : 1;
+
+	ETableGroupContainerPrivate *priv;
 };
 
 struct _ETableGroupContainerClass {
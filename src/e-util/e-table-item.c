@@ -70,6 +70,19 @@ typedef struct _ETableItemPrivate ETableItemPrivate;
 
 struct _ETableItemPrivate {
 	GSource *show_cursor_delay_source;
+
+	/* Fenwick trees over eti->height_cache, both 1-based with
+	 * height_tree_size + 1 elements; the first sums the known row
+	 * heights, the second counts the rows not measured yet. */
+	gint *height_tree;
+	gint *unknown_tree;
+	gint height_tree_size;
+
+	/* Last rows painted by eti_draw(), measured first by the idle */
+	gint visible_first_row;
+	gint visible_last_row;
+
+	gulong table_model_rows_changed_id;
 };
 
 static void eti_check_cursor_bounds (ETableItem *eti);
@@ -119,6 +132,10 @@ enum {
 #define DOUBLE_CLICK_TIME      250
 #define TRIPLE_CLICK_TIME      500
 
+/* How long, in microseconds, one run of height_cache_idle() may spend
+ * measuring rows before yielding back to the main loop */
+#define HEIGHT_CACHE_IDLE_SLICE 8000
+
 static gint eti_get_height (ETableItem *eti);
 static gint eti_row_height (ETableItem *eti, gint row);
 static void e_table_item_focus (ETableItem *eti, gint col, gint row, GdkModifierType state);
@@ -572,6 +589,8 @@ eti_update (GnomeCanvasItem *item,
 static void
 eti_remove_table_model (ETableItem *eti)
 {
+	ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+
 	if (!eti->table_model)
 		return;
 
@@ -596,6 +615,9 @@ eti_remove_table_model (ETableItem *eti)
 	g_signal_handler_disconnect (
 		eti->table_model,
 		eti->table_model_rows_deleted_id);
+	g_signal_handler_disconnect (
+		eti->table_model,
+		priv->table_model_rows_changed_id);
 	g_object_unref (eti->table_model);
 	if (eti->source_model)
 		g_object_unref (eti->source_model);
@@ -607,6 +629,7 @@ eti_remove_table_model (ETableItem *eti)
 	eti->table_model_cell_change_id = 0;
 	eti->table_model_rows_inserted_id = 0;
 	eti->table_model_rows_deleted_id = 0;
+	priv->table_model_rows_changed_id = 0;
 	eti->table_model = NULL;
 	eti->source_model = NULL;
 	eti->uses_source_model = 0;
@@ -703,6 +726,121 @@ eti_row_height_real (ETableItem *eti,
 	return max_h;
 }
 
+/*
+ * The row heights are mirrored in two Fenwick (binary indexed) trees, so
+ * that the offset of a row and the row at an offset are found in O(log n)
+ * instead of summing every row above it.  Rows without a cached height
+ * contribute zero to the height tree and one to the unknown tree.
+ */
+static void
+height_tree_add (gint *tree,
+                 gint size,
+                 gint pos,
+                 gint delta)
+{
+	for (pos++; pos <= size; pos += pos & (-pos))
+		tree[pos] += delta;
+}
+
+/* Returns the sum of the first @count elements of the @tree */
+static gint
+height_tree_sum (const gint *tree,
+                 gint count)
+{
+	gint sum = 0;
+
+	for (; count > 0; count -= count & (-count))
+		sum += tree[count];
+
+	return sum;
+}
+
+/*
+ * Returns the largest count of leading elements of the @tree whose sum,
+ * with @extra added for every element, does not exceed @offset.
+ */
+static gint
+height_tree_search (const gint *tree,
+                    gint size,
+                    gint offset,
+                    gint extra)
+{
+	gint pos = 0, step = 1;
+
+	while (step <= size / 2)
+		step <<= 1;
+
+	for (; step > 0; step >>= 1) {
+		if (pos + step <= size && tree[pos + step] + step * extra <= offset) {
+			pos += step;
+			offset -= tree[pos] + step * extra;
+		}
+	}
+
+	return pos;
+}
+
+static void
+eti_height_tree_free (ETableItem *eti)
+{
+	ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+
+	g_free (priv->height_tree);
+	g_free (priv->unknown_tree);
+	priv->height_tree = NULL;
+	priv->unknown_tree = NULL;
+	priv->height_tree_size = 0;
+}
+
+/* Builds the trees from eti->height_cache in linear time */
+static void
+eti_height_tree_build (ETableItem *eti)
+{
+	ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+	gint size = eti->rows;
+	gint i, parent;
+
+	priv->height_tree = g_renew (gint, priv->height_tree, size + 1);
+	priv->unknown_tree = g_renew (gint, priv->unknown_tree, size + 1);
+	priv->height_tree_size = size;
+
+	priv->height_tree[0] = 0;
+	priv->unknown_tree[0] = 0;
+
+	for (i = 1; i <= size; i++) {
+		gint height = eti->height_cache[i - 1];
+
+		priv->height_tree[i] = height == -1 ? 0 : height;
+		priv->unknown_tree[i] = height == -1 ? 1 : 0;
+	}
+
+	for (i = 1; i <= size; i++) {
+		parent = i + (i & (-i));
+		if (parent <= size) {
+			priv->height_tree[parent] += priv->height_tree[i];
+			priv->unknown_tree[parent] += priv->unknown_tree[i];
+		}
+	}
+}
+
+/* Returns the first row at or after @row without a cached height */
+static gint
+eti_first_unknown_row (ETableItem *eti,
+                       gint row)
+{
+	ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+
+	if (row >= priv->height_tree_size)
+		return priv->height_tree_size;
+
+	if (row < 0)
+		row = 0;
+
+	return height_tree_search (
+		priv->unknown_tree, priv->height_tree_size,
+		height_tree_sum (priv->unknown_tree, row), 0);
+}
+
 static void
 confirm_height_cache (ETableItem *eti)
 {
@@ -714,28 +852,48 @@ confirm_height_cache (ETableItem *eti)
 	for (i = 0; i < eti->rows; i++) {
 		eti->height_cache[i] = -1;
 	}
+	eti_height_tree_build (eti);
 }
 
+/*
+ * height_cache_idle:
+ *
+ * Measures rows in slices of at most HEIGHT_CACHE_IDLE_SLICE.  Rows of the
+ * visible area and of one page below it go first, so that scrolling near
+ * the current position does not wait for the rest of the table.
+ */
 static gboolean
 height_cache_idle (ETableItem *eti)
 {
-	gint changed = 0;
-	gint i;
+	ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+	gint64 started;
+	gint row, ahead;
+
 	confirm_height_cache (eti);
-	for (i = eti->height_cache_idle_count; i < eti->rows; i++) {
-		if (eti->height_cache[i] == -1) {
-			eti_row_height (eti, i);
-			changed++;
-			if (changed >= 20)
-				break;
-		}
-	}
-	if (changed >= 20) {
-		eti->height_cache_idle_count = i;
-		return TRUE;
+
+	if (!eti->height_cache) {
+		eti->height_cache_idle_id = 0;
+		return FALSE;
 	}
-	eti->height_cache_idle_id = 0;
-	return FALSE;
+
+	ahead = 2 * priv->visible_last_row - priv->visible_first_row;
+	started = g_get_monotonic_time ();
+
+	do {
+		row = eti_first_unknown_row (eti, priv->visible_first_row);
+		if (row >= ahead)
+			row = eti_first_unknown_row (eti, 0);
+
+		if (row >= eti->rows) {
+			eti->height_cache_idle_id = 0;
+			return FALSE;
+		}
+
+		eti_row_height (eti, row);
+		eti->height_cache_idle_count = row;
+	} while (g_get_monotonic_time () - started < HEIGHT_CACHE_IDLE_SLICE);
+
+	return TRUE;
 }
 
 static void
@@ -751,6 +909,7 @@ free_height_cache (ETableItem *eti)
 		eti->height_cache = NULL;
 		eti->height_cache_idle_count = 0;
 		eti->uniform_row_height_cache = -1;
+		eti_height_tree_free (eti);
 
 		if (eti->uniform_row_height && eti->height_cache_idle_id != 0) {
 			g_source_remove (eti->height_cache_idle_id);
@@ -787,7 +946,12 @@ eti_row_height (ETableItem *eti,
 			calculate_height_cache (eti);
 		}
 		if (eti->height_cache[row] == -1) {
+			ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+
 			eti->height_cache[row] = eti_row_height_real (eti, row);
+			height_tree_add (priv->height_tree, priv->height_tree_size, row, eti->height_cache[row]);
+			height_tree_add (priv->unknown_tree, priv->height_tree_size, row, -1);
+
 			if (row > 0 &&
 			    eti->length_threshold != -1 &&
 			    eti->rows > eti->length_threshold &&
@@ -800,6 +964,59 @@ eti_row_height (ETableItem *eti,
 	}
 }
 
+/* Measures every row in [@start_row, @end_row) without a cached height */
+static void
+eti_measure_rows (ETableItem *eti,
+                  gint start_row,
+                  gint end_row)
+{
+	gint row;
+
+	confirm_height_cache (eti);
+
+	for (row = eti_first_unknown_row (eti, start_row);
+	     row < end_row;
+	     row = eti_first_unknown_row (eti, row + 1))
+		eti_row_height (eti, row);
+}
+
+/*
+ * eti_row_at_offset:
+ *
+ * Returns the largest number of leading rows, including the separators,
+ * which fit into @offset pixels, or -1 when @offset is negative.  Only
+ * variable height rows are supported.
+ */
+static gint
+eti_row_at_offset (ETableItem *eti,
+                   gint offset)
+{
+	ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+	gint height_extra = eti->horizontal_draw_grid ? 1 : 0;
+	gint count, unknown;
+
+	if (offset < 0)
+		return -1;
+
+	confirm_height_cache (eti);
+
+	/* Rows without a cached height count as zero pixels, thus the search
+	 * can only go too far; measure them and repeat until it settles. */
+	while (TRUE) {
+		count = height_tree_search (
+			priv->height_tree, priv->height_tree_size,
+			offset, height_extra);
+		unknown = eti_first_unknown_row (eti, 0);
+
+		if (unknown > count || unknown >= eti->rows)
+			break;
+
+		eti_row_height (eti, unknown);
+	}
+
+	return count;
+}
+
 /*
  * eti_get_height:
  *
@@ -831,15 +1048,9 @@ eti_get_height (ETableItem *eti)
 			if (rows > eti->length_threshold) {
 				gint row_height = ETI_ROW_HEIGHT (eti, 0);
 				if (eti->height_cache) {
-					height = 0;
-					for (row = 0; row < rows; row++) {
-						if (eti->height_cache[row] == -1) {
-							height += (row_height + height_extra) * (rows - row);
-							break;
-						}
-						else
-							height += eti->height_cache[row] + height_extra;
-					}
+					row = eti_first_unknown_row (eti, 0);
+					height = e_table_item_row_diff (eti, 0, row);
+					height += (row_height + height_extra) * (rows - row);
 				} else
 					height = (ETI_ROW_HEIGHT (eti, 0) + height_extra) * rows;
 
@@ -851,8 +1062,7 @@ eti_get_height (ETableItem *eti)
 		}
 
 		height = height_extra;
-		for (row = 0; row < rows; row++)
-			height += ETI_ROW_HEIGHT (eti, row) + height_extra;
+		height += e_table_item_row_diff (eti, 0, rows);
 
 		return height;
 	}
@@ -898,12 +1108,16 @@ e_table_item_row_diff (ETableItem *eti,
 	if (eti->uniform_row_height) {
 		return ((end_row - start_row) * (ETI_ROW_HEIGHT (eti, -1) + height_extra));
 	} else {
-		gint row, total;
-		total = 0;
-		for (row = start_row; row < end_row; row++)
-			total += ETI_ROW_HEIGHT (eti, row) + height_extra;
+		ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+
+		if (start_row >= end_row)
+			return 0;
+
+		eti_measure_rows (eti, start_row, end_row);
 
-		return total;
+		return height_tree_sum (priv->height_tree, end_row) -
+			height_tree_sum (priv->height_tree, start_row) +
+			(end_row - start_row) * height_extra;
 	}
 }
 
@@ -1283,6 +1497,35 @@ eti_table_model_cell_changed (ETableModel *table_model,
 	e_table_item_redraw_row (eti, row);
 }
 
+static void
+eti_table_model_rows_changed (ETableModel *table_model,
+                              gint row,
+                              gint count,
+                              ETableItem *eti)
+{
+	GnomeCanvasItem *item = GNOME_CANVAS_ITEM (eti);
+	gint ii;
+
+	if (!(item->flags & GNOME_CANVAS_ITEM_REALIZED)) {
+		eti_unfreeze (eti);
+		return;
+	}
+
+	if (!eti->uniform_row_height && eti->height_cache) {
+		for (ii = row; ii < row + count; ii++) {
+			if (eti->height_cache[ii] != -1 && eti_row_height_real (eti, ii) != eti->height_cache[ii]) {
+				eti_table_model_changed (table_model, eti);
+				return;
+			}
+		}
+	}
+
+	eti_unfreeze (eti);
+
+	if (count > 0)
+		e_table_item_redraw_range (eti, 0, row, eti->cols - 1, row + count - 1);
+}
+
 static void
 eti_table_model_rows_inserted (ETableModel *table_model,
                                gint row,
@@ -1303,6 +1546,7 @@ eti_table_model_rows_inserted (ETableModel *table_model,
 		memmove (eti->height_cache + row + count, eti->height_cache + row, (eti->rows - count - row) * sizeof (gint));
 		for (i = row; i < row + count; i++)
 			eti->height_cache[i] = -1;
+		eti_height_tree_build (eti);
 	}
 
 	eti_unfreeze (eti);
@@ -1334,6 +1578,9 @@ eti_table_model_rows_deleted (ETableModel *table_model,
 		memmove (eti->height_cache + row, eti->height_cache + row + count, (eti->rows - row) * sizeof (gint));
 	}
 
+	if (eti->height_cache)
+		eti_height_tree_build (eti);
+
 	eti_unfreeze (eti);
 
 	eti_idle_maybe_show_cursor (eti);
@@ -1397,6 +1644,8 @@ static void
 eti_add_table_model (ETableItem *eti,
                      ETableModel *table_model)
 {
+	ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+
 	g_return_if_fail (eti->table_model == NULL);
 
 	eti->table_model = table_model;
@@ -1430,6 +1679,10 @@ eti_add_table_model (ETableItem *eti,
 		table_model, "model_rows_deleted",
 		G_CALLBACK (eti_table_model_rows_deleted), eti);
 
+	priv->table_model_rows_changed_id = g_signal_connect (
+		table_model, "model_rows_changed",
+		G_CALLBACK (eti_table_model_rows_changed), eti);
+
 	if (eti->header) {
 		eti_detach_cell_views (eti);
 		eti_attach_cell_views (eti);
@@ -1587,6 +1840,7 @@ eti_dispose (GObject *object)
 	if (eti->height_cache)
 		g_free (eti->height_cache);
 	eti->height_cache = NULL;
+	eti_height_tree_free (eti);
 
 	/* Chain up to parent's dispose() method. */
 	G_OBJECT_CLASS (e_table_item_parent_class)->dispose (object);
@@ -1863,6 +2117,7 @@ eti_unrealize (GnomeCanvasItem *item)
 	if (eti->height_cache)
 		g_free (eti->height_cache);
 	eti->height_cache = NULL;
+	eti_height_tree_free (eti);
 	eti->height_cache_idle_count = 0;
 
 	eti_unrealize_cell_views (eti);
@@ -1974,31 +2229,21 @@ eti_draw (GnomeCanvasItem *item,
 		if (last_row > eti->rows)
 			last_row = eti->rows;
 	} else {
-		gint y1, y2;
-
-		y_offset = 0;
-		first_row = -1;
-
-		y1 = y2 = floor (eti_base_y) + height_extra;
-		for (row = 0; row < rows; row++, y1 = y2) {
-
-			y2 += ETI_ROW_HEIGHT (eti, row) + height_extra;
+		ETableItemPrivate *priv = E_TABLE_ITEM_GET_PRIVATE (eti);
+		gint y1 = floor (eti_base_y) + height_extra;
 
-			if (y1 > y + height)
-				break;
+		/* The first row ending at or below y and the first row
+		 * starting below y + height */
+		first_row = MAX (eti_row_at_offset (eti, y - y1 - 1), 0);
+		last_row = MIN (eti_row_at_offset (eti, y + height - y1) + 1, rows);
 
-			if (y2 < y)
-				continue;
+		if (first_row >= last_row)
+			return;
 
-			if (first_row == -1) {
-				y_offset = y1 - y;
-				first_row = row;
-			}
-		}
-		last_row = row;
+		y_offset = y1 + e_table_item_row_diff (eti, 0, first_row) - y;
 
-		if (first_row == -1)
-			return;
+		priv->visible_first_row = first_row;
+		priv->visible_last_row = last_row;
 	}
 
 	if (first_row == -1)
@@ -2229,7 +2474,7 @@ find_cell (ETableItem *eti,
 {
 	const gint cols = eti->cols;
 	const gint rows = eti->rows;
-	gdouble x1, y1, x2, y2;
+	gdouble x1, y1, x2;
 	gint col, row;
 
 	gint height_extra = eti->horizontal_draw_grid ? 1 : 0;
@@ -2268,18 +2513,13 @@ find_cell (ETableItem *eti,
 		if (row >= eti->rows)
 			return FALSE;
 	} else {
-		y1 = y2 = height_extra;
 		if (y < height_extra)
 			return FALSE;
-		for (row = 0; row < rows; row++, y1 = y2) {
-			y2 += ETI_ROW_HEIGHT (eti, row) + height_extra;
-
-			if (y <= y2)
-				break;
-		}
-
-		if (row == rows)
+		/* The first row ending at or below y */
+		row = MAX (eti_row_at_offset (eti, (gint) ceil (y - height_extra) - 1), 0);
+		if (row >= rows)
 			return FALSE;
+		y1 = e_table_item_row_diff (eti, 0, row) + height_extra;
 	}
 	*view_col_res = col;
 	if (x1_res)
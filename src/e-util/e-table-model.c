@@ -31,12 +31,29 @@ enum {
 	MODEL_CELL_CHANGED,
 	MODEL_ROWS_INSERTED,
 	MODEL_ROWS_DELETED,
+	MODEL_ROWS_CHANGED,
 	ROW_SELECTION,
 	LAST_SIGNAL
 };
 
 static guint signals[LAST_SIGNAL] = { 0, };
 
+/* Row changes collected between e_table_model_begin_changes()
+ * and e_table_model_end_changes() */
+typedef struct _ChangesData {
+	gint depth;
+	gboolean pre_change_pending;
+	gboolean model_changed;
+	GArray *ranges; /* ChangesRange, in the order of arrival */
+} ChangesData;
+
+typedef struct _ChangesRange {
+	gint row;
+	gint count;
+} ChangesRange;
+
+#define CHANGES_DATA_KEY "e-table-model-changes"
+
 static gint
 table_model_is_frozen (ETableModel *table_model)
 {
@@ -47,6 +64,162 @@ table_model_is_frozen (ETableModel *table_model)
 	return (GPOINTER_TO_INT (data) != 0);
 }
 
+static void
+changes_data_free (gpointer ptr)
+{
+	ChangesData *cd = ptr;
+
+	if (cd) {
+		g_array_free (cd->ranges, TRUE);
+		g_free (cd);
+	}
+}
+
+static ChangesData *
+table_model_get_changes (ETableModel *table_model)
+{
+	ChangesData *cd;
+
+	cd = g_object_get_data (G_OBJECT (table_model), CHANGES_DATA_KEY);
+
+	if (cd && cd->depth > 0)
+		return cd;
+
+	return NULL;
+}
+
+static gint
+changes_range_compare (gconstpointer ptr1,
+                       gconstpointer ptr2)
+{
+	const ChangesRange *range1 = ptr1, *range2 = ptr2;
+
+	return range1->row - range2->row;
+}
+
+static void
+table_model_add_changed_rows (ChangesData *cd,
+                              gint row,
+                              gint count)
+{
+	ChangesRange range;
+
+	cd->pre_change_pending = FALSE;
+
+	if (cd->model_changed || count <= 0)
+		return;
+
+	/* Changes usually come in row order, extend the last range when possible */
+	if (cd->ranges->len > 0) {
+		ChangesRange *last = &g_array_index (cd->ranges, ChangesRange, cd->ranges->len - 1);
+
+		if (row >= last->row && row <= last->row + last->count) {
+			last->count = MAX (last->count, row + count - last->row);
+			return;
+		}
+	}
+
+	range.row = row;
+	range.count = count;
+
+	g_array_append_val (cd->ranges, range);
+}
+
+/* Emits everything collected so far, merged into as few signals as possible */
+static void
+table_model_flush_changes (ETableModel *table_model,
+                           ChangesData *cd)
+{
+	ChangesRange *ranges;
+	guint ii, n_ranges = 0;
+
+	if (cd->model_changed) {
+		cd->model_changed = FALSE;
+		g_array_set_size (cd->ranges, 0);
+
+		g_signal_emit (table_model, signals[MODEL_PRE_CHANGE], 0);
+		g_signal_emit (table_model, signals[MODEL_CHANGED], 0);
+		return;
+	}
+
+	if (cd->ranges->len == 0)
+		return;
+
+	g_array_sort (cd->ranges, changes_range_compare);
+
+	ranges = (ChangesRange *) cd->ranges->data;
+	for (ii = 1; ii < cd->ranges->len; ii++) {
+		ChangesRange *last = &ranges[n_ranges];
+
+		if (ranges[ii].row <= last->row + last->count)
+			last->count = MAX (last->count, ranges[ii].row + ranges[ii].count - last->row);
+		else
+			ranges[++n_ranges] = ranges[ii];
+	}
+	n_ranges++;
+
+	/* Emitting can start a new batch on the same model, thus work on a copy */
+	ranges = g_memdup (ranges, n_ranges * sizeof (ChangesRange));
+	g_array_set_size (cd->ranges, 0);
+
+	for (ii = 0; ii < n_ranges; ii++) {
+		g_signal_emit (table_model, signals[MODEL_PRE_CHANGE], 0);
+		g_signal_emit (table_model, signals[MODEL_ROWS_CHANGED], 0, ranges[ii].row, ranges[ii].count);
+	}
+
+	g_free (ranges);
+}
+
+/* Rows were inserted (@count > 0) or deleted (@count < 0) at @row in
+ * the middle of a batch; the collected rows are moved accordingly and
+ * the pre-change held back is emitted before the structural change.
+ * Returns FALSE when the change should not be emitted at all, because
+ * the whole model is reported as changed at the end of the batch. */
+static gboolean
+table_model_shift_changes (ETableModel *table_model,
+                           ChangesData *cd,
+                           gint row,
+                           gint count)
+{
+	guint ii, jj;
+
+	if (cd->model_changed) {
+		cd->pre_change_pending = FALSE;
+		return FALSE;
+	}
+
+	for (ii = 0, jj = 0; ii < cd->ranges->len; ii++) {
+		ChangesRange range = g_array_index (cd->ranges, ChangesRange, ii);
+		gint end = range.row + range.count;
+
+		if (count > 0) {
+			if (range.row >= row)
+				range.row += count;
+			if (end > row)
+				end += count;
+		} else {
+			if (range.row > row)
+				range.row = MAX (row, range.row + count);
+			if (end > row)
+				end = MAX (row, end + count);
+		}
+
+		range.count = end - range.row;
+
+		if (range.count > 0)
+			g_array_index (cd->ranges, ChangesRange, jj++) = range;
+	}
+
+	g_array_set_size (cd->ranges, jj);
+
+	if (cd->pre_change_pending) {
+		cd->pre_change_pending = FALSE;
+		g_signal_emit (table_model, signals[MODEL_PRE_CHANGE], 0);
+	}
+
+	return TRUE;
+}
+
 static void
 e_table_model_default_init (ETableModelInterface *iface)
 {
@@ -112,6 +285,16 @@ e_table_model_default_init (ETableModelInterface *iface)
 		G_TYPE_NONE, 2,
 		G_TYPE_INT,
 		G_TYPE_INT);
+
+	signals[MODEL_ROWS_CHANGED] = g_signal_new (
+		"model_rows_changed",
+		G_TYPE_FROM_INTERFACE (iface),
+		G_SIGNAL_RUN_LAST,
+		G_STRUCT_OFFSET (ETableModelInterface, model_rows_changed),
+		NULL, NULL, NULL,
+		G_TYPE_NONE, 2,
+		G_TYPE_INT,
+		G_TYPE_INT);
 }
 
 /**
@@ -404,11 +587,19 @@ print_tabs (void)
 void
 e_table_model_pre_change (ETableModel *table_model)
 {
+	ChangesData *cd;
+
 	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
 
 	if (table_model_is_frozen (table_model))
 		return;
 
+	cd = table_model_get_changes (table_model);
+	if (cd) {
+		cd->pre_change_pending = TRUE;
+		return;
+	}
+
 	d (print_tabs ());
 	d (depth++);
 	g_signal_emit (table_model, signals[MODEL_PRE_CHANGE], 0);
@@ -431,11 +622,19 @@ e_table_model_pre_change (ETableModel *table_model)
 void
 e_table_model_no_change (ETableModel *table_model)
 {
+	ChangesData *cd;
+
 	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
 
 	if (table_model_is_frozen (table_model))
 		return;
 
+	cd = table_model_get_changes (table_model);
+	if (cd) {
+		cd->pre_change_pending = FALSE;
+		return;
+	}
+
 	d (print_tabs ());
 	d (depth++);
 	g_signal_emit (table_model, signals[MODEL_NO_CHANGE], 0);
@@ -458,11 +657,21 @@ e_table_model_no_change (ETableModel *table_model)
 void
 e_table_model_changed (ETableModel *table_model)
 {
+	ChangesData *cd;
+
 	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
 
 	if (table_model_is_frozen (table_model))
 		return;
 
+	cd = table_model_get_changes (table_model);
+	if (cd) {
+		cd->pre_change_pending = FALSE;
+		cd->model_changed = TRUE;
+		g_array_set_size (cd->ranges, 0);
+		return;
+	}
+
 	d (print_tabs ());
 	d (depth++);
 	g_signal_emit (table_model, signals[MODEL_CHANGED], 0);
@@ -483,11 +692,19 @@ void
 e_table_model_row_changed (ETableModel *table_model,
                            gint row)
 {
+	ChangesData *cd;
+
 	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
 
 	if (table_model_is_frozen (table_model))
 		return;
 
+	cd = table_model_get_changes (table_model);
+	if (cd) {
+		table_model_add_changed_rows (cd, row, 1);
+		return;
+	}
+
 	d (print_tabs ());
 	d (depth++);
 	g_signal_emit (table_model, signals[MODEL_ROW_CHANGED], 0, row);
@@ -510,11 +727,19 @@ e_table_model_cell_changed (ETableModel *table_model,
                             gint col,
                             gint row)
 {
+	ChangesData *cd;
+
 	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
 
 	if (table_model_is_frozen (table_model))
 		return;
 
+	cd = table_model_get_changes (table_model);
+	if (cd) {
+		table_model_add_changed_rows (cd, row, 1);
+		return;
+	}
+
 	d (print_tabs ());
 	d (depth++);
 	g_signal_emit (
@@ -538,11 +763,17 @@ e_table_model_rows_inserted (ETableModel *table_model,
                              gint row,
                              gint count)
 {
+	ChangesData *cd;
+
 	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
 
 	if (table_model_is_frozen (table_model))
 		return;
 
+	cd = table_model_get_changes (table_model);
+	if (cd && !table_model_shift_changes (table_model, cd, row, count))
+		return;
+
 	d (print_tabs ());
 	d (depth++);
 	g_signal_emit (
@@ -568,6 +799,45 @@ e_table_model_row_inserted (ETableModel *table_model,
 	e_table_model_rows_inserted (table_model, row, 1);
 }
 
+/**
+ * e_table_model_rows_changed:
+ * @table_model: the table model to notify of the change
+ * @row: the first row that was changed
+ * @count: the number of changed rows
+ *
+ * Use this function to notify any views of the table model that the
+ * contents of @count rows starting at row @row have changed.  This
+ * function will emit the "model_rows_changed" signal on the
+ * @table_model object.  Like with e_table_model_row_changed(), it
+ * should be preceded by e_table_model_pre_change().
+ *
+ * Since: 3.32
+ **/
+void
+e_table_model_rows_changed (ETableModel *table_model,
+                            gint row,
+                            gint count)
+{
+	ChangesData *cd;
+
+	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
+
+	if (table_model_is_frozen (table_model))
+		return;
+
+	cd = table_model_get_changes (table_model);
+	if (cd) {
+		table_model_add_changed_rows (cd, row, count);
+		return;
+	}
+
+	d (print_tabs ());
+	d (depth++);
+	g_signal_emit (
+		table_model, signals[MODEL_ROWS_CHANGED], 0, row, count);
+	d (depth--);
+}
+
 /**
  * e_table_model_row_deleted:
  * @table_model: the table model to notify of the change
@@ -584,11 +854,17 @@ e_table_model_rows_deleted (ETableModel *table_model,
                             gint row,
                             gint count)
 {
+	ChangesData *cd;
+
 	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
 
 	if (table_model_is_frozen (table_model))
 		return;
 
+	cd = table_model_get_changes (table_model);
+	if (cd && !table_model_shift_changes (table_model, cd, row, -count))
+		return;
+
 	d (print_tabs ());
 	d (depth++);
 	g_signal_emit (
@@ -642,3 +918,77 @@ e_table_model_thaw (ETableModel *table_model)
 	e_table_model_changed (table_model);
 }
 
+/**
+ * e_table_model_begin_changes:
+ * @table_model: an #ETableModel
+ *
+ * Starts a batch of changes.  Until the matching e_table_model_end_changes(),
+ * row and cell changes are not emitted, but collected into row ranges,
+ * which are merged and emitted as "model_rows_changed" signals at the end
+ * of the batch.  Each row is reported at most once, thus the views and
+ * the proxy models above this model resort and redraw once per batch,
+ * instead of once per changed row.
+ *
+ * Inserted and deleted rows are still emitted immediately, the rows
+ * collected so far are renumbered accordingly.  A full "model_changed"
+ * within the batch replaces all the collected row changes.
+ *
+ * The calls can be nested.
+ *
+ * Since: 3.32
+ **/
+void
+e_table_model_begin_changes (ETableModel *table_model)
+{
+	ChangesData *cd;
+
+	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
+
+	cd = g_object_get_data (G_OBJECT (table_model), CHANGES_DATA_KEY);
+	if (!cd) {
+		cd = g_new0 (ChangesData, 1);
+		cd->ranges = g_array_new (FALSE, FALSE, sizeof (ChangesRange));
+
+		g_object_set_data_full (G_OBJECT (table_model), CHANGES_DATA_KEY, cd, changes_data_free);
+	}
+
+	cd->depth++;
+}
+
+/**
+ * e_table_model_end_changes:
+ * @table_model: an #ETableModel
+ *
+ * Ends a batch of changes started with e_table_model_begin_changes().
+ * When this is the outermost batch, all the collected changes are emitted.
+ *
+ * Since: 3.32
+ **/
+void
+e_table_model_end_changes (ETableModel *table_model)
+{
+	ChangesData *cd;
+
+	g_return_if_fail (E_IS_TABLE_MODEL (table_model));
+
+	cd = table_model_get_changes (table_model);
+	g_return_if_fail (cd != NULL);
+
+	cd->depth--;
+
+	if (cd->depth > 0)
+		return;
+
+	/* A pre-change without a following change is simply dropped */
+	cd->pre_change_pending = FALSE;
+
+	if (table_model_is_frozen (table_model)) {
+		cd->model_changed = FALSE;
+		g_array_set_size (cd->ranges, 0);
+		return;
+	}
+
+	g_object_ref (table_model);
+	table_model_flush_changes (table_model, cd);
+	g_object_unref (table_model);
+}
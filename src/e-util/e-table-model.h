@@ -100,6 +100,7 @@ struct _ETableModelInterface {
 	 * Only changes in a cell: cell_changed
 	 * A row inserted: row_inserted
 	 * A row deleted: row_deleted
+	 * Changes in a range of rows: rows_changed
 	 */
 	void		(*model_pre_change)	(ETableModel *table_model);
 
@@ -116,6 +117,9 @@ struct _ETableModelInterface {
 	void		(*model_rows_deleted)	(ETableModel *table_model,
 						 gint row,
 						 gint count);
+	void		(*model_rows_changed)	(ETableModel *table_model,
+						 gint row,
+						 gint count);
 };
 
 GType		e_table_model_get_type		(void) G_GNUC_CONST;
@@ -183,6 +187,9 @@ void		e_table_model_rows_inserted	(ETableModel *table_model,
 void		e_table_model_rows_deleted	(ETableModel *table_model,
 						 gint row,
 						 gint count);
+void		e_table_model_rows_changed	(ETableModel *table_model,
+						 gint row,
+						 gint count);
 
 /**/
 void		e_table_model_row_inserted	(ETableModel *table_model,
@@ -192,6 +199,8 @@ void		e_table_model_row_deleted	(ETableModel *table_model,
 
 void		e_table_model_freeze		(ETableModel *table_model);
 void		e_table_model_thaw		(ETableModel *table_model);
+void		e_table_model_begin_changes	(ETableModel *table_model);
+void		e_table_model_end_changes	(ETableModel *table_model);
 
 G_END_DECLS
 
@@ -159,6 +159,15 @@ model_cell_changed (ETableModel *etm,
 	free_hash (etsm);
 }
 
+static void
+model_rows_changed (ETableModel *etm,
+                    gint row,
+                    gint count,
+                    ETableSelectionModel *etsm)
+{
+	free_hash (etsm);
+}
+
 #if 1
 static void
 model_rows_inserted (ETableModel *etm,
@@ -220,6 +229,9 @@ add_model (ETableSelectionModel *etsm,
 		etsm->model_cell_changed_id = g_signal_connect (
 			model, "model_cell_changed",
 			G_CALLBACK (model_cell_changed), etsm);
+		etsm->model_rows_changed_id = g_signal_connect (
+			model, "model_rows_changed",
+			G_CALLBACK (model_rows_changed), etsm);
 		etsm->model_rows_inserted_id = g_signal_connect (
 			model, "model_rows_inserted",
 			G_CALLBACK (model_rows_inserted), etsm);
@@ -246,6 +258,9 @@ drop_model (ETableSelectionModel *etsm)
 		g_signal_handler_disconnect (
 			etsm->model,
 			etsm->model_cell_changed_id);
+		g_signal_handler_disconnect (
+			etsm->model,
+			etsm->model_rows_changed_id);
 		g_signal_handler_disconnect (
 			etsm->model,
 			etsm->model_rows_inserted_id);
@@ -65,6 +65,7 @@ struct _ETableSelectionModel {
 	guint model_changed_id;
 	guint model_row_changed_id;
 	guint model_cell_changed_id;
+	guint model_rows_changed_id;
 	guint model_rows_inserted_id;
 	guint model_rows_deleted_id;
 
@@ -41,6 +41,7 @@ static void ets_sort                     (ETableSorted *ets);
 static void ets_proxy_model_changed      (ETableSubset *etss, ETableModel *source);
 static void ets_proxy_model_row_changed  (ETableSubset *etss, ETableModel *source, gint row);
 static void ets_proxy_model_cell_changed (ETableSubset *etss, ETableModel *source, gint col, gint row);
+static void ets_proxy_model_rows_changed (ETableSubset *etss, ETableModel *source, gint row, gint count);
 static void ets_proxy_model_rows_inserted (ETableSubset *etss, ETableModel *source, gint row, gint count);
 static void ets_proxy_model_rows_deleted  (ETableSubset *etss, ETableModel *source, gint row, gint count);
 
@@ -81,6 +82,7 @@ e_table_sorted_class_init (ETableSortedClass *class)
 	etss_class->proxy_model_changed = ets_proxy_model_changed;
 	etss_class->proxy_model_row_changed = ets_proxy_model_row_changed;
 	etss_class->proxy_model_cell_changed = ets_proxy_model_cell_changed;
+	etss_class->proxy_model_rows_changed = ets_proxy_model_rows_changed;
 	etss_class->proxy_model_rows_inserted = ets_proxy_model_rows_inserted;
 	etss_class->proxy_model_rows_deleted = ets_proxy_model_rows_deleted;
 
@@ -202,6 +204,20 @@ ets_proxy_model_cell_changed (ETableSubset *subset,
 		(E_TABLE_SUBSET_CLASS (e_table_sorted_parent_class)->proxy_model_cell_changed) (subset, source, col, row);
 }
 
+static void
+ets_proxy_model_rows_changed (ETableSubset *subset,
+                              ETableModel *source,
+                              gint row,
+                              gint count)
+{
+	/* One resort for the whole range */
+	if (!E_TABLE_SORTED (subset)->sort_idle_id)
+		E_TABLE_SORTED (subset)->sort_idle_id = g_idle_add_full (50, (GSourceFunc) ets_sort_idle, subset, NULL);
+
+	if (E_TABLE_SUBSET_CLASS (e_table_sorted_parent_class)->proxy_model_rows_changed)
+		(E_TABLE_SUBSET_CLASS (e_table_sorted_parent_class)->proxy_model_rows_changed) (subset, source, row, count);
+}
+
 static void
 ets_proxy_model_rows_inserted (ETableSubset *etss,
                                ETableModel *source,
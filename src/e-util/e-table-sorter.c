@@ -243,6 +243,15 @@ table_sorter_model_cell_changed_cb (ETableModel *table_model,
 	table_sorter_clean (table_sorter);
 }
 
+static void
+table_sorter_model_rows_changed_cb (ETableModel *table_model,
+                                    gint row,
+                                    gint count,
+                                    ETableSorter *table_sorter)
+{
+	table_sorter_clean (table_sorter);
+}
+
 static void
 table_sorter_model_rows_inserted_cb (ETableModel *table_model,
                                      gint row,
@@ -348,6 +357,13 @@ table_sorter_dispose (GObject *object)
 		table_sorter->table_model_cell_changed_id = 0;
 	}
 
+	if (table_sorter->table_model_rows_changed_id > 0) {
+		g_signal_handler_disconnect (
+			table_sorter->source,
+			table_sorter->table_model_rows_changed_id);
+		table_sorter->table_model_rows_changed_id = 0;
+	}
+
 	if (table_sorter->table_model_rows_inserted_id > 0) {
 		g_signal_handler_disconnect (
 			table_sorter->source,
@@ -533,6 +549,10 @@ e_table_sorter_new (ETableModel *source,
 		source, "model_cell_changed",
 		G_CALLBACK (table_sorter_model_cell_changed_cb), table_sorter);
 
+	table_sorter->table_model_rows_changed_id = g_signal_connect (
+		source, "model_rows_changed",
+		G_CALLBACK (table_sorter_model_rows_changed_cb), table_sorter);
+
 	table_sorter->table_model_rows_inserted_id = g_signal_connect (
 		source, "model_rows_inserted",
 		G_CALLBACK (table_sorter_model_rows_inserted_cb), table_sorter);
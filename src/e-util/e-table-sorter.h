@@ -69,6 +69,7 @@ struct _ETableSorter {
 	gulong table_model_changed_id;
 	gulong table_model_row_changed_id;
 	gulong table_model_cell_changed_id;
+	gulong table_model_rows_changed_id;
 	gulong table_model_rows_inserted_id;
 	gulong table_model_rows_deleted_id;
 	gulong sort_info_changed_id;
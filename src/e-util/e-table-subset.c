@@ -47,6 +47,7 @@ struct _ETableSubsetPrivate {
 	gulong table_model_cell_changed_handler_id;
 	gulong table_model_rows_inserted_handler_id;
 	gulong table_model_rows_deleted_handler_id;
+	gulong table_model_rows_changed_handler_id;
 
 	gint last_access;
 };
@@ -156,6 +157,13 @@ table_subset_dispose (GObject *object)
 		priv->table_model_rows_deleted_handler_id = 0;
 	}
 
+	if (priv->table_model_rows_changed_handler_id > 0) {
+		g_signal_handler_disconnect (
+			priv->source_model,
+			priv->table_model_rows_changed_handler_id);
+		priv->table_model_rows_changed_handler_id = 0;
+	}
+
 	g_clear_object (&priv->source_model);
 
 	/* Chain up to parent's dispose() method. */
@@ -225,6 +233,44 @@ table_subset_proxy_model_cell_changed_real (ETableSubset *table_subset,
 		e_table_model_no_change (E_TABLE_MODEL (table_subset));
 }
 
+static void
+table_subset_proxy_model_rows_changed_real (ETableSubset *table_subset,
+                                            ETableModel *source_model,
+                                            gint row,
+                                            gint count)
+{
+	ETableModel *table_model = E_TABLE_MODEL (table_subset);
+	gint ii;
+
+	if (count == 1) {
+		ETableSubsetClass *class;
+
+		class = E_TABLE_SUBSET_GET_CLASS (table_subset);
+
+		if (class->proxy_model_row_changed != NULL)
+			class->proxy_model_row_changed (
+				table_subset, source_model, row);
+		return;
+	}
+
+	/* The view rows can be anywhere in the map, one pass over it finds
+	 * them all and the batch merges them back into ranges.  The batch
+	 * emits its own pre-change for each range, thus cancel the one
+	 * forwarded from the source model. */
+	e_table_model_no_change (table_model);
+
+	e_table_model_begin_changes (table_model);
+
+	for (ii = 0; ii < table_subset->n_map; ii++) {
+		gint source_row = table_subset->map_table[ii];
+
+		if (source_row >= row && source_row < row + count)
+			e_table_model_row_changed (table_model, ii);
+	}
+
+	e_table_model_end_changes (table_model);
+}
+
 static void
 table_subset_proxy_model_rows_inserted_real (ETableSubset *table_subset,
                                              ETableModel *source_model,
@@ -411,6 +457,7 @@ e_table_subset_class_init (ETableSubsetClass *class)
 	class->proxy_model_cell_changed = table_subset_proxy_model_cell_changed_real;
 	class->proxy_model_rows_inserted = table_subset_proxy_model_rows_inserted_real;
 	class->proxy_model_rows_deleted = table_subset_proxy_model_rows_deleted_real;
+	class->proxy_model_rows_changed = table_subset_proxy_model_rows_changed_real;
 }
 
 static void
@@ -535,6 +582,21 @@ table_subset_proxy_model_rows_deleted (ETableModel *source_model,
 			table_subset, source_model, row, col);
 }
 
+static void
+table_subset_proxy_model_rows_changed (ETableModel *source_model,
+                                       gint row,
+                                       gint count,
+                                       ETableSubset *table_subset)
+{
+	ETableSubsetClass *class;
+
+	class = E_TABLE_SUBSET_GET_CLASS (table_subset);
+
+	if (class->proxy_model_rows_changed != NULL)
+		class->proxy_model_rows_changed (
+			table_subset, source_model, row, count);
+}
+
 ETableModel *
 e_table_subset_construct (ETableSubset *table_subset,
                           ETableModel *source_model,
@@ -596,6 +658,12 @@ e_table_subset_construct (ETableSubset *table_subset,
 		table_subset);
 	table_subset->priv->table_model_rows_deleted_handler_id = handler_id;
 
+	handler_id = g_signal_connect (
+		source_model, "model_rows_changed",
+		G_CALLBACK (table_subset_proxy_model_rows_changed),
+		table_subset);
+	table_subset->priv->table_model_rows_changed_handler_id = handler_id;
+
 	return E_TABLE_MODEL (table_subset);
 }
 
@@ -187,6 +187,9 @@ et_disconnect_model (ETable *et)
 	if (et->table_cell_change_id != 0)
 		g_signal_handler_disconnect (
 			et->model, et->table_cell_change_id);
+	if (et->table_rows_change_id != 0)
+		g_signal_handler_disconnect (
+			et->model, et->table_rows_change_id);
 	if (et->table_rows_inserted_id != 0)
 		g_signal_handler_disconnect (
 			et->model, et->table_rows_inserted_id);
@@ -197,6 +200,7 @@ et_disconnect_model (ETable *et)
 	et->table_model_change_id = 0;
 	et->table_row_change_id = 0;
 	et->table_cell_change_id = 0;
+	et->table_rows_change_id = 0;
 	et->table_rows_inserted_id = 0;
 	et->table_rows_deleted_id = 0;
 }
@@ -1038,6 +1042,18 @@ et_table_cell_changed (ETableModel *table_model,
 	et_table_row_changed (table_model, row, et);
 }
 
+static void
+et_table_rows_changed (ETableModel *table_model,
+                       gint row,
+                       gint count,
+                       ETable *et)
+{
+	gint ii;
+
+	for (ii = row; ii < row + count; ii++)
+		et_table_row_changed (table_model, ii, et);
+}
+
 static void
 et_table_rows_inserted (ETableModel *table_model,
                         gint row,
@@ -1171,6 +1187,10 @@ et_build_groups (ETable *et)
 			et->model, "model_cell_changed",
 			G_CALLBACK (et_table_cell_changed), et);
 
+		et->table_rows_change_id = g_signal_connect (
+			et->model, "model_rows_changed",
+			G_CALLBACK (et_table_rows_changed), et);
+
 		et->table_rows_inserted_id = g_signal_connect (
 			et->model, "model_rows_inserted",
 			G_CALLBACK (et_table_rows_inserted), et);
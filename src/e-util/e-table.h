@@ -103,6 +103,7 @@ struct _ETable {
 	gint table_model_change_id;
 	gint table_row_change_id;
 	gint table_cell_change_id;
+	gint table_rows_change_id;
 	gint table_rows_inserted_id;
 	gint table_rows_deleted_id;
 
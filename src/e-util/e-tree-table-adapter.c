@@ -42,18 +42,50 @@
 
 #define d(x)
 
-#define INCREMENT_AMOUNT 100
+/* Binary expanded state: a header followed by the sorted 64-bit hashes
+ * of the save-ids of the nodes whose expanded state is not the default,
+ * all stored little-endian, so a file can be searched directly when
+ * mapped into memory. */
+#define EXPANDED_STATE_MAGIC "ETTAEXPS"
+#define EXPANDED_STATE_VERSION 1
+
+typedef struct {
+	gchar magic[8];
+	guint32 version;
+	guint32 expanded_default;
+	guint32 n_ids;
+	guint32 reserved;
+} ExpandedStateHeader;
+
+typedef struct _MapChunk MapChunk;
 
 typedef struct {
 	ETreePath path;
 	guint32 num_visible_children;
-	guint32 index;
+
+	/* Where the node is in the map, chunk is NULL when it is not there */
+	MapChunk *chunk;
+	guint32 offset;
 
 	guint expanded : 1;
 	guint expandable : 1;
 	guint expandable_set : 1;
 } node_t;
 
+/* The map of visible rows is split into chunks of at most MAP_CHUNK_SIZE
+ * nodes, with a Fenwick tree over the chunk lengths.  Expanding, collapsing,
+ * inserting or removing k rows then touches only the affected chunks, and
+ * the row of a node or the node at a row is found in O(log n), without
+ * renumbering every row below the change. */
+#define MAP_CHUNK_SIZE 512
+#define MAP_CHUNK_FILL (MAP_CHUNK_SIZE * 3 / 4)
+
+struct _MapChunk {
+	node_t *nodes[MAP_CHUNK_SIZE];
+	guint len;
+	guint index; /* position in priv->map_chunks */
+};
+
 struct _ETreeTableAdapterPrivate {
 	ETreeModel *source_model;
 	gulong pre_change_handler_id;
@@ -71,19 +103,21 @@ struct _ETreeTableAdapterPrivate {
 	ETableHeader *header;
 
 	gint n_map;
-	gint n_vals_allocated;
-	node_t **map_table;
+	GPtrArray *map_chunks;
+	gint *map_chunk_tree;
 	GHashTable *nodes;
 	GNode *root;
 
 	guint root_visible : 1;
-	guint remap_needed : 1;
 
 	gint last_access;
 
 	guint resort_idle_id;
 
 	gint force_expanded_state; /* use this instead of model's default if not 0; <0 ... collapse, >0 ... expand */
+
+	/* Last loaded or saved binary expanded state, applied to nodes as they are created */
+	GBytes *expanded_ids;
 };
 
 enum {
@@ -128,53 +162,335 @@ lookup_gnode (ETreeTableAdapter *etta,
 }
 
 static void
-resize_map (ETreeTableAdapter *etta,
-            gint size)
+map_chunk_tree_rebuild (ETreeTableAdapter *etta)
+{
+	GPtrArray *chunks = etta->priv->map_chunks;
+	gint *tree;
+	guint ii, parent;
+
+	tree = g_renew (gint, etta->priv->map_chunk_tree, chunks->len + 1);
+	etta->priv->map_chunk_tree = tree;
+
+	tree[0] = 0;
+	for (ii = 0; ii < chunks->len; ii++) {
+		MapChunk *chunk = g_ptr_array_index (chunks, ii);
+
+		chunk->index = ii;
+		tree[ii + 1] = chunk->len;
+	}
+
+	for (ii = 1; ii <= chunks->len; ii++) {
+		parent = ii + (ii & (-ii));
+		if (parent <= chunks->len)
+			tree[parent] += tree[ii];
+	}
+}
+
+static void
+map_chunk_tree_add (ETreeTableAdapter *etta,
+                    guint chunk_index,
+                    gint delta)
+{
+	guint len = etta->priv->map_chunks->len;
+
+	for (chunk_index++; chunk_index <= len; chunk_index += chunk_index & (-chunk_index))
+		etta->priv->map_chunk_tree[chunk_index] += delta;
+}
+
+/* Returns the row of the first node in the chunk at @chunk_index */
+static gint
+map_chunk_start (ETreeTableAdapter *etta,
+                 guint chunk_index)
+{
+	gint start = 0;
+
+	for (; chunk_index > 0; chunk_index -= chunk_index & (-chunk_index))
+		start += etta->priv->map_chunk_tree[chunk_index];
+
+	return start;
+}
+
+/* Returns the chunk holding @row, which should be less than n_map */
+static MapChunk *
+map_find_chunk (ETreeTableAdapter *etta,
+                gint row,
+                guint *offset)
 {
-	if (size > etta->priv->n_vals_allocated) {
-		etta->priv->n_vals_allocated = MAX (etta->priv->n_vals_allocated + INCREMENT_AMOUNT, size);
-		etta->priv->map_table = g_renew (node_t *, etta->priv->map_table, etta->priv->n_vals_allocated);
+	guint len = etta->priv->map_chunks->len;
+	guint pos = 0, step = 1;
+
+	while (step <= len / 2)
+		step <<= 1;
+
+	for (; step > 0; step >>= 1) {
+		if (pos + step <= len && etta->priv->map_chunk_tree[pos + step] <= row) {
+			pos += step;
+			row -= etta->priv->map_chunk_tree[pos];
+		}
 	}
 
-	etta->priv->n_map = size;
+	*offset = row;
+
+	return g_ptr_array_index (etta->priv->map_chunks, pos);
 }
 
 static void
-move_map_elements (ETreeTableAdapter *etta,
-                   gint to,
-                   gint from,
-                   gint count)
+map_chunk_renumber (MapChunk *chunk,
+                    guint from)
 {
-	if (count <= 0 || from >= etta->priv->n_map)
+	for (; from < chunk->len; from++) {
+		node_t *node = chunk->nodes[from];
+
+		if (node) {
+			node->chunk = chunk;
+			node->offset = from;
+		}
+	}
+}
+
+/* Merges small neighbouring chunks between @from and @to, so the number
+ * of chunks stays proportional to the number of rows */
+static gboolean
+map_merge_chunks (ETreeTableAdapter *etta,
+                  gint from,
+                  gint to)
+{
+	GPtrArray *chunks = etta->priv->map_chunks;
+	gboolean merged = FALSE;
+	gint ii;
+
+	from = MAX (from, 0);
+
+	for (ii = MIN (to, (gint) chunks->len - 2); ii >= from; ii--) {
+		MapChunk *chunk = g_ptr_array_index (chunks, ii);
+		MapChunk *next = g_ptr_array_index (chunks, ii + 1);
+
+		if (chunk->len + next->len > MAP_CHUNK_FILL)
+			continue;
+
+		memcpy (chunk->nodes + chunk->len, next->nodes, next->len * sizeof (node_t *));
+		chunk->len += next->len;
+		map_chunk_renumber (chunk, chunk->len - next->len);
+
+		g_ptr_array_remove_index (chunks, ii + 1);
+		g_free (next);
+		merged = TRUE;
+	}
+
+	return merged;
+}
+
+/* Makes room for @count rows at @row; fill_map() is expected to fill them */
+static void
+insert_map_rows (ETreeTableAdapter *etta,
+                 gint row,
+                 gint count)
+{
+	GPtrArray *chunks = etta->priv->map_chunks;
+	MapChunk *chunk = NULL;
+	node_t **tail = NULL;
+	guint offset = 0, tail_len = 0, total, n_new, position, ii, jj;
+
+	if (count <= 0)
 		return;
-	memmove (etta->priv->map_table + to, etta->priv->map_table + from, count * sizeof (node_t *));
-	etta->priv->remap_needed = TRUE;
+
+	if (row >= etta->priv->n_map) {
+		if (chunks->len > 0) {
+			chunk = g_ptr_array_index (chunks, chunks->len - 1);
+			offset = chunk->len;
+		}
+	} else {
+		chunk = map_find_chunk (etta, row, &offset);
+	}
+
+	etta->priv->n_map += count;
+
+	if (chunk && chunk->len + count <= MAP_CHUNK_SIZE) {
+		memmove (chunk->nodes + offset + count, chunk->nodes + offset, (chunk->len - offset) * sizeof (node_t *));
+		memset (chunk->nodes + offset, 0, count * sizeof (node_t *));
+		chunk->len += count;
+		map_chunk_renumber (chunk, offset + count);
+		map_chunk_tree_add (etta, chunk->index, count);
+		return;
+	}
+
+	/* Split the chunk at the offset; the new rows and the rest of
+	 * the chunk go to new chunks, filled to MAP_CHUNK_FILL. */
+	if (chunk) {
+		tail_len = chunk->len - offset;
+		tail = g_memdup (chunk->nodes + offset, tail_len * sizeof (node_t *));
+		chunk->len = offset;
+		position = chunk->index + 1;
+	} else {
+		position = 0;
+	}
+
+	total = count + tail_len;
+	n_new = (total + MAP_CHUNK_FILL - 1) / MAP_CHUNK_FILL;
+
+	g_ptr_array_set_size (chunks, chunks->len + n_new);
+	memmove (chunks->pdata + position + n_new, chunks->pdata + position, (chunks->len - n_new - position) * sizeof (gpointer));
+
+	for (ii = 0, jj = 0; ii < n_new; ii++) {
+		MapChunk *new_chunk = g_new0 (MapChunk, 1);
+		guint fill = total / n_new + (ii < total % n_new ? 1 : 0);
+
+		for (new_chunk->len = 0; new_chunk->len < fill; new_chunk->len++, jj++) {
+			if (jj >= (guint) count)
+				new_chunk->nodes[new_chunk->len] = tail[jj - count];
+		}
+
+		map_chunk_renumber (new_chunk, 0);
+		chunks->pdata[position + ii] = new_chunk;
+	}
+
+	g_free (tail);
+
+	map_merge_chunks (etta, position - 1, position + n_new - 1);
+	map_chunk_tree_rebuild (etta);
+}
+
+/* Removes @count rows at @row; the nodes themselves can be freed already */
+static void
+delete_map_rows (ETreeTableAdapter *etta,
+                 gint row,
+                 gint count)
+{
+	GPtrArray *chunks = etta->priv->map_chunks;
+	guint offset, first, ii;
+	gboolean emptied = FALSE;
+
+	if (count <= 0 || row >= etta->priv->n_map)
+		return;
+
+	first = map_find_chunk (etta, row, &offset)->index;
+
+	for (ii = first; count > 0 && ii < chunks->len; ii++, offset = 0) {
+		MapChunk *chunk = g_ptr_array_index (chunks, ii);
+		guint take = MIN ((guint) count, chunk->len - offset);
+
+		memmove (chunk->nodes + offset, chunk->nodes + offset + take, (chunk->len - offset - take) * sizeof (node_t *));
+		chunk->len -= take;
+		map_chunk_renumber (chunk, offset);
+
+		count -= take;
+		etta->priv->n_map -= take;
+
+		if (chunk->len == 0)
+			emptied = TRUE;
+		else
+			map_chunk_tree_add (etta, ii, -((gint) take));
+	}
+
+	if (emptied) {
+		for (ii = chunks->len; ii > first; ii--) {
+			MapChunk *chunk = g_ptr_array_index (chunks, ii - 1);
+
+			if (chunk->len == 0) {
+				g_ptr_array_remove_index (chunks, ii - 1);
+				g_free (chunk);
+			}
+		}
+	}
+
+	if (map_merge_chunks (etta, (gint) first - 1, first) || emptied)
+		map_chunk_tree_rebuild (etta);
+}
+
+/* Makes the map @size rows long, with all the rows empty. The callers
+ * fill the whole map afterwards. The nodes in the map can be freed already
+ * (when collapsed or killed), thus they are dropped, not moved around. */
+static void
+resize_map (ETreeTableAdapter *etta,
+            gint size)
+{
+	GPtrArray *chunks = etta->priv->map_chunks;
+	guint ii;
+
+	for (ii = 0; ii < chunks->len; ii++)
+		g_free (g_ptr_array_index (chunks, ii));
+
+	g_ptr_array_set_size (chunks, 0);
+	etta->priv->n_map = 0;
+	map_chunk_tree_rebuild (etta);
+
+	insert_map_rows (etta, 0, size);
+}
+
+static void
+fill_map_at (ETreeTableAdapter *etta,
+             guint *chunk_index,
+             guint *offset,
+             GNode *gnode)
+{
+	node_t *node = gnode->data;
+	GNode *p;
+
+	if ((gnode != etta->priv->root) || etta->priv->root_visible) {
+		MapChunk *chunk = g_ptr_array_index (etta->priv->map_chunks, *chunk_index);
+
+		while (*offset >= chunk->len) {
+			(*chunk_index)++;
+			*offset = 0;
+			chunk = g_ptr_array_index (etta->priv->map_chunks, *chunk_index);
+		}
+
+		chunk->nodes[*offset] = node;
+		node->chunk = chunk;
+		node->offset = *offset;
+		(*offset)++;
+	} else {
+		node->chunk = NULL;
+	}
+
+	for (p = gnode->children; p; p = p->next)
+		fill_map_at (etta, chunk_index, offset, p);
 }
 
+/* Writes @gnode and its visible descendants into the map, starting at @index */
 static gint
 fill_map (ETreeTableAdapter *etta,
           gint index,
           GNode *gnode)
 {
-	GNode *p;
+	node_t *node = gnode->data;
+	gint size = node->num_visible_children;
+	guint chunk_index, offset;
 
 	if ((gnode != etta->priv->root) || etta->priv->root_visible)
-		etta->priv->map_table[index++] = gnode->data;
+		size++;
+	else
+		node->chunk = NULL;
 
-	for (p = gnode->children; p; p = p->next)
-		index = fill_map (etta, index, p);
+	if (size == 0 || index >= etta->priv->n_map)
+		return index;
+
+	chunk_index = map_find_chunk (etta, index, &offset)->index;
+	fill_map_at (etta, &chunk_index, &offset, gnode);
 
-	etta->priv->remap_needed = TRUE;
-	return index;
+	return index + size;
 }
 
-static void
-remap_indices (ETreeTableAdapter *etta)
+static node_t *
+map_node_at_row (ETreeTableAdapter *etta,
+                 gint row)
 {
-	gint i;
-	for (i = 0; i < etta->priv->n_map; i++)
-		etta->priv->map_table[i]->index = i;
-	etta->priv->remap_needed = FALSE;
+	MapChunk *chunk;
+	guint offset;
+
+	chunk = map_find_chunk (etta, row, &offset);
+
+	return chunk->nodes[offset];
+}
+
+static gint
+map_row_of_node (ETreeTableAdapter *etta,
+                 node_t *node)
+{
+	if (!node->chunk)
+		return -1;
+
+	return map_chunk_start (etta, node->chunk->index) + node->offset;
 }
 
 static node_t *
@@ -341,8 +657,7 @@ delete_node (ETreeTableAdapter *etta,
 	to_remove += delete_children (etta, gnode);
 	kill_gnode (gnode, etta);
 
-	move_map_elements (etta, row, row + to_remove, etta->priv->n_map - row - to_remove);
-	resize_map (etta, etta->priv->n_map - to_remove);
+	delete_map_rows (etta, row, to_remove);
 
 	if (parent_gnode != NULL) {
 		node_t *parent_node = parent_gnode->data;
@@ -361,6 +676,68 @@ delete_node (ETreeTableAdapter *etta,
 	e_table_model_rows_deleted (E_TABLE_MODEL (etta), row, to_remove);
 }
 
+static guint64
+expanded_state_hash_id (const gchar *save_id)
+{
+	/* 64-bit FNV-1a, stable across runs and architectures */
+	guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+
+	for (; *save_id; save_id++) {
+		hash ^= (guchar) *save_id;
+		hash *= G_GUINT64_CONSTANT (1099511628211);
+	}
+
+	return hash;
+}
+
+static guint64
+expanded_state_hash_path (ETreeTableAdapter *etta,
+                          ETreePath path)
+{
+	gchar *save_id;
+	guint64 hash;
+
+	save_id = e_tree_model_get_save_id (etta->priv->source_model, path);
+	hash = expanded_state_hash_id (save_id ? save_id : "");
+	g_free (save_id);
+
+	return hash;
+}
+
+/* Whether the loaded expanded state lists @path as not being in the default state */
+static gboolean
+expanded_state_contains (ETreeTableAdapter *etta,
+                         ETreePath path)
+{
+	const guint64 *ids;
+	gsize size, low, high;
+	guint64 hash;
+
+	if (!etta->priv->expanded_ids)
+		return FALSE;
+
+	ids = g_bytes_get_data (etta->priv->expanded_ids, &size);
+	ids = (const guint64 *) (((const gchar *) ids) + sizeof (ExpandedStateHeader));
+	high = (size - sizeof (ExpandedStateHeader)) / sizeof (guint64);
+	low = 0;
+
+	hash = expanded_state_hash_path (etta, path);
+
+	while (low < high) {
+		gsize middle = low + (high - low) / 2;
+		guint64 value = GUINT64_FROM_LE (ids[middle]);
+
+		if (value == hash)
+			return TRUE;
+		else if (value < hash)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return FALSE;
+}
+
 static GNode *
 create_gnode (ETreeTableAdapter *etta,
               ETreePath path)
@@ -370,11 +747,13 @@ create_gnode (ETreeTableAdapter *etta,
 
 	node = g_new0 (node_t, 1);
 	node->path = path;
-	node->index = -1;
 	node->expanded = etta->priv->force_expanded_state == 0 ? e_tree_model_get_expanded_default (etta->priv->source_model) : etta->priv->force_expanded_state > 0;
 	node->expandable = e_tree_model_node_is_expandable (etta->priv->source_model, path);
 	node->expandable_set = 1;
 	node->num_visible_children = 0;
+	if (etta->priv->force_expanded_state == 0 && node->expandable &&
+	    expanded_state_contains (etta, path))
+		node->expanded = !node->expanded;
 	gnode = g_node_new (node);
 	g_hash_table_insert (etta->priv->nodes, path, gnode);
 	return gnode;
@@ -427,6 +806,10 @@ generate_tree (ETreeTableAdapter *etta,
 		resort_node (etta, gnode, TRUE);
 
 	etta->priv->root = gnode;
+
+	/* The loaded expanded state is applied only to the generated nodes */
+	g_clear_pointer (&etta->priv->expanded_ids, g_bytes_unref);
+
 	size = etta->priv->root_visible ? node->num_visible_children + 1 : node->num_visible_children;
 	resize_map (etta, size);
 	fill_map (etta, 0, gnode);
@@ -438,10 +821,12 @@ insert_node (ETreeTableAdapter *etta,
              ETreePath parent,
              ETreePath path)
 {
-	GNode *gnode, *parent_gnode;
+	GNode *gnode, *parent_gnode, *child;
+	GPtrArray *siblings;
 	node_t *node, *parent_node;
-	gboolean expandable;
+	gboolean expandable, siblings_moved;
 	gint size, row;
+	guint ii;
 
 	e_table_model_pre_change (E_TABLE_MODEL (etta));
 
@@ -469,7 +854,7 @@ insert_node (ETreeTableAdapter *etta,
 			e_table_model_pre_change (E_TABLE_MODEL (etta));
 			parent_node->expandable = expandable;
 			parent_node->expandable_set = 1;
-			e_table_model_row_changed (E_TABLE_MODEL (etta), parent_node->index);
+			e_table_model_row_changed (E_TABLE_MODEL (etta), e_tree_table_adapter_row_of_node (etta, parent));
 		}
 	}
 
@@ -484,22 +869,55 @@ insert_node (ETreeTableAdapter *etta,
 	if (node->expanded)
 		node->num_visible_children = insert_children (etta, gnode);
 
+	siblings = g_ptr_array_sized_new (g_node_n_children (parent_gnode));
+	for (child = parent_gnode->children; child; child = child->next)
+		g_ptr_array_add (siblings, child);
+
 	g_node_append (parent_gnode, gnode);
 	update_child_counts (parent_gnode, node->num_visible_children + 1);
 	resort_node (etta, parent_gnode, FALSE);
 	resort_node (etta, gnode, TRUE);
 
+	/* Only the new node's rows need to be written into the map, unless
+	 * the resort also moved some of the existing children around. */
+	ii = 0;
+	for (child = parent_gnode->children; child; child = child->next) {
+		if (child == gnode)
+			continue;
+		if (ii >= siblings->len || g_ptr_array_index (siblings, ii) != child)
+			break;
+		ii++;
+	}
+	siblings_moved = child != NULL;
+	g_ptr_array_free (siblings, TRUE);
+
 	size = node->num_visible_children + 1;
-	resize_map (etta, etta->priv->n_map + size);
-	if (parent_gnode == etta->priv->root)
-		row = 0;
-	else {
-		gint new_size = parent_node->num_visible_children + 1;
-		gint old_size = new_size - size;
-		row = parent_node->index;
-		move_map_elements (etta, row + new_size, row + old_size, etta->priv->n_map - row - new_size);
+
+	if (siblings_moved) {
+		gint new_size = parent_node->num_visible_children;
+
+		if (parent_gnode == etta->priv->root)
+			row = 0;
+		else
+			row = e_tree_table_adapter_row_of_node (etta, parent);
+		if (parent_gnode != etta->priv->root || etta->priv->root_visible)
+			new_size++;
+		insert_map_rows (etta, row + new_size - size, size);
+		fill_map (etta, row, parent_gnode);
+	} else {
+		if (gnode->prev) {
+			node_t *prev_node = gnode->prev->data;
+
+			row = map_row_of_node (etta, prev_node) + prev_node->num_visible_children + 1;
+		} else if (parent_gnode == etta->priv->root) {
+			row = etta->priv->root_visible ? 1 : 0;
+		} else {
+			row = e_tree_table_adapter_row_of_node (etta, parent) + 1;
+		}
+		insert_map_rows (etta, row, size);
+		fill_map (etta, row, gnode);
 	}
-	fill_map (etta, row, parent_gnode);
+
 	e_table_model_rows_inserted (
 		E_TABLE_MODEL (etta),
 		e_tree_table_adapter_row_of_node (etta, path), size);
@@ -847,7 +1265,12 @@ tree_table_adapter_finalize (GObject *object)
 
 	g_hash_table_destroy (priv->nodes);
 
-	g_free (priv->map_table);
+	resize_map (E_TREE_TABLE_ADAPTER (object), 0);
+	g_ptr_array_free (priv->map_chunks, TRUE);
+	g_free (priv->map_chunk_tree);
+
+	if (priv->expanded_ids)
+		g_bytes_unref (priv->expanded_ids);
 
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_tree_table_adapter_parent_class)->finalize (object);
@@ -1142,8 +1565,9 @@ e_tree_table_adapter_init (ETreeTableAdapter *etta)
 
 	etta->priv->nodes = g_hash_table_new (NULL, NULL);
 
+	etta->priv->map_chunks = g_ptr_array_new ();
+
 	etta->priv->root_visible = TRUE;
-	etta->priv->remap_needed = TRUE;
 }
 
 ETableModel *
@@ -1316,19 +1740,172 @@ e_tree_table_adapter_save_expanded_state_xml (ETreeTableAdapter *etta)
 	return doc;
 }
 
+typedef struct {
+	GArray *ids;
+	gboolean expanded_default;
+	ETreeTableAdapter *etta;
+} CollectExpandedIdsData;
+
+static void
+collect_expanded_ids_func (gpointer keyp,
+                           gpointer value,
+                           gpointer data)
+{
+	node_t *node = ((GNode *) value)->data;
+	CollectExpandedIdsData *ceid = data;
+
+	if (node->expandable && node->expanded != ceid->expanded_default) {
+		guint64 hash = expanded_state_hash_path (ceid->etta, node->path);
+		g_array_append_val (ceid->ids, hash);
+	}
+}
+
+static gint
+compare_expanded_ids (gconstpointer ptr1,
+                      gconstpointer ptr2)
+{
+	guint64 id1 = *((const guint64 *) ptr1);
+	guint64 id2 = *((const guint64 *) ptr2);
+
+	return id1 < id2 ? -1 : id1 > id2 ? 1 : 0;
+}
+
+static gboolean
+expanded_state_is_binary (gconstpointer data,
+                          gsize size)
+{
+	return data && size >= sizeof (ExpandedStateHeader) &&
+		memcmp (data, EXPANDED_STATE_MAGIC, strlen (EXPANDED_STATE_MAGIC)) == 0;
+}
+
+static gboolean
+expanded_state_is_valid (ETreeTableAdapter *etta,
+                         GBytes *bytes)
+{
+	const ExpandedStateHeader *header;
+	gboolean model_default;
+	gsize size;
+
+	header = g_bytes_get_data (bytes, &size);
+
+	if (!expanded_state_is_binary (header, size) ||
+	    GUINT32_FROM_LE (header->version) != EXPANDED_STATE_VERSION ||
+	    size != sizeof (ExpandedStateHeader) + ((gsize) GUINT32_FROM_LE (header->n_ids)) * sizeof (guint64))
+		return FALSE;
+
+	/* In case the default is changed, forget the changes and stick to default */
+	model_default = e_tree_model_get_expanded_default (etta->priv->source_model);
+
+	return (GUINT32_FROM_LE (header->expanded_default) != 0) == (model_default != FALSE);
+}
+
+/* Sets @gnode and its descendants listed in etta->priv->expanded_ids to
+ * the non-default expanded state and leaves the others as they are, like
+ * the XML loader does.  The forced expanded state wins over the listed one,
+ * like in create_gnode().  Returns the number of visible descendants. */
+static guint32
+apply_expanded_state (ETreeTableAdapter *etta,
+                      GNode *gnode,
+                      gboolean model_default,
+                      gboolean *changed)
+{
+	node_t *node = (node_t *) gnode->data;
+	guint32 count = 0;
+	GNode *child;
+
+	if (gnode != etta->priv->root && node->expandable &&
+	    etta->priv->force_expanded_state == 0 &&
+	    expanded_state_contains (etta, node->path)) {
+		gboolean expanded = !model_default;
+
+		if (expanded != node->expanded) {
+			node->expanded = expanded;
+
+			if (expanded)
+				insert_children (etta, gnode);
+			else
+				delete_children (etta, gnode);
+
+			*changed = TRUE;
+		}
+	}
+
+	if (node->expanded) {
+		for (child = gnode->children; child; child = child->next)
+			count += apply_expanded_state (etta, child, model_default, changed) + 1;
+	}
+
+	node->num_visible_children = count;
+
+	return count;
+}
+
+/**
+ * e_tree_table_adapter_save_expanded_state_bytes:
+ * @etta: an #ETreeTableAdapter
+ *
+ * Stores the expanded state of the nodes in a compact binary form, which
+ * can be restored with e_tree_table_adapter_load_expanded_state_bytes().
+ *
+ * Returns: (transfer full): a #GBytes with the expanded state; free it
+ *    with g_bytes_unref(), when no longer needed.
+ *
+ * Since: 3.32
+ **/
+GBytes *
+e_tree_table_adapter_save_expanded_state_bytes (ETreeTableAdapter *etta)
+{
+	CollectExpandedIdsData ceid;
+	ExpandedStateHeader header;
+	GByteArray *array;
+	guint ii;
+
+	g_return_val_if_fail (E_IS_TREE_TABLE_ADAPTER (etta), NULL);
+
+	ceid.etta = etta;
+	ceid.expanded_default = e_tree_model_get_expanded_default (etta->priv->source_model);
+	ceid.ids = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+	g_hash_table_foreach (etta->priv->nodes, collect_expanded_ids_func, &ceid);
+	g_array_sort (ceid.ids, compare_expanded_ids);
+
+	memset (&header, 0, sizeof (ExpandedStateHeader));
+	memcpy (header.magic, EXPANDED_STATE_MAGIC, sizeof (header.magic));
+	header.version = GUINT32_TO_LE (EXPANDED_STATE_VERSION);
+	header.expanded_default = GUINT32_TO_LE (ceid.expanded_default ? 1 : 0);
+	header.n_ids = GUINT32_TO_LE (ceid.ids->len);
+
+	array = g_byte_array_sized_new (sizeof (ExpandedStateHeader) + ceid.ids->len * sizeof (guint64));
+	g_byte_array_append (array, (const guint8 *) &header, sizeof (ExpandedStateHeader));
+
+	for (ii = 0; ii < ceid.ids->len; ii++) {
+		guint64 value = GUINT64_TO_LE (g_array_index (ceid.ids, guint64, ii));
+
+		g_byte_array_append (array, (const guint8 *) &value, sizeof (guint64));
+	}
+
+	g_array_free (ceid.ids, TRUE);
+
+	return g_byte_array_free_to_bytes (array);
+}
+
 void
 e_tree_table_adapter_save_expanded_state (ETreeTableAdapter *etta,
                                           const gchar *filename)
 {
-	xmlDoc *doc;
+	GBytes *bytes;
+	GError *error = NULL;
 
 	g_return_if_fail (E_IS_TREE_TABLE_ADAPTER (etta));
 
-	doc = e_tree_table_adapter_save_expanded_state_xml (etta);
-	if (doc) {
-		e_xml_save_file (filename, doc);
-		xmlFreeDoc (doc);
+	bytes = e_tree_table_adapter_save_expanded_state_bytes (etta);
+
+	if (!g_file_set_contents (filename, g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes), &error)) {
+		g_warning ("%s: Failed to save '%s': %s", G_STRFUNC, filename, error ? error->message : "Unknown error");
+		g_clear_error (&error);
 	}
+
+	g_bytes_unref (bytes);
 }
 
 static xmlDoc *
@@ -1450,14 +2027,107 @@ e_tree_table_adapter_load_expanded_state_xml (ETreeTableAdapter *etta,
 	e_table_model_changed (E_TABLE_MODEL (etta));
 }
 
+/**
+ * e_tree_table_adapter_load_expanded_state_bytes:
+ * @etta: an #ETreeTableAdapter
+ * @bytes: a #GBytes with the expanded state
+ *
+ * Restores the expanded state saved by e_tree_table_adapter_save_expanded_state_bytes().
+ * Existing nodes are updated in one pass.  When the tree is not generated
+ * yet, the state is applied to it once it is.  Nodes not listed in
+ * the @bytes keep their current state.
+ *
+ * Since: 3.32
+ **/
+void
+e_tree_table_adapter_load_expanded_state_bytes (ETreeTableAdapter *etta,
+                                                GBytes *bytes)
+{
+	gboolean model_default;
+	gboolean changed = FALSE;
+	guint32 count;
+
+	g_return_if_fail (E_IS_TREE_TABLE_ADAPTER (etta));
+	g_return_if_fail (bytes != NULL);
+
+	if (etta->priv->expanded_ids) {
+		g_bytes_unref (etta->priv->expanded_ids);
+		etta->priv->expanded_ids = NULL;
+	}
+
+	if (!expanded_state_is_valid (etta, bytes))
+		return;
+
+	etta->priv->expanded_ids = g_bytes_ref (bytes);
+
+	/* Applied by generate_tree() */
+	if (!etta->priv->root)
+		return;
+
+	e_table_model_pre_change (E_TABLE_MODEL (etta));
+
+	model_default = e_tree_model_get_expanded_default (etta->priv->source_model);
+	count = apply_expanded_state (etta, etta->priv->root, model_default, &changed);
+
+	/* Applied; the nodes created later get the default state */
+	g_clear_pointer (&etta->priv->expanded_ids, g_bytes_unref);
+
+	if (!changed) {
+		e_table_model_no_change (E_TABLE_MODEL (etta));
+		return;
+	}
+
+	if (etta->priv->sort_info && e_table_sort_info_sorting_get_count (etta->priv->sort_info) > 0)
+		resort_node (etta, etta->priv->root, TRUE);
+
+	resize_map (etta, etta->priv->root_visible ? count + 1 : count);
+	fill_map (etta, 0, etta->priv->root);
+
+	e_table_model_changed (E_TABLE_MODEL (etta));
+}
+
 void
 e_tree_table_adapter_load_expanded_state (ETreeTableAdapter *etta,
                                           const gchar *filename)
 {
+	GMappedFile *mapped_file;
 	xmlDoc *doc;
 
 	g_return_if_fail (E_IS_TREE_TABLE_ADAPTER (etta));
 
+	mapped_file = g_mapped_file_new (filename, FALSE, NULL);
+	if (mapped_file) {
+		if (expanded_state_is_binary (
+			g_mapped_file_get_contents (mapped_file),
+			g_mapped_file_get_length (mapped_file))) {
+			GBytes *bytes;
+
+#ifdef G_OS_WIN32
+			/* Do not keep the file mapped, it could not be replaced then */
+			bytes = g_bytes_new (
+				g_mapped_file_get_contents (mapped_file),
+				g_mapped_file_get_length (mapped_file));
+#else
+			bytes = g_mapped_file_get_bytes (mapped_file);
+#endif
+			g_mapped_file_unref (mapped_file);
+
+			e_tree_table_adapter_load_expanded_state_bytes (etta, bytes);
+			g_bytes_unref (bytes);
+
+			return;
+		}
+
+		g_mapped_file_unref (mapped_file);
+	}
+
+	if (etta->priv->expanded_ids) {
+		g_bytes_unref (etta->priv->expanded_ids);
+		etta->priv->expanded_ids = NULL;
+	}
+
+	/* Files written by older versions are XML; the next save
+	 * stores them in the binary form. */
 	doc = open_file (etta, filename);
 	if (!doc)
 		return;
@@ -1537,8 +2207,7 @@ e_tree_table_adapter_node_set_expanded (ETreeTableAdapter *etta,
 		update_child_counts (gnode, num_children);
 		if (etta->priv->sort_info && e_table_sort_info_sorting_get_count (etta->priv->sort_info) > 0)
 			resort_node (etta, gnode, TRUE);
-		resize_map (etta, etta->priv->n_map + num_children);
-		move_map_elements (etta, row + 1 + num_children, row + 1, etta->priv->n_map - row - 1 - num_children);
+		insert_map_rows (etta, row + 1, num_children);
 		fill_map (etta, row, gnode);
 		if (num_children != 0) {
 			e_table_model_rows_inserted (E_TABLE_MODEL (etta), row + 1, num_children);
@@ -1550,9 +2219,8 @@ e_tree_table_adapter_node_set_expanded (ETreeTableAdapter *etta,
 			e_table_model_no_change (E_TABLE_MODEL (etta));
 			return;
 		}
-		move_map_elements (etta, row + 1, row + 1 + num_children, etta->priv->n_map - row - 1 - num_children);
+		delete_map_rows (etta, row + 1, num_children);
 		update_child_counts (gnode, - num_children);
-		resize_map (etta, etta->priv->n_map - num_children);
 		e_table_model_rows_deleted (E_TABLE_MODEL (etta), row + 1, num_children);
 	}
 }
@@ -1586,7 +2254,7 @@ e_tree_table_adapter_node_at_row (ETreeTableAdapter *etta,
 	else if (row < 0 || row >= etta->priv->n_map)
 		return NULL;
 
-	return etta->priv->map_table[row]->path;
+	return map_node_at_row (etta, row)->path;
 }
 
 gint
@@ -1601,10 +2269,7 @@ e_tree_table_adapter_row_of_node (ETreeTableAdapter *etta,
 	if (node == NULL)
 		return -1;
 
-	if (etta->priv->remap_needed)
-		remap_indices (etta);
-
-	return node->index;
+	return map_row_of_node (etta, node);
 }
 
 gboolean
@@ -133,6 +133,11 @@ xmlDoc *	e_tree_table_adapter_save_expanded_state_xml
 void		e_tree_table_adapter_load_expanded_state_xml
 						(ETreeTableAdapter *etta,
 						 xmlDoc *doc);
+GBytes *	e_tree_table_adapter_save_expanded_state_bytes
+						(ETreeTableAdapter *etta);
+void		e_tree_table_adapter_load_expanded_state_bytes
+						(ETreeTableAdapter *etta,
+						 GBytes *bytes);
 void		e_tree_table_adapter_clear_nodes_silent
 						(ETreeTableAdapter *etta);
 
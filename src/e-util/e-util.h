@@ -166,6 +166,7 @@
 #include <e-util/e-photo-cache.h>
 #include <e-util/e-photo-source.h>
 #include <e-util/e-picture-gallery.h>
+#include <e-util/e-pipe-stream.h>
 #include <e-util/e-plugin-ui.h>
 #include <e-util/e-plugin.h>
 #include <e-util/e-poolv.h>
@@ -43,6 +43,11 @@ gal_a11y_e_cell_toggle_dispose (GObject *object)
 		a11y->model_id = 0;
 	}
 
+	if (e_table_model && a11y->model_rows_id > 0) {
+		g_signal_handler_disconnect (e_table_model, a11y->model_rows_id);
+		a11y->model_rows_id = 0;
+	}
+
 	if (parent_class->dispose)
 		parent_class->dispose (object);
 }
@@ -147,6 +152,16 @@ model_change_cb (ETableModel *etm,
 		update_cell (cell, TRUE);
 }
 
+static void
+model_rows_change_cb (ETableModel *etm,
+                      gint row,
+                      gint count,
+                      GalA11yECell *cell)
+{
+	if (cell->row >= row && cell->row < row + count)
+		update_cell (cell, TRUE);
+}
+
 AtkObject *
 gal_a11y_e_cell_toggle_new (ETableItem *item,
                             ECellView *cell_view,
@@ -187,6 +202,9 @@ gal_a11y_e_cell_toggle_new (ETableItem *item,
 	toggle_cell->model_id = g_signal_connect (
 		item->table_model, "model_cell_changed",
 		(GCallback) model_change_cb, a11y);
+	toggle_cell->model_rows_id = g_signal_connect (
+		item->table_model, "model_rows_changed",
+		(GCallback) model_rows_change_cb, a11y);
 
 	update_cell (cell, FALSE);
 
@@ -44,6 +44,7 @@ struct _GalA11yECellToggle
 {
   GalA11yECell parent;
   gint         model_id;
+  gint         model_rows_id;
 };
 
 GType gal_a11y_e_cell_toggle_get_type (void);
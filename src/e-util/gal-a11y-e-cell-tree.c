@@ -39,18 +39,13 @@ static AtkObjectClass *a11y_parent_class;
 #define d(x)
 
 static void
-ectr_model_row_changed_cb (ETableModel *etm,
-                           gint row,
-                           GalA11yECell *a11y)
+ectr_update_expanded_state (ETableModel *etm,
+                            GalA11yECell *a11y)
 {
 	ETreePath node;
 	ETreeModel *tree_model;
 	ETreeTableAdapter *tree_table_adapter;
 
-	g_return_if_fail (a11y);
-	if (a11y->row != row)
-		return;
-
 	node = e_table_model_value_at (etm, -1, a11y->row);
 	tree_model = e_table_model_value_at (etm, -2, a11y->row);
 	tree_table_adapter = e_table_model_value_at (etm, -3, a11y->row);
@@ -64,6 +59,31 @@ ectr_model_row_changed_cb (ETableModel *etm,
 	}
 }
 
+static void
+ectr_model_row_changed_cb (ETableModel *etm,
+                           gint row,
+                           GalA11yECell *a11y)
+{
+	g_return_if_fail (a11y);
+	if (a11y->row != row)
+		return;
+
+	ectr_update_expanded_state (etm, a11y);
+}
+
+static void
+ectr_model_rows_changed_cb (ETableModel *etm,
+                            gint row,
+                            gint count,
+                            GalA11yECell *a11y)
+{
+	g_return_if_fail (a11y);
+	if (a11y->row < row || a11y->row >= row + count)
+		return;
+
+	ectr_update_expanded_state (etm, a11y);
+}
+
 static void
 kill_view_cb (ECellView *subcell_view,
              gpointer psubcell_a11ies)
@@ -95,6 +115,9 @@ ectr_subcell_weak_ref (GalA11yECellTree *a11y,
 		g_signal_handler_disconnect (
 			GAL_A11Y_E_CELL (a11y)->item->table_model,
 			a11y->model_row_changed_id);
+		g_signal_handler_disconnect (
+			GAL_A11Y_E_CELL (a11y)->item->table_model,
+			a11y->model_rows_changed_id);
 	}
 	g_object_unref (a11y);
 }
@@ -249,6 +272,9 @@ gal_a11y_e_cell_tree_new (ETableItem *item,
 	a11y->model_row_changed_id = g_signal_connect (
 		item->table_model, "model_row_changed",
 		G_CALLBACK (ectr_model_row_changed_cb), subcell_a11y);
+	a11y->model_rows_changed_id = g_signal_connect (
+		item->table_model, "model_rows_changed",
+		G_CALLBACK (ectr_model_rows_changed_cb), subcell_a11y);
 
 	if (subcell_a11y && subcell_view)
 	{
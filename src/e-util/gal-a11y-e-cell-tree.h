@@ -47,6 +47,7 @@ struct _GalA11yECellTree {
 	GalA11yECell object;
 
 	gint model_row_changed_id;
+	gint model_rows_changed_id;
 };
 
 struct _GalA11yECellTreeClass {
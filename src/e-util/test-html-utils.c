@@ -0,0 +1,630 @@
+/*
+ * test-html-utils.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Compares e_text_to_html_full() with the implementation it replaced,
+ * which is kept below as the reference, on random texts, and checks
+ * that its time grows linearly with the size of the text. */
+
+#include "evolution-config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "e-html-utils.h"
+
+static gchar *reference_text_to_html_full (const gchar *input, guint flags, guint32 color);
+
+static gchar *
+reference_text_to_html (const gchar *input,
+                        guint flags)
+{
+	return reference_text_to_html_full (input, flags, 0);
+}
+
+static gchar *
+check_size (gchar **buffer,
+            gint *buffer_size,
+            gchar *out,
+            gint len)
+{
+	if (out + len + 1> *buffer + *buffer_size) {
+		gint index = out - *buffer;
+
+		*buffer_size = MAX (index + len + 1, *buffer_size * 2);
+		*buffer = g_realloc (*buffer, *buffer_size);
+		out = *buffer + index;
+	}
+	return out;
+}
+
+/* auto-urlification hints: the goal is not to be strictly RFC-compliant,
+ * but rather to accurately distinguish urls/addresses from non-urls/
+ * addresses in real-world email.
+ *
+ * 1 = non-email-address chars: ()<>@,;:\"[]`'{}|
+ * 2 = trailing url garbage:    ,.!?;:>)]}`'-_
+ * 4 = allowed dns chars
+ * 8 = non-url chars:           "|
+ */
+static gint special_chars[] = {
+	9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,    /*  nul - 0x0f */
+	9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,    /* 0x10 - 0x1f */
+	9, 2, 9, 0, 0, 0, 0, 3, 1, 3, 0, 0, 3, 6, 6, 0,    /*   sp - /    */
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 3, 3, 1, 0, 3, 2,    /*    0 - ?    */
+	1, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,    /*    @ - O    */
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 1, 1, 3, 0, 2,    /*    P - _    */
+	3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,    /*    ` - o    */
+	4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 1, 9, 3, 0, 3     /*    p - del  */
+};
+
+#define is_addr_char(c) (c < 128 && !(special_chars[c] & 1))
+#define is_url_char(c) (c < 128 && !(special_chars[c] & 8))
+#define is_trailing_garbage(c) (c > 127 || (special_chars[c] & 2))
+#define is_domain_name_char(c) (c < 128 && (special_chars[c] & 4))
+
+/* (http|https|ftp|nntp)://[^ "|/]+\.([^ "|]*[^ ,.!?;:>)\]}`'"|_-])+ */
+/* www\.[A-Za-z0-9.-]+(/([^ "|]*[^ ,.!?;:>)\]}`'"|_-])+)             */
+
+static gchar *
+url_extract (const guchar **text,
+             gboolean full_url,
+	     gboolean use_whole_text)
+{
+	const guchar *end = *text, *p;
+	gchar *out;
+
+	if (use_whole_text) {
+		end = (*text) + strlen ((const gchar *) (*text));
+	} else {
+		while (*end && is_url_char (*end))
+			end++;
+	}
+
+	/* Back up if we probably went too far. */
+	while (end > *text && is_trailing_garbage (*(end - 1)))
+		end--;
+
+	if (full_url) {
+		/* Make sure this really looks like a URL. */
+		p = memchr (*text, ':', end - *text);
+		if (!p || end - p < 4)
+			return NULL;
+	} else {
+		/* Make sure this really looks like a hostname. */
+		p = memchr (*text, '.', end - *text);
+		if (!p || p >= end - 2)
+			return NULL;
+		p = memchr (p + 2, '.', end - (p + 2));
+		if (!p || p >= end - 2)
+			return NULL;
+	}
+
+	out = g_strndup ((gchar *) * text, end - *text);
+	*text = end;
+	return out;
+}
+
+static gchar *
+email_address_extract (const guchar **cur,
+                       gchar **out,
+                       const guchar *linestart)
+{
+	const guchar *start, *end, *dot;
+	gchar *addr;
+
+	/* *cur points to the '@'. Look backward for a valid local-part */
+	for (start = *cur; start - 1 >= linestart && is_addr_char (*(start - 1)); start--)
+		;
+	if (start == *cur)
+		return NULL;
+	if (start > linestart + 2 &&
+	    start[-1] == ':' && start[0] == '/' && start[1] == '/')
+		return NULL;
+
+	/* Now look forward for a valid domain part */
+	for (end = *cur + 1, dot = NULL; is_domain_name_char (*end); end++) {
+		if (*end == '.' && !dot)
+			dot = end;
+	}
+	if (!dot)
+		return NULL;
+
+	/* Remove trailing garbage */
+	while (is_trailing_garbage (*(end - 1)))
+		end--;
+	if (dot > end)
+		return NULL;
+
+	addr = g_strndup ((gchar *) start, end - start);
+	*out -= *cur - start;
+	*cur = end;
+
+	return addr;
+}
+
+static gboolean
+is_citation (const guchar *c,
+             gboolean saw_citation)
+{
+	const guchar *p;
+
+	if (*c != '>')
+		return FALSE;
+
+	/* A line that starts with a ">" is a citation, unless it's
+	 * just mbox From-mangling...
+	 */
+	if (strncmp ((const gchar *) c, ">From ", 6) != 0)
+		return TRUE;
+
+	/* If the previous line was a citation, then say this
+	 * one is too.
+	 */
+	if (saw_citation)
+		return TRUE;
+
+	/* Same if the next line is */
+	p = (const guchar *) strchr ((const gchar *) c, '\n');
+	if (p && *++p == '>')
+		return TRUE;
+
+	/* Otherwise, it was just an isolated ">From" line. */
+	return FALSE;
+}
+
+/* e_text_to_html_full() before the plain text runs were copied at once
+ * and before the URL and address candidates were scanned only once. */
+gchar *
+reference_text_to_html_full (const gchar *input,
+                             guint flags,
+                             guint32 color)
+{
+	const guchar *cur, *next, *linestart;
+	gchar *buffer = NULL;
+	gchar *out = NULL;
+	gint buffer_size = 0, col;
+	gboolean colored = FALSE, saw_citation = FALSE;
+
+	/* Allocate a translation buffer, with the one byte fix.  */
+	buffer_size = strlen (input) * 2 + 6;
+	buffer = g_malloc (buffer_size);
+
+	out = buffer;
+	if (flags & E_TEXT_TO_HTML_PRE)
+		out += sprintf (out, "<PRE>");
+
+	col = 0;
+
+	for (cur = linestart = (const guchar *) input; cur && *cur; cur = next) {
+		gunichar u;
+
+		if (flags & E_TEXT_TO_HTML_MARK_CITATION && col == 0) {
+			saw_citation = is_citation (cur, saw_citation);
+			if (saw_citation) {
+				if (!colored) {
+					gchar font[25];
+
+					g_snprintf (font, 25, "<FONT COLOR=\"#%06x\">", color);
+
+					out = check_size (&buffer, &buffer_size, out, 25);
+					out += sprintf (out, "%s", font);
+					colored = TRUE;
+				}
+			} else if (colored) {
+				const gchar *no_font = "</FONT>";
+
+				out = check_size (&buffer, &buffer_size, out, 9);
+				out += sprintf (out, "%s", no_font);
+				colored = FALSE;
+			}
+
+			/* Display mbox-mangled ">From" as "From" */
+			if (*cur == '>' && !saw_citation)
+				cur++;
+		} else if (flags & E_TEXT_TO_HTML_CITE && col == 0) {
+			out = check_size (&buffer, &buffer_size, out, 5);
+			out += sprintf (out, "&gt; ");
+		}
+
+		u = g_utf8_get_char ((gchar *) cur);
+		if (g_unichar_isalpha (u) &&
+		    (flags & E_TEXT_TO_HTML_CONVERT_URLS)) {
+			gchar *tmpurl = NULL, *refurl = NULL, *dispurl = NULL;
+
+			if (!g_ascii_strncasecmp ((gchar *) cur, "http://", 7) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "https://", 8) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "ftp://", 6) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "nntp://", 7) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "mailto:", 7) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "news:", 5) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "file:", 5) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "callto:", 7) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "h323:", 5) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "sip:", 4) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "tel:", 4) ||
+			    !g_ascii_strncasecmp ((gchar *) cur, "webcal:", 7)) {
+				tmpurl = url_extract (&cur, TRUE, (flags & E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT) != 0);
+				if (tmpurl) {
+					refurl = reference_text_to_html (tmpurl, 0);
+					if ((flags & E_TEXT_TO_HTML_HIDE_URL_SCHEME) != 0) {
+						const gchar *str;
+
+						str = strchr (refurl, ':');
+						if (str) {
+							str++;
+							if (g_ascii_strncasecmp (str, "//", 2) == 0) {
+								str += 2;
+							}
+
+							dispurl = g_strdup (str);
+						} else {
+							dispurl = g_strdup (refurl);
+						}
+					} else {
+						dispurl = g_strdup (refurl);
+					}
+				}
+			} else if (!g_ascii_strncasecmp ((gchar *) cur, "www.", 4) &&
+				   is_url_char (*(cur + 4))) {
+				tmpurl = url_extract (&cur, FALSE, (flags & E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT) != 0);
+				if (tmpurl) {
+					dispurl = reference_text_to_html (tmpurl, 0);
+					refurl = g_strdup_printf (
+						"http://%s", dispurl);
+				}
+			}
+
+			if (tmpurl) {
+				if ((flags & E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT) != 0) {
+					/* also remove any spaces in refurl */
+					gchar *replaced, **split_url;
+
+					split_url = g_strsplit (refurl, " ", 0);
+					replaced = g_strjoinv ("", split_url);
+					g_strfreev (split_url);
+
+					g_free (refurl);
+					refurl = replaced;
+				}
+
+				out = check_size (
+					&buffer, &buffer_size, out,
+					strlen (refurl) +
+					strlen (dispurl) + 15);
+				out += sprintf (out,
+						"<a href=\"%s\">%s</a>",
+						refurl, dispurl);
+				col += strlen (tmpurl);
+				g_free (tmpurl);
+				g_free (refurl);
+				g_free (dispurl);
+			}
+
+			if (!*cur)
+				break;
+			u = g_utf8_get_char ((gchar *) cur);
+		}
+
+		if (u == '@' && (flags & E_TEXT_TO_HTML_CONVERT_ADDRESSES)) {
+			gchar *addr, *dispaddr, *outaddr;
+
+			addr = email_address_extract (&cur, &out, linestart);
+			if (addr) {
+				dispaddr = reference_text_to_html (addr, 0);
+				outaddr = g_strdup_printf (
+					"<a href=\"mailto:%s\">%s</a>",
+					addr, dispaddr);
+				out = check_size (&buffer, &buffer_size, out, strlen (outaddr));
+				out += sprintf (out, "%s", outaddr);
+				col += strlen (addr);
+				g_free (addr);
+				g_free (dispaddr);
+				g_free (outaddr);
+
+				if (!*cur)
+					break;
+				u = g_utf8_get_char ((gchar *) cur);
+			}
+		}
+
+		if (!g_unichar_validate (u)) {
+			/* Sigh. Someone sent undeclared 8-bit data.
+			 * Assume it's iso-8859-1.
+			 */
+			u = *cur;
+			next = cur + 1;
+		} else
+			next = (const guchar *) g_utf8_next_char (cur);
+
+		out = check_size (&buffer, &buffer_size, out, 10);
+
+		switch (u) {
+		case '<':
+			strcpy (out, "&lt;");
+			out += 4;
+			col++;
+			break;
+
+		case '>':
+			strcpy (out, "&gt;");
+			out += 4;
+			col++;
+			break;
+
+		case '&':
+			strcpy (out, "&amp;");
+			out += 5;
+			col++;
+			break;
+
+		case '"':
+			strcpy (out, "&quot;");
+			out += 6;
+			col++;
+			break;
+
+		case '\n':
+			if (flags & E_TEXT_TO_HTML_CONVERT_NL) {
+				strcpy (out, "<br>");
+				out += 4;
+			}
+			*out++ = *cur;
+			linestart = cur;
+			col = 0;
+			break;
+
+		case '\t':
+			if (flags & (E_TEXT_TO_HTML_CONVERT_SPACES |
+				     E_TEXT_TO_HTML_CONVERT_NL)) {
+				do {
+					out = check_size (
+						&buffer, &buffer_size, out, 7);
+					strcpy (out, "&nbsp;");
+					out += 6;
+					col++;
+				} while (col % 8);
+				break;
+			}
+			/* otherwise, FALL THROUGH */
+
+		case ' ':
+			if (flags & E_TEXT_TO_HTML_CONVERT_SPACES) {
+				if (cur == (const guchar *) input ||
+				    *(cur + 1) == ' ' || *(cur + 1) == '\t' ||
+				    *(cur - 1) == '\n') {
+					strcpy (out, "&nbsp;");
+					out += 6;
+					col++;
+					break;
+				}
+			}
+			/* otherwise, FALL THROUGH */
+
+		default:
+			if ((u >= 0x20 && u < 0x80) ||
+			    (u == '\r' || u == '\t')) {
+				/* Default case, just copy. */
+				*out++ = u;
+			} else {
+				if (flags & E_TEXT_TO_HTML_ESCAPE_8BIT)
+					*out++ = '?';
+				else
+					out += g_snprintf (out, 9, "&#%d;", u);
+			}
+			col++;
+			break;
+		}
+	}
+
+	out = check_size (&buffer, &buffer_size, out, 7);
+	if (flags & E_TEXT_TO_HTML_PRE)
+		strcpy (out, "</PRE>");
+	else
+		*out = '\0';
+
+	return buffer;
+}
+
+static const gchar *fragments[] = {
+	"a", "Hello", "world", " ", "  ", "\t", "\n", "\r\n", "> ", ">", ">From ",
+	"<", "&", "\"", "'", ".", ",", "(", ")", "|", "@", "bob@foo.com", "@foo.com",
+	"http://www.foo.com/index.html?a=1&b=2", "https://", "HTTP://foo.com.",
+	"www.foo.com", "www.", "mailto:bob@foo.com", "sip:bob", "tel:123",
+	"webcal://x.org/cal.ics", "h323:", "news:", "ftp://ftp.foo.org/",
+	"\xc3\xa9t\xc3\xa9", "\xe2\x82\xac", "\xff", "\x01", "~", "{}", "[x]"
+};
+
+static gchar *
+random_text (GRand *rand)
+{
+	GString *text;
+	gint ii, n_fragments;
+
+	text = g_string_new ("");
+	n_fragments = g_rand_int_range (rand, 0, 40);
+
+	for (ii = 0; ii < n_fragments; ii++) {
+		g_string_append (text, fragments[g_rand_int_range (rand, 0, G_N_ELEMENTS (fragments))]);
+	}
+
+	return g_string_free (text, FALSE);
+}
+
+/* The output is byte-identical to the reference implementation */
+static void
+test_compare_with_reference (void)
+{
+	GRand *rand;
+	gint ii;
+
+	rand = g_rand_new_with_seed (41);
+
+	for (ii = 0; ii < 200000; ii++) {
+		gchar *text, *html, *expected;
+		guint flags;
+
+		text = random_text (rand);
+		flags = g_rand_int_range (rand, 0, E_TEXT_TO_HTML_LAST_FLAG);
+
+		html = e_text_to_html_full (text, flags, 0x737373);
+		expected = reference_text_to_html_full (text, flags, 0x737373);
+
+		if (strcmp (html, expected) != 0) {
+			g_test_message (
+				"Text \"%s\" with flags 0x%x:\n  expected %s\n  got %s",
+				text, flags, expected, html);
+		}
+
+		g_assert_cmpstr (html, ==, expected);
+
+		g_free (expected);
+		g_free (html);
+		g_free (text);
+	}
+
+	g_rand_free (rand);
+}
+
+#define ALL_FLAGS \
+	(E_TEXT_TO_HTML_CONVERT_NL | \
+	 E_TEXT_TO_HTML_CONVERT_SPACES | \
+	 E_TEXT_TO_HTML_CONVERT_URLS | \
+	 E_TEXT_TO_HTML_MARK_CITATION | \
+	 E_TEXT_TO_HTML_CONVERT_ADDRESSES)
+
+static const struct {
+	const gchar *name;
+	const gchar *line;
+	guint flags;
+} scaling_texts[] = {
+	{ "mail",
+	  "> Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do\n"
+	  "eiusmod tempor incididunt ut labore et dolore magna aliqua. Ut enim\n"
+	  "ad minim veniam, see http://www.example.com/path or mail bob@foo.com\n"
+	  "\n", ALL_FLAGS },
+	/* One long line of address and URL candidates */
+	{ "candidates", "bob@foo a@b.c@d www.x sip: http:x ", ALL_FLAGS },
+	/* One long word with a candidate in every few characters */
+	{ "word", "bob@foo-www.x-sip:a-", ALL_FLAGS },
+	{ "whole-text", "www.x http:/ @ ", ALL_FLAGS | E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT }
+};
+
+/* The best of several runs, to filter out the noise */
+static gdouble
+measure_text_to_html (const gchar *text,
+                      guint flags)
+{
+	GTimer *timer;
+	gdouble best = G_MAXDOUBLE;
+	gint ii;
+
+	timer = g_timer_new ();
+
+	for (ii = 0; ii < 3; ii++) {
+		gchar *html;
+
+		g_timer_start (timer);
+		html = e_text_to_html_full (text, flags, 0);
+		best = MIN (best, g_timer_elapsed (timer, NULL));
+		g_free (html);
+	}
+
+	g_timer_destroy (timer);
+
+	return best;
+}
+
+/* The time grows linearly with the size of the text; a quadratic
+ * one would be 64 times longer for the eight times larger text. */
+static void
+test_scaling (void)
+{
+	const gsize sizes[] = { 128 * 1024, 256 * 1024, 512 * 1024, 1024 * 1024 };
+	guint ii, jj;
+
+	for (ii = 0; ii < G_N_ELEMENTS (scaling_texts); ii++) {
+		GString *text;
+		gdouble secs[G_N_ELEMENTS (sizes)];
+
+		text = g_string_new ("");
+
+		for (jj = 0; jj < G_N_ELEMENTS (sizes); jj++) {
+			while (text->len < sizes[jj])
+				g_string_append (text, scaling_texts[ii].line);
+
+			secs[jj] = measure_text_to_html (text->str, scaling_texts[ii].flags);
+
+			g_test_message (
+				"%s: %" G_GSIZE_FORMAT " bytes in %.4f s",
+				scaling_texts[ii].name, text->len, secs[jj]);
+		}
+
+		g_assert_cmpfloat (secs[G_N_ELEMENTS (sizes) - 1], <, 24 * MAX (secs[0], 0.0005));
+
+		g_string_free (text, TRUE);
+	}
+}
+
+/* Compares with the reference on larger texts; only with "-m perf" */
+static void
+test_benchmark (void)
+{
+	const gsize sizes[] = { 1024 * 1024, 2 * 1024 * 1024, 4 * 1024 * 1024, 8 * 1024 * 1024 };
+	GString *text;
+	GTimer *timer;
+	guint ii;
+
+	text = g_string_new ("");
+	timer = g_timer_new ();
+
+	for (ii = 0; ii < G_N_ELEMENTS (sizes); ii++) {
+		gdouble reference_secs, secs;
+		gchar *html;
+
+		while (text->len < sizes[ii])
+			g_string_append (text, scaling_texts[0].line);
+
+		g_timer_start (timer);
+		html = reference_text_to_html_full (text->str, ALL_FLAGS, 0);
+		reference_secs = g_timer_elapsed (timer, NULL);
+		g_free (html);
+
+		secs = measure_text_to_html (text->str, ALL_FLAGS);
+
+		g_test_message (
+			"%" G_GSIZE_FORMAT " bytes: reference %.3f s, current %.3f s",
+			text->len, reference_secs, secs);
+	}
+
+	g_timer_destroy (timer);
+	g_string_free (text, TRUE);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/EHTMLUtils/CompareWithReference", test_compare_with_reference);
+	g_test_add_func ("/EHTMLUtils/Scaling", test_scaling);
+
+	if (g_test_perf ())
+		g_test_add_func ("/EHTMLUtils/Benchmark", test_benchmark);
+
+	return g_test_run ();
+}
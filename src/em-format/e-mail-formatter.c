@@ -1062,9 +1062,9 @@ e_mail_formatter_format_text (EMailFormatter *formatter,
 {
 	CamelMimeFilter *filter;
 	const gchar *charset = NULL;
-	CamelMimeFilter *windows = NULL;
 	CamelMimePart *mime_part;
 	CamelContentType *mime_type;
+	GBytes *decoded = NULL;
 
 	if (g_cancellable_is_cancelled (cancellable))
 		return;
@@ -1074,34 +1074,51 @@ e_mail_formatter_format_text (EMailFormatter *formatter,
 
 	if (formatter->priv->charset != NULL) {
 		charset = formatter->priv->charset;
+	} else if ((charset = e_mail_part_get_real_charset (part)) != NULL) {
+		/* Detected when the part had been formatted before. */
 	} else if (mime_type != NULL
 		   && (charset = camel_content_type_param (mime_type, "charset"))
 		   && g_ascii_strncasecmp (charset, "iso-8859-", 9) == 0) {
-		GOutputStream *null_stream;
+		CamelMimeFilter *windows;
+		GOutputStream *memory_stream;
 		GOutputStream *filter_stream;
 
 		/* Since a few Windows mailers like to claim they sent
 		 * out iso-8859-# encoded text when they really sent
 		 * out windows-cp125#, do some simple sanity checking
-		 * before we move on... */
+		 * before we move on. The windows filter passes the data
+		 * through unchanged, thus keep the decoded content and
+		 * convert it from memory, instead of decoding it twice. */
 
-		null_stream = camel_null_output_stream_new ();
+		memory_stream = g_memory_output_stream_new_resizable ();
 		windows = camel_mime_filter_windows_new (charset);
 		filter_stream = camel_filter_output_stream_new (
-			null_stream, windows);
+			memory_stream, windows);
 		g_filter_output_stream_set_close_base_stream (
 			G_FILTER_OUTPUT_STREAM (filter_stream), FALSE);
 
 		camel_data_wrapper_decode_to_output_stream_sync (
-			CAMEL_DATA_WRAPPER (mime_part),
+			camel_medium_get_content (CAMEL_MEDIUM (mime_part)),
 			filter_stream, cancellable, NULL);
 		g_output_stream_flush (filter_stream, cancellable, NULL);
+		g_output_stream_close (memory_stream, NULL, NULL);
+
+		decoded = g_memory_output_stream_steal_as_bytes (
+			G_MEMORY_OUTPUT_STREAM (memory_stream));
 
 		g_object_unref (filter_stream);
-		g_object_unref (null_stream);
+		g_object_unref (memory_stream);
+
+		/* Interned, because it can belong to the filter */
+		charset = g_intern_string (
+			camel_mime_filter_windows_real_charset (
+			CAMEL_MIME_FILTER_WINDOWS (windows)));
+
+		/* Only a complete scan has the right answer */
+		if (!g_cancellable_is_cancelled (cancellable))
+			e_mail_part_set_real_charset (part, charset);
 
-		charset = camel_mime_filter_windows_real_charset (
-			CAMEL_MIME_FILTER_WINDOWS (windows));
+		g_object_unref (windows);
 	} else if (charset == NULL) {
 		charset = formatter->priv->default_charset;
 	}
@@ -1118,13 +1135,21 @@ e_mail_formatter_format_text (EMailFormatter *formatter,
 		g_object_ref (stream);
 	}
 
-	camel_data_wrapper_decode_to_output_stream_sync (
-		camel_medium_get_content (CAMEL_MEDIUM (mime_part)),
-		stream, cancellable, NULL);
+	if (decoded != NULL) {
+		g_output_stream_write_all (
+			stream,
+			g_bytes_get_data (decoded, NULL),
+			g_bytes_get_size (decoded),
+			NULL, cancellable, NULL);
+		g_bytes_unref (decoded);
+	} else {
+		camel_data_wrapper_decode_to_output_stream_sync (
+			camel_medium_get_content (CAMEL_MEDIUM (mime_part)),
+			stream, cancellable, NULL);
+	}
 	g_output_stream_flush (stream, cancellable, NULL);
 
 	g_object_unref (stream);
-	g_clear_object (&windows);
 	g_clear_object (&mime_part);
 }
 
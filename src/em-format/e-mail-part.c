@@ -49,6 +49,8 @@ struct _EMailPartPrivate {
 
 	gboolean is_attachment;
 	gboolean converted_to_utf8;
+
+	const gchar *real_charset; /* interned */
 };
 
 enum {
@@ -492,6 +494,47 @@ e_mail_part_set_converted_to_utf8 (EMailPart *part,
 	g_object_notify (G_OBJECT (part), "converted-to-utf8");
 }
 
+/**
+ * e_mail_part_get_real_charset:
+ * @part: an #EMailPart
+ *
+ * Returns the charset detected for the text of the @part, as previously
+ * set by e_mail_part_set_real_charset(), or %NULL when not detected yet.
+ * It can differ from the charset declared in the part's Content-Type,
+ * like windows-1252 for text claimed to be iso-8859-1.
+ *
+ * Returns: (nullable): the detected charset, or %NULL
+ *
+ * Since: 3.32
+ **/
+const gchar *
+e_mail_part_get_real_charset (EMailPart *part)
+{
+	g_return_val_if_fail (E_IS_MAIL_PART (part), NULL);
+
+	return part->priv->real_charset;
+}
+
+/**
+ * e_mail_part_set_real_charset:
+ * @part: an #EMailPart
+ * @charset: (nullable): the detected charset, or %NULL
+ *
+ * Remembers the charset detected for the text of the @part, thus
+ * the detection can be skipped when the @part is formatted again.
+ *
+ * Since: 3.32
+ **/
+void
+e_mail_part_set_real_charset (EMailPart *part,
+                              const gchar *charset)
+{
+	g_return_if_fail (E_IS_MAIL_PART (part));
+
+	/* Interned, thus it can be read from other threads without a lock */
+	part->priv->real_charset = g_intern_string (charset);
+}
+
 gboolean
 e_mail_part_should_show_inline (EMailPart *part)
 {
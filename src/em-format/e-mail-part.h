@@ -115,6 +115,9 @@ gboolean	e_mail_part_get_converted_to_utf8
 void		e_mail_part_set_converted_to_utf8
 						(EMailPart *part,
 						 gboolean converted_to_utf8);
+const gchar *	e_mail_part_get_real_charset	(EMailPart *part);
+void		e_mail_part_set_real_charset	(EMailPart *part,
+						 const gchar *charset);
 gboolean	e_mail_part_should_show_inline	(EMailPart *part);
 struct _EMailPartList *
 		e_mail_part_ref_part_list	(EMailPart *part);
@@ -1558,6 +1558,116 @@ mail_folder_save_prepare_part (CamelMimePart *mime_part)
 	}
 }
 
+/* How many messages can be fetched at once and how many
+ * of them can wait to be written, when saving messages */
+#define SAVE_MESSAGES_MAX_THREADS 4
+#define SAVE_MESSAGES_READ_AHEAD 16
+
+typedef struct _SaveMessageSlot {
+	GBytes *bytes;
+	GError *error;
+	gboolean done;
+} SaveMessageSlot;
+
+typedef struct _SaveMessagesData {
+	CamelFolder *folder;
+	GPtrArray *message_uids;
+	GCancellable *cancellable;
+
+	GMutex lock;
+	GCond cond;
+	SaveMessageSlot *slots;
+} SaveMessagesData;
+
+/* Helper for e_mail_folder_save_messages_sync() */
+static GBytes *
+mail_folder_save_message_to_bytes (CamelFolder *folder,
+                                   const gchar *uid,
+                                   GCancellable *cancellable,
+                                   GError **error)
+{
+	CamelMimeMessage *message;
+	CamelMimeFilter *filter;
+	CamelStream *base_stream;
+	CamelStream *stream;
+	GByteArray *byte_array;
+	gchar *from_line;
+	gboolean success;
+
+	message = camel_folder_get_message_sync (
+		folder, uid, cancellable, error);
+	if (message == NULL)
+		return NULL;
+
+	mail_folder_save_prepare_part (CAMEL_MIME_PART (message));
+
+	/* CamelStreamMem does NOT take ownership of the byte
+	 * array when set with camel_stream_mem_set_byte_array(). */
+	byte_array = g_byte_array_new ();
+	base_stream = camel_stream_mem_new ();
+	camel_stream_mem_set_byte_array (
+		CAMEL_STREAM_MEM (base_stream), byte_array);
+
+	from_line = camel_mime_message_build_mbox_from (message);
+
+	filter = camel_mime_filter_from_new ();
+	stream = camel_stream_filter_new (base_stream);
+	camel_stream_filter_add (CAMEL_STREAM_FILTER (stream), filter);
+
+	/* Only the message content is From-escaped, not the From line */
+	success = camel_stream_write_string (
+		base_stream, from_line, cancellable, error) != -1 &&
+		camel_data_wrapper_write_to_stream_sync (
+		CAMEL_DATA_WRAPPER (message),
+		stream, cancellable, error) != -1 &&
+		camel_stream_flush (stream, cancellable, error) != -1;
+
+	g_object_unref (filter);
+	g_object_unref (stream);
+	g_object_unref (base_stream);
+	g_object_unref (message);
+	g_free (from_line);
+
+	if (!success) {
+		g_byte_array_free (byte_array, TRUE);
+		return NULL;
+	}
+
+	g_byte_array_append (byte_array, (guint8 *) "\n", 1);
+
+	return g_byte_array_free_to_bytes (byte_array);
+}
+
+/* Helper for e_mail_folder_save_messages_sync() */
+static void
+mail_folder_save_messages_fetch_thread (gpointer data,
+                                        gpointer user_data)
+{
+	SaveMessagesData *smd = user_data;
+	guint index = GPOINTER_TO_UINT (data) - 1;
+	GBytes *bytes;
+	GError *local_error = NULL;
+
+	bytes = mail_folder_save_message_to_bytes (
+		smd->folder, g_ptr_array_index (smd->message_uids, index),
+		smd->cancellable, &local_error);
+
+	g_mutex_lock (&smd->lock);
+	smd->slots[index].bytes = bytes;
+	smd->slots[index].error = local_error;
+	smd->slots[index].done = TRUE;
+	g_cond_broadcast (&smd->cond);
+	g_mutex_unlock (&smd->lock);
+}
+
+/* Helper for e_mail_folder_save_messages_sync() */
+static void
+mail_folder_save_messages_cancelled_cb (GCancellable *cancellable,
+                                        GCancellable *fetch_cancellable)
+{
+	g_cancellable_cancel (fetch_cancellable);
+}
+
 gboolean
 e_mail_folder_save_messages_sync (CamelFolder *folder,
                                   GPtrArray *message_uids,
@@ -1566,8 +1676,10 @@ e_mail_folder_save_messages_sync (CamelFolder *folder,
                                   GError **error)
 {
 	GFileOutputStream *file_output_stream;
-	CamelStream *base_stream = NULL;
-	GByteArray *byte_array;
+	GOutputStream *output_stream;
+	GThreadPool *thread_pool;
+	SaveMessagesData smd;
+	gulong cancelled_id = 0;
 	gboolean success = TRUE;
 	guint ii;
 
@@ -1596,97 +1708,92 @@ e_mail_folder_save_messages_sync (CamelFolder *folder,
 		return FALSE;
 	}
 
-	byte_array = g_byte_array_new ();
+	/* Coalesce writes of small messages */
+	output_stream = g_buffered_output_stream_new_sized (
+		G_OUTPUT_STREAM (file_output_stream), 256 * 1024);
+
+	/* The messages are fetched by several threads ahead of the one
+	 * which writes them in order. The fetchers have their own
+	 * cancellable, thus they can be stopped on a write error and
+	 * they do not fight over the operation's status message. */
+	smd.folder = folder;
+	smd.message_uids = message_uids;
+	smd.cancellable = g_cancellable_new ();
+	smd.slots = g_new0 (SaveMessageSlot, message_uids->len);
+	g_mutex_init (&smd.lock);
+	g_cond_init (&smd.cond);
+
+	if (cancellable)
+		cancelled_id = g_cancellable_connect (cancellable,
+			G_CALLBACK (mail_folder_save_messages_cancelled_cb),
+			smd.cancellable, NULL);
+
+	thread_pool = g_thread_pool_new (
+		mail_folder_save_messages_fetch_thread, &smd,
+		SAVE_MESSAGES_MAX_THREADS, FALSE, NULL);
+
+	/* The index is shifted by one, to not push NULL */
+	for (ii = 0; ii < message_uids->len && ii < SAVE_MESSAGES_READ_AHEAD; ii++) {
+		g_thread_pool_push (thread_pool, GUINT_TO_POINTER (ii + 1), NULL);
+	}
 
-	for (ii = 0; ii < message_uids->len; ii++) {
-		CamelMimeMessage *message;
-		CamelMimeFilter *filter;
-		CamelStream *stream;
-		const gchar *uid;
-		gchar *from_line;
+	for (ii = 0; ii < message_uids->len && success; ii++) {
+		SaveMessageSlot *slot = &smd.slots[ii];
 		gint percent;
-		gint retval;
 
-		if (base_stream != NULL)
-			g_object_unref (base_stream);
+		g_mutex_lock (&smd.lock);
+		while (!slot->done)
+			g_cond_wait (&smd.cond, &smd.lock);
+		g_mutex_unlock (&smd.lock);
 
-		/* CamelStreamMem does NOT take ownership of the byte
-		 * array when set with camel_stream_mem_set_byte_array().
-		 * This allows us to reuse the same memory slab for each
-		 * message, which is slightly more efficient. */
-		base_stream = camel_stream_mem_new ();
-		camel_stream_mem_set_byte_array (
-			CAMEL_STREAM_MEM (base_stream), byte_array);
+		if (ii + SAVE_MESSAGES_READ_AHEAD < message_uids->len)
+			g_thread_pool_push (thread_pool, GUINT_TO_POINTER (ii + SAVE_MESSAGES_READ_AHEAD + 1), NULL);
 
-		uid = g_ptr_array_index (message_uids, ii);
+		if (!slot->bytes) {
+			/* Report the user's cancellation, not the fetcher's */
+			if (!g_cancellable_set_error_if_cancelled (cancellable, error)) {
+				g_propagate_error (error, slot->error);
+				slot->error = NULL;
+			}
 
-		message = camel_folder_get_message_sync (
-			folder, uid, cancellable, error);
-		if (message == NULL) {
 			success = FALSE;
-			goto exit;
-		}
-
-		mail_folder_save_prepare_part (CAMEL_MIME_PART (message));
-
-		from_line = camel_mime_message_build_mbox_from (message);
-		g_return_val_if_fail (from_line != NULL, FALSE);
-
-		success = g_output_stream_write_all (
-			G_OUTPUT_STREAM (file_output_stream),
-			from_line, strlen (from_line), NULL,
-			cancellable, error);
-
-		g_free (from_line);
-
-		if (!success) {
-			g_object_unref (message);
-			goto exit;
-		}
-
-		filter = camel_mime_filter_from_new ();
-		stream = camel_stream_filter_new (base_stream);
-		camel_stream_filter_add (CAMEL_STREAM_FILTER (stream), filter);
-
-		retval = camel_data_wrapper_write_to_stream_sync (
-			CAMEL_DATA_WRAPPER (message),
-			stream, cancellable, error);
-
-		g_object_unref (filter);
-		g_object_unref (stream);
-
-		if (retval == -1) {
-			g_object_unref (message);
-			goto exit;
+			break;
 		}
 
-		g_byte_array_append (byte_array, (guint8 *) "\n", 1);
-
 		success = g_output_stream_write_all (
-			G_OUTPUT_STREAM (file_output_stream),
-			byte_array->data, byte_array->len,
+			output_stream,
+			g_bytes_get_data (slot->bytes, NULL),
+			g_bytes_get_size (slot->bytes),
 			NULL, cancellable, error);
 
-		if (!success) {
-			g_object_unref (message);
-			goto exit;
-		}
+		g_clear_pointer (&slot->bytes, g_bytes_unref);
 
 		percent = ((ii + 1) * 100) / message_uids->len;
 		camel_operation_progress (cancellable, percent);
+	}
 
-		/* Reset the byte array for the next message. */
-		g_byte_array_set_size (byte_array, 0);
+	if (success)
+		success = g_output_stream_close (output_stream, cancellable, error);
 
-		g_object_unref (message);
-	}
+	/* Stop the fetchers still running and drop the waiting ones */
+	g_cancellable_cancel (smd.cancellable);
+	g_thread_pool_free (thread_pool, TRUE, TRUE);
 
-exit:
-	if (base_stream != NULL)
-		g_object_unref (base_stream);
+	if (cancelled_id)
+		g_cancellable_disconnect (cancellable, cancelled_id);
 
-	g_byte_array_free (byte_array, TRUE);
+	for (ii = 0; ii < message_uids->len; ii++) {
+		if (smd.slots[ii].bytes)
+			g_bytes_unref (smd.slots[ii].bytes);
+		g_clear_error (&smd.slots[ii].error);
+	}
+
+	g_free (smd.slots);
+	g_mutex_clear (&smd.lock);
+	g_cond_clear (&smd.cond);
+	g_object_unref (smd.cancellable);
 
+	g_object_unref (output_stream);
 	g_object_unref (file_output_stream);
 
 	camel_operation_pop_message (cancellable);
@@ -1756,6 +1863,80 @@ e_mail_folder_save_messages_finish (CamelFolder *folder,
 	return !g_simple_async_result_propagate_error (simple, error);
 }
 
+/**
+ * e_mail_folder_set_messages_flags:
+ * @folder: a #CamelFolder
+ * @message_uids: (element-type utf8): UIDs of the messages to change
+ * @mask: flags to change
+ * @set: values of the flags in @mask
+ * @cancellable: optional #GCancellable object, or %NULL
+ *
+ * Sets the @mask flags of all the @message_uids to @set, like
+ * camel_folder_set_message_flags() does for one message. The folder
+ * is frozen and its summary locked only once for the whole set, thus
+ * all the changes are notified at once and the messages, which have
+ * the flags already set, are not notified at all.
+ *
+ * When the @cancellable is cancelled, the remaining messages are left
+ * unchanged; the messages changed before stay changed.
+ *
+ * Returns: how many messages had been changed
+ *
+ * Since: 3.32
+ **/
+guint
+e_mail_folder_set_messages_flags (CamelFolder *folder,
+                                  GPtrArray *message_uids,
+                                  guint32 mask,
+                                  guint32 set,
+                                  GCancellable *cancellable)
+{
+	CamelFolderSummary *summary;
+	guint ii, n_changed = 0;
+
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), 0);
+	g_return_val_if_fail (message_uids != NULL, 0);
+
+	if (!message_uids->len)
+		return 0;
+
+	/* Changes in a search folder are forwarded to the original folders
+	 * and their summaries, thus do not hold its own summary lock. */
+	if (CAMEL_IS_VEE_FOLDER (folder))
+		summary = NULL;
+	else
+		summary = camel_folder_get_folder_summary (folder);
+
+	camel_folder_freeze (folder);
+
+	if (summary)
+		camel_folder_summary_lock (summary);
+
+	for (ii = 0; ii < message_uids->len; ii++) {
+		CamelMessageInfo *info;
+
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+
+		info = camel_folder_get_message_info (folder, message_uids->pdata[ii]);
+		if (!info)
+			continue;
+
+		if ((camel_message_info_get_flags (info) & mask) != (set & mask) &&
+		    camel_message_info_set_flags (info, mask, set))
+			n_changed++;
+
+		g_object_unref (info);
+	}
+
+	if (summary)
+		camel_folder_summary_unlock (summary);
+
+	camel_folder_thaw (folder);
+
+	return n_changed;
+}
+
 /**
  * e_mail_folder_uri_build:
  * @store: a #CamelStore
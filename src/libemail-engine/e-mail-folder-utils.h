@@ -158,6 +158,12 @@ gboolean	e_mail_folder_save_messages_finish
 						(CamelFolder *folder,
 						 GAsyncResult *result,
 						 GError **error);
+guint		e_mail_folder_set_messages_flags
+						(CamelFolder *folder,
+						 GPtrArray *message_uids,
+						 guint32 mask,
+						 guint32 set,
+						 GCancellable *cancellable);
 
 gchar *		e_mail_folder_uri_build		(CamelStore *store,
 						 const gchar *folder_name);
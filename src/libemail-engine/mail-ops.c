@@ -1214,14 +1214,10 @@ transfer_messages_exec (struct _transfer_msg *m,
 
 	/* make sure all deleted messages are marked as seen */
 
-	if (m->delete) {
-		gint i;
-
-		for (i = 0; i < m->uids->len; i++)
-			camel_folder_set_message_flags (
-				m->source, m->uids->pdata[i],
-				CAMEL_MESSAGE_SEEN, CAMEL_MESSAGE_SEEN);
-	}
+	if (m->delete)
+		e_mail_folder_set_messages_flags (
+			m->source, m->uids,
+			CAMEL_MESSAGE_SEEN, CAMEL_MESSAGE_SEEN, NULL);
 
 	camel_folder_thaw (m->source);
 	camel_folder_thaw (dest);
@@ -1335,19 +1331,12 @@ sync_folder_exec (struct _sync_folder_msg *m,
 				GPtrArray *uids;
 				guint32 flags;
 				guint32 mask;
-				guint ii;
 
 				uids = camel_folder_get_uids (folder);
 				flags = mask = CAMEL_MESSAGE_DELETED | CAMEL_MESSAGE_SEEN;
 
-				camel_folder_freeze (folder);
-
-				for (ii = 0; ii < uids->len && !g_cancellable_is_cancelled (cancellable); ii++) {
-					const gchar *uid = uids->pdata[ii];
-					camel_folder_set_message_flags (folder, uid, flags, mask);
-				}
+				e_mail_folder_set_messages_flags (folder, uids, mask, flags, cancellable);
 
-				camel_folder_thaw (folder);
 				camel_folder_free_uids (folder, uids);
 
 				g_object_unref (folder);
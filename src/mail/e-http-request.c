@@ -38,10 +38,26 @@
 
 #define d(x)
 
+/* How long a cached resource is used without asking the server */
+#define HTTP_CACHE_FRESH_SECONDS (60 * 60)
+
+#define HTTP_MAX_CONNS_PER_HOST 6
+#define HTTP_MAX_CONNS 24
+
 struct _EHTTPRequestPrivate {
 	gint dummy;
 };
 
+/* The requests run in dedicated threads, but they all share one session,
+ * thus the connections are kept alive and reused, and one data cache.
+ * Identical URIs requested at the same time are downloaded only once,
+ * the other requests wait for it and then read the cache. */
+static GMutex http_lock;
+static GCond http_cond;
+static SoupSession *http_session = NULL;
+static CamelDataCache *http_cache = NULL;
+static GHashTable *http_in_flight = NULL; /* gchar *uri_md5 */
+
 static void e_http_request_content_request_init (EContentRequestInterface *iface);
 
 G_DEFINE_TYPE_WITH_CODE (EHTTPRequest, e_http_request, G_TYPE_OBJECT,
@@ -147,8 +163,6 @@ send_and_handle_redirection (SoupSession *session,
 	soup_message_add_header_handler (
 		message, "got_body", "Location",
 		G_CALLBACK (redirect_handler), session);
-	soup_message_headers_append (
-		message->request_headers, "Connection", "close");
 	soup_session_send_message (session, message);
 
 	if (new_location != NULL) {
@@ -166,11 +180,266 @@ send_and_handle_redirection (SoupSession *session,
 	g_free (old_uri);
 }
 
+static SoupSession *
+http_request_ref_session (EShell *shell)
+{
+	SoupSession *session;
+
+	g_mutex_lock (&http_lock);
+
+	if (!http_session) {
+		ESource *proxy_source;
+
+		proxy_source = e_source_registry_ref_builtin_proxy (e_shell_get_registry (shell));
+
+		/* A plain SoupSession can be used synchronously from any thread */
+		http_session = soup_session_new_with_options (
+			SOUP_SESSION_TIMEOUT, 90,
+			SOUP_SESSION_MAX_CONNS_PER_HOST, HTTP_MAX_CONNS_PER_HOST,
+			SOUP_SESSION_MAX_CONNS, HTTP_MAX_CONNS,
+			SOUP_SESSION_PROXY_RESOLVER, G_PROXY_RESOLVER (proxy_source),
+			SOUP_SESSION_USER_AGENT, "Evolution/" VERSION,
+			NULL);
+
+		g_object_unref (proxy_source);
+	}
+
+	session = g_object_ref (http_session);
+
+	g_mutex_unlock (&http_lock);
+
+	return session;
+}
+
+static CamelDataCache *
+http_request_ref_cache (void)
+{
+	CamelDataCache *cache = NULL;
+
+	g_mutex_lock (&http_lock);
+
+	if (!http_cache) {
+		http_cache = camel_data_cache_new (e_get_user_cache_dir (), NULL);
+		if (http_cache) {
+			camel_data_cache_set_expire_age (http_cache, 24 * 60 * 60);
+			camel_data_cache_set_expire_access (http_cache, 2 * 60 * 60);
+		}
+	}
+
+	if (http_cache)
+		cache = g_object_ref (http_cache);
+
+	g_mutex_unlock (&http_lock);
+
+	return cache;
+}
+
+/* Waits until no other thread downloads @uri_md5, then marks it as being
+ * downloaded by the caller.  Sets @out_waited when it had to wait, in which
+ * case the resource is probably in the cache already.  Returns FALSE when
+ * cancelled while waiting. */
+static gboolean
+http_request_begin_fetch (const gchar *uri_md5,
+                          GCancellable *cancellable,
+                          gboolean *out_waited)
+{
+	gboolean claimed = FALSE;
+
+	*out_waited = FALSE;
+
+	g_mutex_lock (&http_lock);
+
+	if (!http_in_flight)
+		http_in_flight = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	while (g_hash_table_contains (http_in_flight, uri_md5) &&
+	       !g_cancellable_is_cancelled (cancellable)) {
+		*out_waited = TRUE;
+
+		/* Wake up from time to time to notice the cancellation */
+		g_cond_wait_until (&http_cond, &http_lock, g_get_monotonic_time () + G_TIME_SPAN_SECOND / 10);
+	}
+
+	if (!g_hash_table_contains (http_in_flight, uri_md5)) {
+		g_hash_table_add (http_in_flight, g_strdup (uri_md5));
+		claimed = TRUE;
+	}
+
+	g_mutex_unlock (&http_lock);
+
+	return claimed;
+}
+
+static void
+http_request_end_fetch (const gchar *uri_md5)
+{
+	g_mutex_lock (&http_lock);
+
+	g_hash_table_remove (http_in_flight, uri_md5);
+	g_cond_broadcast (&http_cond);
+
+	g_mutex_unlock (&http_lock);
+}
+
+/* Reads the cached resource; @out_is_fresh is set to whether it can be used
+ * without revalidating it with the server */
+static gboolean
+http_request_read_cache (CamelDataCache *cache,
+                         const gchar *uri_md5,
+                         GInputStream **out_stream,
+                         gint64 *out_stream_length,
+                         gchar **out_mime_type,
+                         gboolean *out_is_fresh,
+                         GCancellable *cancellable)
+{
+	GIOStream *cache_stream;
+	GInputStream *stream;
+	GFile *file;
+	GFileInfo *info;
+	gchar *path;
+	gssize len;
+
+	cache_stream = camel_data_cache_get (cache, "http", uri_md5, NULL);
+	if (!cache_stream)
+		return FALSE;
+
+	stream = g_memory_input_stream_new ();
+
+	len = copy_stream_to_stream (cache_stream, G_MEMORY_INPUT_STREAM (stream), cancellable);
+
+	g_object_unref (cache_stream);
+
+	/* When succesfully read some data from cache then get mimetype
+	 * and return the stream to WebKit.  Otherwise try to fetch
+	 * the resource again from the network. */
+	if (len <= 0) {
+		g_object_unref (stream);
+		return FALSE;
+	}
+
+	*out_is_fresh = FALSE;
+
+	path = camel_data_cache_get_filename (cache, "http", uri_md5);
+	file = g_file_new_for_path (path);
+	info = g_file_query_info (
+		file,
+		G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
+		G_FILE_ATTRIBUTE_TIME_MODIFIED,
+		0, cancellable, NULL);
+
+	if (info) {
+		guint64 modified;
+
+		g_free (*out_mime_type);
+		*out_mime_type = g_strdup (g_file_info_get_content_type (info));
+
+		modified = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+		*out_is_fresh = modified + HTTP_CACHE_FRESH_SECONDS > (guint64) (g_get_real_time () / G_USEC_PER_SEC);
+	}
+
+	g_clear_object (&info);
+	g_clear_object (&file);
+	g_free (path);
+
+	g_clear_object (out_stream);
+	*out_stream = stream;
+	*out_stream_length = len;
+
+	return TRUE;
+}
+
+/* The cached resource is still valid, restart its freshness period */
+static void
+http_request_touch_cache (CamelDataCache *cache,
+                          const gchar *uri_md5)
+{
+	GFile *file;
+	gchar *path;
+
+	path = camel_data_cache_get_filename (cache, "http", uri_md5);
+	file = g_file_new_for_path (path);
+
+	g_file_set_attribute_uint64 (
+		file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+		g_get_real_time () / G_USEC_PER_SEC,
+		G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+	g_object_unref (file);
+	g_free (path);
+}
+
+/* The ETag and Last-Modified values of a cached resource are stored
+ * next to it, one per line, to revalidate it with the server */
+static void
+http_request_load_validators (CamelDataCache *cache,
+                              const gchar *uri_md5,
+                              gchar **out_etag,
+                              gchar **out_last_modified)
+{
+	gchar *path, *contents = NULL;
+
+	path = camel_data_cache_get_filename (cache, "http-validators", uri_md5);
+
+	if (g_file_get_contents (path, &contents, NULL, NULL)) {
+		gchar **lines;
+
+		lines = g_strsplit (contents, "\n", 3);
+
+		if (lines[0] && *lines[0])
+			*out_etag = g_strdup (lines[0]);
+		if (lines[0] && lines[1] && *lines[1])
+			*out_last_modified = g_strdup (lines[1]);
+
+		g_strfreev (lines);
+		g_free (contents);
+	}
+
+	g_free (path);
+}
+
+static void
+http_request_save_validators (CamelDataCache *cache,
+                              const gchar *uri_md5,
+                              SoupMessage *message)
+{
+	const gchar *etag, *last_modified;
+	GIOStream *cache_stream;
+	gchar *contents;
+
+	etag = soup_message_headers_get_one (message->response_headers, "ETag");
+	last_modified = soup_message_headers_get_one (message->response_headers, "Last-Modified");
+
+	if (!etag && !last_modified) {
+		camel_data_cache_remove (cache, "http-validators", uri_md5, NULL);
+		return;
+	}
+
+	cache_stream = camel_data_cache_add (cache, "http-validators", uri_md5, NULL);
+	if (!cache_stream)
+		return;
+
+	contents = g_strdup_printf ("%s\n%s\n", etag ? etag : "", last_modified ? last_modified : "");
+
+	g_output_stream_write_all (
+		g_io_stream_get_output_stream (cache_stream),
+		contents, strlen (contents), NULL, NULL, NULL);
+
+	g_io_stream_close (cache_stream, NULL, NULL);
+	g_object_unref (cache_stream);
+	g_free (contents);
+}
+
+typedef struct _CancelData {
+	SoupSession *session;
+	SoupMessage *message;
+} CancelData;
+
 static void
 http_request_cancelled_cb (GCancellable *cancellable,
-			   SoupSession *session)
+			   CancelData *cd)
 {
-	soup_session_abort (session);
+	/* Only this message, the session is shared with other requests */
+	soup_session_cancel_message (cd->session, cd->message, SOUP_STATUS_CANCELLED);
 }
 
 static gboolean
@@ -186,15 +455,18 @@ e_http_request_process_sync (EContentRequest *request,
 	SoupURI *soup_uri;
 	gchar *evo_uri = NULL, *use_uri;
 	gchar *mail_uri = NULL;
-	GInputStream *stream;
 	gboolean force_load_images = FALSE;
 	EImageLoadingPolicy image_policy;
 	gchar *uri_md5;
 	EShell *shell;
 	GSettings *settings;
-	const gchar *user_cache_dir, *soup_query;
+	const gchar *soup_query;
 	CamelDataCache *cache;
-	GIOStream *cache_stream;
+	GInputStream *cached_stream = NULL;
+	gint64 cached_length = -1;
+	gchar *cached_mime_type = NULL;
+	gboolean is_cached = FALSE, is_fresh = FALSE;
+	gboolean fetch_claimed = FALSE;
 	gint uri_len;
 	gboolean success = FALSE;
 
@@ -274,70 +546,52 @@ e_http_request_process_sync (EContentRequest *request,
 	uri_md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, use_uri, -1);
 
 	/* Open Evolution's cache */
-	user_cache_dir = e_get_user_cache_dir ();
-	cache = camel_data_cache_new (user_cache_dir, NULL);
+	cache = http_request_ref_cache ();
 	if (cache) {
-		camel_data_cache_set_expire_age (cache, 24 * 60 * 60);
-		camel_data_cache_set_expire_access (cache, 2 * 60 * 60);
-
-		cache_stream = camel_data_cache_get (cache, "http", uri_md5, NULL);
-	} else
-		cache_stream = NULL;
-
-	if (cache_stream != NULL) {
-		gssize len;
-
-		stream = g_memory_input_stream_new ();
+		is_cached = http_request_read_cache (
+			cache, uri_md5, &cached_stream, &cached_length,
+			&cached_mime_type, &is_fresh, cancellable);
 
-		len = copy_stream_to_stream (cache_stream, G_MEMORY_INPUT_STREAM (stream), cancellable);
-		*out_stream_length = len;
+		/* Another request can be downloading the same resource
+		 * right now; wait for it and look into the cache again. */
+		if (!is_fresh) {
+			gboolean waited = FALSE;
 
-		g_object_unref (cache_stream);
+			fetch_claimed = http_request_begin_fetch (uri_md5, cancellable, &waited);
 
-		/* When succesfully read some data from cache then
-		 * get mimetype and return the stream to WebKit.
-		 * Otherwise try to fetch the resource again from the network. */
-		if (len != -1 && *out_stream_length > 0) {
-			GFile *file;
-			GFileInfo *info;
-			gchar *path;
-
-			path = camel_data_cache_get_filename (
-				cache, "http", uri_md5);
-			file = g_file_new_for_path (path);
-			info = g_file_query_info (
-				file, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
-				0, cancellable, NULL);
-
-			if (info) {
-				*out_mime_type = g_strdup (g_file_info_get_content_type (info));
+			if (!fetch_claimed) {
+				g_cancellable_set_error_if_cancelled (cancellable, error);
+				goto cleanup;
+			}
 
-				d (
-					printf ("'%s' found in cache (%d bytes, %s)\n",
-					use_uri, (gint) *out_stream_length,
-					*out_mime_type));
+			if (waited) {
+				is_cached = http_request_read_cache (
+					cache, uri_md5, &cached_stream, &cached_length,
+					&cached_mime_type, &is_fresh, cancellable) || is_cached;
 			}
+		}
+	}
 
-			g_clear_object (&info);
-			g_clear_object (&file);
-			g_free (path);
+	if (is_fresh) {
+		d (
+			printf ("'%s' found in cache (%d bytes, %s)\n",
+			use_uri, (gint) cached_length,
+			cached_mime_type));
 
-			/* Set result and quit the thread */
-			*out_stream = stream;
-			success = TRUE;
+		goto use_cached;
+	}
 
-			goto cleanup;
-		} else {
-			d (printf ("Failed to load '%s' from cache.\n", use_uri));
-			g_object_unref (stream);
-		}
+	if (is_cached) {
+		d (printf ("'%s' found in cache, but needs to be revalidated\n", use_uri));
+	} else {
+		d (printf ("Failed to load '%s' from cache.\n", use_uri));
 	}
 
 	/* If the item is not cached and Evolution is offline
 	 * then quit regardless of any image loading policy. */
 	shell = e_shell_get_default ();
 	if (!e_shell_get_online (shell))
-		goto cleanup;
+		goto use_cached;
 
 	settings = e_util_ref_settings ("org.gnome.evolution.mail");
 	image_policy = g_settings_get_enum (settings, "image-loading-policy");
@@ -391,11 +645,10 @@ e_http_request_process_sync (EContentRequest *request,
 
 	if ((image_policy == E_IMAGE_LOADING_POLICY_ALWAYS) ||
 	    force_load_images) {
-		ESource *proxy_source;
-		SoupSession *temp_session;
+		SoupSession *session;
 		SoupMessage *message;
 		GIOStream *cache_stream;
-		GMainContext *context;
+		CancelData cd;
 		gulong cancelled_id = 0;
 
 		if (g_cancellable_set_error_if_cancelled (cancellable, error))
@@ -407,40 +660,55 @@ e_http_request_process_sync (EContentRequest *request,
 			goto cleanup;
 		}
 
-		context = g_main_context_new ();
-		g_main_context_push_thread_default (context);
+		session = http_request_ref_session (shell);
 
-		temp_session = soup_session_new_with_options (
-			SOUP_SESSION_TIMEOUT, 90, NULL);
+		if (is_cached && cache) {
+			gchar *etag = NULL, *last_modified = NULL;
 
-		proxy_source = e_source_registry_ref_builtin_proxy (e_shell_get_registry (shell));
+			http_request_load_validators (cache, uri_md5, &etag, &last_modified);
 
-		g_object_set (
-			temp_session,
-			SOUP_SESSION_PROXY_RESOLVER,
-			G_PROXY_RESOLVER (proxy_source),
-			NULL);
+			if (etag)
+				soup_message_headers_append (message->request_headers, "If-None-Match", etag);
+			if (last_modified)
+				soup_message_headers_append (message->request_headers, "If-Modified-Since", last_modified);
 
-		g_object_unref (proxy_source);
+			g_free (etag);
+			g_free (last_modified);
+		}
 
-		soup_message_headers_append (
-			message->request_headers,
-			"User-Agent", "Evolution/" VERSION);
+		cd.session = session;
+		cd.message = message;
 
 		if (cancellable)
-			cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (http_request_cancelled_cb), temp_session, NULL);
+			cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (http_request_cancelled_cb), &cd, NULL);
 
-		send_and_handle_redirection (temp_session, message, NULL);
+		send_and_handle_redirection (session, message, NULL);
 
 		if (cancellable && cancelled_id)
 			g_cancellable_disconnect (cancellable, cancelled_id);
 
+		if (message->status_code == SOUP_STATUS_NOT_MODIFIED && is_cached) {
+			d (printf ("'%s' not modified on the server\n", use_uri));
+
+			http_request_touch_cache (cache, uri_md5);
+
+			g_object_unref (message);
+			g_object_unref (session);
+			goto use_cached;
+		}
+
 		if (!SOUP_STATUS_IS_SUCCESSFUL (message->status_code)) {
-			g_debug ("Failed to request %s (code %d)", use_uri, message->status_code);
+			guint status_code = message->status_code;
+
+			g_debug ("Failed to request %s (code %d)", use_uri, status_code);
 			g_object_unref (message);
-			g_object_unref (temp_session);
-			g_main_context_unref (context);
-			goto cleanup;
+			g_object_unref (session);
+
+			if (status_code == SOUP_STATUS_CANCELLED)
+				goto cleanup;
+
+			/* Better the cached version than nothing */
+			goto use_cached;
 		}
 
 		if (cache) {
@@ -475,21 +743,21 @@ e_http_request_process_sync (EContentRequest *request,
 							local_error->message);
 					g_clear_error (&local_error);
 					g_object_unref (message);
-					g_object_unref (temp_session);
-					g_main_context_unref (context);
+					g_object_unref (session);
 					goto cleanup;
 				}
 
 				if (success) {
+					http_request_save_validators (cache, uri_md5, message);
+
 					/* Send the response body to WebKit */
-					stream = g_memory_input_stream_new_from_data (
+					*out_stream = g_memory_input_stream_new_from_data (
 						g_memdup (
 							message->response_body->data,
 							message->response_body->length),
 						message->response_body->length,
 						(GDestroyNotify) g_free);
 
-					*out_stream = stream;
 					*out_stream_length = message->response_body->length;
 					*out_mime_type = g_strdup (
 						soup_message_headers_get_content_type (
@@ -498,21 +766,35 @@ e_http_request_process_sync (EContentRequest *request,
 			}
 		}
 
-		g_object_unref (message);
-		g_object_unref (temp_session);
-		g_main_context_unref (context);
-
 		d (printf ("Received image from %s\n"
 			"Content-Type: %s\n"
 			"Content-Length: %d bytes\n"
 			"URI MD5: %s:\n",
 			use_uri, *out_mime_type ? *out_mime_type : "[null]",
 			(gint) *out_stream_length, uri_md5));
+
+		g_object_unref (message);
+		g_object_unref (session);
+
+		goto cleanup;
+	}
+
+ use_cached:
+	if (is_cached) {
+		*out_stream = g_steal_pointer (&cached_stream);
+		*out_stream_length = cached_length;
+		*out_mime_type = g_steal_pointer (&cached_mime_type);
+		success = TRUE;
 	}
 
  cleanup:
+	if (fetch_claimed)
+		http_request_end_fetch (uri_md5);
+
+	g_clear_object (&cached_stream);
 	g_clear_object (&cache);
 
+	g_free (cached_mime_type);
 	g_free (use_uri);
 	g_free (uri_md5);
 	g_free (mail_uri);
@@ -1021,7 +1021,7 @@ e_mail_reader_mark_selected (EMailReader *reader,
                              guint32 set)
 {
 	CamelFolder *folder;
-	guint ii = 0;
+	guint n_marked = 0;
 
 	g_return_val_if_fail (E_IS_MAIL_READER (reader), 0);
 
@@ -1034,9 +1034,8 @@ e_mail_reader_mark_selected (EMailReader *reader,
 
 		uids = e_mail_reader_get_selected_uids_with_collapsed_threads (reader);
 
-		for (ii = 0; ii < uids->len; ii++)
-			camel_folder_set_message_flags (
-				folder, uids->pdata[ii], mask, set);
+		e_mail_folder_set_messages_flags (folder, uids, mask, set, NULL);
+		n_marked = uids->len;
 
 		/* This function is called on user interaction, thus make sure the message list
 		   will scroll to the selected message, which can eventually change due to
@@ -1055,7 +1054,7 @@ e_mail_reader_mark_selected (EMailReader *reader,
 		g_object_unref (folder);
 	}
 
-	return ii;
+	return n_marked;
 }
 
 static guint
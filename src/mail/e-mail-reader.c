@@ -107,6 +107,12 @@ struct _EMailReaderPrivate {
 
 	guint main_menu_label_merge_id;
 	guint popup_menu_label_merge_id;
+
+	/* Parsed messages around the shown one, to be able to move
+	 * to them quickly; the most recently used first. */
+	GQueue read_ahead_lru; /* EMailPartList * */
+	guint read_ahead_lru_size;
+	GCancellable *read_ahead_cancellable;
 };
 
 enum {
@@ -161,6 +167,14 @@ mail_reader_private_free (EMailReaderPrivate *priv)
 		priv->retrieving_message = NULL;
 	}
 
+	if (priv->read_ahead_cancellable != NULL) {
+		g_cancellable_cancel (priv->read_ahead_cancellable);
+		g_clear_object (&priv->read_ahead_cancellable);
+	}
+
+	g_queue_foreach (&priv->read_ahead_lru, (GFunc) g_object_unref, NULL);
+	g_queue_clear (&priv->read_ahead_lru);
+
 	g_slice_free (EMailReaderPrivate, priv);
 }
 
@@ -3909,6 +3923,212 @@ mail_reader_folder_loaded (EMailReader *reader)
 	e_mail_reader_update_actions (reader, state);
 }
 
+typedef struct _ReadAheadData {
+	CamelFolder *folder;
+	EMailSession *session;
+	GPtrArray *uids; /* gchar *, camel_pstring */
+	GPtrArray *part_lists; /* EMailPartList * */
+} ReadAheadData;
+
+static void
+read_ahead_data_free (gpointer ptr)
+{
+	ReadAheadData *rad = ptr;
+
+	if (rad) {
+		g_clear_object (&rad->folder);
+		g_clear_object (&rad->session);
+		g_ptr_array_unref (rad->uids);
+		g_ptr_array_unref (rad->part_lists);
+		g_slice_free (ReadAheadData, rad);
+	}
+}
+
+/* Moves the @part_list to the front of the read-ahead LRU,
+ * dropping the least recently used ones above the limit */
+static void
+mail_reader_read_ahead_remember (EMailReader *reader,
+                                 EMailPartList *part_list)
+{
+	EMailReaderPrivate *priv;
+	GList *link;
+
+	priv = E_MAIL_READER_GET_PRIVATE (reader);
+
+	if (!part_list || !priv->read_ahead_lru_size)
+		return;
+
+	link = g_queue_find (&priv->read_ahead_lru, part_list);
+	if (link) {
+		g_queue_unlink (&priv->read_ahead_lru, link);
+		g_queue_push_head_link (&priv->read_ahead_lru, link);
+	} else {
+		g_queue_push_head (&priv->read_ahead_lru, g_object_ref (part_list));
+	}
+
+	while (g_queue_get_length (&priv->read_ahead_lru) > priv->read_ahead_lru_size)
+		g_object_unref (g_queue_pop_tail (&priv->read_ahead_lru));
+}
+
+static void
+mail_reader_read_ahead_thread (GTask *task,
+                               gpointer source_object,
+                               gpointer task_data,
+                               GCancellable *cancellable)
+{
+	ReadAheadData *rad = task_data;
+	CamelObjectBag *registry;
+	EMailParser *parser = NULL;
+	guint ii;
+
+	registry = e_mail_part_list_get_registry ();
+
+	for (ii = 0; ii < rad->uids->len && !g_cancellable_is_cancelled (cancellable); ii++) {
+		const gchar *uid = g_ptr_array_index (rad->uids, ii);
+		EMailPartList *part_list;
+		gchar *mail_uri;
+
+		mail_uri = e_mail_part_build_uri (rad->folder, uid, NULL, NULL);
+
+		/* The same as mail_reader_parse_message_run(), thus the message
+		 * selected by the user in the meantime is parsed only once */
+		part_list = camel_object_bag_reserve (registry, mail_uri);
+
+		if (!part_list) {
+			CamelMimeMessage *message;
+
+			message = camel_folder_get_message_sync (rad->folder, uid, cancellable, NULL);
+			if (message) {
+				if (!parser)
+					parser = e_mail_parser_new (CAMEL_SESSION (rad->session));
+
+				part_list = e_mail_parser_parse_sync (parser, rad->folder, uid, message, cancellable);
+
+				g_object_unref (message);
+			}
+
+			if (part_list)
+				camel_object_bag_add (registry, mail_uri, part_list);
+			else
+				camel_object_bag_abort (registry, mail_uri);
+		}
+
+		/* The reference keeps it in the registry until it's in the LRU */
+		if (part_list)
+			g_ptr_array_add (rad->part_lists, part_list);
+
+		g_free (mail_uri);
+	}
+
+	g_clear_object (&parser);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+mail_reader_read_ahead_done_cb (GObject *source_object,
+                                GAsyncResult *result,
+                                gpointer user_data)
+{
+	EMailReader *reader = E_MAIL_READER (source_object);
+	ReadAheadData *rad;
+	guint ii;
+
+	rad = g_task_get_task_data (G_TASK (result));
+
+	/* Also when cancelled, what's done is worth keeping; the nearest
+	 * messages come first, thus they end as the most recently used */
+	for (ii = rad->part_lists->len; ii > 0; ii--)
+		mail_reader_read_ahead_remember (reader, g_ptr_array_index (rad->part_lists, ii - 1));
+}
+
+static void
+mail_reader_schedule_read_ahead (EMailReader *reader,
+                                 CamelFolder *folder,
+                                 const gchar *message_uid)
+{
+	EMailReaderPrivate *priv;
+	EMailBackend *backend;
+	EMailDisplay *display;
+	CamelObjectBag *registry;
+	ReadAheadData *rad;
+	GSettings *settings;
+	GtkWidget *message_list;
+	GPtrArray *uids;
+	GTask *task;
+	gint count;
+	guint ii;
+
+	priv = E_MAIL_READER_GET_PRIVATE (reader);
+
+	if (priv->read_ahead_cancellable) {
+		g_cancellable_cancel (priv->read_ahead_cancellable);
+		g_clear_object (&priv->read_ahead_cancellable);
+	}
+
+	settings = e_util_ref_settings ("org.gnome.evolution.mail");
+	count = g_settings_get_int (settings, "message-read-ahead");
+	g_object_unref (settings);
+
+	display = e_mail_reader_get_mail_display (reader);
+	message_list = e_mail_reader_get_message_list (reader);
+
+	if (count <= 0 || !folder || !message_uid ||
+	    !IS_MESSAGE_LIST (message_list) ||
+	    e_mail_display_get_mode (display) == E_MAIL_FORMATTER_MODE_SOURCE) {
+		priv->read_ahead_lru_size = 0;
+		g_queue_foreach (&priv->read_ahead_lru, (GFunc) g_object_unref, NULL);
+		g_queue_clear (&priv->read_ahead_lru);
+		return;
+	}
+
+	/* The messages around, the shown one and the next unread */
+	priv->read_ahead_lru_size = 2 * count + 2;
+
+	registry = e_mail_part_list_get_registry ();
+	uids = message_list_get_uids_around (MESSAGE_LIST (message_list), message_uid, count);
+
+	/* Those still parsed only need to stay in the LRU */
+	for (ii = uids->len; ii > 0; ii--) {
+		EMailPartList *part_list;
+		gchar *mail_uri;
+
+		mail_uri = e_mail_part_build_uri (folder, g_ptr_array_index (uids, ii - 1), NULL, NULL);
+		part_list = camel_object_bag_peek (registry, mail_uri);
+		g_free (mail_uri);
+
+		if (part_list) {
+			mail_reader_read_ahead_remember (reader, part_list);
+			g_object_unref (part_list);
+			g_ptr_array_remove_index (uids, ii - 1);
+		}
+	}
+
+	if (!uids->len) {
+		g_ptr_array_unref (uids);
+		return;
+	}
+
+	backend = e_mail_reader_get_backend (reader);
+
+	rad = g_slice_new0 (ReadAheadData);
+	rad->folder = g_object_ref (folder);
+	rad->session = g_object_ref (e_mail_backend_get_session (backend));
+	rad->uids = uids;
+	rad->part_lists = g_ptr_array_new_with_free_func (g_object_unref);
+
+	priv->read_ahead_cancellable = g_cancellable_new ();
+
+	task = g_task_new (reader, priv->read_ahead_cancellable, mail_reader_read_ahead_done_cb, NULL);
+	g_task_set_source_tag (task, mail_reader_schedule_read_ahead);
+	g_task_set_task_data (task, rad, read_ahead_data_free);
+	g_task_set_priority (task, G_PRIORITY_LOW);
+
+	g_task_run_in_thread (task, mail_reader_read_ahead_thread);
+
+	g_object_unref (task);
+}
+
 static void
 set_mail_display_part_list (GObject *object,
                             GAsyncResult *result,
@@ -3935,8 +4155,12 @@ set_mail_display_part_list (GObject *object,
 	e_mail_display_set_part_list (display, part_list);
 	e_mail_display_load (display, NULL);
 
+	/* To be able to get back to it quickly */
+	mail_reader_read_ahead_remember (reader, part_list);
+
 	/* Remove the reference added when parts list was
-	 * created, so that only owners are EMailDisplays. */
+	 * created, so that only owners are EMailDisplays
+	 * and the read-ahead LRU. */
 	g_object_unref (part_list);
 }
 
@@ -3969,6 +4193,7 @@ mail_reader_set_display_formatter_for_message (EMailReader *reader,
 	} else {
 		e_mail_display_set_part_list (display, parts);
 		e_mail_display_load (display, NULL);
+		mail_reader_read_ahead_remember (reader, parts);
 		g_object_unref (parts);
 	}
 }
@@ -4014,6 +4239,9 @@ mail_reader_message_loaded (EMailReader *reader,
 	mail_reader_set_display_formatter_for_message (
 		reader, display, message_uid, message, folder);
 
+	if (message != NULL)
+		mail_reader_schedule_read_ahead (reader, folder, message_uid);
+
 	/* Reset the shell view icon. */
 	e_shell_event (shell, "mail-icon", (gpointer) "evolution-mail");
 
@@ -5199,6 +5427,12 @@ e_mail_reader_dispose (EMailReader *reader)
 	if (priv->retrieving_message)
 		g_cancellable_cancel (priv->retrieving_message);
 
+	if (priv->read_ahead_cancellable)
+		g_cancellable_cancel (priv->read_ahead_cancellable);
+
+	g_queue_foreach (&priv->read_ahead_lru, (GFunc) g_object_unref, NULL);
+	g_queue_clear (&priv->read_ahead_lru);
+
 	ongoing_operations = g_slist_copy_deep (priv->ongoing_operations, (GCopyFunc) g_object_ref, NULL);
 	g_slist_free (priv->ongoing_operations);
 	priv->ongoing_operations = NULL;
@@ -84,6 +84,88 @@ save_gicon_to_stream (GIcon *icon,
 	g_object_unref (icon);
 }
 
+/* How much of the formatted message can wait for WebKit to read it */
+#define MAIL_REQUEST_PIPE_BUFFER (256 * 1024)
+
+typedef struct _FormatData {
+	EMailFormatter *formatter;
+	EMailPartList *part_list;
+	EMailFormatterHeaderFlags flags;
+	EMailFormatterMode mode;
+	GOutputStream *output_stream;
+	GCancellable *cancellable;
+	GCancellable *request_cancellable;
+	gulong request_cancelled_id;
+} FormatData;
+
+static void
+mail_request_cancel_format_cb (GCancellable *request_cancellable,
+			       gpointer user_data)
+{
+	GCancellable *cancellable = user_data;
+
+	g_cancellable_cancel (cancellable);
+}
+
+static gpointer
+mail_request_format_thread (gpointer user_data)
+{
+	FormatData *fd = user_data;
+
+	e_mail_formatter_format_sync (
+		fd->formatter, fd->part_list, fd->output_stream,
+		fd->flags, fd->mode, fd->cancellable);
+
+	/* This is the end of the data for the reader */
+	g_output_stream_close (fd->output_stream, NULL, NULL);
+
+	if (fd->request_cancellable)
+		g_cancellable_disconnect (fd->request_cancellable, fd->request_cancelled_id);
+
+	g_clear_object (&fd->request_cancellable);
+	g_object_unref (fd->output_stream);
+	g_object_unref (fd->cancellable);
+	g_object_unref (fd->part_list);
+	g_object_unref (fd->formatter);
+	g_slice_free (FormatData, fd);
+
+	return NULL;
+}
+
+/* Formats the whole message in a dedicated thread, which writes into
+ * a pipe read by WebKit, thus the headers and the first parts can be
+ * shown while the rest of the message is still being formatted. */
+static void
+mail_request_format_in_thread (EMailFormatter *formatter,
+			       EMailPartList *part_list,
+			       EMailFormatterHeaderFlags flags,
+			       EMailFormatterMode mode,
+			       GCancellable *cancellable,
+			       GInputStream **out_stream)
+{
+	FormatData *fd;
+	GThread *thread;
+
+	fd = g_slice_new0 (FormatData);
+	fd->formatter = g_object_ref (formatter);
+	fd->part_list = g_object_ref (part_list);
+	fd->flags = flags;
+	fd->mode = mode;
+	fd->cancellable = g_cancellable_new ();
+
+	if (cancellable) {
+		fd->request_cancellable = g_object_ref (cancellable);
+		fd->request_cancelled_id = g_cancellable_connect (cancellable,
+			G_CALLBACK (mail_request_cancel_format_cb), fd->cancellable, NULL);
+	}
+
+	/* Closing the reading side cancels the formatting as well */
+	e_pipe_stream_new (MAIL_REQUEST_PIPE_BUFFER, fd->cancellable, out_stream, &fd->output_stream);
+
+	thread = g_thread_new ("mail-request-format", mail_request_format_thread, fd);
+	g_thread_unref (thread);
+}
+
 static gboolean
 mail_request_process_mail_sync (EContentRequest *request,
 				SoupURI *suri,
@@ -164,6 +246,26 @@ mail_request_process_mail_sync (EContentRequest *request,
 	if (charset != NULL && *charset != '\0')
 		e_mail_formatter_set_charset (formatter, charset);
 
+	if (!uri_query || (
+	    !g_hash_table_lookup (uri_query, "attachment_icon") &&
+	    !g_hash_table_lookup (uri_query, "part_id"))) {
+		/* The whole message always has at least the HTML header,
+		 * thus it cannot end without any content. */
+		mail_request_format_in_thread (
+			formatter, part_list, context.flags, context.mode,
+			cancellable, out_stream);
+
+		*out_stream_length = -1;
+		*out_mime_type = g_strdup ("text/html");
+
+		g_clear_object (&context.part_list);
+		g_object_unref (part_list);
+		g_object_unref (formatter);
+		g_free (context.uri);
+
+		return TRUE;
+	}
+
 	output_stream = g_memory_output_stream_new_resizable ();
 
 	val = uri_query ? g_hash_table_lookup (uri_query, "attachment_icon") : NULL;
@@ -252,11 +354,6 @@ mail_request_process_mail_sync (EContentRequest *request,
 		part_converted_to_utf8 = e_mail_part_get_converted_to_utf8 (part);
 
 		g_object_unref (part);
-
-	} else {
-		e_mail_formatter_format_sync (
-			formatter, part_list, output_stream,
-			context.flags, context.mode, cancellable);
 	}
 
  no_part:
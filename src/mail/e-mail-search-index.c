@@ -0,0 +1,1235 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* The index answers whether a folder can contain any message matching
+ * a search expression, thus the "All Accounts" search does not need to
+ * evaluate the expression in folders which cannot match.
+ *
+ * Each folder has a Bloom filter of the trigrams of the Subject, From,
+ * To and Cc of its messages, which is saved in the cache directory, and
+ * a set of the indexed message UIDs. The index of a folder is used only
+ * after it had been checked against the folder summary in this session;
+ * the check indexes only the new messages. Any change reported by the
+ * MailFolderCache makes the folder to be checked again. Removed messages
+ * stay in the filter until there are too many of them, when the folder
+ * is indexed from scratch. Their UIDs are forgotten immediately, thus
+ * a message reusing the UID is indexed again.
+ *
+ * The filter can say "maybe" for a folder without any matching message,
+ * but never "no" for a folder with one, thus the search results are the
+ * same as without the index. */
+
+#include "evolution-config.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include <libedataserver/libedataserver.h>
+#include <e-util/e-util.h>
+
+#include "e-mail-search-index.h"
+
+#define E_MAIL_SEARCH_INDEX_GET_PRIVATE(obj) \
+	(G_TYPE_INSTANCE_GET_PRIVATE \
+	((obj), E_TYPE_MAIL_SEARCH_INDEX, EMailSearchIndexPrivate))
+
+/* Bits of the filter per message; it's rounded up to a power of two */
+#define BLOOM_BITS_PER_MESSAGE 64
+#define BLOOM_MIN_BYTES 1024
+#define BLOOM_MAX_BYTES (1024 * 1024)
+#define BLOOM_N_HASHES 3
+
+#define INDEX_FILE_MAGIC 0x49534d45 /* "EMSI" */
+#define INDEX_FILE_VERSION 2
+#define INDEX_FILE_HEADER_LEN (5 * sizeof (guint32))
+
+typedef struct _FolderIndex {
+	guint8 *bloom;
+	guint32 bloom_size;	/* in bytes, a power of two */
+	GHashTable *uids;	/* camel_pstring UID ~> NULL */
+	guint32 n_stale;	/* removed messages still in the bloom */
+
+	/* UIDs forgotten while the folder is being indexed */
+	GHashTable *dropped_uids;
+
+	GWeakRef folder;
+	gulong folder_changed_handler_id;
+
+	gboolean verified;	/* checked against the folder summary */
+	gboolean excluded;	/* answered "no" since the last change */
+	gboolean update_queued;
+	guint change_stamp;
+} FolderIndex;
+
+typedef struct _QueryTerm {
+	gchar *func;		/* NULL for a value */
+	gchar *value;
+	GPtrArray *args;	/* QueryTerm * */
+} QueryTerm;
+
+struct _EMailSearchIndexPrivate {
+	MailFolderCache *folder_cache;
+	gulong folder_changed_handler_id;
+	gulong folder_deleted_handler_id;
+	gulong folder_renamed_handler_id;
+
+	gchar *cache_dir;
+
+	GMutex lock;
+	GHashTable *folders;	/* gchar *key ~> FolderIndex * */
+	GQueue update_queue;	/* CamelFolder * */
+	gboolean updating;
+
+	/* The last used expression and its parsed form */
+	gchar *expression;
+	QueryTerm *query;
+};
+
+enum {
+	EXCLUDED_FOLDER_CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL];
+
+G_DEFINE_TYPE (EMailSearchIndex, e_mail_search_index, G_TYPE_OBJECT)
+
+static GHashTable *
+search_index_new_uid_set (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify) camel_pstring_free, NULL);
+}
+
+static void
+folder_index_free (gpointer ptr)
+{
+	FolderIndex *fi = ptr;
+
+	if (fi) {
+		CamelFolder *folder;
+
+		folder = g_weak_ref_get (&fi->folder);
+		if (folder) {
+			g_signal_handler_disconnect (folder, fi->folder_changed_handler_id);
+			g_object_unref (folder);
+		}
+
+		g_weak_ref_clear (&fi->folder);
+		g_free (fi->bloom);
+		g_hash_table_destroy (fi->uids);
+		if (fi->dropped_uids)
+			g_hash_table_destroy (fi->dropped_uids);
+		g_slice_free (FolderIndex, fi);
+	}
+}
+
+static void
+query_term_free (gpointer ptr)
+{
+	QueryTerm *term = ptr;
+
+	if (term) {
+		g_free (term->func);
+		g_free (term->value);
+		if (term->args)
+			g_ptr_array_unref (term->args);
+		g_slice_free (QueryTerm, term);
+	}
+}
+
+static gchar *
+search_index_build_key (CamelStore *store,
+			const gchar *folder_name)
+{
+	return g_strconcat (camel_service_get_uid (CAMEL_SERVICE (store)), "\n", folder_name, NULL);
+}
+
+static gchar *
+search_index_build_filename (EMailSearchIndex *search_index,
+			     const gchar *key)
+{
+	gchar *checksum, *basename, *filename;
+
+	checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+	basename = g_strconcat (checksum, ".idx", NULL);
+	filename = g_build_filename (search_index->priv->cache_dir, basename, NULL);
+
+	g_free (basename);
+	g_free (checksum);
+
+	return filename;
+}
+
+/* The same case folding as camel_ustrstrcase(), which does the substring
+ * matching for the header searches, thus the trigrams of the folded text
+ * contain the trigrams of any folded substring. */
+static gchar *
+search_index_fold (const gchar *text)
+{
+	GString *folded;
+	const gchar *ptr;
+
+	if (!text || !*text)
+		return NULL;
+
+	if (!g_utf8_validate (text, -1, NULL))
+		return g_ascii_strdown (text, -1);
+
+	folded = g_string_sized_new (strlen (text));
+
+	for (ptr = text; *ptr; ptr = g_utf8_next_char (ptr)) {
+		g_string_append_unichar (folded, g_unichar_tolower (g_utf8_get_char (ptr)));
+	}
+
+	return g_string_free (folded, FALSE);
+}
+
+static guint32
+search_index_hash_trigram (gchar field,
+			   const gchar *trigram)
+{
+	guint32 hash = 2166136261u;
+	gint ii;
+
+	/* FNV-1a, with the field as the first byte */
+	hash = (hash ^ (guchar) field) * 16777619u;
+
+	for (ii = 0; ii < 3; ii++) {
+		hash = (hash ^ (guchar) trigram[ii]) * 16777619u;
+	}
+
+	return hash;
+}
+
+static void
+search_index_bloom_add (guint8 *bloom,
+			guint32 bloom_size,
+			guint32 hash)
+{
+	guint32 mask = bloom_size * 8 - 1, step;
+	gint ii;
+
+	step = ((hash >> 16) | (hash << 16)) | 1;
+
+	for (ii = 0; ii < BLOOM_N_HASHES; ii++) {
+		guint32 bit = (hash + ii * step) & mask;
+
+		bloom[bit / 8] |= 1 << (bit % 8);
+	}
+}
+
+static gboolean
+search_index_bloom_test (const guint8 *bloom,
+			 guint32 bloom_size,
+			 guint32 hash)
+{
+	guint32 mask = bloom_size * 8 - 1, step;
+	gint ii;
+
+	step = ((hash >> 16) | (hash << 16)) | 1;
+
+	for (ii = 0; ii < BLOOM_N_HASHES; ii++) {
+		guint32 bit = (hash + ii * step) & mask;
+
+		if (!(bloom[bit / 8] & (1 << (bit % 8))))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static guint32
+search_index_bloom_size_for (guint n_messages)
+{
+	guint64 wanted = ((guint64) n_messages) * BLOOM_BITS_PER_MESSAGE / 8;
+	guint32 size = BLOOM_MIN_BYTES;
+
+	while (size < wanted && size < BLOOM_MAX_BYTES)
+		size *= 2;
+
+	return size;
+}
+
+static void
+search_index_add_text (guint8 *bloom,
+		       guint32 bloom_size,
+		       gchar field,
+		       const gchar *text)
+{
+	gchar *folded;
+	gsize ii, len;
+
+	folded = search_index_fold (text);
+	if (!folded)
+		return;
+
+	len = strlen (folded);
+
+	for (ii = 0; ii + 3 <= len; ii++) {
+		search_index_bloom_add (bloom, bloom_size, search_index_hash_trigram (field, folded + ii));
+	}
+
+	g_free (folded);
+}
+
+static void
+search_index_add_address (guint8 *bloom,
+			  guint32 bloom_size,
+			  gchar field,
+			  const gchar *formatted)
+{
+	CamelInternetAddress *address;
+	const gchar *name, *email;
+	gint ii;
+
+	if (!formatted || !*formatted)
+		return;
+
+	search_index_add_text (bloom, bloom_size, field, formatted);
+
+	/* The address matching compares also the name and the email
+	 * separately, which can differ from the formatted value, like
+	 * with quoted names. */
+	address = camel_internet_address_new ();
+
+	if (camel_address_unformat (CAMEL_ADDRESS (address), formatted) > 0) {
+		for (ii = 0; camel_internet_address_get (address, ii, &name, &email); ii++) {
+			search_index_add_text (bloom, bloom_size, field, name);
+			search_index_add_text (bloom, bloom_size, field, email);
+		}
+	}
+
+	g_object_unref (address);
+}
+
+static void
+search_index_add_message_info (guint8 *bloom,
+			       guint32 bloom_size,
+			       CamelMessageInfo *info)
+{
+	search_index_add_text (bloom, bloom_size, 's', camel_message_info_get_subject (info));
+	search_index_add_address (bloom, bloom_size, 'f', camel_message_info_get_from (info));
+	search_index_add_address (bloom, bloom_size, 't', camel_message_info_get_to (info));
+	search_index_add_address (bloom, bloom_size, 'c', camel_message_info_get_cc (info));
+}
+
+static gboolean
+search_index_text_may_be_present (FolderIndex *fi,
+				  gchar field,
+				  const gchar *text)
+{
+	gchar *folded;
+	gsize ii, len;
+	gboolean may_be_present = TRUE;
+
+	folded = search_index_fold (text);
+	if (!folded)
+		return TRUE;
+
+	len = strlen (folded);
+
+	for (ii = 0; ii + 3 <= len && may_be_present; ii++) {
+		may_be_present = search_index_bloom_test (fi->bloom, fi->bloom_size,
+			search_index_hash_trigram (field, folded + ii));
+	}
+
+	g_free (folded);
+
+	return may_be_present;
+}
+
+static FolderIndex *
+search_index_load_folder (EMailSearchIndex *search_index,
+			  const gchar *key)
+{
+	FolderIndex *fi;
+	gchar *filename, *contents = NULL;
+	gsize length = 0;
+
+	fi = g_slice_new0 (FolderIndex);
+	fi->uids = search_index_new_uid_set ();
+
+	filename = search_index_build_filename (search_index, key);
+
+	if (g_file_get_contents (filename, &contents, &length, NULL) &&
+	    length >= INDEX_FILE_HEADER_LEN) {
+		const guint32 *header = (const guint32 *) contents;
+		guint32 bloom_size, n_uids;
+
+		bloom_size = GUINT32_FROM_LE (header[2]);
+		n_uids = GUINT32_FROM_LE (header[3]);
+
+		if (GUINT32_FROM_LE (header[0]) == INDEX_FILE_MAGIC &&
+		    GUINT32_FROM_LE (header[1]) == INDEX_FILE_VERSION &&
+		    bloom_size >= BLOOM_MIN_BYTES && bloom_size <= BLOOM_MAX_BYTES &&
+		    (bloom_size & (bloom_size - 1)) == 0 &&
+		    length >= INDEX_FILE_HEADER_LEN + bloom_size + n_uids &&
+		    (length == INDEX_FILE_HEADER_LEN + bloom_size || contents[length - 1] == '\0')) {
+			const gchar *ptr, *end = contents + length;
+			guint32 ii;
+
+			/* The UIDs follow the filter, each terminated by a nul byte */
+			ptr = contents + INDEX_FILE_HEADER_LEN + bloom_size;
+
+			for (ii = 0; ii < n_uids && ptr < end; ii++) {
+				g_hash_table_add (fi->uids, (gpointer) camel_pstring_strdup (ptr));
+				ptr += strlen (ptr) + 1;
+			}
+
+			if (ii == n_uids && ptr == end) {
+				fi->bloom_size = bloom_size;
+				fi->bloom = g_memdup (contents + INDEX_FILE_HEADER_LEN, bloom_size);
+				fi->n_stale = GUINT32_FROM_LE (header[4]);
+			} else {
+				g_hash_table_remove_all (fi->uids);
+			}
+		}
+	}
+
+	g_free (contents);
+	g_free (filename);
+
+	return fi;
+}
+
+/* Called with the lock held */
+static FolderIndex *
+search_index_get_folder (EMailSearchIndex *search_index,
+			 const gchar *key)
+{
+	FolderIndex *fi;
+
+	fi = g_hash_table_lookup (search_index->priv->folders, key);
+	if (!fi) {
+		fi = search_index_load_folder (search_index, key);
+		g_hash_table_insert (search_index->priv->folders, g_strdup (key), fi);
+	}
+
+	return fi;
+}
+
+static GBytes *
+search_index_encode_folder (FolderIndex *fi)
+{
+	GByteArray *data;
+	GHashTableIter iter;
+	gpointer uid;
+	guint32 header[5];
+
+	header[0] = GUINT32_TO_LE (INDEX_FILE_MAGIC);
+	header[1] = GUINT32_TO_LE (INDEX_FILE_VERSION);
+	header[2] = GUINT32_TO_LE (fi->bloom_size);
+	header[3] = GUINT32_TO_LE (g_hash_table_size (fi->uids));
+	header[4] = GUINT32_TO_LE (fi->n_stale);
+
+	data = g_byte_array_sized_new (INDEX_FILE_HEADER_LEN + fi->bloom_size + g_hash_table_size (fi->uids) * 8);
+	g_byte_array_append (data, (const guint8 *) header, INDEX_FILE_HEADER_LEN);
+	g_byte_array_append (data, fi->bloom, fi->bloom_size);
+
+	g_hash_table_iter_init (&iter, fi->uids);
+
+	while (g_hash_table_iter_next (&iter, &uid, NULL)) {
+		g_byte_array_append (data, uid, strlen (uid) + 1);
+	}
+
+	return g_byte_array_free_to_bytes (data);
+}
+
+/* Called with the lock held */
+static void
+search_index_drop_uid (FolderIndex *fi,
+		       const gchar *uid,
+		       gboolean removed)
+{
+	if (!g_hash_table_remove (fi->uids, uid))
+		return;
+
+	if (removed)
+		fi->n_stale++;
+
+	/* Not to be added back by the running update */
+	if (fi->dropped_uids)
+		g_hash_table_add (fi->dropped_uids, (gpointer) camel_pstring_strdup (uid));
+}
+
+/* Brings the index of the @folder up to date with its summary,
+ * indexing only the messages which are not indexed yet. */
+static void
+search_index_update_folder (EMailSearchIndex *search_index,
+			    CamelFolder *folder,
+			    GCancellable *cancellable)
+{
+	CamelFolderSummary *summary;
+	FolderIndex *fi;
+	GPtrArray *uids;
+	GHashTable *indexed_uids;
+	GBytes *encoded = NULL;
+	guint8 *bloom;
+	gboolean *known;
+	guint32 bloom_size, n_stale, base_stale;
+	guint ii, n_uids, n_known = 0, stamp;
+	gboolean rebuild;
+	gchar *key;
+
+	summary = camel_folder_get_folder_summary (folder);
+	if (!summary)
+		return;
+
+	key = search_index_build_key (camel_folder_get_parent_store (folder), camel_folder_get_full_name (folder));
+
+	uids = camel_folder_summary_get_array (summary);
+	n_uids = uids ? uids->len : 0;
+
+	known = g_new0 (gboolean, n_uids);
+
+	g_mutex_lock (&search_index->priv->lock);
+
+	fi = search_index_get_folder (search_index, key);
+	stamp = fi->change_stamp;
+	base_stale = fi->n_stale;
+	bloom_size = search_index_bloom_size_for (n_uids);
+
+	if (!fi->dropped_uids)
+		fi->dropped_uids = search_index_new_uid_set ();
+
+	for (ii = 0; ii < n_uids; ii++) {
+		known[ii] = g_hash_table_contains (fi->uids, g_ptr_array_index (uids, ii));
+		if (known[ii])
+			n_known++;
+	}
+
+	n_stale = fi->n_stale + g_hash_table_size (fi->uids) - n_known;
+
+	/* Start from scratch when the filter is too small for the folder
+	 * or when too many removed messages make it less useful. */
+	rebuild = !fi->bloom || fi->bloom_size < bloom_size ||
+		(n_stale > 0 && n_stale > n_uids / 2);
+
+	if (rebuild) {
+		bloom = g_malloc0 (bloom_size);
+		n_stale = 0;
+	} else {
+		bloom_size = fi->bloom_size;
+		bloom = g_memdup (fi->bloom, bloom_size);
+	}
+
+	g_mutex_unlock (&search_index->priv->lock);
+
+	indexed_uids = search_index_new_uid_set ();
+
+	if (uids && (rebuild || n_uids - n_known > 10))
+		camel_folder_summary_prepare_fetch_all (summary, NULL);
+
+	for (ii = 0; ii < n_uids && !g_cancellable_is_cancelled (cancellable); ii++) {
+		const gchar *uid = g_ptr_array_index (uids, ii);
+
+		if (rebuild || !known[ii]) {
+			CamelMessageInfo *info;
+
+			info = camel_folder_summary_get (summary, uid);
+			if (info) {
+				search_index_add_message_info (bloom, bloom_size, info);
+				g_clear_object (&info);
+			}
+		}
+
+		g_hash_table_add (indexed_uids, (gpointer) camel_pstring_strdup (uid));
+	}
+
+	g_mutex_lock (&search_index->priv->lock);
+
+	/* The folder could be removed from the index meanwhile */
+	fi = g_hash_table_lookup (search_index->priv->folders, key);
+	if (fi) {
+		fi->update_queued = FALSE;
+
+		if (!g_cancellable_is_cancelled (cancellable) && fi->dropped_uids) {
+			GHashTableIter iter;
+			gpointer uid;
+
+			/* Messages removed or replaced meanwhile could be
+			 * indexed with their old content above. */
+			g_hash_table_iter_init (&iter, fi->dropped_uids);
+
+			while (g_hash_table_iter_next (&iter, &uid, NULL)) {
+				g_hash_table_remove (indexed_uids, uid);
+			}
+
+			if (fi->n_stale > base_stale)
+				n_stale += fi->n_stale - base_stale;
+
+			g_free (fi->bloom);
+			fi->bloom = bloom;
+			fi->bloom_size = bloom_size;
+			fi->n_stale = n_stale;
+
+			g_hash_table_destroy (fi->uids);
+			fi->uids = indexed_uids;
+
+			/* Changed while being indexed, thus check it again later */
+			fi->verified = fi->change_stamp == stamp;
+
+			encoded = search_index_encode_folder (fi);
+
+			bloom = NULL;
+			indexed_uids = NULL;
+		}
+
+		if (fi->dropped_uids) {
+			g_hash_table_destroy (fi->dropped_uids);
+			fi->dropped_uids = NULL;
+		}
+	}
+
+	g_mutex_unlock (&search_index->priv->lock);
+
+	if (encoded) {
+		gchar *filename;
+
+		filename = search_index_build_filename (search_index, key);
+
+		g_file_set_contents (filename,
+			g_bytes_get_data (encoded, NULL),
+			g_bytes_get_size (encoded), NULL);
+
+		g_bytes_unref (encoded);
+		g_free (filename);
+	}
+
+	if (indexed_uids)
+		g_hash_table_destroy (indexed_uids);
+	g_free (bloom);
+	g_free (known);
+	g_free (key);
+
+	if (uids)
+		camel_folder_summary_free_array (uids);
+}
+
+static void
+search_index_update_thread (GTask *task,
+			    gpointer source_object,
+			    gpointer task_data,
+			    GCancellable *cancellable)
+{
+	EMailSearchIndex *search_index = source_object;
+	CamelFolder *folder;
+
+	while (TRUE) {
+		g_mutex_lock (&search_index->priv->lock);
+
+		folder = g_queue_pop_head (&search_index->priv->update_queue);
+		if (!folder)
+			search_index->priv->updating = FALSE;
+
+		g_mutex_unlock (&search_index->priv->lock);
+
+		if (!folder)
+			break;
+
+		search_index_update_folder (search_index, folder, cancellable);
+
+		g_object_unref (folder);
+	}
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/* Called with the lock held */
+static void
+search_index_queue_update (EMailSearchIndex *search_index,
+			   FolderIndex *fi,
+			   CamelFolder *folder)
+{
+	GTask *task;
+
+	if (fi->update_queued)
+		return;
+
+	fi->update_queued = TRUE;
+
+	g_queue_push_tail (&search_index->priv->update_queue, g_object_ref (folder));
+
+	if (search_index->priv->updating)
+		return;
+
+	search_index->priv->updating = TRUE;
+
+	task = g_task_new (search_index, NULL, NULL, NULL);
+	g_task_set_source_tag (task, search_index_queue_update);
+	g_task_set_priority (task, G_PRIORITY_LOW);
+	g_task_run_in_thread (task, search_index_update_thread);
+	g_object_unref (task);
+}
+
+static QueryTerm *
+search_index_parse_term (const gchar **pexpr)
+{
+	const gchar *ptr = *pexpr;
+	QueryTerm *term;
+
+	while (g_ascii_isspace (*ptr))
+		ptr++;
+
+	if (!*ptr || *ptr == ')')
+		return NULL;
+
+	term = g_slice_new0 (QueryTerm);
+
+	if (*ptr == '(') {
+		const gchar *start;
+
+		ptr++;
+
+		while (g_ascii_isspace (*ptr))
+			ptr++;
+
+		start = ptr;
+		while (*ptr && *ptr != '(' && *ptr != ')' && *ptr != '"' && !g_ascii_isspace (*ptr))
+			ptr++;
+
+		term->func = g_strndup (start, ptr - start);
+		term->args = g_ptr_array_new_with_free_func (query_term_free);
+
+		while (TRUE) {
+			QueryTerm *arg;
+
+			while (g_ascii_isspace (*ptr))
+				ptr++;
+
+			if (*ptr == ')') {
+				ptr++;
+				break;
+			}
+
+			arg = search_index_parse_term (&ptr);
+			if (!arg) {
+				query_term_free (term);
+				return NULL;
+			}
+
+			g_ptr_array_add (term->args, arg);
+		}
+	} else if (*ptr == '"') {
+		GString *value = g_string_new ("");
+
+		ptr++;
+
+		while (*ptr && *ptr != '"') {
+			if (*ptr == '\\' && ptr[1])
+				ptr++;
+
+			g_string_append_c (value, *ptr);
+			ptr++;
+		}
+
+		if (*ptr != '"') {
+			g_string_free (value, TRUE);
+			query_term_free (term);
+			return NULL;
+		}
+
+		ptr++;
+
+		term->value = g_string_free (value, FALSE);
+	} else {
+		const gchar *start = ptr;
+
+		while (*ptr && *ptr != '(' && *ptr != ')' && !g_ascii_isspace (*ptr))
+			ptr++;
+
+		term->value = g_strndup (start, ptr - start);
+	}
+
+	*pexpr = ptr;
+
+	return term;
+}
+
+static gchar
+search_index_field_for_header (const gchar *header_name)
+{
+	if (!header_name)
+		return 0;
+
+	if (g_ascii_strcasecmp (header_name, "subject") == 0)
+		return 's';
+
+	if (g_ascii_strcasecmp (header_name, "from") == 0)
+		return 'f';
+
+	if (g_ascii_strcasecmp (header_name, "to") == 0)
+		return 't';
+
+	if (g_ascii_strcasecmp (header_name, "cc") == 0)
+		return 'c';
+
+	return 0;
+}
+
+/* Returns FALSE only when no message of the folder can match the @term;
+ * anything not understood can match. */
+static gboolean
+search_index_term_may_match (FolderIndex *fi,
+			     QueryTerm *term)
+{
+	const gchar *func = term->func;
+	guint ii;
+
+	if (!func)
+		return TRUE;
+
+	if (g_strcmp0 (func, "and") == 0) {
+		for (ii = 0; ii < term->args->len; ii++) {
+			if (!search_index_term_may_match (fi, g_ptr_array_index (term->args, ii)))
+				return FALSE;
+		}
+
+		return TRUE;
+	}
+
+	if (g_strcmp0 (func, "or") == 0) {
+		for (ii = 0; ii < term->args->len; ii++) {
+			if (search_index_term_may_match (fi, g_ptr_array_index (term->args, ii)))
+				return TRUE;
+		}
+
+		return term->args->len == 0;
+	}
+
+	if (g_strcmp0 (func, "match-all") == 0) {
+		if (term->args->len != 1)
+			return TRUE;
+
+		return search_index_term_may_match (fi, g_ptr_array_index (term->args, 0));
+	}
+
+	if (g_strcmp0 (func, "header-contains") == 0 ||
+	    g_strcmp0 (func, "header-matches") == 0 ||
+	    g_strcmp0 (func, "header-starts-with") == 0 ||
+	    g_strcmp0 (func, "header-ends-with") == 0 ||
+	    g_strcmp0 (func, "header-has-words") == 0) {
+		gboolean split_words = g_strcmp0 (func, "header-has-words") == 0;
+		QueryTerm *arg;
+		gchar field;
+
+		if (term->args->len < 2)
+			return TRUE;
+
+		arg = g_ptr_array_index (term->args, 0);
+		field = search_index_field_for_header (arg->value);
+		if (!field)
+			return TRUE;
+
+		/* Any of the values can match */
+		for (ii = 1; ii < term->args->len; ii++) {
+			arg = g_ptr_array_index (term->args, ii);
+
+			if (!arg->value)
+				return TRUE;
+
+			if (split_words) {
+				gchar **words;
+				gint jj;
+				gboolean may_match = FALSE, any_word = FALSE;
+
+				words = g_strsplit_set (arg->value, " \t\r\n", -1);
+
+				for (jj = 0; words[jj] && !may_match; jj++) {
+					if (*words[jj]) {
+						any_word = TRUE;
+						may_match = search_index_text_may_be_present (fi, field, words[jj]);
+					}
+				}
+
+				g_strfreev (words);
+
+				/* A value without any word is not understood */
+				if (may_match || !any_word)
+					return TRUE;
+			} else if (search_index_text_may_be_present (fi, field, arg->value)) {
+				return TRUE;
+			}
+		}
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+search_index_forget_folder (EMailSearchIndex *search_index,
+			    CamelStore *store,
+			    const gchar *folder_name)
+{
+	gchar *key, *filename;
+
+	key = search_index_build_key (store, folder_name);
+	filename = search_index_build_filename (search_index, key);
+
+	g_mutex_lock (&search_index->priv->lock);
+	g_hash_table_remove (search_index->priv->folders, key);
+	g_unlink (filename);
+	g_mutex_unlock (&search_index->priv->lock);
+
+	g_free (filename);
+	g_free (key);
+}
+
+static void
+search_index_folder_changed_cb (MailFolderCache *folder_cache,
+				CamelStore *store,
+				const gchar *folder_name,
+				gint new_messages,
+				const gchar *msg_uid,
+				const gchar *msg_sender,
+				const gchar *msg_subject,
+				EMailSearchIndex *search_index)
+{
+	FolderIndex *fi;
+	gboolean was_excluded = FALSE;
+	gchar *key;
+
+	key = search_index_build_key (store, folder_name);
+
+	g_mutex_lock (&search_index->priv->lock);
+
+	/* Not loaded folders are not verified yet anyway */
+	fi = g_hash_table_lookup (search_index->priv->folders, key);
+	if (fi) {
+		was_excluded = fi->excluded;
+
+		fi->verified = FALSE;
+		fi->excluded = FALSE;
+		fi->change_stamp++;
+	}
+
+	g_mutex_unlock (&search_index->priv->lock);
+
+	/* Any change can make the folder match, not only new messages */
+	if (was_excluded)
+		g_signal_emit (search_index, signals[EXCLUDED_FOLDER_CHANGED], 0, store, folder_name);
+
+	g_free (key);
+}
+
+/* Camel reports a change of the UIDVALIDITY of a folder as a change
+ * of all its messages, because the UIDs can refer to other messages
+ * now; the folder is then indexed from scratch. */
+static void
+search_index_camel_folder_changed_cb (CamelFolder *folder,
+				      CamelFolderChangeInfo *changes,
+				      EMailSearchIndex *search_index)
+{
+	FolderIndex *fi;
+	gchar *key;
+
+	if (!changes)
+		return;
+
+	key = search_index_build_key (camel_folder_get_parent_store (folder), camel_folder_get_full_name (folder));
+
+	g_mutex_lock (&search_index->priv->lock);
+
+	fi = g_hash_table_lookup (search_index->priv->folders, key);
+	if (fi) {
+		guint ii, n_changed = 0;
+
+		for (ii = 0; ii < changes->uid_removed->len; ii++) {
+			search_index_drop_uid (fi, g_ptr_array_index (changes->uid_removed, ii), TRUE);
+		}
+
+		for (ii = 0; ii < changes->uid_changed->len; ii++) {
+			if (g_hash_table_contains (fi->uids, g_ptr_array_index (changes->uid_changed, ii)))
+				n_changed++;
+		}
+
+		if (n_changed > 0 && n_changed == g_hash_table_size (fi->uids)) {
+			GHashTableIter iter;
+			gpointer uid;
+			gchar *filename;
+
+			if (fi->dropped_uids) {
+				g_hash_table_iter_init (&iter, fi->uids);
+
+				while (g_hash_table_iter_next (&iter, &uid, NULL)) {
+					g_hash_table_add (fi->dropped_uids, (gpointer) camel_pstring_strdup (uid));
+				}
+			}
+
+			g_hash_table_remove_all (fi->uids);
+			g_free (fi->bloom);
+			fi->bloom = NULL;
+			fi->n_stale = 0;
+
+			filename = search_index_build_filename (search_index, key);
+			g_unlink (filename);
+			g_free (filename);
+		}
+
+		fi->verified = FALSE;
+		fi->change_stamp++;
+	}
+
+	g_mutex_unlock (&search_index->priv->lock);
+
+	g_free (key);
+}
+
+/* Called with the lock held */
+static void
+search_index_watch_folder (EMailSearchIndex *search_index,
+			   FolderIndex *fi,
+			   CamelFolder *folder)
+{
+	CamelFolder *watched;
+
+	watched = g_weak_ref_get (&fi->folder);
+
+	if (watched != folder) {
+		if (watched)
+			g_signal_handler_disconnect (watched, fi->folder_changed_handler_id);
+
+		g_weak_ref_set (&fi->folder, folder);
+
+		fi->folder_changed_handler_id = g_signal_connect (
+			folder, "changed",
+			G_CALLBACK (search_index_camel_folder_changed_cb), search_index);
+	}
+
+	g_clear_object (&watched);
+}
+
+static void
+search_index_folder_deleted_cb (MailFolderCache *folder_cache,
+				CamelStore *store,
+				const gchar *folder_name,
+				EMailSearchIndex *search_index)
+{
+	search_index_forget_folder (search_index, store, folder_name);
+}
+
+static void
+search_index_folder_renamed_cb (MailFolderCache *folder_cache,
+				CamelStore *store,
+				const gchar *old_folder_name,
+				const gchar *new_folder_name,
+				EMailSearchIndex *search_index)
+{
+	search_index_forget_folder (search_index, store, old_folder_name);
+}
+
+static void
+search_index_dispose (GObject *object)
+{
+	EMailSearchIndexPrivate *priv;
+
+	priv = E_MAIL_SEARCH_INDEX_GET_PRIVATE (object);
+
+	if (priv->folder_cache) {
+		e_signal_disconnect_notify_handler (priv->folder_cache, &priv->folder_changed_handler_id);
+		e_signal_disconnect_notify_handler (priv->folder_cache, &priv->folder_deleted_handler_id);
+		e_signal_disconnect_notify_handler (priv->folder_cache, &priv->folder_renamed_handler_id);
+		g_clear_object (&priv->folder_cache);
+	}
+
+	/* Chain up to parent's dispose() method. */
+	G_OBJECT_CLASS (e_mail_search_index_parent_class)->dispose (object);
+}
+
+static void
+search_index_finalize (GObject *object)
+{
+	EMailSearchIndexPrivate *priv;
+
+	priv = E_MAIL_SEARCH_INDEX_GET_PRIVATE (object);
+
+	g_queue_foreach (&priv->update_queue, (GFunc) g_object_unref, NULL);
+	g_queue_clear (&priv->update_queue);
+	g_hash_table_destroy (priv->folders);
+	query_term_free (priv->query);
+	g_free (priv->expression);
+	g_free (priv->cache_dir);
+	g_mutex_clear (&priv->lock);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (e_mail_search_index_parent_class)->finalize (object);
+}
+
+static void
+e_mail_search_index_class_init (EMailSearchIndexClass *class)
+{
+	GObjectClass *object_class;
+
+	g_type_class_add_private (class, sizeof (EMailSearchIndexPrivate));
+
+	object_class = G_OBJECT_CLASS (class);
+	object_class->dispose = search_index_dispose;
+	object_class->finalize = search_index_finalize;
+
+	/**
+	 * EMailSearchIndex::excluded-folder-changed:
+	 * @search_index: the #EMailSearchIndex which emitted the signal
+	 * @store: the #CamelStore of the folder
+	 * @folder_name: full name of the folder
+	 *
+	 * Emitted when a folder, for which e_mail_search_index_folder_may_match()
+	 * returned %FALSE, changed, thus it can match now.
+	 *
+	 * Since: 3.32
+	 **/
+	signals[EXCLUDED_FOLDER_CHANGED] = g_signal_new (
+		"excluded-folder-changed",
+		G_TYPE_FROM_CLASS (class),
+		G_SIGNAL_RUN_LAST,
+		0, NULL, NULL, NULL,
+		G_TYPE_NONE, 2,
+		CAMEL_TYPE_STORE,
+		G_TYPE_STRING);
+}
+
+static void
+e_mail_search_index_init (EMailSearchIndex *search_index)
+{
+	search_index->priv = E_MAIL_SEARCH_INDEX_GET_PRIVATE (search_index);
+
+	g_mutex_init (&search_index->priv->lock);
+	search_index->priv->folders = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, folder_index_free);
+	search_index->priv->cache_dir = g_build_filename (mail_session_get_cache_dir (), "search-index", NULL);
+
+	g_mkdir_with_parents (search_index->priv->cache_dir, 0700);
+}
+
+/**
+ * e_mail_search_index_ref_default:
+ * @folder_cache: a #MailFolderCache
+ *
+ * Returns the search index shared by all the views. The index follows
+ * the changes reported by the @folder_cache.
+ *
+ * Free the returned object with g_object_unref(), when no longer needed.
+ *
+ * Returns: (transfer full): the default #EMailSearchIndex
+ *
+ * Since: 3.32
+ **/
+EMailSearchIndex *
+e_mail_search_index_ref_default (MailFolderCache *folder_cache)
+{
+	static GMutex def_search_index_lock;
+	static GWeakRef def_search_index;
+	EMailSearchIndex *search_index;
+
+	g_return_val_if_fail (MAIL_IS_FOLDER_CACHE (folder_cache), NULL);
+
+	g_mutex_lock (&def_search_index_lock);
+
+	search_index = g_weak_ref_get (&def_search_index);
+	if (search_index) {
+		g_mutex_unlock (&def_search_index_lock);
+		return search_index;
+	}
+
+	search_index = g_object_new (E_TYPE_MAIL_SEARCH_INDEX, NULL);
+	search_index->priv->folder_cache = g_object_ref (folder_cache);
+
+	search_index->priv->folder_changed_handler_id = g_signal_connect (
+		folder_cache, "folder-changed",
+		G_CALLBACK (search_index_folder_changed_cb), search_index);
+
+	search_index->priv->folder_deleted_handler_id = g_signal_connect (
+		folder_cache, "folder-deleted",
+		G_CALLBACK (search_index_folder_deleted_cb), search_index);
+
+	search_index->priv->folder_renamed_handler_id = g_signal_connect (
+		folder_cache, "folder-renamed",
+		G_CALLBACK (search_index_folder_renamed_cb), search_index);
+
+	g_weak_ref_set (&def_search_index, search_index);
+
+	g_mutex_unlock (&def_search_index_lock);
+
+	return search_index;
+}
+
+/**
+ * e_mail_search_index_folder_may_match:
+ * @search_index: an #EMailSearchIndex
+ * @folder: a #CamelFolder
+ * @expression: a search expression
+ *
+ * Checks whether the @folder can contain any message matching
+ * the @expression. It returns %FALSE only when it's certain that
+ * no message matches, which considers only the header searches
+ * on Subject, From, To and Cc. When the @folder had not been indexed
+ * yet, or it changed since then, it returns %TRUE and indexes
+ * the @folder in a dedicated thread. Any later change of a folder
+ * for which it returned %FALSE is reported by the
+ * #EMailSearchIndex::excluded-folder-changed signal.
+ *
+ * This can be called from any thread.
+ *
+ * Returns: whether any message of the @folder can match the @expression
+ *
+ * Since: 3.32
+ **/
+gboolean
+e_mail_search_index_folder_may_match (EMailSearchIndex *search_index,
+				      CamelFolder *folder,
+				      const gchar *expression)
+{
+	FolderIndex *fi;
+	gchar *key;
+	gboolean may_match = TRUE;
+
+	g_return_val_if_fail (E_IS_MAIL_SEARCH_INDEX (search_index), TRUE);
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), TRUE);
+
+	if (!expression || !*expression || !camel_folder_get_folder_summary (folder))
+		return TRUE;
+
+	key = search_index_build_key (camel_folder_get_parent_store (folder), camel_folder_get_full_name (folder));
+
+	g_mutex_lock (&search_index->priv->lock);
+
+	if (g_strcmp0 (expression, search_index->priv->expression) != 0) {
+		const gchar *ptr = expression;
+
+		query_term_free (search_index->priv->query);
+		g_free (search_index->priv->expression);
+
+		search_index->priv->expression = g_strdup (expression);
+		search_index->priv->query = search_index_parse_term (&ptr);
+	}
+
+	fi = search_index_get_folder (search_index, key);
+
+	search_index_watch_folder (search_index, fi, folder);
+
+	if (!fi->verified || !fi->bloom)
+		search_index_queue_update (search_index, fi, folder);
+	else if (search_index->priv->query)
+		may_match = search_index_term_may_match (fi, search_index->priv->query);
+
+	if (!may_match)
+		fi->excluded = TRUE;
+
+	g_mutex_unlock (&search_index->priv->lock);
+
+	g_free (key);
+
+	return may_match;
+}
@@ -0,0 +1,74 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef E_MAIL_SEARCH_INDEX_H
+#define E_MAIL_SEARCH_INDEX_H
+
+#include <glib.h>
+
+#include <camel/camel.h>
+#include <libemail-engine/libemail-engine.h>
+
+/* Standard GObject macros */
+#define E_TYPE_MAIL_SEARCH_INDEX \
+	(e_mail_search_index_get_type ())
+#define E_MAIL_SEARCH_INDEX(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST \
+	((obj), E_TYPE_MAIL_SEARCH_INDEX, EMailSearchIndex))
+#define E_MAIL_SEARCH_INDEX_CLASS(cls) \
+	(G_TYPE_CHECK_CLASS_CAST \
+	((cls), E_TYPE_MAIL_SEARCH_INDEX, EMailSearchIndexClass))
+#define E_IS_MAIL_SEARCH_INDEX(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE \
+	((obj), E_TYPE_MAIL_SEARCH_INDEX))
+#define E_IS_MAIL_SEARCH_INDEX_CLASS(cls) \
+	(G_TYPE_CHECK_CLASS_TYPE \
+	((cls), E_TYPE_MAIL_SEARCH_INDEX))
+#define E_MAIL_SEARCH_INDEX_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS \
+	((obj), E_TYPE_MAIL_SEARCH_INDEX, EMailSearchIndexClass))
+
+G_BEGIN_DECLS
+
+typedef struct _EMailSearchIndex EMailSearchIndex;
+typedef struct _EMailSearchIndexClass EMailSearchIndexClass;
+typedef struct _EMailSearchIndexPrivate EMailSearchIndexPrivate;
+
+/**
+ * EMailSearchIndex:
+ *
+ * Contains only private data that should be read and manipulated using
+ * the functions below.
+ **/
+struct _EMailSearchIndex {
+	GObject parent;
+	EMailSearchIndexPrivate *priv;
+};
+
+struct _EMailSearchIndexClass {
+	GObjectClass parent_class;
+};
+
+GType		e_mail_search_index_get_type	(void) G_GNUC_CONST;
+EMailSearchIndex *
+		e_mail_search_index_ref_default	(MailFolderCache *folder_cache);
+gboolean	e_mail_search_index_folder_may_match
+						(EMailSearchIndex *search_index,
+						 CamelFolder *folder,
+						 const gchar *expression);
+
+G_END_DECLS
+
+#endif /* E_MAIL_SEARCH_INDEX_H */
@@ -1507,9 +1507,13 @@ em_folder_properties_autoarchive_set (EMailBackend *mail_backend,
 	}
 
 	/* To avoid overwriting unchanged values or adding default values. */
-	if (g_strcmp0 (stored_value, value) != 0)
+	if (g_strcmp0 (stored_value, value) != 0) {
 		e_mail_properties_set_for_folder_uri (properties, folder_uri, "autoarchive", value);
 
+		/* Search the whole folder with the new settings */
+		e_mail_properties_set_for_folder_uri (properties, folder_uri, "autoarchive-watermark", NULL);
+	}
+
 	e_named_parameters_free (parameters);
 	g_free (stored_value);
 	g_free (value);
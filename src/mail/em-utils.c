@@ -1769,6 +1769,44 @@ em_utils_get_archive_folder_uri_from_folder (CamelFolder *folder,
 	return archive_folder;
 }
 
+/* Autoarchive remembers the time it processed the folder up to, the watermark,
+ * and the next run searches only for messages sent since then. The folder is
+ * not searched again until the watermark would move by at least an hour.
+ * Once in a while the whole folder is searched, to catch also old messages
+ * added to the folder after the watermark had passed them. */
+#define AUTOARCHIVE_MIN_INTERVAL (60 * 60)
+#define AUTOARCHIVE_FULL_SEARCH_INTERVAL (7 * 24 * 60 * 60)
+
+static gint64
+em_utils_autoarchive_get_time_property (EMailProperties *properties,
+					const gchar *folder_uri,
+					const gchar *key)
+{
+	gchar *stored;
+	gint64 value = 0;
+
+	stored = e_mail_properties_get_for_folder_uri (properties, folder_uri, key);
+	if (stored && *stored)
+		value = g_ascii_strtoll (stored, NULL, 10);
+
+	g_free (stored);
+
+	return value;
+}
+
+static void
+em_utils_autoarchive_set_time_property (EMailProperties *properties,
+					const gchar *folder_uri,
+					const gchar *key,
+					gint64 value)
+{
+	gchar *stored;
+
+	stored = g_strdup_printf ("%" G_GINT64_FORMAT, value);
+	e_mail_properties_set_for_folder_uri (properties, folder_uri, key, stored);
+	g_free (stored);
+}
+
 gboolean
 em_utils_process_autoarchive_sync (EMailBackend *mail_backend,
 				   CamelFolder *folder,
@@ -1782,6 +1820,9 @@ em_utils_process_autoarchive_sync (EMailBackend *mail_backend,
 	EAutoArchiveUnit aa_unit;
 	gchar *aa_custom_target_folder_uri = NULL;
 	GDateTime *now_time, *use_time;
+	EMailProperties *properties;
+	gint64 use_time_unix, watermark, last_full_search, now_unix;
+	gboolean full_search;
 	gchar *search_sexp;
 	GPtrArray *uids;
 	gboolean success = TRUE;
@@ -1821,20 +1862,46 @@ em_utils_process_autoarchive_sync (EMailBackend *mail_backend,
 			return TRUE;
 	}
 
+	now_unix = g_date_time_to_unix (now_time);
+	use_time_unix = g_date_time_to_unix (use_time);
+
 	g_date_time_unref (now_time);
+	g_date_time_unref (use_time);
+
+	properties = e_mail_backend_get_mail_properties (mail_backend);
+
+	watermark = em_utils_autoarchive_get_time_property (properties, folder_uri, "autoarchive-watermark");
+	last_full_search = em_utils_autoarchive_get_time_property (properties, folder_uri, "autoarchive-full-search");
+
+	full_search = watermark <= 0 || watermark > use_time_unix ||
+		last_full_search <= 0 || last_full_search > now_unix ||
+		now_unix - last_full_search >= AUTOARCHIVE_FULL_SEARCH_INTERVAL;
+
+	if (!full_search && use_time_unix - watermark < AUTOARCHIVE_MIN_INTERVAL) {
+		g_free (aa_custom_target_folder_uri);
+		return TRUE;
+	}
+
+	if (full_search) {
+		search_sexp = g_strdup_printf ("(match-all (and "
+			"(not (system-flag \"junk\")) "
+			"(not (system-flag \"deleted\")) "
+			"(< (get-sent-date) %" G_GINT64_FORMAT ")"
+			"))", use_time_unix);
+	} else {
+		search_sexp = g_strdup_printf ("(match-all (and "
+			"(not (system-flag \"junk\")) "
+			"(not (system-flag \"deleted\")) "
+			"(> (get-sent-date) %" G_GINT64_FORMAT ")"
+			"(< (get-sent-date) %" G_GINT64_FORMAT ")"
+			"))", watermark - 1, use_time_unix);
+	}
 
-	search_sexp = g_strdup_printf ("(match-all (and "
-		"(not (system-flag \"junk\")) "
-		"(not (system-flag \"deleted\")) "
-		"(< (get-sent-date) %" G_GINT64_FORMAT ")"
-		"))", g_date_time_to_unix (use_time));
 	uids = camel_folder_search_by_expression (folder, search_sexp, cancellable, error);
 
 	if (!uids) {
 		success = FALSE;
 	} else if (uids->len > 0) {
-		gint ii;
-
 		if (aa_config == E_AUTO_ARCHIVE_CONFIG_MOVE_TO_ARCHIVE ||
 		    aa_config == E_AUTO_ARCHIVE_CONFIG_MOVE_TO_CUSTOM) {
 			CamelFolder *dest;
@@ -1855,11 +1922,9 @@ em_utils_process_autoarchive_sync (EMailBackend *mail_backend,
 					folder, uids, dest, TRUE, NULL,
 					cancellable, error)) {
 					/* make sure all deleted messages are marked as seen */
-					for (ii = 0; ii < uids->len; ii++) {
-						camel_folder_set_message_flags (
-							folder, uids->pdata[ii],
-							CAMEL_MESSAGE_SEEN, CAMEL_MESSAGE_SEEN);
-					}
+					e_mail_folder_set_messages_flags (
+						folder, uids,
+						CAMEL_MESSAGE_SEEN, CAMEL_MESSAGE_SEEN, NULL);
 				} else {
 					success = FALSE;
 				}
@@ -1877,11 +1942,9 @@ em_utils_process_autoarchive_sync (EMailBackend *mail_backend,
 
 			camel_operation_push_message (cancellable, "%s", _("Deleting old messages"));
 
-			for (ii = 0; ii < uids->len; ii++) {
-				camel_folder_set_message_flags (
-					folder, uids->pdata[ii],
-					CAMEL_MESSAGE_DELETED | CAMEL_MESSAGE_SEEN, CAMEL_MESSAGE_DELETED | CAMEL_MESSAGE_SEEN);
-			}
+			e_mail_folder_set_messages_flags (
+				folder, uids,
+				CAMEL_MESSAGE_DELETED | CAMEL_MESSAGE_SEEN, CAMEL_MESSAGE_DELETED | CAMEL_MESSAGE_SEEN, NULL);
 
 			camel_operation_pop_message (cancellable);
 
@@ -1892,9 +1955,15 @@ em_utils_process_autoarchive_sync (EMailBackend *mail_backend,
 	if (uids)
 		camel_folder_search_free (folder, uids);
 
+	if (success) {
+		em_utils_autoarchive_set_time_property (properties, folder_uri, "autoarchive-watermark", use_time_unix);
+
+		if (full_search)
+			em_utils_autoarchive_set_time_property (properties, folder_uri, "autoarchive-full-search", now_unix);
+	}
+
 	g_free (search_sexp);
 	g_free (aa_custom_target_folder_uri);
-	g_date_time_unref (use_time);
 
 	return success;
 }
@@ -1322,6 +1322,76 @@ main_op_cancelled_cb (GCancellable *main_op,
 	g_cancellable_cancel (refresh_op);
 }
 
+struct _autoarchive_folders_msg {
+	MailMsg base;
+
+	EMailBackend *mail_backend;
+	GPtrArray *folders;
+};
+
+static gchar *
+autoarchive_folders_desc (struct _autoarchive_folders_msg *m)
+{
+	return g_strdup (_("Archiving old messages"));
+}
+
+static void
+autoarchive_folders_exec (struct _autoarchive_folders_msg *m,
+                          GCancellable *cancellable,
+                          GError **error)
+{
+	guint ii;
+
+	for (ii = 0; ii < m->folders->len && !g_cancellable_is_cancelled (cancellable); ii++) {
+		CamelFolder *folder = m->folders->pdata[ii];
+		gchar *folder_uri;
+		GError *local_error = NULL;
+
+		folder_uri = e_mail_folder_uri_from_folder (folder);
+
+		if (!em_utils_process_autoarchive_sync (m->mail_backend, folder, folder_uri, cancellable, &local_error) &&
+		    local_error && !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			report_error_to_ui (
+				CAMEL_SERVICE (camel_folder_get_parent_store (folder)),
+				camel_folder_get_full_name (folder), local_error, NULL);
+		}
+
+		g_clear_error (&local_error);
+		g_free (folder_uri);
+	}
+}
+
+static void
+autoarchive_folders_free (struct _autoarchive_folders_msg *m)
+{
+	g_ptr_array_unref (m->folders);
+	g_object_unref (m->mail_backend);
+}
+
+static MailMsgInfo autoarchive_folders_info = {
+	sizeof (struct _autoarchive_folders_msg),
+	(MailMsgDescFunc) autoarchive_folders_desc,
+	(MailMsgExecFunc) autoarchive_folders_exec,
+	(MailMsgDoneFunc) NULL,
+	(MailMsgFreeFunc) autoarchive_folders_free
+};
+
+static void
+autoarchive_folders_push (EMailBackend *mail_backend,
+                          GPtrArray *folders)
+{
+	struct _autoarchive_folders_msg *m;
+
+	m = mail_msg_new (&autoarchive_folders_info);
+	m->mail_backend = g_object_ref (mail_backend);
+	m->folders = g_ptr_array_ref (folders);
+
+	/* Let other operations go first */
+	m->base.priority = -1;
+
+	mail_msg_unordered_push (m);
+}
+
 struct _refresh_folders_msg {
 	MailMsg base;
 
@@ -1349,6 +1419,7 @@ refresh_folders_exec (struct _refresh_folders_msg *m,
 	gboolean success;
 	gboolean delete_junk = FALSE, expunge = FALSE;
 	GHashTable *known_errors;
+	GPtrArray *autoarchive_folders;
 	EMailBackend *mail_backend;
 	GError *local_error = NULL;
 	gulong handler_id = 0;
@@ -1381,6 +1452,7 @@ refresh_folders_exec (struct _refresh_folders_msg *m,
 	mail_backend = E_MAIL_BACKEND (e_shell_get_backend_by_name (e_shell_get_default (), "mail"));
 
 	known_errors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	autoarchive_folders = g_ptr_array_new_with_free_func (g_object_unref);
 
 	for (i = 0; i < m->folders->len; i++) {
 		folder = e_mail_session_uri_to_folder_sync (
@@ -1390,9 +1462,8 @@ refresh_folders_exec (struct _refresh_folders_msg *m,
 		if (folder && camel_folder_synchronize_sync (folder, expunge, cancellable, &local_error))
 			camel_folder_refresh_info_sync (folder, cancellable, &local_error);
 
-		if (folder && !local_error && mail_backend) {
-			em_utils_process_autoarchive_sync (mail_backend, folder, m->folders->pdata[i], cancellable, &local_error);
-		}
+		if (folder && !local_error && mail_backend)
+			g_ptr_array_add (autoarchive_folders, g_object_ref (folder));
 
 		if (local_error != NULL) {
 			const gchar *error_message = local_error->message ? local_error->message : _("Unknown error");
@@ -1439,6 +1510,14 @@ refresh_folders_exec (struct _refresh_folders_msg *m,
 	camel_operation_pop_message (m->info->cancellable);
 	g_hash_table_destroy (known_errors);
 
+	/* Do not make the user wait for the autoarchive, run it separately */
+	if (autoarchive_folders->len > 0 &&
+	    !g_cancellable_is_cancelled (m->info->cancellable) &&
+	    !g_cancellable_is_cancelled (cancellable))
+		autoarchive_folders_push (mail_backend, autoarchive_folders);
+
+	g_ptr_array_unref (autoarchive_folders);
+
 exit:
 	if (handler_id > 0)
 		g_signal_handler_disconnect (m->info->cancellable, handler_id);
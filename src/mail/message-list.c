@@ -165,7 +165,7 @@ struct _RegenData {
 
 	gint last_row; /* last selected (cursor) row */
 
-	xmlDoc *expand_state; /* expanded state to be restored */
+	GBytes *expand_state; /* expanded state to be restored */
 
 	/* These may be set during a regen operation.  Use the
 	 * select_lock to ensure consistency and thread-safety.
@@ -554,7 +554,7 @@ regen_data_unref (RegenData *regen_data)
 		g_clear_object (&regen_data->folder);
 
 		if (regen_data->expand_state != NULL)
-			xmlFreeDoc (regen_data->expand_state);
+			g_bytes_unref (regen_data->expand_state);
 
 		g_mutex_clear (&regen_data->select_lock);
 		g_free (regen_data->select_uid);
@@ -1499,21 +1499,15 @@ message_list_copy (MessageList *message_list,
 	if (uids->len > 0) {
 		if (cut) {
 			CamelFolder *folder;
-			gint i;
 
 			folder = message_list_ref_folder (message_list);
 
-			camel_folder_freeze (folder);
-
-			for (i = 0; i < uids->len; i++)
-				camel_folder_set_message_flags (
-					folder, uids->pdata[i],
-					CAMEL_MESSAGE_SEEN |
-					CAMEL_MESSAGE_DELETED,
-					CAMEL_MESSAGE_SEEN |
-					CAMEL_MESSAGE_DELETED);
-
-			camel_folder_thaw (folder);
+			e_mail_folder_set_messages_flags (
+				folder, uids,
+				CAMEL_MESSAGE_SEEN |
+				CAMEL_MESSAGE_DELETED,
+				CAMEL_MESSAGE_SEEN |
+				CAMEL_MESSAGE_DELETED, NULL);
 
 			g_object_unref (folder);
 		}
@@ -2403,7 +2397,7 @@ save_tree_state (MessageList *message_list,
 static void
 load_tree_state (MessageList *message_list,
                  CamelFolder *folder,
-                 xmlDoc *expand_state)
+                 GBytes *expand_state)
 {
 	ETreeTableAdapter *adapter;
 
@@ -2413,7 +2407,7 @@ load_tree_state (MessageList *message_list,
 	adapter = e_tree_get_table_adapter (E_TREE (message_list));
 
 	if (expand_state != NULL) {
-		e_tree_table_adapter_load_expanded_state_xml (
+		e_tree_table_adapter_load_expanded_state_bytes (
 			adapter, expand_state);
 	} else {
 		gchar *filename;
@@ -6430,7 +6424,7 @@ message_list_regen_done_cb (GObject *source_object,
 			if (regen_data->expand_state != NULL) {
 				/* Load state from disk rather than use
 				 * the memory data when changing folders. */
-				xmlFreeDoc (regen_data->expand_state);
+				g_bytes_unref (regen_data->expand_state);
 				regen_data->expand_state = NULL;
 			}
 		}
@@ -6764,12 +6758,12 @@ message_list_regen_idle_cb (gpointer user_data)
 			/* Remember the expand state and restore it
 			 * after regen. */
 			regen_data->expand_state =
-				e_tree_table_adapter_save_expanded_state_xml (
+				e_tree_table_adapter_save_expanded_state_bytes (
 				adapter);
 		}
 	} else {
 		/* Remember the expand state and restore it after regen. */
-		regen_data->expand_state = e_tree_table_adapter_save_expanded_state_xml (adapter);
+		regen_data->expand_state = e_tree_table_adapter_save_expanded_state_bytes (adapter);
 	}
 
 	message_list->priv->regen_idle_id = 0;
@@ -6982,3 +6976,73 @@ message_list_contains_uid (MessageList *message_list,
 
 	return g_hash_table_lookup (message_list->uid_nodemap, uid) != NULL;
 }
+
+/**
+ * message_list_get_uids_around:
+ * @message_list: a #MessageList
+ * @uid: UID of a message shown in the list
+ * @count: how many rows to take in each direction
+ *
+ * Returns UIDs of the messages shown up to @count rows after and before
+ * the message @uid, the nearest first, followed by the next unread message,
+ * when it is not one of them.  These are the messages the user will most
+ * likely move to next.
+ *
+ * Returns: (transfer full): a #GPtrArray of UIDs; free it with
+ *    g_ptr_array_unref() when done with it
+ *
+ * Since: 3.32
+ **/
+GPtrArray *
+message_list_get_uids_around (MessageList *message_list,
+                              const gchar *uid,
+                              guint count)
+{
+	ETreeTableAdapter *etta;
+	GPtrArray *uids;
+	GNode *node;
+	gint row, n_rows;
+	guint ii;
+
+	g_return_val_if_fail (IS_MESSAGE_LIST (message_list), NULL);
+
+	uids = g_ptr_array_new_with_free_func ((GDestroyNotify) camel_pstring_free);
+
+	if (!uid || !*uid || !message_list->priv->folder)
+		return uids;
+
+	node = g_hash_table_lookup (message_list->uid_nodemap, uid);
+	if (!node)
+		return uids;
+
+	etta = e_tree_get_table_adapter (E_TREE (message_list));
+	row = e_tree_table_adapter_row_of_node (etta, node);
+	if (row == -1)
+		return uids;
+
+	n_rows = e_table_model_row_count (E_TABLE_MODEL (etta));
+
+	for (ii = 1; ii <= count; ii++) {
+		if (row + (gint) ii < n_rows) {
+			node = e_tree_table_adapter_node_at_row (etta, row + (gint) ii);
+			if (node)
+				g_ptr_array_add (uids, (gpointer) camel_pstring_strdup (get_message_uid (message_list, node)));
+		}
+
+		if (row - (gint) ii >= 0) {
+			node = e_tree_table_adapter_node_at_row (etta, row - (gint) ii);
+			if (node)
+				g_ptr_array_add (uids, (gpointer) camel_pstring_strdup (get_message_uid (message_list, node)));
+		}
+	}
+
+	if (row + (gint) count + 1 < n_rows) {
+		node = ml_search_forward (
+			message_list, row + count + 1, n_rows - 1,
+			0, CAMEL_MESSAGE_SEEN, FALSE, FALSE);
+		if (node)
+			g_ptr_array_add (uids, (gpointer) camel_pstring_strdup (get_message_uid (message_list, node)));
+	}
+
+	return uids;
+}
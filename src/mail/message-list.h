@@ -230,6 +230,9 @@ void		message_list_sort_uids		(MessageList *message_list,
 						 GPtrArray *uids);
 gboolean	message_list_contains_uid	(MessageList *message_list,
 						 const gchar *uid);
+GPtrArray *	message_list_get_uids_around	(MessageList *message_list,
+						 const gchar *uid,
+						 guint count);
 
 G_END_DECLS
 
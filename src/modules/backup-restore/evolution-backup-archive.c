@@ -0,0 +1,1125 @@
+/*
+ * evolution-backup-archive.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Writes and reads the back up archives, which are tar files compressed
+ * with gzip or xz, the same as 'tar --dereference' with 'gzip' or 'xz'
+ * would create them, thus any tar can extract them.
+ *
+ * The gzip compression is done in-process, in parallel: the archive is cut
+ * into chunks, each compressed into its own gzip member, and the members
+ * are written in order. A gzip reader decompresses concatenated members
+ * as one stream. There is no xz library among the dependencies, thus the
+ * xz compression runs in the 'xz' binary, using its own threads. */
+
+#include "evolution-config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "evolution-backup-archive.h"
+
+#define TAR_BLOCK_SIZE 512
+#define TAR_RECORD_SIZE (20 * TAR_BLOCK_SIZE)
+
+/* Size of the chunks compressed independently */
+#define CHUNK_SIZE (1024 * 1024)
+
+#define READ_BUFFER_SIZE (64 * 1024)
+
+typedef struct _TarHeader {
+	gchar name[100];
+	gchar mode[8];
+	gchar uid[8];
+	gchar gid[8];
+	gchar size[12];
+	gchar mtime[12];
+	gchar chksum[8];
+	gchar typeflag;
+	gchar linkname[100];
+	gchar magic[6];
+	gchar version[2];
+	gchar uname[32];
+	gchar gname[32];
+	gchar devmajor[8];
+	gchar devminor[8];
+	gchar prefix[155];
+	gchar padding[12];
+} TarHeader;
+
+G_STATIC_ASSERT (sizeof (TarHeader) == TAR_BLOCK_SIZE);
+
+typedef struct _ArchiveChunk {
+	GByteArray *data; /* uncompressed, then compressed */
+	GError *error;
+	gboolean done;
+} ArchiveChunk;
+
+typedef struct _ArchiveWriter {
+	GOutputStream *output;
+	GThreadPool *compress_pool; /* NULL, when compressed by an external process */
+	guint max_chunks;
+
+	GMutex lock;
+	GCond cond;
+	GQueue chunks; /* ArchiveChunk *, in the archive order */
+
+	GByteArray *pending;
+	guint8 *read_buffer;
+	guint64 archive_size;
+
+	guint64 bytes_done;
+	guint64 bytes_total;
+	EvolutionBackupProgressFunc progress_func;
+	gpointer progress_data;
+
+	GCancellable *cancellable;
+} ArchiveWriter;
+
+typedef struct _ArchiveReader {
+	GInputStream *input;
+	GConverter *decompressor; /* NULL, when decompressed by an external process */
+	guint8 *buffer;
+	gsize buffer_start;
+	gsize buffer_len;
+	gboolean input_eof;
+
+	GCancellable *cancellable;
+} ArchiveReader;
+
+typedef gboolean (* ArchiveVisitFunc) (ArchiveWriter *writer,
+				       const gchar *filename,
+				       const gchar *name,
+				       GStatBuf *st,
+				       GError **error);
+
+static gboolean
+archive_filename_is_xz (const gchar *filename)
+{
+	gsize len = strlen (filename);
+
+	return len >= 3 && g_ascii_strcasecmp (filename + len - 3, ".xz") == 0;
+}
+
+static void
+archive_chunk_free (gpointer ptr)
+{
+	ArchiveChunk *chunk = ptr;
+
+	if (chunk) {
+		g_byte_array_unref (chunk->data);
+		g_clear_error (&chunk->error);
+		g_slice_free (ArchiveChunk, chunk);
+	}
+}
+
+static void
+archive_compress_chunk_thread (gpointer data,
+			       gpointer user_data)
+{
+	ArchiveChunk *chunk = data;
+	ArchiveWriter *writer = user_data;
+	GConverter *compressor;
+	GConverterResult res = G_CONVERTER_CONVERTED;
+	GByteArray *compressed;
+	const guint8 *input = chunk->data->data;
+	gsize input_len = chunk->data->len;
+	gsize output_len = 0;
+	GError *local_error = NULL;
+
+	compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+
+	compressed = g_byte_array_new ();
+	g_byte_array_set_size (compressed, input_len / 2 + 4096);
+
+	while (res != G_CONVERTER_FINISHED) {
+		gsize bytes_read = 0, bytes_written = 0;
+
+		if (compressed->len - output_len < 4096)
+			g_byte_array_set_size (compressed, compressed->len * 2);
+
+		res = g_converter_convert (
+			compressor, input, input_len,
+			compressed->data + output_len, compressed->len - output_len,
+			G_CONVERTER_INPUT_AT_END, &bytes_read, &bytes_written, &local_error);
+
+		if (res == G_CONVERTER_ERROR)
+			break;
+
+		input += bytes_read;
+		input_len -= bytes_read;
+		output_len += bytes_written;
+	}
+
+	g_byte_array_set_size (compressed, output_len);
+	g_object_unref (compressor);
+
+	g_mutex_lock (&writer->lock);
+	g_byte_array_unref (chunk->data);
+	chunk->data = compressed;
+	chunk->error = local_error;
+	chunk->done = TRUE;
+	g_cond_broadcast (&writer->cond);
+	g_mutex_unlock (&writer->lock);
+}
+
+/* Writes the compressed chunks in order, waiting for them
+ * until at most @max_queued chunks are left in the queue. */
+static gboolean
+archive_writer_drain (ArchiveWriter *writer,
+		      guint max_queued,
+		      GError **error)
+{
+	gboolean success = TRUE;
+
+	g_mutex_lock (&writer->lock);
+
+	while (success && !g_queue_is_empty (&writer->chunks)) {
+		ArchiveChunk *chunk = g_queue_peek_head (&writer->chunks);
+
+		if (!chunk->done) {
+			if (g_queue_get_length (&writer->chunks) <= max_queued)
+				break;
+
+			g_cond_wait (&writer->cond, &writer->lock);
+			continue;
+		}
+
+		g_queue_pop_head (&writer->chunks);
+		g_mutex_unlock (&writer->lock);
+
+		if (chunk->error) {
+			g_propagate_error (error, chunk->error);
+			chunk->error = NULL;
+			success = FALSE;
+		} else {
+			success = g_output_stream_write_all (
+				writer->output, chunk->data->data, chunk->data->len,
+				NULL, writer->cancellable, error);
+		}
+
+		archive_chunk_free (chunk);
+
+		g_mutex_lock (&writer->lock);
+	}
+
+	g_mutex_unlock (&writer->lock);
+
+	return success;
+}
+
+static gboolean
+archive_writer_flush_pending (ArchiveWriter *writer,
+			      GError **error)
+{
+	ArchiveChunk *chunk;
+
+	if (!writer->pending->len)
+		return TRUE;
+
+	if (!writer->compress_pool) {
+		gboolean success;
+
+		success = g_output_stream_write_all (
+			writer->output, writer->pending->data, writer->pending->len,
+			NULL, writer->cancellable, error);
+
+		g_byte_array_set_size (writer->pending, 0);
+
+		return success;
+	}
+
+	chunk = g_slice_new0 (ArchiveChunk);
+	chunk->data = writer->pending;
+
+	writer->pending = g_byte_array_sized_new (CHUNK_SIZE);
+
+	g_mutex_lock (&writer->lock);
+	g_queue_push_tail (&writer->chunks, chunk);
+	g_mutex_unlock (&writer->lock);
+
+	g_thread_pool_push (writer->compress_pool, chunk, NULL);
+
+	return archive_writer_drain (writer, writer->max_chunks, error);
+}
+
+static gboolean
+archive_writer_write (ArchiveWriter *writer,
+		      gconstpointer data,
+		      gsize len,
+		      GError **error)
+{
+	const guint8 *bytes = data;
+
+	if (g_cancellable_set_error_if_cancelled (writer->cancellable, error))
+		return FALSE;
+
+	writer->archive_size += len;
+
+	while (len > 0) {
+		gsize n = MIN (len, CHUNK_SIZE - writer->pending->len);
+
+		g_byte_array_append (writer->pending, bytes, n);
+		bytes += n;
+		len -= n;
+
+		if (writer->pending->len >= CHUNK_SIZE &&
+		    !archive_writer_flush_pending (writer, error))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+archive_writer_write_zeros (ArchiveWriter *writer,
+			    gsize len,
+			    GError **error)
+{
+	static const guint8 zeros[TAR_BLOCK_SIZE] = { 0 };
+
+	while (len > 0) {
+		gsize n = MIN (len, TAR_BLOCK_SIZE);
+
+		if (!archive_writer_write (writer, zeros, n, error))
+			return FALSE;
+
+		len -= n;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+archive_writer_pad_block (ArchiveWriter *writer,
+			  GError **error)
+{
+	return archive_writer_write_zeros (writer, (TAR_BLOCK_SIZE - writer->archive_size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE, error);
+}
+
+static void
+archive_writer_progress (ArchiveWriter *writer,
+			 gsize n_bytes)
+{
+	writer->bytes_done += n_bytes;
+
+	if (writer->progress_func)
+		writer->progress_func (writer->bytes_done, writer->bytes_total, writer->progress_data);
+}
+
+/* Values which do not fit into the octal digits use the GNU base-256 encoding */
+static void
+tar_set_number (gchar *field,
+		gsize field_len,
+		guint64 value)
+{
+	if (value >> (3 * (field_len - 1))) {
+		gsize ii;
+
+		for (ii = field_len - 1; ii > 0; ii--) {
+			field[ii] = value & 0xFF;
+			value >>= 8;
+		}
+
+		field[0] = (gchar) 0x80;
+	} else {
+		g_snprintf (field, field_len, "%0*" G_GINT64_MODIFIER "o", (gint) field_len - 1, value);
+	}
+}
+
+static guint64
+tar_get_number (const gchar *field,
+		gsize field_len)
+{
+	guint64 value = 0;
+	gsize ii;
+
+	if (((guchar) field[0]) & 0x80) {
+		for (ii = 1; ii < field_len; ii++)
+			value = (value << 8) | (guchar) field[ii];
+
+		return value;
+	}
+
+	for (ii = 0; ii < field_len && field[ii] == ' '; ii++) {
+		/* skip leading spaces */
+	}
+
+	for (; ii < field_len && field[ii] >= '0' && field[ii] <= '7'; ii++)
+		value = (value * 8) + (field[ii] - '0');
+
+	return value;
+}
+
+static void
+tar_header_set_checksum (TarHeader *header)
+{
+	const guchar *bytes = (const guchar *) header;
+	guint sum = 0;
+	gsize ii;
+
+	memset (header->chksum, ' ', sizeof (header->chksum));
+
+	for (ii = 0; ii < sizeof (TarHeader); ii++)
+		sum += bytes[ii];
+
+	/* Six digits, NUL and the space stays */
+	g_snprintf (header->chksum, 7, "%06o", sum);
+}
+
+static gboolean
+tar_header_check_checksum (const TarHeader *header)
+{
+	const guchar *bytes = (const guchar *) header;
+	const gchar *chksum_start = header->chksum;
+	const gchar *chksum_end = chksum_start + sizeof (header->chksum);
+	guint64 expected;
+	guint sum = 0;
+	gint signed_sum = 0;
+	gsize ii;
+
+	expected = tar_get_number (header->chksum, sizeof (header->chksum));
+
+	for (ii = 0; ii < sizeof (TarHeader); ii++) {
+		const gchar *pos = (const gchar *) bytes + ii;
+
+		if (pos >= chksum_start && pos < chksum_end) {
+			sum += ' ';
+			signed_sum += ' ';
+		} else {
+			sum += bytes[ii];
+			signed_sum += (gint) ((const gchar *) bytes)[ii];
+		}
+	}
+
+	/* Some old tars summed signed chars */
+	return expected == sum || expected == (guint64) signed_sum;
+}
+
+static gboolean
+tar_block_is_zero (const TarHeader *header)
+{
+	const guchar *bytes = (const guchar *) header;
+	gsize ii;
+
+	for (ii = 0; ii < sizeof (TarHeader); ii++) {
+		if (bytes[ii])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+archive_writer_add_header (ArchiveWriter *writer,
+			   const gchar *name,
+			   gchar typeflag,
+			   const GStatBuf *st,
+			   guint64 size,
+			   GError **error)
+{
+	TarHeader header;
+	gsize name_len = strlen (name);
+
+	/* GNU extension for long names: the name is the content of a preceding entry */
+	if (name_len >= sizeof (header.name)) {
+		memset (&header, 0, sizeof (TarHeader));
+		strcpy (header.name, "././@LongLink");
+		tar_set_number (header.mode, sizeof (header.mode), 0644);
+		tar_set_number (header.uid, sizeof (header.uid), 0);
+		tar_set_number (header.gid, sizeof (header.gid), 0);
+		tar_set_number (header.size, sizeof (header.size), name_len + 1);
+		tar_set_number (header.mtime, sizeof (header.mtime), 0);
+		header.typeflag = 'L';
+		memcpy (header.magic, "ustar ", sizeof (header.magic));
+		memcpy (header.version, " ", sizeof (header.version));
+		tar_header_set_checksum (&header);
+
+		if (!archive_writer_write (writer, &header, sizeof (TarHeader), error) ||
+		    !archive_writer_write (writer, name, name_len + 1, error) ||
+		    !archive_writer_pad_block (writer, error))
+			return FALSE;
+	}
+
+	memset (&header, 0, sizeof (TarHeader));
+	memcpy (header.name, name, MIN (name_len, sizeof (header.name)));
+	tar_set_number (header.mode, sizeof (header.mode), st->st_mode & 07777);
+	tar_set_number (header.uid, sizeof (header.uid), st->st_uid);
+	tar_set_number (header.gid, sizeof (header.gid), st->st_gid);
+	tar_set_number (header.size, sizeof (header.size), size);
+	tar_set_number (header.mtime, sizeof (header.mtime), st->st_mtime > 0 ? st->st_mtime : 0);
+	header.typeflag = typeflag;
+	memcpy (header.magic, "ustar ", sizeof (header.magic));
+	memcpy (header.version, " ", sizeof (header.version));
+	tar_header_set_checksum (&header);
+
+	return archive_writer_write (writer, &header, sizeof (TarHeader), error);
+}
+
+static gboolean
+archive_writer_add_file (ArchiveWriter *writer,
+			 const gchar *filename,
+			 const gchar *name,
+			 GStatBuf *st,
+			 GError **error)
+{
+	GFile *file;
+	GFileInputStream *input;
+	guint64 remaining;
+	GError *local_error = NULL;
+
+	file = g_file_new_for_path (filename);
+	input = g_file_read (file, writer->cancellable, &local_error);
+	g_object_unref (file);
+
+	if (!input) {
+		if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_propagate_error (error, local_error);
+			return FALSE;
+		}
+
+		/* Skip what cannot be read, like tar does */
+		g_warning ("%s: Cannot read '%s': %s", G_STRFUNC, filename, local_error ? local_error->message : "Unknown error");
+		g_clear_error (&local_error);
+
+		return TRUE;
+	}
+
+	if (!archive_writer_add_header (writer, name, '0', st, st->st_size, error)) {
+		g_object_unref (input);
+		return FALSE;
+	}
+
+	remaining = st->st_size;
+
+	while (remaining > 0) {
+		gssize n_read;
+
+		n_read = g_input_stream_read (
+			G_INPUT_STREAM (input), writer->read_buffer,
+			MIN (remaining, READ_BUFFER_SIZE),
+			writer->cancellable, &local_error);
+
+		if (n_read <= 0) {
+			if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+				g_propagate_error (error, local_error);
+				g_object_unref (input);
+				return FALSE;
+			}
+
+			/* The file shrank or cannot be read any further; the size
+			 * in the header cannot change, thus fill it with zeros */
+			g_warning ("%s: File '%s' shrank by %" G_GUINT64_FORMAT " bytes%s%s", G_STRFUNC, filename, remaining,
+				local_error ? ": " : "", local_error ? local_error->message : "");
+			g_clear_error (&local_error);
+			break;
+		}
+
+		if (!archive_writer_write (writer, writer->read_buffer, n_read, error)) {
+			g_object_unref (input);
+			return FALSE;
+		}
+
+		remaining -= n_read;
+		archive_writer_progress (writer, n_read);
+	}
+
+	g_object_unref (input);
+
+	if (remaining > 0) {
+		if (!archive_writer_write_zeros (writer, remaining, error))
+			return FALSE;
+
+		archive_writer_progress (writer, remaining);
+	}
+
+	return archive_writer_pad_block (writer, error);
+}
+
+static gboolean
+archive_writer_add_entry_cb (ArchiveWriter *writer,
+			     const gchar *filename,
+			     const gchar *name,
+			     GStatBuf *st,
+			     GError **error)
+{
+	if (S_ISDIR (st->st_mode))
+		return archive_writer_add_header (writer, name, '5', st, 0, error);
+
+	return archive_writer_add_file (writer, filename, name, st, error);
+}
+
+static gboolean
+archive_writer_count_entry_cb (ArchiveWriter *writer,
+			       const gchar *filename,
+			       const gchar *name,
+			       GStatBuf *st,
+			       GError **error)
+{
+	if (S_ISREG (st->st_mode))
+		writer->bytes_total += st->st_size;
+
+	return TRUE;
+}
+
+static gboolean
+archive_walk (ArchiveWriter *writer,
+	      GHashTable *ancestors,
+	      const gchar *filename,
+	      const gchar *name,
+	      ArchiveVisitFunc func,
+	      GError **error)
+{
+	GStatBuf st;
+	gboolean success = TRUE;
+
+	if (g_cancellable_set_error_if_cancelled (writer->cancellable, error))
+		return FALSE;
+
+	/* Symbolic links are followed, like 'tar --dereference' does */
+	if (g_stat (filename, &st) == -1) {
+		g_warning ("%s: Cannot stat '%s': %s", G_STRFUNC, filename, g_strerror (errno));
+		return TRUE;
+	}
+
+	if (S_ISDIR (st.st_mode)) {
+		GDir *dir;
+		gchar *key = NULL;
+		gchar *dir_name;
+		GError *local_error = NULL;
+
+		/* Protect against symbolic links pointing to a parent directory */
+		if (st.st_ino) {
+			key = g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT, (guint64) st.st_dev, (guint64) st.st_ino);
+
+			if (g_hash_table_contains (ancestors, key)) {
+				g_warning ("%s: Skipping '%s', it is a link to its parent directory", G_STRFUNC, filename);
+				g_free (key);
+				return TRUE;
+			}
+
+			g_hash_table_add (ancestors, key);
+		}
+
+		dir_name = g_strconcat (name, "/", NULL);
+		success = func (writer, filename, dir_name, &st, error);
+		g_free (dir_name);
+
+		dir = success ? g_dir_open (filename, 0, &local_error) : NULL;
+
+		if (dir) {
+			const gchar *child;
+
+			while (success && (child = g_dir_read_name (dir)) != NULL) {
+				gchar *child_filename, *child_name;
+
+				child_filename = g_build_filename (filename, child, NULL);
+				child_name = g_strconcat (name, "/", child, NULL);
+
+				success = archive_walk (writer, ancestors, child_filename, child_name, func, error);
+
+				g_free (child_filename);
+				g_free (child_name);
+			}
+
+			g_dir_close (dir);
+		} else if (local_error) {
+			g_warning ("%s: Cannot read directory '%s': %s", G_STRFUNC, filename, local_error->message);
+			g_clear_error (&local_error);
+		}
+
+		if (key)
+			g_hash_table_remove (ancestors, key);
+	} else if (S_ISREG (st.st_mode)) {
+		success = func (writer, filename, name, &st, error);
+	}
+
+	/* Other file types, like sockets or FIFOs, are not archived */
+
+	return success;
+}
+
+static gboolean
+archive_walk_paths (ArchiveWriter *writer,
+		    const gchar *base_dir,
+		    const gchar * const *paths,
+		    ArchiveVisitFunc func,
+		    GError **error)
+{
+	GHashTable *ancestors;
+	gboolean success = TRUE;
+	gint ii;
+
+	ancestors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (ii = 0; success && paths[ii]; ii++) {
+		GString *name;
+		gchar *filename;
+		const gchar *skipped;
+
+		if (g_path_is_absolute (paths[ii]))
+			filename = g_strdup (paths[ii]);
+		else
+			filename = g_build_filename (base_dir, paths[ii], NULL);
+
+		/* Member names are relative and use slashes */
+		skipped = g_path_skip_root (paths[ii]);
+		name = g_string_new (skipped ? skipped : paths[ii]);
+
+		while (name->len > 0 && G_IS_DIR_SEPARATOR (name->str[name->len - 1]))
+			g_string_truncate (name, name->len - 1);
+
+#ifdef G_OS_WIN32
+		g_strdelimit (name->str, "\\", '/');
+#endif
+
+		if (name->len > 0)
+			success = archive_walk (writer, ancestors, filename, name->str, func, error);
+
+		g_string_free (name, TRUE);
+		g_free (filename);
+	}
+
+	g_hash_table_destroy (ancestors);
+
+	return success;
+}
+
+/* Creates a tar archive of the @paths, which are relative to the @base_dir,
+ * or absolute. It's compressed with xz, when the @archive_filename ends
+ * with ".xz", otherwise with gzip. */
+gboolean
+evolution_backup_archive_create (const gchar *archive_filename,
+				 const gchar *base_dir,
+				 const gchar * const *paths,
+				 EvolutionBackupProgressFunc progress_func,
+				 gpointer progress_data,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	ArchiveWriter writer;
+	GSubprocess *compressor = NULL;
+	gboolean success;
+
+	g_return_val_if_fail (archive_filename != NULL, FALSE);
+	g_return_val_if_fail (base_dir != NULL, FALSE);
+	g_return_val_if_fail (paths != NULL, FALSE);
+
+	memset (&writer, 0, sizeof (ArchiveWriter));
+
+	if (archive_filename_is_xz (archive_filename)) {
+#ifdef G_OS_UNIX
+		GSubprocessLauncher *launcher;
+
+		launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDIN_PIPE);
+		g_subprocess_launcher_set_stdout_file_path (launcher, archive_filename);
+
+		/* The '-T0' uses as many threads as there are processors */
+		compressor = g_subprocess_launcher_spawn (launcher, error, "xz", "-z", "-c", "-T0", NULL);
+
+		g_object_unref (launcher);
+
+		if (!compressor)
+			return FALSE;
+
+		writer.output = g_object_ref (g_subprocess_get_stdin_pipe (compressor));
+#else
+		g_set_error_literal (
+			error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			_("Back up into xz archives is not supported on this platform"));
+		return FALSE;
+#endif
+	} else {
+		GFile *file;
+		guint n_threads;
+
+		file = g_file_new_for_path (archive_filename);
+		writer.output = G_OUTPUT_STREAM (g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, cancellable, error));
+		g_object_unref (file);
+
+		if (!writer.output)
+			return FALSE;
+
+		n_threads = MAX (1, g_get_num_processors ());
+
+		writer.compress_pool = g_thread_pool_new (archive_compress_chunk_thread, &writer, n_threads, FALSE, NULL);
+		writer.max_chunks = 2 * n_threads;
+	}
+
+	g_mutex_init (&writer.lock);
+	g_cond_init (&writer.cond);
+	g_queue_init (&writer.chunks);
+
+	writer.pending = g_byte_array_sized_new (CHUNK_SIZE);
+	writer.read_buffer = g_malloc (READ_BUFFER_SIZE);
+	writer.progress_func = progress_func;
+	writer.progress_data = progress_data;
+	writer.cancellable = cancellable;
+
+	/* The first pass only sums the file sizes, for the progress */
+	success = archive_walk_paths (&writer, base_dir, paths, archive_writer_count_entry_cb, error) &&
+		archive_walk_paths (&writer, base_dir, paths, archive_writer_add_entry_cb, error) &&
+		/* End of the archive are two zero blocks; the file is padded to a full record */
+		archive_writer_write_zeros (&writer, 2 * TAR_BLOCK_SIZE, error) &&
+		archive_writer_write_zeros (&writer, (TAR_RECORD_SIZE - writer.archive_size % TAR_RECORD_SIZE) % TAR_RECORD_SIZE, error) &&
+		archive_writer_flush_pending (&writer, error) &&
+		archive_writer_drain (&writer, 0, error);
+
+	if (writer.compress_pool) {
+		/* Not compressed chunks are not needed after a failure */
+		g_thread_pool_free (writer.compress_pool, TRUE, TRUE);
+		writer.compress_pool = NULL;
+	}
+
+	g_queue_foreach (&writer.chunks, (GFunc) archive_chunk_free, NULL);
+	g_queue_clear (&writer.chunks);
+
+	if (!g_output_stream_close (writer.output, success ? cancellable : NULL, success ? error : NULL))
+		success = FALSE;
+
+	if (compressor) {
+		if (success)
+			success = g_subprocess_wait_check (compressor, cancellable, error);
+		else
+			g_subprocess_force_exit (compressor);
+
+		g_object_unref (compressor);
+	}
+
+	g_clear_object (&writer.output);
+	g_byte_array_unref (writer.pending);
+	g_free (writer.read_buffer);
+	g_mutex_clear (&writer.lock);
+	g_cond_clear (&writer.cond);
+
+	return success;
+}
+
+static gboolean
+archive_reader_fill (ArchiveReader *reader,
+		     GError **error)
+{
+	gssize n_read;
+
+	if (reader->buffer_start > 0) {
+		memmove (reader->buffer, reader->buffer + reader->buffer_start, reader->buffer_len);
+		reader->buffer_start = 0;
+	}
+
+	n_read = g_input_stream_read (
+		reader->input, reader->buffer + reader->buffer_len,
+		READ_BUFFER_SIZE - reader->buffer_len, reader->cancellable, error);
+
+	if (n_read < 0)
+		return FALSE;
+
+	reader->buffer_len += n_read;
+	reader->input_eof = n_read == 0;
+
+	return TRUE;
+}
+
+/* Reads exactly @count bytes of the uncompressed archive */
+static gboolean
+archive_reader_read (ArchiveReader *reader,
+		     gpointer data,
+		     gsize count,
+		     GError **error)
+{
+	gsize done = 0;
+
+	if (!reader->decompressor) {
+		if (!g_input_stream_read_all (reader->input, data, count, &done, reader->cancellable, error))
+			return FALSE;
+	}
+
+	while (reader->decompressor && done < count) {
+		GConverterResult res;
+		gsize bytes_read = 0, bytes_written = 0;
+		GError *local_error = NULL;
+
+		if (!reader->buffer_len && !reader->input_eof &&
+		    !archive_reader_fill (reader, error))
+			return FALSE;
+
+		res = g_converter_convert (
+			reader->decompressor,
+			reader->buffer + reader->buffer_start, reader->buffer_len,
+			(guint8 *) data + done, count - done,
+			reader->input_eof ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS,
+			&bytes_read, &bytes_written, &local_error);
+
+		if (res == G_CONVERTER_ERROR) {
+			if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT)) {
+				g_propagate_error (error, local_error);
+				return FALSE;
+			}
+
+			g_clear_error (&local_error);
+
+			if (reader->input_eof)
+				break;
+
+			if (!archive_reader_fill (reader, error))
+				return FALSE;
+
+			continue;
+		}
+
+		reader->buffer_start += bytes_read;
+		reader->buffer_len -= bytes_read;
+		done += bytes_written;
+
+		/* Another gzip member can follow */
+		if (res == G_CONVERTER_FINISHED)
+			g_converter_reset (reader->decompressor);
+	}
+
+	if (done < count) {
+		g_set_error_literal (
+			error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+			_("Unexpected end of the archive"));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+archive_reader_read_data (ArchiveReader *reader,
+			  guint64 size,
+			  gchar **out_data,
+			  GError **error)
+{
+	guint64 padded = (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+
+	if (out_data) {
+		gchar *data;
+
+		/* Names and extended headers are small */
+		if (padded > 1024 * 1024) {
+			g_set_error_literal (
+				error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				_("Invalid archive header"));
+			return FALSE;
+		}
+
+		data = g_malloc (padded + 1);
+
+		if (!archive_reader_read (reader, data, padded, error)) {
+			g_free (data);
+			return FALSE;
+		}
+
+		data[size] = '\0';
+		*out_data = data;
+
+		return TRUE;
+	}
+
+	while (padded > 0) {
+		guint8 buffer[16 * TAR_BLOCK_SIZE];
+		gsize n = MIN (padded, sizeof (buffer));
+
+		if (!archive_reader_read (reader, buffer, n, error))
+			return FALSE;
+
+		padded -= n;
+	}
+
+	return TRUE;
+}
+
+/* Returns the "path" record of the pax extended header, if any */
+static gchar *
+archive_pax_get_path (const gchar *data,
+		      guint64 size)
+{
+	const gchar *pos = data, *end = data + size;
+
+	while (pos < end) {
+		const gchar *record_end, *key, *value;
+		guint64 len;
+		gchar *endptr = NULL;
+
+		len = g_ascii_strtoull (pos, &endptr, 10);
+
+		if (!endptr || *endptr != ' ' || len == 0 || len > (guint64) (end - pos))
+			break;
+
+		record_end = pos + len;
+		key = endptr + 1;
+		value = memchr (key, '=', record_end - key);
+
+		if (value && value - key == 4 && strncmp (key, "path", 4) == 0) {
+			value++;
+
+			/* Without the trailing new line */
+			return g_strndup (value, record_end - value - 1);
+		}
+
+		pos = record_end;
+	}
+
+	return NULL;
+}
+
+/* Reads the whole archive, verifying its structure, and calls @func
+ * for each entry. It returns FALSE, when the archive is broken or
+ * the @func stopped the reading. */
+gboolean
+evolution_backup_archive_foreach (const gchar *archive_filename,
+				  EvolutionBackupEntryFunc func,
+				  gpointer user_data,
+				  GCancellable *cancellable,
+				  GError **error)
+{
+	ArchiveReader reader;
+	GSubprocess *decompressor = NULL;
+	gchar *long_name = NULL;
+	gboolean success = FALSE;
+
+	g_return_val_if_fail (archive_filename != NULL, FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+
+	memset (&reader, 0, sizeof (ArchiveReader));
+
+	if (archive_filename_is_xz (archive_filename)) {
+		decompressor = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_PIPE, error, "xz", "-d", "-c", archive_filename, NULL);
+
+		if (!decompressor)
+			return FALSE;
+
+		reader.input = g_object_ref (g_subprocess_get_stdout_pipe (decompressor));
+	} else {
+		GFile *file;
+
+		file = g_file_new_for_path (archive_filename);
+		reader.input = G_INPUT_STREAM (g_file_read (file, cancellable, error));
+		g_object_unref (file);
+
+		if (!reader.input)
+			return FALSE;
+
+		reader.decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+		reader.buffer = g_malloc (READ_BUFFER_SIZE);
+	}
+
+	reader.cancellable = cancellable;
+
+	while (TRUE) {
+		TarHeader header;
+		guint64 size;
+
+		if (!archive_reader_read (&reader, &header, sizeof (TarHeader), error))
+			break;
+
+		if (tar_block_is_zero (&header)) {
+			/* The end of the archive */
+			success = TRUE;
+			break;
+		}
+
+		if (!tar_header_check_checksum (&header)) {
+			g_set_error_literal (
+				error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				_("Invalid archive header"));
+			break;
+		}
+
+		size = tar_get_number (header.size, sizeof (header.size));
+
+		if (header.typeflag == 'L') {
+			/* GNU long name of the next entry */
+			g_free (long_name);
+			long_name = NULL;
+
+			if (!archive_reader_read_data (&reader, size, &long_name, error))
+				break;
+		} else if (header.typeflag == 'x') {
+			/* pax extended header of the next entry */
+			gchar *data = NULL;
+
+			if (!archive_reader_read_data (&reader, size, &data, error))
+				break;
+
+			g_free (long_name);
+			long_name = archive_pax_get_path (data, size);
+			g_free (data);
+		} else if (header.typeflag == 'g' || header.typeflag == 'K') {
+			/* pax global header or GNU long link name */
+			if (!archive_reader_read_data (&reader, size, NULL, error))
+				break;
+		} else {
+			gchar *name = long_name;
+			gboolean stop;
+
+			long_name = NULL;
+
+			if (!name) {
+				gchar *short_name = g_strndup (header.name, sizeof (header.name));
+
+				if (memcmp (header.magic, "ustar", 6) == 0 && header.prefix[0]) {
+					gchar *prefix = g_strndup (header.prefix, sizeof (header.prefix));
+
+					name = g_strconcat (prefix, "/", short_name, NULL);
+
+					g_free (prefix);
+					g_free (short_name);
+				} else {
+					name = short_name;
+				}
+			}
+
+			stop = !func (name, user_data);
+
+			g_free (name);
+
+			if (stop) {
+				g_set_error_literal (
+					error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+					_("Reading of the archive was stopped"));
+				break;
+			}
+
+			/* Links and special files have no content */
+			if (!(header.typeflag && strchr ("123456", header.typeflag)) &&
+			    !archive_reader_read_data (&reader, size, NULL, error))
+				break;
+		}
+	}
+
+	g_free (long_name);
+	g_clear_object (&reader.decompressor);
+	g_free (reader.buffer);
+
+	g_input_stream_close (reader.input, NULL, NULL);
+	g_object_unref (reader.input);
+
+	if (decompressor) {
+		/* Whatever follows the end of the archive is not needed */
+		if (success)
+			g_subprocess_force_exit (decompressor);
+
+		g_subprocess_wait (decompressor, NULL, NULL);
+		g_object_unref (decompressor);
+	}
+
+	return success;
+}
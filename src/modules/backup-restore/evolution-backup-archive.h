@@ -0,0 +1,52 @@
+/*
+ * evolution-backup-archive.h
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EVOLUTION_BACKUP_ARCHIVE_H
+#define EVOLUTION_BACKUP_ARCHIVE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Called from the archiving thread, with the number of file content
+ * bytes archived so far and the expected total. */
+typedef void	(* EvolutionBackupProgressFunc)	(guint64 bytes_done,
+						 guint64 bytes_total,
+						 gpointer user_data);
+
+/* Called for each entry of the archive, in the archive order; directory
+ * names end with a slash. Return FALSE to stop reading the archive. */
+typedef gboolean (* EvolutionBackupEntryFunc)	(const gchar *name,
+						 gpointer user_data);
+
+gboolean	evolution_backup_archive_create	(const gchar *archive_filename,
+						 const gchar *base_dir,
+						 const gchar * const *paths,
+						 EvolutionBackupProgressFunc progress_func,
+						 gpointer progress_data,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	evolution_backup_archive_foreach
+						(const gchar *archive_filename,
+						 EvolutionBackupEntryFunc func,
+						 gpointer user_data,
+						 GCancellable *cancellable,
+						 GError **error);
+
+G_END_DECLS
+
+#endif /* EVOLUTION_BACKUP_ARCHIVE_H */
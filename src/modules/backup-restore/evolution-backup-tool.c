@@ -37,6 +37,8 @@
 #include "e-util/e-util-private.h"
 #include "e-util/e-util.h"
 
+#include "evolution-backup-archive.h"
+
 #define EVOUSERDATADIR_MAGIC "#EVO_USERDATADIR#"
 
 #define EVOLUTION "evolution"
@@ -67,6 +69,8 @@ static gint result = 0;
 static GtkWidget *progress_dialog;
 static GtkWidget *pbar;
 static gchar *txt = NULL;
+static GMutex progress_lock;
+static gdouble progress_fraction = -1.0;
 
 static GOptionEntry options[] = {
 	{ "backup", '\0', 0, G_OPTION_ARG_NONE, &backup_op,
@@ -278,13 +282,30 @@ get_filename_is_xz (const gchar *filename)
 	return g_ascii_strcasecmp (filename + len - 3, ".xz") == 0;
 }
 
+static void
+set_progress_fraction (gdouble fraction)
+{
+	g_mutex_lock (&progress_lock);
+	progress_fraction = fraction;
+	g_mutex_unlock (&progress_lock);
+}
+
+static void
+archive_progress_cb (guint64 bytes_done,
+                     guint64 bytes_total,
+                     gpointer user_data)
+{
+	set_progress_fraction (bytes_total > 0 ? MIN (1.0, (gdouble) bytes_done / bytes_total) : -1.0);
+}
+
 static void
 backup (const gchar *filename,
         GCancellable *cancellable)
 {
-	gchar *command;
-	gchar *quotedfname;
-	gboolean use_xz;
+	GString *data_dir;
+	GString *config_dir;
+	const gchar *paths[4];
+	GError *error = NULL;
 
 	g_return_if_fail (filename && *filename);
 
@@ -319,17 +340,28 @@ backup (const gchar *filename,
 
 	txt = _("Backing Evolution data (Mails, Contacts, Calendar, Tasks, Memos)");
 
-	quotedfname = g_shell_quote (filename);
-	use_xz = get_filename_is_xz (filename);
+	data_dir = replace_variables ("$STRIPDATADIR", TRUE);
+	config_dir = replace_variables ("$STRIPCONFIGDIR", TRUE);
+	g_return_if_fail (data_dir != NULL && config_dir != NULL);
 
-	command = g_strdup_printf (
-		"cd $HOME && tar chf - $STRIPDATADIR "
-		"$STRIPCONFIGDIR " EVOLUTION_DIR_FILE " | "
-		"%s > %s", use_xz ? "xz -z" : "gzip", quotedfname);
-	run_cmd (command);
+	paths[0] = data_dir->str;
+	paths[1] = config_dir->str;
+	paths[2] = EVOLUTION_DIR_FILE;
+	paths[3] = NULL;
 
-	g_free (command);
-	g_free (quotedfname);
+	if (!evolution_backup_archive_create (filename, g_get_home_dir (), paths, archive_progress_cb, NULL, cancellable, &error)) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("%s: Failed to create '%s': %s", G_STRFUNC, filename, error ? error->message : "Unknown error");
+
+		g_clear_error (&error);
+		g_unlink (filename);
+		result = 1;
+	}
+
+	set_progress_fraction (-1.0);
+
+	g_string_free (data_dir, TRUE);
+	g_string_free (config_dir, TRUE);
 
 	run_cmd ("rm $HOME/" EVOLUTION_DIR_FILE);
 
@@ -712,84 +744,59 @@ end:
 	}
 }
 
+typedef struct _CheckData {
+	gboolean has_dir_file;
+	gboolean has_old_dir;
+	gboolean has_ancient_gconf_dump;
+} CheckData;
+
+static gboolean
+check_archive_entry_cb (const gchar *name,
+                        gpointer user_data)
+{
+	CheckData *cd = user_data;
+
+	if (g_str_has_suffix (name, EVOLUTION_DIR_FILE))
+		cd->has_dir_file = TRUE;
+	else if (g_str_equal (name, ".evolution/"))
+		cd->has_old_dir = TRUE;
+	else if (g_str_equal (name, ".evolution/" ANCIENT_GCONF_DUMP_FILE))
+		cd->has_ancient_gconf_dump = TRUE;
+
+	return TRUE;
+}
+
 static gboolean
 check (const gchar *filename,
        gboolean *is_new_format)
 {
-	gchar *command;
-	gchar *quotedfname;
-	const gchar *tar_opts;
-	gboolean is_new = TRUE;
+	CheckData cd = { FALSE, FALSE, FALSE };
+	GError *error = NULL;
 
 	g_return_val_if_fail (filename && *filename, FALSE);
 
-	if (get_filename_is_xz (filename))
-		tar_opts = "-tJf";
-	else
-		tar_opts = "-tzf";
-
-	quotedfname = g_shell_quote (filename);
-
 	if (is_new_format)
 		*is_new_format = FALSE;
 
-	command = g_strdup_printf ("tar %s %s 1>/dev/null", tar_opts, quotedfname);
-	result = system (command);
-	g_free (command);
-
-	g_message ("First result %d", result);
-	if (result) {
-		g_free (quotedfname);
-		return FALSE;
-	}
-
-	command = g_strdup_printf (
-		"tar %s %s | grep -e \"%s$\"",
-		tar_opts, quotedfname, EVOLUTION_DIR_FILE);
-	result = system (command);
-	g_free (command);
-
-	if (result) {
-		command = g_strdup_printf (
-			"tar %s %s | grep -e \"^\\.evolution/$\"",
-			tar_opts, quotedfname);
-		result = system (command);
-		g_free (command);
-		is_new = FALSE;
-	}
-
-	g_message ("Second result %d", result);
-	if (result) {
-		g_free (quotedfname);
+	/* One pass over the archive verifies it and lists its content */
+	if (!evolution_backup_archive_foreach (filename, check_archive_entry_cb, &cd, NULL, &error)) {
+		g_message ("Archive '%s' is not valid: %s", filename, error ? error->message : "Unknown error");
+		g_clear_error (&error);
+		result = 1;
 		return FALSE;
 	}
 
-	if (is_new) {
+	if (cd.has_dir_file) {
 		if (is_new_format)
 			*is_new_format = TRUE;
-		g_free (quotedfname);
-		return TRUE;
-	}
-
-	command = g_strdup_printf (
-		"tar %s %s | grep -e \"^\\.evolution/%s$\"",
-		tar_opts, quotedfname, ANCIENT_GCONF_DUMP_FILE);
-	result = system (command);
-	g_free (command);
-
-	if (result != 0) {
-		/* maybe it's an ancient backup */
-		command = g_strdup_printf (
-			"tar %s %s | grep -e \"^\\.evolution/%s$\"",
-			tar_opts, quotedfname, ANCIENT_GCONF_DUMP_FILE);
-		result = system (command);
-		g_free (command);
+		result = 0;
+	} else if (cd.has_old_dir && cd.has_ancient_gconf_dump) {
+		result = 0;
+	} else {
+		g_message ("Archive '%s' does not contain an Evolution back up", filename);
+		result = 1;
 	}
 
-	g_free (quotedfname);
-
-	g_message ("Third result %d", result);
-
 	return result == 0;
 }
 
@@ -797,8 +804,16 @@ static gboolean
 pbar_update (gpointer user_data)
 {
 	GCancellable *cancellable = G_CANCELLABLE (user_data);
+	gdouble fraction;
+
+	g_mutex_lock (&progress_lock);
+	fraction = progress_fraction;
+	g_mutex_unlock (&progress_lock);
 
-	gtk_progress_bar_pulse ((GtkProgressBar *) pbar);
+	if (fraction >= 0.0)
+		gtk_progress_bar_set_fraction ((GtkProgressBar *) pbar, fraction);
+	else
+		gtk_progress_bar_pulse ((GtkProgressBar *) pbar);
 	gtk_progress_bar_set_text ((GtkProgressBar *) pbar, txt);
 
 	/* Return TRUE to reschedule the timeout. */
@@ -842,9 +857,11 @@ dlg_response (GtkWidget *dlg,
 	if (response != GTK_RESPONSE_NONE)
 		gtk_widget_destroy (dlg);
 
-	/* We will kill just the tar operation. Rest of
-	 * them will be just a second of microseconds.*/
-	run_cmd ("pkill tar");
+	/* The back up stops on the cancellable, the restore
+	 * runs tar. Rest of them will be just a second of
+	 * microseconds.*/
+	if (restore_op)
+		run_cmd ("pkill tar");
 
 	if (bk_file && backup_op && response == GTK_RESPONSE_REJECT) {
 		/* Backup was cancelled, delete the
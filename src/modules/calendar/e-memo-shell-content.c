@@ -254,6 +254,18 @@ memo_shell_content_model_row_changed_cb (EMemoShellContent *memo_shell_content,
 		memo_shell_content, 0, E_TABLE (memo_table));
 }
 
+static void
+memo_shell_content_model_rows_changed_cb (EMemoShellContent *memo_shell_content,
+                                          gint row,
+                                          gint count,
+                                          ETableModel *model)
+{
+	gint ii;
+
+	for (ii = row; ii < row + count; ii++)
+		memo_shell_content_model_row_changed_cb (memo_shell_content, ii, model);
+}
+
 static void
 memo_shell_content_is_editing_changed_cb (EMemoTable *memo_table,
                                           GParamSpec *param,
@@ -553,6 +565,11 @@ memo_shell_content_constructed (GObject *object)
 		G_CALLBACK (memo_shell_content_model_row_changed_cb),
 		object);
 
+	g_signal_connect_swapped (
+		model, "model-rows-changed",
+		G_CALLBACK (memo_shell_content_model_rows_changed_cb),
+		object);
+
 	/* Prepare the view instance. */
 
 	view_instance = e_shell_view_new_view_instance (shell_view, NULL);
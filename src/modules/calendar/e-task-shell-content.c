@@ -249,6 +249,18 @@ task_shell_content_model_row_changed_cb (ETaskShellContent *task_shell_content,
 		task_shell_content, 0, E_TABLE (task_table));
 }
 
+static void
+task_shell_content_model_rows_changed_cb (ETaskShellContent *task_shell_content,
+                                          gint row,
+                                          gint count,
+                                          ETableModel *model)
+{
+	gint ii;
+
+	for (ii = row; ii < row + count; ii++)
+		task_shell_content_model_row_changed_cb (task_shell_content, ii, model);
+}
+
 static void
 task_shell_content_is_editing_changed_cb (ETaskTable *task_table,
                                           GParamSpec *param,
@@ -573,6 +585,10 @@ task_shell_content_constructed (GObject *object)
 		model, "model-row-changed",
 		G_CALLBACK (task_shell_content_model_row_changed_cb), object);
 
+	g_signal_connect_swapped (
+		model, "model-rows-changed",
+		G_CALLBACK (task_shell_content_model_rows_changed_cb), object);
+
 	/* Prepare the view instance. */
 
 	view_instance = e_shell_view_new_view_instance (shell_view, NULL);
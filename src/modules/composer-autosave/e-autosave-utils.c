@@ -20,6 +20,8 @@
 #include "e-autosave-utils.h"
 
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 #include <glib/gstdio.h>
 #include <camel/camel.h>
 
@@ -29,24 +31,110 @@
 #define SNAPSHOT_FILE_PREFIX	".evolution-composer.autosave"
 #define SNAPSHOT_FILE_SEED	SNAPSHOT_FILE_PREFIX "-XXXXXX"
 
+/* The attachments are not part of the snapshot file, which would have
+ * to be rewritten, with all the attachments encoded again, on each save.
+ * They are appended to a parts journal, next to the snapshot file, only
+ * once, and the snapshot contains a placeholder part with this header,
+ * referencing the journal record. The journal record is a line with
+ * the header name, the part ID and the part length, followed by the part. */
+#define SNAPSHOT_PARTS_KEY	"e-composer-snapshot-parts"
+#define SNAPSHOT_PARTS_SUFFIX	".parts"
+#define SNAPSHOT_PART_HEADER	"X-Evolution-Autosave-Part"
+
+/* A compacted journal is written next to the current one first and it
+ * replaces it only after the snapshot referencing it is saved, thus
+ * an interrupted save keeps the previous snapshot and journal pair. */
+#define SNAPSHOT_PARTS_NEW_SUFFIX	".new" SNAPSHOT_PARTS_SUFFIX
+
 typedef struct _LoadContext LoadContext;
 typedef struct _SaveContext SaveContext;
+typedef struct _SnapshotParts SnapshotParts;
+typedef struct _JournalPart JournalPart;
 
 struct _LoadContext {
 	EMsgComposer *composer;
+	CamelMimeMessage *message;
 };
 
 struct _SaveContext {
 	GCancellable *cancellable;
 	GOutputStream *output_stream;
+
+	GFile *parts_file;
+	GFile *parts_new_file;
+	GPtrArray *parts; /* JournalPart *, all the parts in the journal */
+	gboolean parts_rewrite;
+	SnapshotParts *sparts;
+};
+
+/* Which attachments of the composer are in the parts journal already */
+struct _SnapshotParts {
+	GHashTable *ids; /* CamelMimePart * ~> GUINT_TO_POINTER (id) */
+	guint last_id;
+	gboolean written;
+
+	/* A failed append could leave a partial record, which would hide
+	 * any record appended after it; used under the journal lock. */
+	gboolean journal_broken;
+};
+
+struct _JournalPart {
+	CamelMimePart *part;
+	guint id;
+	gboolean is_new;
 };
 
+static void
+journal_part_free (gpointer ptr)
+{
+	JournalPart *jpart = ptr;
+
+	if (jpart) {
+		g_object_unref (jpart->part);
+		g_slice_free (JournalPart, jpart);
+	}
+}
+
+static void
+snapshot_parts_free (gpointer ptr)
+{
+	SnapshotParts *sparts = ptr;
+
+	if (sparts) {
+		g_hash_table_destroy (sparts->ids);
+		g_slice_free (SnapshotParts, sparts);
+	}
+}
+
+static GFile *
+snapshot_get_parts_file (GFile *snapshot_file,
+                         const gchar *suffix)
+{
+	GFile *parts_file;
+	gchar *path, *parts_path;
+
+	path = g_file_get_path (snapshot_file);
+	if (!path)
+		return NULL;
+
+	parts_path = g_strconcat (path, suffix, NULL);
+	parts_file = g_file_new_for_path (parts_path);
+
+	g_free (parts_path);
+	g_free (path);
+
+	return parts_file;
+}
+
 static void
 load_context_free (LoadContext *context)
 {
 	if (context->composer != NULL)
 		g_object_unref (context->composer);
 
+	if (context->message != NULL)
+		g_object_unref (context->message);
+
 	g_slice_free (LoadContext, context);
 }
 
@@ -59,13 +147,19 @@ save_context_free (SaveContext *context)
 	if (context->output_stream != NULL)
 		g_object_unref (context->output_stream);
 
+	g_clear_object (&context->parts_file);
+	g_clear_object (&context->parts_new_file);
+
+	if (context->parts != NULL)
+		g_ptr_array_unref (context->parts);
+
 	g_slice_free (SaveContext, context);
 }
 
 static void
 delete_snapshot_file (GFile *snapshot_file)
 {
-	g_file_delete (snapshot_file, NULL, NULL);
+	e_composer_delete_snapshot (snapshot_file);
 	g_object_unref (snapshot_file);
 }
 
@@ -151,19 +245,190 @@ autosave_composer_created_cb (GObject *source_object,
 	g_free (ccd);
 }
 
+static void
+load_snapshot_create_composer (GSimpleAsyncResult *simple,
+                               GFile *snapshot_file,
+                               CamelMimeMessage *message)
+{
+	EShell *shell;
+	GObject *object;
+	CreateComposerData *ccd;
+
+	/* g_async_result_get_source_object() returns a new reference. */
+	object = g_async_result_get_source_object (G_ASYNC_RESULT (simple));
+
+	/* Create a new composer window from the loaded message and
+	 * restore its snapshot file so it continues auto-saving to
+	 * the same file. */
+	shell = E_SHELL (object);
+
+	ccd = g_new0 (CreateComposerData, 1);
+	ccd->simple = simple;
+	ccd->context = g_simple_async_result_get_op_res_gpointer (simple);
+	ccd->message = message;
+	ccd->snapshot_file = g_object_ref (snapshot_file);
+
+	e_msg_composer_new (shell, autosave_composer_created_cb, ccd);
+
+	g_object_unref (object);
+}
+
+static gboolean
+load_snapshot_has_placeholders (CamelMimeMessage *message)
+{
+	CamelDataWrapper *content;
+	guint ii, n_parts;
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (message));
+
+	if (!CAMEL_IS_MULTIPART (content))
+		return FALSE;
+
+	n_parts = camel_multipart_get_number (CAMEL_MULTIPART (content));
+
+	for (ii = 0; ii < n_parts; ii++) {
+		CamelMimePart *part;
+
+		part = camel_multipart_get_part (CAMEL_MULTIPART (content), ii);
+
+		if (camel_medium_get_header (CAMEL_MEDIUM (part), SNAPSHOT_PART_HEADER))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Puts the parts from the journal in place of their placeholders;
+ * placeholders without a part in the journal are dropped. */
+static void
+load_snapshot_replace_placeholders (CamelMimeMessage *message,
+                                    const gchar *contents,
+                                    gsize length)
+{
+	CamelDataWrapper *content;
+	CamelMultipart *multipart;
+	GHashTable *parts;
+	const gchar *pos = contents, *end = contents + length;
+	guint ii, n_parts;
+
+	parts = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_object_unref);
+
+	while (pos && pos < end) {
+		CamelMimePart *part;
+		CamelStream *camel_stream;
+		const gchar *eol;
+		gchar *line;
+		guint id = 0;
+		guint64 size = 0;
+		gboolean valid;
+
+		eol = memchr (pos, '\n', end - pos);
+		if (!eol)
+			break;
+
+		line = g_strndup (pos, eol - pos);
+		valid = sscanf (line, SNAPSHOT_PART_HEADER " %u %" G_GINT64_MODIFIER "u", &id, &size) == 2;
+		g_free (line);
+
+		/* A truncated record ends the journal */
+		if (!valid || size > (guint64) (end - eol - 1))
+			break;
+
+		part = camel_mime_part_new ();
+		camel_stream = camel_stream_mem_new_with_buffer (eol + 1, size);
+
+		if (camel_data_wrapper_construct_from_stream_sync (CAMEL_DATA_WRAPPER (part), camel_stream, NULL, NULL))
+			g_hash_table_insert (parts, GUINT_TO_POINTER (id), part);
+		else
+			g_object_unref (part);
+
+		g_object_unref (camel_stream);
+
+		pos = eol + 1 + size;
+	}
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (message));
+	n_parts = camel_multipart_get_number (CAMEL_MULTIPART (content));
+
+	multipart = camel_multipart_new ();
+	camel_multipart_set_boundary (multipart, NULL);
+
+	for (ii = 0; ii < n_parts; ii++) {
+		CamelMimePart *part;
+		const gchar *value;
+
+		part = camel_multipart_get_part (CAMEL_MULTIPART (content), ii);
+		value = camel_medium_get_header (CAMEL_MEDIUM (part), SNAPSHOT_PART_HEADER);
+
+		if (value) {
+			part = g_hash_table_lookup (parts, GUINT_TO_POINTER (strtoul (value, NULL, 10)));
+			if (!part) {
+				g_warning ("%s: Attachment part %s is missing in the journal", G_STRFUNC, value);
+				continue;
+			}
+		}
+
+		camel_multipart_add_part (multipart, part);
+	}
+
+	camel_medium_set_content (CAMEL_MEDIUM (message), CAMEL_DATA_WRAPPER (multipart));
+
+	g_object_unref (multipart);
+	g_hash_table_destroy (parts);
+}
+
+static void
+load_snapshot_parts_loaded_cb (GFile *parts_file,
+                               GAsyncResult *result,
+                               GSimpleAsyncResult *simple)
+{
+	LoadContext *context;
+	CamelMimeMessage *message;
+	GFile *snapshot_file;
+	gchar *contents = NULL;
+	gchar *path, *snapshot_path;
+	gsize length = 0;
+	GError *local_error = NULL;
+
+	context = g_simple_async_result_get_op_res_gpointer (simple);
+
+	g_file_load_contents_finish (
+		parts_file, result, &contents, &length, NULL, &local_error);
+
+	if (local_error != NULL) {
+		/* Recover at least the message body */
+		g_warning ("%s: %s", G_STRFUNC, local_error->message);
+		g_clear_error (&local_error);
+	}
+
+	message = context->message;
+	context->message = NULL;
+
+	load_snapshot_replace_placeholders (message, contents, length);
+
+	g_free (contents);
+
+	path = g_file_get_path (parts_file);
+	snapshot_path = g_strndup (path, strlen (path) - strlen (SNAPSHOT_PARTS_SUFFIX));
+	snapshot_file = g_file_new_for_path (snapshot_path);
+
+	load_snapshot_create_composer (simple, snapshot_file, message);
+
+	g_object_unref (snapshot_file);
+	g_free (snapshot_path);
+	g_free (path);
+}
+
 static void
 load_snapshot_loaded_cb (GFile *snapshot_file,
                          GAsyncResult *result,
                          GSimpleAsyncResult *simple)
 {
-	EShell *shell;
-	GObject *object;
 	LoadContext *context;
 	CamelMimeMessage *message;
 	CamelStream *camel_stream;
 	gchar *contents = NULL;
 	gsize length;
-	CreateComposerData *ccd;
 	GError *local_error = NULL;
 
 	context = g_simple_async_result_get_op_res_gpointer (simple);
@@ -197,23 +462,47 @@ load_snapshot_loaded_cb (GFile *snapshot_file,
 		return;
 	}
 
-	/* g_async_result_get_source_object() returns a new reference. */
-	object = g_async_result_get_source_object (G_ASYNC_RESULT (simple));
+	if (load_snapshot_has_placeholders (message)) {
+		GFile *parts_file;
 
-	/* Create a new composer window from the loaded message and
-	 * restore its snapshot file so it continues auto-saving to
-	 * the same file. */
-	shell = E_SHELL (object);
+		context->message = message;
 
-	ccd = g_new0 (CreateComposerData, 1);
-	ccd->simple = simple;
-	ccd->context = context;
-	ccd->message = message;
-	ccd->snapshot_file = g_object_ref (snapshot_file);
+		/* The attachments are in the parts journal */
+		parts_file = snapshot_get_parts_file (snapshot_file, SNAPSHOT_PARTS_SUFFIX);
+		g_file_load_contents_async (
+			parts_file, NULL, (GAsyncReadyCallback)
+			load_snapshot_parts_loaded_cb, simple);
+		g_object_unref (parts_file);
+		return;
+	}
 
-	e_msg_composer_new (shell, autosave_composer_created_cb, ccd);
+	load_snapshot_create_composer (simple, snapshot_file, message);
+}
 
-	g_object_unref (object);
+/* Remembers which parts made it into the parts journal */
+static void
+save_snapshot_commit_parts (EMsgComposer *composer,
+                            SaveContext *context)
+{
+	SnapshotParts *sparts;
+	guint ii;
+
+	if (!context->parts)
+		return;
+
+	sparts = g_object_get_data (G_OBJECT (composer), SNAPSHOT_PARTS_KEY);
+	g_return_if_fail (sparts != NULL);
+
+	if (context->parts_rewrite)
+		g_hash_table_remove_all (sparts->ids);
+
+	for (ii = 0; ii < context->parts->len; ii++) {
+		JournalPart *jpart = g_ptr_array_index (context->parts, ii);
+
+		g_hash_table_insert (sparts->ids, g_object_ref (jpart->part), GUINT_TO_POINTER (jpart->id));
+	}
+
+	sparts->written = TRUE;
 }
 
 static void
@@ -228,30 +517,188 @@ save_snapshot_splice_cb (CamelDataWrapper *data_wrapper,
 
 	g_task_propagate_int (G_TASK (result), &local_error);
 
-	if (local_error != NULL)
+	if (local_error != NULL) {
 		g_simple_async_result_take_error (simple, local_error);
+	} else {
+		GObject *object;
+
+		/* g_async_result_get_source_object() returns a new reference. */
+		object = g_async_result_get_source_object (G_ASYNC_RESULT (simple));
+
+		save_snapshot_commit_parts (E_MSG_COMPOSER (object),
+			g_simple_async_result_get_op_res_gpointer (simple));
+
+		g_object_unref (object);
+	}
 
 	g_simple_async_result_complete (simple);
 	g_object_unref (simple);
 }
 
+static gboolean
+write_journal_part (GOutputStream *output_stream,
+                    JournalPart *jpart,
+                    GError **error)
+{
+	GOutputStream *mem_stream;
+	gchar *line;
+	gboolean success;
+
+	mem_stream = g_memory_output_stream_new_resizable ();
+
+	success = camel_data_wrapper_write_to_output_stream_sync (
+		CAMEL_DATA_WRAPPER (jpart->part), mem_stream, NULL, error) != -1 &&
+		g_output_stream_close (mem_stream, NULL, error);
+
+	if (success) {
+		GMemoryOutputStream *mos = G_MEMORY_OUTPUT_STREAM (mem_stream);
+
+		line = g_strdup_printf (SNAPSHOT_PART_HEADER " %u %" G_GSIZE_FORMAT "\n",
+			jpart->id, g_memory_output_stream_get_data_size (mos));
+
+		/* No cancellable here, a partially written record
+		 * would hide any record appended after it. */
+		success = g_output_stream_write_all (output_stream, line, strlen (line), NULL, NULL, error) &&
+			g_output_stream_write_all (output_stream,
+				g_memory_output_stream_get_data (mos),
+				g_memory_output_stream_get_data_size (mos), NULL, NULL, error);
+
+		g_free (line);
+	}
+
+	g_object_unref (mem_stream);
+
+	return success;
+}
+
+static gboolean
+write_parts_journal (SaveContext *context,
+                     GCancellable *cancellable,
+                     GError **error)
+{
+	GFileOutputStream *file_stream;
+	guint ii;
+	gboolean success = TRUE;
+
+	if (context->parts_rewrite) {
+		file_stream = g_file_replace (context->parts_new_file, NULL, FALSE,
+			G_FILE_CREATE_PRIVATE, cancellable, error);
+	} else {
+		for (ii = 0; ii < context->parts->len; ii++) {
+			JournalPart *jpart = g_ptr_array_index (context->parts, ii);
+
+			if (jpart->is_new)
+				break;
+		}
+
+		/* Nothing new to append */
+		if (ii == context->parts->len)
+			return TRUE;
+
+		file_stream = g_file_append_to (context->parts_file,
+			G_FILE_CREATE_PRIVATE, cancellable, error);
+	}
+
+	if (!file_stream)
+		return FALSE;
+
+	for (ii = 0; ii < context->parts->len && success; ii++) {
+		JournalPart *jpart = g_ptr_array_index (context->parts, ii);
+
+		if (!context->parts_rewrite && !jpart->is_new)
+			continue;
+
+		success = !g_cancellable_set_error_if_cancelled (cancellable, error) &&
+			write_journal_part (G_OUTPUT_STREAM (file_stream), jpart, error);
+	}
+
+	if (success) {
+		success = g_output_stream_close (G_OUTPUT_STREAM (file_stream), NULL, error);
+	} else {
+		GCancellable *abort_cancellable;
+
+		/* Closing a replaced file with a cancelled cancellable
+		 * keeps the previous content of the file. */
+		abort_cancellable = g_cancellable_new ();
+		g_cancellable_cancel (abort_cancellable);
+		g_output_stream_close (G_OUTPUT_STREAM (file_stream), abort_cancellable, NULL);
+		g_object_unref (abort_cancellable);
+	}
+
+	g_object_unref (file_stream);
+
+	if (!success && context->parts_rewrite)
+		g_file_delete (context->parts_new_file, NULL, NULL);
+
+	return success;
+}
+
 static void
 write_message_to_stream_thread (GTask *task,
 				gpointer source_object,
 				gpointer task_data,
 				GCancellable *cancellable)
 {
+	static GMutex journal_lock;
+	SaveContext *context;
 	GOutputStream *output_stream;
-	gssize bytes_written;
+	gssize bytes_written = -1;
 	GError *local_error = NULL;
 
-	output_stream = task_data;
+	context = task_data;
+	output_stream = context->output_stream;
 
-	bytes_written = camel_data_wrapper_decode_to_output_stream_sync (
-		CAMEL_DATA_WRAPPER (source_object),
-		output_stream, cancellable, &local_error);
+	/* The journal has to be complete before the snapshot
+	 * references any of the parts in it. */
+	if (context->parts) {
+		g_mutex_lock (&journal_lock);
 
-	g_output_stream_close (output_stream, cancellable, local_error ? NULL : &local_error);
+		if (context->sparts->journal_broken)
+			context->parts_rewrite = TRUE;
+
+		/* A rewrite goes to the new journal file, thus a failed
+		 * one keeps the previous journal untouched */
+		if (write_parts_journal (context, cancellable, &local_error))
+			context->sparts->journal_broken = FALSE;
+		else if (!context->parts_rewrite)
+			context->sparts->journal_broken = TRUE;
+	}
+
+	if (!local_error) {
+		bytes_written = camel_data_wrapper_decode_to_output_stream_sync (
+			CAMEL_DATA_WRAPPER (source_object),
+			output_stream, cancellable, &local_error);
+	}
+
+	if (local_error && context->parts) {
+		GCancellable *abort_cancellable;
+
+		/* Keep the previous snapshot, which matches the journal */
+		abort_cancellable = g_cancellable_new ();
+		g_cancellable_cancel (abort_cancellable);
+		g_output_stream_close (output_stream, abort_cancellable, NULL);
+		g_object_unref (abort_cancellable);
+	} else {
+		g_output_stream_close (output_stream, cancellable, local_error ? NULL : &local_error);
+	}
+
+	if (context->parts) {
+		/* The new journal replaces the previous one only once
+		 * the snapshot referencing it is saved. */
+		if (context->parts_rewrite && !local_error &&
+		    !g_file_move (context->parts_new_file, context->parts_file,
+				  G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &local_error)) {
+			/* The new snapshot and the previous journal
+			 * do not match, compact the journal again
+			 * on the next save. */
+			context->sparts->journal_broken = TRUE;
+		}
+
+		if (context->parts_rewrite && local_error)
+			g_file_delete (context->parts_new_file, NULL, NULL);
+
+		g_mutex_unlock (&journal_lock);
+	}
 
 	if (local_error != NULL) {
 		g_task_return_error (task, local_error);
@@ -260,6 +707,93 @@ write_message_to_stream_thread (GTask *task,
 	}
 }
 
+/* Replaces the attachments of the message with placeholders referencing
+ * the parts journal and notes in the context which parts the journal
+ * should contain. */
+static void
+save_snapshot_prepare_parts (EMsgComposer *composer,
+                             CamelMimeMessage *message,
+                             SaveContext *context)
+{
+	CamelDataWrapper *content;
+	CamelMultipart *multipart;
+	SnapshotParts *sparts;
+	GFile *snapshot_file;
+	guint ii, n_parts, n_known = 0;
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (message));
+
+	if (!CAMEL_IS_MULTIPART (content) ||
+	    !camel_content_type_is (camel_data_wrapper_get_mime_type_field (content), "multipart", "mixed"))
+		return;
+
+	n_parts = camel_multipart_get_number (CAMEL_MULTIPART (content));
+	if (n_parts < 2)
+		return;
+
+	snapshot_file = e_composer_get_snapshot_file (composer);
+	context->parts_file = snapshot_get_parts_file (snapshot_file, SNAPSHOT_PARTS_SUFFIX);
+	if (!context->parts_file)
+		return;
+
+	context->parts_new_file = snapshot_get_parts_file (snapshot_file, SNAPSHOT_PARTS_NEW_SUFFIX);
+
+	sparts = g_object_get_data (G_OBJECT (composer), SNAPSHOT_PARTS_KEY);
+	if (!sparts) {
+		sparts = g_slice_new0 (SnapshotParts);
+		sparts->ids = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
+
+		g_object_set_data_full (G_OBJECT (composer), SNAPSHOT_PARTS_KEY, sparts, snapshot_parts_free);
+	}
+
+	context->parts = g_ptr_array_new_with_free_func (journal_part_free);
+	context->sparts = sparts;
+
+	multipart = camel_multipart_new ();
+	camel_multipart_set_boundary (multipart, NULL);
+
+	/* The first part is the message body */
+	camel_multipart_add_part (multipart, camel_multipart_get_part (CAMEL_MULTIPART (content), 0));
+
+	for (ii = 1; ii < n_parts; ii++) {
+		CamelMimePart *part, *placeholder;
+		JournalPart *jpart;
+		gpointer id;
+		gchar *value;
+
+		part = camel_multipart_get_part (CAMEL_MULTIPART (content), ii);
+
+		jpart = g_slice_new0 (JournalPart);
+		jpart->part = g_object_ref (part);
+
+		if (g_hash_table_lookup_extended (sparts->ids, part, NULL, &id)) {
+			jpart->id = GPOINTER_TO_UINT (id);
+			n_known++;
+		} else {
+			jpart->id = ++sparts->last_id;
+			jpart->is_new = TRUE;
+		}
+
+		g_ptr_array_add (context->parts, jpart);
+
+		value = g_strdup_printf ("%u", jpart->id);
+
+		placeholder = camel_mime_part_new ();
+		camel_medium_set_header (CAMEL_MEDIUM (placeholder), SNAPSHOT_PART_HEADER, value);
+		camel_mime_part_set_content (placeholder, "", 0, "text/plain");
+		camel_multipart_add_part (multipart, placeholder);
+
+		g_object_unref (placeholder);
+		g_free (value);
+	}
+
+	camel_medium_set_content (CAMEL_MEDIUM (message), CAMEL_DATA_WRAPPER (multipart));
+	g_object_unref (multipart);
+
+	/* Compact the journal when any of the parts written before is gone */
+	context->parts_rewrite = !sparts->written || n_known != g_hash_table_size (sparts->ids);
+}
+
 static void
 save_snapshot_get_message_cb (EMsgComposer *composer,
                               GAsyncResult *result,
@@ -285,9 +819,11 @@ save_snapshot_get_message_cb (EMsgComposer *composer,
 
 	g_return_if_fail (CAMEL_IS_MIME_MESSAGE (message));
 
+	save_snapshot_prepare_parts (composer, message, context);
+
 	task = g_task_new (message, context->cancellable, (GAsyncReadyCallback) save_snapshot_splice_cb, simple);
 
-	g_task_set_task_data (task, g_object_ref (context->output_stream), g_object_unref);
+	g_task_set_task_data (task, context, NULL);
 
 	g_task_run_in_thread (task, write_message_to_stream_thread);
 
@@ -387,7 +923,8 @@ e_composer_find_orphans (GQueue *registry,
 		struct stat st;
 
 		/* Is this a snapshot file? */
-		if (!g_str_has_prefix (basename, SNAPSHOT_FILE_PREFIX))
+		if (!g_str_has_prefix (basename, SNAPSHOT_FILE_PREFIX) ||
+		    g_str_has_suffix (basename, SNAPSHOT_PARTS_SUFFIX))
 			continue;
 
 		/* Is this an orphaned snapshot file? */
@@ -413,6 +950,16 @@ e_composer_find_orphans (GQueue *registry,
 			if (g_unlink (filename) < 0) {
 				errmsg = g_strerror (errno);
 				g_warning ("%s: %s", filename, errmsg);
+			} else {
+				gchar *parts_filename;
+
+				parts_filename = g_strconcat (filename, SNAPSHOT_PARTS_SUFFIX, NULL);
+				g_unlink (parts_filename);
+				g_free (parts_filename);
+
+				parts_filename = g_strconcat (filename, SNAPSHOT_PARTS_NEW_SUFFIX, NULL);
+				g_unlink (parts_filename);
+				g_free (parts_filename);
 			}
 			g_free (filename);
 			continue;
@@ -557,6 +1104,28 @@ e_composer_get_snapshot_file (EMsgComposer *composer)
 	return g_object_get_data (G_OBJECT (composer), SNAPSHOT_FILE_KEY);
 }
 
+void
+e_composer_delete_snapshot (GFile *snapshot_file)
+{
+	GFile *parts_file;
+
+	g_return_if_fail (G_IS_FILE (snapshot_file));
+
+	g_file_delete (snapshot_file, NULL, NULL);
+
+	parts_file = snapshot_get_parts_file (snapshot_file, SNAPSHOT_PARTS_SUFFIX);
+	if (parts_file) {
+		g_file_delete (parts_file, NULL, NULL);
+		g_object_unref (parts_file);
+	}
+
+	parts_file = snapshot_get_parts_file (snapshot_file, SNAPSHOT_PARTS_NEW_SUFFIX);
+	if (parts_file) {
+		g_file_delete (parts_file, NULL, NULL);
+		g_object_unref (parts_file);
+	}
+}
+
 void
 e_composer_prevent_snapshot_file_delete (EMsgComposer *composer)
 {
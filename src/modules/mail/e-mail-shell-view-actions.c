@@ -539,7 +539,6 @@ mark_all_read_thread (GSimpleAsyncResult *simple,
 	CamelStore *store;
 	CamelFolder *folder;
 	GPtrArray *uids;
-	gint ii;
 	GError *error = NULL;
 
 	context = g_simple_async_result_get_op_res_gpointer (simple);
@@ -556,17 +555,12 @@ mark_all_read_thread (GSimpleAsyncResult *simple,
 		if (folder == NULL)
 			break;
 
-		camel_folder_freeze (folder);
-
 		uids = camel_folder_get_uids (folder);
 
-		for (ii = 0; ii < uids->len; ii++)
-			camel_folder_set_message_flags (
-				folder, uids->pdata[ii],
-				CAMEL_MESSAGE_SEEN,
-				CAMEL_MESSAGE_SEEN);
-
-		camel_folder_thaw (folder);
+		e_mail_folder_set_messages_flags (
+			folder, uids,
+			CAMEL_MESSAGE_SEEN,
+			CAMEL_MESSAGE_SEEN, NULL);
 
 		/* Save changes to the server immediately. */
 		camel_folder_synchronize_sync (folder, FALSE, cancellable, &error);
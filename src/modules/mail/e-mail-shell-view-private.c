@@ -732,6 +732,16 @@ e_mail_shell_view_private_dispose (EMailShellView *mail_shell_view)
 		g_clear_object (&priv->opening_folder);
 	}
 
+	if (priv->search_account_refresh_id) {
+		g_source_remove (priv->search_account_refresh_id);
+		priv->search_account_refresh_id = 0;
+	}
+
+	if (priv->search_index) {
+		e_signal_disconnect_notify_handler (priv->search_index, &priv->excluded_folder_changed_handler_id);
+		g_clear_object (&priv->search_index);
+	}
+
 	g_clear_object (&priv->search_folder_and_subfolders);
 	g_clear_object (&priv->search_account_all);
 	g_clear_object (&priv->search_account_current);
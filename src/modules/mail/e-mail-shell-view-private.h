@@ -29,6 +29,7 @@
 #include <mail/e-mail-folder-create-dialog.h>
 #include <mail/e-mail-reader.h>
 #include <mail/e-mail-reader-utils.h>
+#include <mail/e-mail-search-index.h>
 #include <mail/e-mail-sidebar.h>
 #include <mail/e-mail-ui-session.h>
 #include <mail/em-composer-utils.h>
@@ -133,6 +134,12 @@ struct _EMailShellViewPrivate {
 	CamelVeeFolder *search_account_current;
 	GCancellable *search_account_cancel;
 
+	/* EMailSearchIndex::excluded-folder-changed, to add folders
+	 * which can match after a change to the account searches */
+	EMailSearchIndex *search_index;
+	gulong excluded_folder_changed_handler_id;
+	guint search_account_refresh_id;
+
 	GtkToolItem *send_receive_tool_item;
 	GtkToolItem *send_receive_tool_separator;
 
@@ -50,6 +50,8 @@ static const gchar *SEARCH_RESULTS_STATE =
 static void
 add_folders_from_store (GList **folders,
                         CamelStore *store,
+                        EMailSearchIndex *search_index,
+                        const gchar *expression,
                         GCancellable *cancellable,
                         GError **error)
 {
@@ -74,7 +76,10 @@ add_folders_from_store (GList **folders,
 			fldr = camel_store_get_folder_sync (
 				store, fi->full_name, 0, cancellable, error);
 			if (fldr) {
-				if (CAMEL_IS_VEE_FOLDER (fldr)) {
+				/* Skip folders which cannot match, to not
+				 * evaluate the expression on them at all. */
+				if (CAMEL_IS_VEE_FOLDER (fldr) || (search_index &&
+				    !e_mail_search_index_folder_may_match (search_index, fldr, expression))) {
 					g_object_unref (fldr);
 				} else {
 					*folders = g_list_prepend (*folders, fldr);
@@ -110,6 +115,8 @@ typedef struct {
 	CamelFolder *folder;
 	GCancellable *cancellable;
 	GList *stores_list;
+	EMailSearchIndex *search_index;
+	gchar *expression;
 } SearchResultsMsg;
 
 static gchar *
@@ -131,7 +138,9 @@ search_results_exec (SearchResultsMsg *msg,
 		if (g_cancellable_is_cancelled (cancellable))
 			break;
 
-		add_folders_from_store (&folders, store, cancellable, error);
+		add_folders_from_store (
+			&folders, store, msg->search_index,
+			msg->expression, cancellable, error);
 	}
 
 	if (!g_cancellable_is_cancelled (cancellable)) {
@@ -155,6 +164,8 @@ search_results_free (SearchResultsMsg *msg)
 {
 	g_object_unref (msg->folder);
 	g_list_free_full (msg->stores_list, g_object_unref);
+	g_clear_object (&msg->search_index);
+	g_free (msg->expression);
 }
 
 static MailMsgInfo search_results_setup_info = {
@@ -171,14 +182,25 @@ mail_shell_view_setup_search_results_folder (CamelFolder *folder,
                                              GCancellable *cancellable)
 {
 	SearchResultsMsg *msg;
+	CamelSession *session;
 	gint id;
 
 	g_object_ref (folder);
 
+	session = camel_service_ref_session (CAMEL_SERVICE (camel_folder_get_parent_store (folder)));
+
 	msg = mail_msg_new (&search_results_setup_info);
 	msg->folder = folder;
 	msg->cancellable = cancellable;
 	msg->stores_list = stores;
+	msg->expression = g_strdup (camel_vee_folder_get_expression (CAMEL_VEE_FOLDER (folder)));
+
+	if (E_IS_MAIL_SESSION (session)) {
+		msg->search_index = e_mail_search_index_ref_default (
+			e_mail_session_get_folder_cache (E_MAIL_SESSION (session)));
+	}
+
+	g_clear_object (&session);
 
 	id = msg->base.seq;
 	mail_msg_slow_ordered_push (msg);
@@ -186,6 +208,96 @@ mail_shell_view_setup_search_results_folder (CamelFolder *folder,
 	return id;
 }
 
+static gboolean
+mail_shell_view_refresh_search_account_cb (gpointer user_data)
+{
+	EMailShellView *mail_shell_view = user_data;
+	EMailShellViewPrivate *priv = mail_shell_view->priv;
+	EMailView *mail_view;
+	EMFolderTree *folder_tree;
+	CamelFolder *folder;
+	GList *list = NULL;
+
+	priv->search_account_refresh_id = 0;
+
+	mail_view = e_mail_shell_content_get_mail_view (priv->mail_shell_content);
+	folder = e_mail_reader_ref_folder (E_MAIL_READER (mail_view));
+
+	/* Only the shown search is refreshed; the other is set up
+	 * again when its scope is chosen. */
+	if (!folder || (folder != CAMEL_FOLDER (priv->search_account_all) &&
+	    folder != CAMEL_FOLDER (priv->search_account_current))) {
+		g_clear_object (&folder);
+		return FALSE;
+	}
+
+	folder_tree = e_mail_shell_sidebar_get_folder_tree (priv->mail_shell_sidebar);
+
+	if (folder == CAMEL_FOLDER (priv->search_account_all)) {
+		list = em_folder_tree_model_list_stores (EM_FOLDER_TREE_MODEL (
+			gtk_tree_view_get_model (GTK_TREE_VIEW (folder_tree))));
+		g_list_foreach (list, (GFunc) g_object_ref, NULL);
+	} else {
+		CamelStore *store = NULL;
+
+		em_folder_tree_get_selected (folder_tree, &store, NULL);
+
+		if (store != NULL)
+			list = g_list_append (NULL, store);
+	}
+
+	if (priv->search_account_cancel != NULL) {
+		g_cancellable_cancel (priv->search_account_cancel);
+		g_object_unref (priv->search_account_cancel);
+	}
+
+	priv->search_account_cancel = camel_operation_new ();
+
+	/* This takes ownership of the stores list. */
+	mail_shell_view_setup_search_results_folder (
+		folder, list, priv->search_account_cancel);
+
+	g_object_unref (folder);
+
+	return FALSE;
+}
+
+static void
+mail_shell_view_excluded_folder_changed_cb (EMailShellView *mail_shell_view,
+                                            CamelStore *store,
+                                            const gchar *folder_name,
+                                            EMailSearchIndex *search_index)
+{
+	EMailShellViewPrivate *priv = mail_shell_view->priv;
+
+	/* The account searches contain only folders which could
+	 * match, thus any change can make another folder match. */
+	if ((!priv->search_account_all && !priv->search_account_current) ||
+	    priv->search_account_refresh_id)
+		return;
+
+	priv->search_account_refresh_id = e_named_timeout_add_seconds (
+		5, mail_shell_view_refresh_search_account_cb, mail_shell_view);
+}
+
+static void
+mail_shell_view_watch_search_index (EMailShellView *mail_shell_view,
+                                    EMailSession *session)
+{
+	EMailShellViewPrivate *priv = mail_shell_view->priv;
+
+	if (priv->search_index)
+		return;
+
+	priv->search_index = e_mail_search_index_ref_default (
+		e_mail_session_get_folder_cache (session));
+
+	priv->excluded_folder_changed_handler_id = g_signal_connect_swapped (
+		priv->search_index, "excluded-folder-changed",
+		G_CALLBACK (mail_shell_view_excluded_folder_changed_cb),
+		mail_shell_view);
+}
+
 typedef struct {
 	MailMsg base;
 
@@ -200,16 +312,53 @@ search_results_with_subfolders_desc (SearchResultsWithSubfoldersMsg *msg)
 	return g_strdup (_("Searching"));
 }
 
+/* How many folders can be opened and searched at once */
+#define SEARCH_MAX_THREADS 4
+
+typedef struct _SearchFolderData {
+	CamelStore *store;
+	GCancellable *cancellable;
+	GPtrArray *full_names;	/* gchar *, in the folder tree order */
+
+	GMutex lock;
+	GCond cond;
+	CamelFolder **folders;	/* filled by the threads */
+	gboolean *opened;	/* whether the matching folder is done */
+} SearchFolderData;
+
+static void
+search_results_with_subfolders_open_thread (gpointer data,
+					    gpointer user_data)
+{
+	SearchFolderData *sfd = user_data;
+	guint index = GPOINTER_TO_UINT (data) - 1;
+	CamelFolder *folder = NULL;
+
+	if (!g_cancellable_is_cancelled (sfd->cancellable))
+		folder = camel_store_get_folder_sync (
+			sfd->store, sfd->full_names->pdata[index],
+			0, sfd->cancellable, NULL);
+
+	g_mutex_lock (&sfd->lock);
+	sfd->folders[index] = folder;
+	sfd->opened[index] = TRUE;
+	g_cond_broadcast (&sfd->cond);
+	g_mutex_unlock (&sfd->lock);
+}
+
 static void
 search_results_with_subfolders_exec (SearchResultsWithSubfoldersMsg *msg,
 				     GCancellable *cancellable,
 				     GError **error)
 {
-	GList *folders = NULL;
+	CamelVeeFolder *vfolder = CAMEL_VEE_FOLDER (msg->vfolder);
 	CamelStore *root_store;
 	CamelFolderInfo *fi;
 	const CamelFolderInfo *cur;
 	const gchar *root_folder_name;
+	GHashTable *full_names;
+	GPtrArray *ordered_names;
+	GList *folders, *link;
 
 	root_store = camel_folder_get_parent_store (msg->root_folder);
 	if (!root_store)
@@ -220,14 +369,17 @@ search_results_with_subfolders_exec (SearchResultsWithSubfoldersMsg *msg,
 	fi = camel_store_get_folder_info_sync (root_store, root_folder_name,
 		CAMEL_STORE_FOLDER_INFO_RECURSIVE, cancellable, NULL);
 
+	full_names = g_hash_table_new (g_str_hash, g_str_equal);
+	ordered_names = g_ptr_array_new_with_free_func (g_free);
+
 	cur = fi;
 	while (cur && !g_cancellable_is_cancelled (cancellable)) {
-		if ((cur->flags & CAMEL_FOLDER_NOSELECT) == 0) {
-			CamelFolder *folder;
+		if ((cur->flags & CAMEL_FOLDER_NOSELECT) == 0 &&
+		    !g_hash_table_contains (full_names, cur->full_name)) {
+			gchar *full_name = g_strdup (cur->full_name);
 
-			folder = camel_store_get_folder_sync (root_store, cur->full_name, 0, cancellable, NULL);
-			if (folder)
-				folders = g_list_prepend (folders, folder);
+			g_ptr_array_add (ordered_names, full_name);
+			g_hash_table_add (full_names, full_name);
 		}
 
 		/* move to the next fi */
@@ -247,15 +399,82 @@ search_results_with_subfolders_exec (SearchResultsWithSubfoldersMsg *msg,
 
 	camel_folder_info_free (fi);
 
-	if (!g_cancellable_is_cancelled (cancellable)) {
-		CamelVeeFolder *vfolder = CAMEL_VEE_FOLDER (msg->vfolder);
+	if (g_cancellable_is_cancelled (cancellable)) {
+		g_hash_table_destroy (full_names);
+		g_ptr_array_unref (ordered_names);
+		return;
+	}
 
-		folders = g_list_reverse (folders);
+	/* The search folder is reused, thus first remove the folders
+	 * from the previous search which are not part of this one. */
+	folders = camel_vee_folder_ref_folders (vfolder);
 
-		camel_vee_folder_set_folders (vfolder, folders, cancellable);
+	for (link = folders; link; link = g_list_next (link)) {
+		CamelFolder *folder = link->data;
+
+		if (camel_folder_get_parent_store (folder) != root_store ||
+		    !g_hash_table_contains (full_names, camel_folder_get_full_name (folder)))
+			camel_vee_folder_remove_folder (vfolder, folder, cancellable);
 	}
 
 	g_list_free_full (folders, g_object_unref);
+
+	if (!g_cancellable_is_cancelled (cancellable) && ordered_names->len > 0) {
+		SearchFolderData sfd;
+		GThreadPool *thread_pool;
+		guint ii;
+
+		sfd.store = root_store;
+		sfd.cancellable = cancellable;
+		sfd.full_names = ordered_names;
+		g_mutex_init (&sfd.lock);
+		g_cond_init (&sfd.cond);
+		sfd.folders = g_new0 (CamelFolder *, ordered_names->len);
+		sfd.opened = g_new0 (gboolean, ordered_names->len);
+
+		/* Open the folders in parallel, but add them to the search
+		 * folder only from this thread and in the folder tree order.
+		 * Adding a folder evaluates the search on it and notifies
+		 * about the matches, thus they show in the message list as
+		 * soon as the folder is done, not after all of them. */
+		thread_pool = g_thread_pool_new (
+			search_results_with_subfolders_open_thread,
+			&sfd, SEARCH_MAX_THREADS, FALSE, NULL);
+
+		for (ii = 0; ii < ordered_names->len; ii++) {
+			g_thread_pool_push (thread_pool, GUINT_TO_POINTER (ii + 1), NULL);
+		}
+
+		for (ii = 0; ii < ordered_names->len; ii++) {
+			CamelFolder *folder;
+
+			g_mutex_lock (&sfd.lock);
+			while (!sfd.opened[ii])
+				g_cond_wait (&sfd.cond, &sfd.lock);
+			folder = sfd.folders[ii];
+			g_mutex_unlock (&sfd.lock);
+
+			if (!folder)
+				continue;
+
+			/* The folders already in the search folder are skipped by it */
+			if (!g_cancellable_is_cancelled (cancellable))
+				camel_vee_folder_add_folder (vfolder, folder, cancellable);
+
+			g_object_unref (folder);
+		}
+
+		/* All the threads are done by now */
+		g_thread_pool_free (thread_pool, FALSE, TRUE);
+
+		g_free (sfd.folders);
+		g_free (sfd.opened);
+		g_cond_clear (&sfd.cond);
+		g_mutex_clear (&sfd.lock);
+	}
+
+	g_hash_table_destroy (full_names);
+	g_ptr_array_unref (ordered_names);
 }
 
 static void
@@ -1016,6 +1235,8 @@ all_accounts:
 
 	g_object_unref (service);
 
+	mail_shell_view_watch_search_index (E_MAIL_SHELL_VIEW (shell_view), session);
+
 	camel_vee_folder_set_expression (search_folder, query);
 
 all_accounts_setup:
@@ -1124,6 +1345,8 @@ current_account:
 
 	g_object_unref (service);
 
+	mail_shell_view_watch_search_index (E_MAIL_SHELL_VIEW (shell_view), session);
+
 	camel_vee_folder_set_expression (search_folder, query);
 
 current_accout_setup:
@@ -55,6 +55,15 @@
 
 #define d(x)
 
+/* How many messages are decoded in parallel, and how many
+ * decoded messages can wait to be appended to the folder. */
+#define DBX_IMPORT_THREADS 4
+#define DBX_IMPORT_WINDOW 64
+
+/* How many messages are appended to the frozen folder before
+ * its changes are saved and announced. */
+#define DBX_IMPORT_BATCH 100
+
 #ifdef WIN32
 #ifdef gmtime_r
 #undef gmtime_r
@@ -101,6 +110,10 @@ typedef struct {
 	guint32 *indices;
 	guint32 index_count;
 
+	/* Protects the done flags of the DbxImportJob-s */
+	GMutex jobs_lock;
+	GCond jobs_cond;
+
 	gchar *uri;
 	gint dbx_fd;
 
@@ -315,9 +328,20 @@ struct _dbx_block_hdrstruct {
 
 static gint dbx_pread (gint fd, gpointer buf, guint32 count, guint32 offset)
 {
+	/* The import workers share the file descriptor */
+	static GMutex pread_lock;
+	gint res;
+
+	g_mutex_lock (&pread_lock);
+
 	if (lseek (fd, offset, SEEK_SET) != offset)
-		return -1;
-	return read (fd, buf, count);
+		res = -1;
+	else
+		res = read (fd, buf, count);
+
+	g_mutex_unlock (&pread_lock);
+
+	return res;
 }
 
 static gboolean dbx_load_index_table (DbxImporter *m, guint32 pos, guint32 *index_ofs)
@@ -430,27 +454,23 @@ static gboolean dbx_load_indices (DbxImporter *m)
 }
 
 static gboolean
-dbx_read_mail_body (DbxImporter *m,
+dbx_read_mail_body (gint dbx_fd,
                     guint32 offset,
-                    gint bodyfd)
+                    GByteArray *body,
+                    GError **error)
 {
-	/* FIXME: We really ought to set up CamelStream that we can feed to the
-	 * MIME parser, rather than using a temporary file */
-
 	struct _dbx_block_hdrstruct hdr;
 	guint32 buflen = 0x200;
 	guchar *buffer = g_malloc (buflen);
 
-	if (ftruncate (bodyfd, 0) == -1)
-		g_warning ("%s: Failed to truncate file: %s", G_STRFUNC, g_strerror (errno));
-	lseek (bodyfd, 0, SEEK_SET);
+	g_byte_array_set_size (body, 0);
 
 	while (offset) {
 		d (printf ("Reading mail data chunk from %x\n", offset));
 
-		if (dbx_pread (m->dbx_fd, &hdr, sizeof (hdr), offset) != sizeof (hdr)) {
+		if (dbx_pread (dbx_fd, &hdr, sizeof (hdr), offset) != sizeof (hdr)) {
 			g_set_error (
-				&m->base.error,
+				error,
 				CAMEL_ERROR, CAMEL_ERROR_GENERIC,
 				"Failed to read mail data block from "
 				"DBX file at offset %x", offset);
@@ -463,7 +483,7 @@ dbx_read_mail_body (DbxImporter *m,
 
 		if (hdr.self != offset) {
 			g_set_error (
-				&m->base.error,
+				error,
 				CAMEL_ERROR, CAMEL_ERROR_GENERIC,
 				"Corrupt DBX file: Mail data block at "
 				"0x%x does not point to itself", offset);
@@ -476,10 +496,10 @@ dbx_read_mail_body (DbxImporter *m,
 			buflen = hdr.blocksize;
 			buffer = g_malloc (buflen);
 		}
-		if (dbx_pread (m->dbx_fd, buffer, hdr.blocksize,
+		if (dbx_pread (dbx_fd, buffer, hdr.blocksize,
 			offset + sizeof (hdr)) != hdr.blocksize) {
 			g_set_error (
-				&m->base.error,
+				error,
 				CAMEL_ERROR, CAMEL_ERROR_GENERIC,
 				"Failed to read mail data from DBX file "
 				"at offset %lx",
@@ -487,14 +507,7 @@ dbx_read_mail_body (DbxImporter *m,
 			g_free (buffer);
 			return FALSE;
 		}
-		if (write (bodyfd, buffer, hdr.blocksize) != hdr.blocksize) {
-			g_set_error (
-				&m->base.error,
-				CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-				"Failed to write mail data to temporary file");
-			g_free (buffer);
-			return FALSE;
-		}
+		g_byte_array_append (body, buffer, hdr.blocksize);
 		offset = hdr.nextaddress;
 	}
 
@@ -504,19 +517,20 @@ dbx_read_mail_body (DbxImporter *m,
 }
 
 static gboolean
-dbx_read_email (DbxImporter *m,
+dbx_read_email (gint dbx_fd,
                 guint32 offset,
-                gint bodyfd,
-                gint *flags)
+                GByteArray *body,
+                gint *flags,
+                GError **error)
 {
 	struct _dbx_email_headerstruct hdr;
 	guchar *buffer;
 	guint32 dataptr = 0;
 	gint i;
 
-	if (dbx_pread (m->dbx_fd, &hdr, sizeof (hdr), offset) != sizeof (hdr)) {
+	if (dbx_pread (dbx_fd, &hdr, sizeof (hdr), offset) != sizeof (hdr)) {
 		g_set_error (
-			&m->base.error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
 			"Failed to read mail header from DBX file at offset %x",
 			offset);
 		return FALSE;
@@ -526,16 +540,16 @@ dbx_read_email (DbxImporter *m,
 
 	if (hdr.self != offset) {
 		g_set_error (
-			&m->base.error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
 			"Corrupt DBX file: Mail header at 0x%x does not "
 			"point to itself", offset);
 		return FALSE;
 	}
 	buffer = g_malloc (hdr.size);
 	offset += sizeof (hdr);
-	if (dbx_pread (m->dbx_fd, buffer, hdr.size, offset) != hdr.size) {
+	if (dbx_pread (dbx_fd, buffer, hdr.size, offset) != hdr.size) {
 		g_set_error (
-			&m->base.error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
+			error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
 			"Failed to read mail data block from DBX file "
 			"at offset %x", offset);
 		g_free (buffer);
@@ -578,7 +592,203 @@ dbx_read_email (DbxImporter *m,
 	if (!dataptr)
 		return FALSE;
 
-	return dbx_read_mail_body (m, dataptr, bodyfd);
+	return dbx_read_mail_body (dbx_fd, dataptr, body, error);
+}
+
+typedef struct {
+	guint32 offset;
+	gboolean done;
+
+	CamelMimeMessage *msg;
+	gint flags;
+	gboolean missing;
+	GError *error;
+} DbxImportJob;
+
+static void
+dbx_import_job_free (gpointer ptr)
+{
+	DbxImportJob *job = ptr;
+
+	if (job) {
+		g_clear_object (&job->msg);
+		g_clear_error (&job->error);
+		g_free (job);
+	}
+}
+
+/* Reads and parses one message, in a worker thread; the messages
+ * are appended to the folder in order, by dbx_import_file(). */
+static void
+dbx_import_job_run (gpointer data,
+                    gpointer user_data)
+{
+	DbxImportJob *job = data;
+	DbxImporter *m = user_data;
+	GByteArray *body;
+	gint dbx_flags = 0;
+
+	body = g_byte_array_new ();
+
+	if (g_cancellable_is_cancelled (m->base.cancellable)) {
+		g_byte_array_free (body, TRUE);
+	} else if (!dbx_read_email (m->dbx_fd, job->offset, body, &dbx_flags, &job->error)) {
+		d (printf ("Cannot read email at %x\n", job->offset));
+		g_byte_array_free (body, TRUE);
+		job->missing = job->error == NULL;
+	} else {
+		CamelStream *stream;
+		CamelMimeParser *mp;
+		CamelMimeMessage *msg;
+
+		if (dbx_flags & 0x40)
+			job->flags |= CAMEL_MESSAGE_DELETED;
+		if (dbx_flags & 0x80)
+			job->flags |= CAMEL_MESSAGE_SEEN;
+		if (dbx_flags & 0x80000)
+			job->flags |= CAMEL_MESSAGE_ANSWERED;
+
+		/* The stream takes ownership of the body */
+		stream = camel_stream_mem_new_with_byte_array (body);
+
+		mp = camel_mime_parser_new ();
+		camel_mime_parser_init_with_stream (mp, stream, NULL);
+
+		msg = camel_mime_message_new ();
+		if (camel_mime_part_construct_from_parser_sync (
+			(CamelMimePart *) msg, mp, NULL, NULL))
+			job->msg = msg;
+		else
+			g_object_unref (msg);
+
+		g_object_unref (mp);
+		g_object_unref (stream);
+	}
+
+	g_mutex_lock (&m->jobs_lock);
+	job->done = TRUE;
+	g_cond_broadcast (&m->jobs_cond);
+	g_mutex_unlock (&m->jobs_lock);
+}
+
+/* Called for each message, in the DBX order */
+typedef gboolean (* DbxImportAppendFunc)	(CamelMimeMessage *msg,
+						 gint flags,
+						 gpointer user_data,
+						 GCancellable *cancellable,
+						 GError **error);
+
+/* Reads the messages from the opened DBX file on the worker pool and
+ * passes them to the append_func, in the DBX order. Any error is set
+ * to m->base.error. Returns how many message bodies were missing. */
+static gint
+dbx_import_messages (DbxImporter *m,
+                     DbxImportAppendFunc append_func,
+                     gpointer user_data,
+                     GCancellable *cancellable)
+{
+	GThreadPool *pool;
+	GQueue jobs = G_QUEUE_INIT;
+	guint32 next = 0, appended;
+	gint missing = 0;
+
+	if (!dbx_load_indices (m))
+		return 0;
+
+	/* The messages are read and parsed by the workers, ahead of the
+	 * message being appended, and are appended in the DBX order. */
+	pool = g_thread_pool_new (dbx_import_job_run, m, DBX_IMPORT_THREADS, FALSE, NULL);
+
+	for (appended = 0; appended < m->index_count; appended++) {
+		DbxImportJob *job;
+		gboolean success;
+
+		while (next < m->index_count && g_queue_get_length (&jobs) < DBX_IMPORT_WINDOW) {
+			job = g_new0 (DbxImportJob, 1);
+			job->offset = m->indices[next++];
+
+			g_queue_push_tail (&jobs, job);
+			g_thread_pool_push (pool, job, NULL);
+		}
+
+		job = g_queue_peek_head (&jobs);
+
+		g_mutex_lock (&m->jobs_lock);
+		while (!job->done)
+			g_cond_wait (&m->jobs_cond, &m->jobs_lock);
+		g_mutex_unlock (&m->jobs_lock);
+
+		g_queue_pop_head (&jobs);
+
+		camel_operation_progress (NULL, 100 * appended / m->index_count);
+		camel_operation_progress (cancellable, 100 * appended / m->index_count);
+
+		if (job->error) {
+			g_propagate_error (&m->base.error, job->error);
+			job->error = NULL;
+			dbx_import_job_free (job);
+			break;
+		}
+
+		if (job->missing) {
+			missing++;
+			dbx_import_job_free (job);
+			continue;
+		}
+
+		/* Failed to parse, or cancelled */
+		if (!job->msg) {
+			dbx_import_job_free (job);
+			break;
+		}
+
+		success = append_func (job->msg, job->flags, user_data, cancellable, &m->base.error);
+		dbx_import_job_free (job);
+
+		if (!success)
+			break;
+	}
+
+	/* Drop the messages not started yet and wait for the rest */
+	g_thread_pool_free (pool, TRUE, TRUE);
+	g_queue_foreach (&jobs, (GFunc) dbx_import_job_free, NULL);
+	g_queue_clear (&jobs);
+
+	return missing;
+}
+
+typedef struct {
+	CamelFolder *folder;
+	gint batch;
+} DbxImportFolder;
+
+static gboolean
+dbx_import_append_to_folder (CamelMimeMessage *msg,
+                             gint flags,
+                             gpointer user_data,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+	DbxImportFolder *ifolder = user_data;
+	CamelMessageInfo *info;
+	gboolean success;
+
+	info = camel_message_info_new (NULL);
+	camel_message_info_set_flags (info, flags, ~0);
+	success = camel_folder_append_message_sync (
+		ifolder->folder, msg, info, NULL,
+		cancellable, error);
+	g_clear_object (&info);
+
+	if (success && ++ifolder->batch >= DBX_IMPORT_BATCH) {
+		success = camel_folder_synchronize_sync (
+			ifolder->folder, FALSE, cancellable, error);
+		camel_folder_thaw (ifolder->folder);
+		camel_folder_freeze (ifolder->folder);
+		ifolder->batch = 0;
+	}
+
+	return success;
 }
 
 static void
@@ -590,8 +800,7 @@ dbx_import_file (DbxImporter *m)
 	GCancellable *cancellable;
 	gchar *filename;
 	CamelFolder *folder;
-	gint tmpfile;
-	gint i;
+	DbxImportFolder ifolder;
 	gint missing = 0;
 	m->status_what = NULL;
 	filename = g_filename_from_uri (
@@ -631,78 +840,19 @@ dbx_import_file (DbxImporter *m)
 		goto out;
 	}
 
-	if (!dbx_load_indices (m))
-		goto out;
-
-	tmpfile = e_mkstemp ("dbx-import-XXXXXX");
-	if (tmpfile == -1) {
-		g_set_error (
-			&m->base.error, CAMEL_ERROR, CAMEL_ERROR_GENERIC,
-			"Failed to create temporary file for import");
-		goto out;
-	}
-
-	for (i = 0; i < m->index_count; i++) {
-		CamelMessageInfo *info;
-		CamelMimeMessage *msg;
-		CamelMimeParser *mp;
-		gint dbx_flags = 0;
-		gint flags = 0;
-		gboolean success;
-
-		camel_operation_progress (NULL, 100 * i / m->index_count);
-		camel_operation_progress (cancellable, 100 * i / m->index_count);
-
-		if (!dbx_read_email (m, m->indices[i], tmpfile, &dbx_flags)) {
-			d (
-				printf ("Cannot read email index %d at %x\n",
-				i, m->indices[i]));
-			if (m->base.error != NULL)
-				goto out;
-			missing++;
-			continue;
-		}
-		if (dbx_flags & 0x40)
-			flags |= CAMEL_MESSAGE_DELETED;
-		if (dbx_flags & 0x80)
-			flags |= CAMEL_MESSAGE_SEEN;
-		if (dbx_flags & 0x80000)
-			flags |= CAMEL_MESSAGE_ANSWERED;
+	ifolder.folder = folder;
+	ifolder.batch = 0;
 
-		mp = camel_mime_parser_new ();
-
-		lseek (tmpfile, 0, SEEK_SET);
-		camel_mime_parser_init_with_fd (mp, tmpfile);
+	missing = dbx_import_messages (m, dbx_import_append_to_folder, &ifolder, cancellable);
 
-		msg = camel_mime_message_new ();
-		if (!camel_mime_part_construct_from_parser_sync (
-			(CamelMimePart *) msg, mp, NULL, NULL)) {
-			/* set exception? */
-			g_object_unref (msg);
-			g_object_unref (mp);
-			break;
-		}
-
-		info = camel_message_info_new (NULL);
-		camel_message_info_set_flags (info, flags, ~0);
-		success = camel_folder_append_message_sync (
-			folder, msg, info, NULL,
-			cancellable, &m->base.error);
-		g_clear_object (&info);
-		g_object_unref (msg);
-
-		if (!success) {
-			g_object_unref (mp);
-			break;
-		}
-	}
  out:
 	if (m->dbx_fd != -1)
 		close (m->dbx_fd);
 	if (m->indices)
 		g_free (m->indices);
-	/* FIXME Not passing GCancellable or GError here. */
-	camel_folder_synchronize_sync (folder, FALSE, NULL, NULL);
+	/* Not passing the cancellable, the messages appended so far
+	 * are saved also when the import is cancelled. */
+	camel_folder_synchronize_sync (folder, FALSE, NULL, m->base.error ? NULL : &m->base.error);
 	camel_folder_thaw (folder);
 	g_object_unref (folder);
 	if (missing && m->base.error == NULL) {
@@ -734,6 +884,8 @@ dbx_import_free (DbxImporter *m)
 {
 	g_free (m->status_what);
 	g_mutex_clear (&m->status_lock);
+	g_mutex_clear (&m->jobs_lock);
+	g_cond_clear (&m->jobs_cond);
 
 	g_source_remove (m->status_timeout_id);
 	m->status_timeout_id = 0;
@@ -811,6 +963,8 @@ org_gnome_evolution_readdbx_import (EImport *ei,
 	m->status_timeout_id =
 		e_named_timeout_add (100, dbx_status_timeout, m);
 	g_mutex_init (&m->status_lock);
+	g_mutex_init (&m->jobs_lock);
+	g_cond_init (&m->jobs_cond);
 	m->cancellable = camel_operation_new ();
 
 	g_signal_connect (
@@ -0,0 +1,278 @@
+/*
+ * test-dbx-importer.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Writes a small DBX file and checks that the messages read from it on
+ * the worker pool are passed on complete and in the DBX order. */
+
+#include "dbx-importer.c"
+
+/* More than one index table and more than the worker window */
+#define N_MESSAGES 250
+#define N_PER_TABLE 100
+
+/* This message has no body in the file */
+#define MISSING_MESSAGE 123
+
+typedef struct {
+	GPtrArray *subjects;
+	GArray *flags;
+} TestAppended;
+
+static void
+test_put_u32 (GByteArray *data,
+              guint32 offset,
+              guint32 value)
+{
+	value = GUINT32_TO_LE (value);
+
+	if (data->len < offset + 4)
+		g_byte_array_set_size (data, offset + 4);
+
+	memcpy (data->data + offset, &value, 4);
+}
+
+static guint32
+test_add_block (GByteArray *data,
+                const gchar *text,
+                guint16 len,
+                guint32 nextaddress)
+{
+	struct _dbx_block_hdrstruct hdr;
+	guint32 offset = data->len;
+
+	memset (&hdr, 0, sizeof (hdr));
+	hdr.self = GUINT32_TO_LE (offset);
+	hdr.blocksize = GUINT16_TO_LE (len);
+	hdr.nextaddress = GUINT32_TO_LE (nextaddress);
+
+	g_byte_array_append (data, (const guint8 *) &hdr, sizeof (hdr));
+	g_byte_array_append (data, (const guint8 *) text, len);
+
+	return offset;
+}
+
+/* Adds the message, with its body split into two blocks, and
+ * returns the offset of its header */
+static guint32
+test_add_message (GByteArray *data,
+                  guint index)
+{
+	struct _dbx_email_headerstruct hdr;
+	guint32 offset, dataptr = 0, dbx_flags;
+	guint8 items[8];
+
+	if (index != MISSING_MESSAGE) {
+		gchar *text;
+		guint16 half;
+
+		text = g_strdup_printf (
+			"From: sender@example.com\r\n"
+			"Subject: Message %u\r\n"
+			"\r\n"
+			"Body of the message %u\r\n", index, index);
+		half = strlen (text) / 2;
+
+		/* The blocks are written in the reverse order, to know
+		 * the offset of the second one in the first one. */
+		dataptr = test_add_block (data, text + half, strlen (text + half), 0);
+		dataptr = test_add_block (data, text, half, dataptr);
+
+		g_free (text);
+	}
+
+	dbx_flags = (index % 2) ? 0x80 : 0;
+
+	/* Type 0x84 is a direct data pointer, type 0x81 direct flags */
+	items[0] = 0x84;
+	items[1] = dataptr & 0xff;
+	items[2] = (dataptr >> 8) & 0xff;
+	items[3] = (dataptr >> 16) & 0xff;
+	items[4] = 0x81;
+	items[5] = dbx_flags & 0xff;
+	items[6] = (dbx_flags >> 8) & 0xff;
+	items[7] = (dbx_flags >> 16) & 0xff;
+
+	offset = data->len;
+
+	memset (&hdr, 0, sizeof (hdr));
+	hdr.self = GUINT32_TO_LE (offset);
+	hdr.size = GUINT32_TO_LE (sizeof (items));
+	hdr.count = 2;
+
+	g_byte_array_append (data, (const guint8 *) &hdr, sizeof (hdr));
+	g_byte_array_append (data, items, sizeof (items));
+
+	return offset;
+}
+
+/* Each index table references the previous one, which is read first */
+static guint32
+test_add_index_table (GByteArray *data,
+                      const guint32 *offsets,
+                      guint n_offsets,
+                      guint32 previous_table)
+{
+	struct _dbx_tableindexstruct tindex;
+	guint32 offset = data->len;
+	guint ii;
+
+	memset (&tindex, 0, sizeof (tindex));
+	tindex.self = GUINT32_TO_LE (offset);
+	tindex.anotherTablePtr = GUINT32_TO_LE (previous_table);
+	tindex.ptrCount = n_offsets;
+	tindex.indexCount = GUINT32_TO_LE (previous_table ? 1 : 0);
+
+	g_byte_array_append (data, (const guint8 *) &tindex, sizeof (tindex));
+
+	for (ii = 0; ii < n_offsets; ii++) {
+		struct _dbx_indexstruct index;
+
+		memset (&index, 0, sizeof (index));
+		index.indexptr = GUINT32_TO_LE (offsets[ii]);
+
+		g_byte_array_append (data, (const guint8 *) &index, sizeof (index));
+	}
+
+	return offset;
+}
+
+static gchar *
+test_write_dbx_file (void)
+{
+	GByteArray *data;
+	GError *local_error = NULL;
+	guint32 offsets[N_MESSAGES];
+	guint32 table = 0;
+	gchar *filename;
+	gint fd;
+	guint ii;
+
+	data = g_byte_array_new ();
+	g_byte_array_append (data, oe56_mbox_sig, sizeof (oe56_mbox_sig));
+	g_byte_array_set_size (data, 0x100);
+	memset (data->data + sizeof (oe56_mbox_sig), 0, 0x100 - sizeof (oe56_mbox_sig));
+
+	for (ii = 0; ii < N_MESSAGES; ii++) {
+		offsets[ii] = test_add_message (data, ii);
+	}
+
+	for (ii = 0; ii < N_MESSAGES; ii += N_PER_TABLE) {
+		table = test_add_index_table (
+			data, offsets + ii,
+			MIN (N_PER_TABLE, N_MESSAGES - ii), table);
+	}
+
+	test_put_u32 (data, ITEM_COUNT, N_MESSAGES);
+	test_put_u32 (data, INDEX_POINTER, table);
+
+	fd = g_file_open_tmp ("test-dbx-importer-XXXXXX.dbx", &filename, &local_error);
+	g_assert_no_error (local_error);
+	close (fd);
+
+	g_file_set_contents (filename, (const gchar *) data->data, data->len, &local_error);
+	g_assert_no_error (local_error);
+
+	g_byte_array_free (data, TRUE);
+
+	return filename;
+}
+
+static gboolean
+test_append_cb (CamelMimeMessage *msg,
+                gint flags,
+                gpointer user_data,
+                GCancellable *cancellable,
+                GError **error)
+{
+	TestAppended *appended = user_data;
+
+	g_ptr_array_add (appended->subjects, g_strdup (camel_mime_message_get_subject (msg)));
+	g_array_append_val (appended->flags, flags);
+
+	return TRUE;
+}
+
+static void
+test_import_order (void)
+{
+	DbxImporter *m;
+	TestAppended appended;
+	gchar *filename;
+	gint missing;
+	guint ii, jj;
+
+	filename = test_write_dbx_file ();
+
+	m = g_new0 (DbxImporter, 1);
+	g_mutex_init (&m->jobs_lock);
+	g_cond_init (&m->jobs_cond);
+
+	m->dbx_fd = g_open (filename, O_RDONLY, 0);
+	g_assert_cmpint (m->dbx_fd, !=, -1);
+
+	appended.subjects = g_ptr_array_new_with_free_func (g_free);
+	appended.flags = g_array_new (FALSE, FALSE, sizeof (gint));
+
+	missing = dbx_import_messages (m, test_append_cb, &appended, NULL);
+
+	g_assert_no_error (m->base.error);
+	g_assert_cmpint (m->index_count, ==, N_MESSAGES);
+	g_assert_cmpint (missing, ==, 1);
+	g_assert_cmpint (appended.subjects->len, ==, N_MESSAGES - 1);
+
+	for (ii = 0, jj = 0; ii < N_MESSAGES; ii++) {
+		gchar *expected;
+		gint flags;
+
+		if (ii == MISSING_MESSAGE)
+			continue;
+
+		expected = g_strdup_printf ("Message %u", ii);
+		g_assert_cmpstr (appended.subjects->pdata[jj], ==, expected);
+		g_free (expected);
+
+		flags = g_array_index (appended.flags, gint, jj);
+		g_assert_cmpint (flags & CAMEL_MESSAGE_SEEN, ==, (ii % 2) ? CAMEL_MESSAGE_SEEN : 0);
+
+		jj++;
+	}
+
+	g_ptr_array_unref (appended.subjects);
+	g_array_unref (appended.flags);
+
+	close (m->dbx_fd);
+	g_free (m->indices);
+	g_mutex_clear (&m->jobs_lock);
+	g_cond_clear (&m->jobs_cond);
+	g_free (m);
+
+	g_unlink (filename);
+	g_free (filename);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	camel_init (NULL, FALSE);
+
+	g_test_add_func ("/DbxImporter/ImportOrder", test_import_order);
+
+	return g_test_run ();
+}
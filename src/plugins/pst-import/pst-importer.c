@@ -56,6 +56,13 @@
 #define gmtime_r(tp,tmp) (gmtime(tp)?(*(tmp)=*gmtime(tp),(tmp)):0)
 #endif
 
+/* How many messages are built in parallel, how many built messages can
+ * wait to be appended to the folder, and after how many appended messages
+ * the folder is synchronized. */
+#define PST_IMPORT_THREADS 4
+#define PST_IMPORT_WINDOW 64
+#define PST_IMPORT_BATCH 100
+
 typedef struct _PstImporter PstImporter;
 
 gint pst_init (pst_file *pst, gchar *filename);
@@ -65,6 +72,8 @@ static void pst_import_folders (PstImporter *m, pst_desc_tree *topitem);
 static void pst_process_item (PstImporter *m, pst_desc_tree *d_ptr, gchar **previouss_folder);
 static void pst_process_folder (PstImporter *m, pst_item *item);
 static void pst_process_email (PstImporter *m, pst_item *item);
+static void pst_email_job_run (gpointer data, gpointer user_data);
+static void pst_append_emails (PstImporter *m, gboolean wait_all);
 static void pst_process_contact (PstImporter *m, pst_item *item);
 static void pst_process_appointment (PstImporter *m, pst_item *item);
 static void pst_process_task (PstImporter *m, pst_item *item);
@@ -112,6 +121,15 @@ struct _PstImporter {
 	gint folder_count;
 	gint current_item;
 
+	/* The emails are built by the email_pool workers and appended
+	 * to their folders by the import thread, in the PST order. */
+	GThreadPool *email_pool;
+	GQueue email_jobs;	/* PstEmailJob * */
+	GMutex jobs_lock;	/* protects the done flags of the jobs */
+	GCond jobs_cond;
+	CamelFolder *append_folder; /* frozen, while appending to it */
+	gint append_batch;
+
 	EBookClient *addressbook;
 	ECalClient *calendar;
 	ECalClient *tasks;
@@ -787,8 +805,18 @@ pst_import_file (PstImporter *m)
 
 	camel_operation_progress (m->cancellable, 3);
 	count_items (m, d_ptr);
+
+	if (GPOINTER_TO_INT (g_datalist_get_data (&m->target->data, "pst-do-mail")))
+		m->email_pool = g_thread_pool_new (pst_email_job_run, m, PST_IMPORT_THREADS, FALSE, NULL);
+
 	pst_import_folders (m, d_ptr);
 
+	if (m->email_pool) {
+		pst_append_emails (m, TRUE);
+		g_thread_pool_free (m->email_pool, FALSE, TRUE);
+		m->email_pool = NULL;
+	}
+
 	camel_operation_progress (m->cancellable, 100);
 
 	camel_operation_pop_message (m->cancellable);
@@ -917,15 +945,19 @@ pst_process_item (PstImporter *m,
 		case PST_TYPE_NOTE:
 		case PST_TYPE_SCHEDULE:
 		case PST_TYPE_REPORT:
-			if (item->email && GPOINTER_TO_INT (g_datalist_get_data (&m->target->data, "pst-do-mail")))
+			if (item->email && GPOINTER_TO_INT (g_datalist_get_data (&m->target->data, "pst-do-mail"))) {
+				/* The email is built in a worker thread, which frees the item */
 				pst_process_email (m, item);
+				item = NULL;
+			}
 			break;
 		}
 
 		m->current_item++;
 	}
 
-	pst_freeItem (item);
+	if (item)
+		pst_freeItem (item);
 }
 
 /**
@@ -1073,8 +1105,23 @@ pst_create_folder (PstImporter *m)
 }
 
 /**
- * attachment_to_part:
+ * pst_load_attachment:
  * @m: a #PstImporter
+ * @attach: attachment to load
+ *
+ * Reads the attachment data from the PST file, unless it's stored
+ * in the item already. The data is freed with the item.
+ */
+static void
+pst_load_attachment (PstImporter *m,
+                     pst_item_attach *attach)
+{
+	if (attach->data.data == NULL)
+		attach->data = pst_attach_to_mem (&m->pst, attach);
+}
+
+/**
+ * attachment_to_part:
  * @attach: attachment to convert
  *
  * Create a #CamelMimePart from given PST attachment
@@ -1082,8 +1129,7 @@ pst_create_folder (PstImporter *m)
  * Returns: #CamelMimePart containing data and mime type
  */
 static CamelMimePart *
-attachment_to_part (PstImporter *m,
-                    pst_item_attach *attach)
+attachment_to_part (pst_item_attach *attach)
 {
 	CamelMimePart *part;
 	const gchar *mimetype;
@@ -1104,15 +1150,8 @@ attachment_to_part (PstImporter *m,
 		mimetype = "application/octet-stream";
 	}
 
-	if (attach->data.data != NULL) {
-		camel_mime_part_set_content (part, attach->data.data, attach->data.size, mimetype);
-	} else {
-		pst_binary attach_rc;
-		attach_rc = pst_attach_to_mem (&m->pst, attach);
-
-		camel_mime_part_set_content (part, (gchar *) attach_rc.data, attach_rc.size, mimetype);
-		free (attach_rc.data);
-	}
+	/* The data was read by pst_load_attachment() */
+	camel_mime_part_set_content (part, attach->data.data, attach->data.size, mimetype);
 
 	return part;
 }
@@ -1175,9 +1214,11 @@ strip_smtp (const gchar *str)
 	return str;
 }
 
-static void
-pst_process_email (PstImporter *m,
-                   pst_item *item)
+/* Builds the message in a worker thread, thus it shouldn't read
+ * from the PST file, nor touch the PstImporter. */
+static CamelMimeMessage *
+pst_build_email (pst_item *item,
+                 CamelMessageInfo **out_info)
 {
 	CamelMimeMessage *msg;
 	CamelInternetAddress *addr;
@@ -1187,13 +1228,6 @@ pst_process_email (PstImporter *m,
 	pst_item_attach *attach;
 	gboolean has_attachments;
 	gchar *comp_str = NULL;
-	gboolean success;
-
-	if (m->folder == NULL) {
-		pst_create_folder (m);
-		if (!m->folder)
-			return;
-	}
 
 	/* stops on the first valid attachment */
 	for (attach = item->attach; attach; attach = attach->next) {
@@ -1212,7 +1246,7 @@ pst_process_email (PstImporter *m,
 
 		comp = e_cal_component_new ();
 		e_cal_component_set_new_vtype (comp, E_CAL_COMPONENT_EVENT);
-		fill_calcomponent (m, item, comp, "meeting-request");
+		fill_calcomponent (NULL, item, comp, "meeting-request");
 
 		vcal = e_cal_util_new_top_level ();
 
@@ -1244,8 +1278,6 @@ pst_process_email (PstImporter *m,
 		}
 	}
 
-	camel_folder_freeze (m->folder);
-
 	msg = camel_mime_message_new ();
 
 	if (item->subject.str != NULL) {
@@ -1363,7 +1395,7 @@ pst_process_email (PstImporter *m,
 
 	for (attach = item->attach; attach; attach = attach->next) {
 		if (attach->data.data || attach->i_id) {
-			part = attachment_to_part (m, attach);
+			part = attachment_to_part (attach);
 			camel_multipart_add_part (mp, part);
 			g_object_unref (part);
 		}
@@ -1394,23 +1426,153 @@ pst_process_email (PstImporter *m,
 	if (item->flags & 0x08)
 		camel_message_info_set_flags (info, CAMEL_MESSAGE_DRAFT, ~0);
 
-	/* FIXME Not passing a GCancellable or GError here. */
-	success = camel_folder_append_message_sync (
-		m->folder, msg, info, NULL, NULL, NULL);
-	g_clear_object (&info);
-	g_object_unref (msg);
+	g_object_unref (mp);
+	g_free (comp_str);
 
-	/* FIXME Not passing a GCancellable or GError here. */
-	camel_folder_synchronize_sync (m->folder, FALSE, NULL, NULL);
-	camel_folder_thaw (m->folder);
+	*out_info = info;
 
-	g_free (comp_str);
+	return msg;
+}
 
-	if (!success) {
-		g_debug ("%s: Exception!", G_STRFUNC);
+typedef struct {
+	CamelFolder *folder;
+	pst_item *item;
+	gboolean done;
+
+	CamelMimeMessage *msg;
+	CamelMessageInfo *info;
+} PstEmailJob;
+
+static void
+pst_email_job_free (gpointer ptr)
+{
+	PstEmailJob *job = ptr;
+
+	if (job) {
+		g_clear_object (&job->folder);
+		g_clear_object (&job->msg);
+		g_clear_object (&job->info);
+		if (job->item)
+			pst_freeItem (job->item);
+		g_free (job);
+	}
+}
+
+static void
+pst_email_job_run (gpointer data,
+                   gpointer user_data)
+{
+	PstEmailJob *job = data;
+	PstImporter *m = user_data;
+
+	if (!g_cancellable_is_cancelled (m->cancellable))
+		job->msg = pst_build_email (job->item, &job->info);
+
+	pst_freeItem (job->item);
+	job->item = NULL;
+
+	g_mutex_lock (&m->jobs_lock);
+	job->done = TRUE;
+	g_cond_broadcast (&m->jobs_cond);
+	g_mutex_unlock (&m->jobs_lock);
+}
+
+/* Synchronizes the folder the messages were appended to */
+static void
+pst_finish_append_batch (PstImporter *m)
+{
+	if (!m->append_folder)
 		return;
+
+	/* Only the first error is reported */
+	camel_folder_synchronize_sync (
+		m->append_folder, FALSE, m->cancellable,
+		m->base.error ? NULL : &m->base.error);
+	camel_folder_thaw (m->append_folder);
+
+	g_clear_object (&m->append_folder);
+	m->append_batch = 0;
+}
+
+/**
+ * pst_append_emails:
+ * @m: a #PstImporter
+ * @wait_all: whether to wait for all the emails being built
+ *
+ * Appends the built emails to their folders, in the order they were
+ * queued. Without @wait_all, only waits when too many emails are queued.
+ */
+static void
+pst_append_emails (PstImporter *m,
+                   gboolean wait_all)
+{
+	PstEmailJob *job;
+
+	while ((job = g_queue_peek_head (&m->email_jobs)) != NULL) {
+		g_mutex_lock (&m->jobs_lock);
+		if (!job->done && !wait_all && g_queue_get_length (&m->email_jobs) < PST_IMPORT_WINDOW) {
+			g_mutex_unlock (&m->jobs_lock);
+			break;
+		}
+		while (!job->done)
+			g_cond_wait (&m->jobs_cond, &m->jobs_lock);
+		g_mutex_unlock (&m->jobs_lock);
+
+		g_queue_pop_head (&m->email_jobs);
+
+		/* Nothing is appended after an error */
+		if (job->msg && !m->base.error && !g_cancellable_is_cancelled (m->cancellable)) {
+			if (m->append_folder != job->folder) {
+				pst_finish_append_batch (m);
+
+				m->append_folder = g_object_ref (job->folder);
+				camel_folder_freeze (m->append_folder);
+			}
+
+			camel_folder_append_message_sync (
+				job->folder, job->msg, job->info, NULL,
+				m->cancellable, &m->base.error);
+
+			if (++m->append_batch >= PST_IMPORT_BATCH)
+				pst_finish_append_batch (m);
+		}
+
+		pst_email_job_free (job);
 	}
 
+	if (wait_all)
+		pst_finish_append_batch (m);
+}
+
+static void
+pst_process_email (PstImporter *m,
+                   pst_item *item)
+{
+	PstEmailJob *job;
+	pst_item_attach *attach;
+
+	if (m->folder == NULL) {
+		pst_create_folder (m);
+		if (!m->folder) {
+			pst_freeItem (item);
+			return;
+		}
+	}
+
+	/* libpst can't read from the PST file in more threads */
+	for (attach = item->attach; attach; attach = attach->next) {
+		if (attach->data.data || attach->i_id)
+			pst_load_attachment (m, attach);
+	}
+
+	job = g_new0 (PstEmailJob, 1);
+	job->folder = g_object_ref (m->folder);
+	job->item = item;
+
+	g_queue_push_tail (&m->email_jobs, job);
+	g_thread_pool_push (m->email_pool, job, NULL);
+
+	pst_append_emails (m, FALSE);
 }
 
 static void
@@ -1709,7 +1871,8 @@ set_cal_attachments (ECalClient *cal,
 		CamelStream *stream;
 		struct stat st;
 
-		part = attachment_to_part (m, attach);
+		pst_load_attachment (m, attach);
+		part = attachment_to_part (attach);
 
 		orig_filename = camel_mime_part_get_filename (part);
 
@@ -2078,6 +2241,8 @@ pst_import_free (PstImporter *m)
 
 	g_free (m->status_what);
 	g_mutex_clear (&m->status_lock);
+	g_mutex_clear (&m->jobs_lock);
+	g_cond_clear (&m->jobs_cond);
 
 	g_source_remove (m->status_timeout_id);
 	m->status_timeout_id = 0;
@@ -2155,6 +2320,9 @@ pst_import (EImport *ei,
 	m->status_timeout_id =
 		e_named_timeout_add (100, pst_status_timeout, m);
 	g_mutex_init (&m->status_lock);
+	g_mutex_init (&m->jobs_lock);
+	g_cond_init (&m->jobs_cond);
+	g_queue_init (&m->email_jobs);
 	m->cancellable = camel_operation_new ();
 
 	g_signal_connect (
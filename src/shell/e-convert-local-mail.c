@@ -23,11 +23,33 @@
 
 #include <shell/e-shell.h>
 
+/* How many folders are converted at once */
+#define CONVERT_MAX_THREADS 4
+
+/* How many messages are copied before the journal is updated */
+#define CONVERT_BATCH_SIZE 500
+
+/* How many times a folder is tried to be converted before giving up */
+#define CONVERT_MAX_ATTEMPTS 3
+
+/* The conversion journal records the mbox store UID, which folders
+ * were already converted, the source UIDs of the messages copied from
+ * the folders not converted yet and how many times a folder failed,
+ * thus an interrupted conversion can continue where it stopped.
+ * It's removed once the conversion is done. */
+#define CONVERT_JOURNAL_NAME	"convert-local-mail.ini"
+#define JOURNAL_GROUP_CONVERSION "Conversion"
+#define JOURNAL_GROUP_FOLDERS	"Folders"
+#define JOURNAL_GROUP_COPIED	"Copied"
+#define JOURNAL_GROUP_FAILURES	"Failures"
+#define JOURNAL_KEY_MBOX_UID	"MboxUid"
+
 /* Forward Declarations */
 void e_convert_local_mail (EShell *shell);
 
 static gboolean
-mail_to_maildir_migration_needed (const gchar *mail_data_dir)
+mail_to_maildir_migration_needed (const gchar *mail_data_dir,
+                                  const gchar *journal_filename)
 {
 	gchar *local_store;
 	gchar *local_outbox;
@@ -36,9 +58,13 @@ mail_to_maildir_migration_needed (const gchar *mail_data_dir)
 	local_store = g_build_filename (mail_data_dir, "local", NULL);
 	local_outbox = g_build_filename (local_store, ".Outbox", NULL);
 
+	/* An interrupted conversion, the Outbox can be converted already. */
+	if (g_file_test (journal_filename, G_FILE_TEST_IS_REGULAR))
+		migration_needed = TRUE;
+
 	/* If this is a fresh install (no local store exists yet)
 	 * then obviously there's nothing to migrate to Maildir. */
-	if (!g_file_test (local_store, G_FILE_TEST_IS_DIR))
+	else if (!g_file_test (local_store, G_FILE_TEST_IS_DIR))
 		migration_needed = FALSE;
 
 	/* Look for a Maildir Outbox folder. */
@@ -51,6 +77,185 @@ mail_to_maildir_migration_needed (const gchar *mail_data_dir)
 	return migration_needed;
 }
 
+struct MigrateStore {
+	CamelSession *session;
+	CamelStore *mail_store;
+	CamelStore *maildir_store;
+	gboolean complete;
+
+	GMutex journal_lock;
+	GKeyFile *journal;
+	const gchar *journal_filename;
+	guint n_failed;		/* to be tried again on the next start */
+	GPtrArray *given_up;	/* gchar *, folder names */
+};
+
+static void
+migrate_journal_save (GKeyFile *journal,
+                      const gchar *journal_filename)
+{
+	gchar *contents;
+	gsize length = 0;
+	GError *error = NULL;
+
+	contents = g_key_file_to_data (journal, &length, NULL);
+
+	if (!g_file_set_contents (journal_filename, contents, length, &error)) {
+		g_warning ("%s: Failed to save '%s': %s", G_STRFUNC, journal_filename, error ? error->message : "Unknown error");
+		g_clear_error (&error);
+	}
+
+	g_free (contents);
+}
+
+/* Folder names can contain characters not allowed in the key names */
+static gchar *
+migrate_journal_folder_key (const gchar *folder_name)
+{
+	return g_compute_checksum_for_string (G_CHECKSUM_SHA1, folder_name, -1);
+}
+
+static gboolean
+migrate_journal_get_folder_done (struct MigrateStore *ms,
+                                 const gchar *folder_name)
+{
+	gchar *key;
+	gboolean done;
+
+	key = migrate_journal_folder_key (folder_name);
+
+	g_mutex_lock (&ms->journal_lock);
+	done = g_key_file_get_boolean (ms->journal, JOURNAL_GROUP_FOLDERS, key, NULL);
+	g_mutex_unlock (&ms->journal_lock);
+
+	g_free (key);
+
+	return done;
+}
+
+static void
+migrate_journal_set_folder_done (struct MigrateStore *ms,
+                                 const gchar *folder_name)
+{
+	gchar *key;
+
+	key = migrate_journal_folder_key (folder_name);
+
+	g_mutex_lock (&ms->journal_lock);
+	g_key_file_set_boolean (ms->journal, JOURNAL_GROUP_FOLDERS, key, TRUE);
+	g_key_file_remove_key (ms->journal, JOURNAL_GROUP_COPIED, key, NULL);
+	g_key_file_remove_key (ms->journal, JOURNAL_GROUP_FAILURES, key, NULL);
+	migrate_journal_save (ms->journal, ms->journal_filename);
+	g_mutex_unlock (&ms->journal_lock);
+
+	g_free (key);
+}
+
+/* Returns a set of the source UIDs already copied from the folder */
+static GHashTable *
+migrate_journal_get_copied_uids (struct MigrateStore *ms,
+                                 const gchar *folder_name)
+{
+	GHashTable *copied;
+	gchar **uids;
+	gchar *key;
+	guint ii;
+
+	copied = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	key = migrate_journal_folder_key (folder_name);
+
+	g_mutex_lock (&ms->journal_lock);
+	uids = g_key_file_get_string_list (ms->journal, JOURNAL_GROUP_COPIED, key, NULL, NULL);
+	g_mutex_unlock (&ms->journal_lock);
+
+	for (ii = 0; uids && uids[ii]; ii++) {
+		g_hash_table_add (copied, uids[ii]);
+	}
+
+	/* The strings are owned by the hash table now */
+	g_free (uids);
+	g_free (key);
+
+	return copied;
+}
+
+static void
+migrate_journal_add_copied_uids (struct MigrateStore *ms,
+                                 const gchar *folder_name,
+                                 GPtrArray *uids)
+{
+	gchar **copied;
+	gchar *key;
+	gsize length = 0;
+	guint ii;
+
+	key = migrate_journal_folder_key (folder_name);
+
+	g_mutex_lock (&ms->journal_lock);
+
+	copied = g_key_file_get_string_list (ms->journal, JOURNAL_GROUP_COPIED, key, &length, NULL);
+	copied = g_renew (gchar *, copied, length + uids->len + 1);
+
+	for (ii = 0; ii < uids->len; ii++) {
+		copied[length + ii] = g_strdup (uids->pdata[ii]);
+	}
+
+	copied[length + uids->len] = NULL;
+
+	g_key_file_set_string_list (ms->journal, JOURNAL_GROUP_COPIED, key, (const gchar * const *) copied, length + uids->len);
+	migrate_journal_save (ms->journal, ms->journal_filename);
+
+	g_mutex_unlock (&ms->journal_lock);
+
+	g_strfreev (copied);
+	g_free (key);
+}
+
+static gint
+migrate_journal_get_folder_failures (struct MigrateStore *ms,
+                                     const gchar *folder_name)
+{
+	gchar *key;
+	gint failures;
+
+	key = migrate_journal_folder_key (folder_name);
+
+	g_mutex_lock (&ms->journal_lock);
+	failures = g_key_file_get_integer (ms->journal, JOURNAL_GROUP_FAILURES, key, NULL);
+	g_mutex_unlock (&ms->journal_lock);
+
+	g_free (key);
+
+	return failures;
+}
+
+/* Counts the failure; the folder is given up after CONVERT_MAX_ATTEMPTS failures */
+static void
+migrate_journal_set_folder_failed (struct MigrateStore *ms,
+                                   const gchar *folder_name)
+{
+	gchar *key;
+	gint failures;
+
+	key = migrate_journal_folder_key (folder_name);
+
+	g_mutex_lock (&ms->journal_lock);
+
+	failures = g_key_file_get_integer (ms->journal, JOURNAL_GROUP_FAILURES, key, NULL) + 1;
+	g_key_file_set_integer (ms->journal, JOURNAL_GROUP_FAILURES, key, failures);
+	migrate_journal_save (ms->journal, ms->journal_filename);
+
+	if (failures >= CONVERT_MAX_ATTEMPTS)
+		g_ptr_array_add (ms->given_up, g_strdup (folder_name));
+	else
+		ms->n_failed++;
+
+	g_mutex_unlock (&ms->journal_lock);
+
+	g_free (key);
+}
+
 /* Folder names with '.' are converted to '_' */
 static gchar *
 sanitize_maildir_folder_name (gchar *folder_name)
@@ -63,79 +268,132 @@ sanitize_maildir_folder_name (gchar *folder_name)
 	 return maildir_folder_name;
 }
 
-static void
-copy_folder (CamelStore *mail_store,
-             CamelStore *maildir_store,
+static gboolean
+copy_batch (struct MigrateStore *ms,
+            CamelFolder *fromfolder,
+            CamelFolder *tofolder,
+            const gchar *mail_fname,
+            GPtrArray *uids)
+{
+	gboolean success;
+
+	success = camel_folder_transfer_messages_to_sync (
+		fromfolder, uids, tofolder, FALSE, NULL, NULL, NULL);
+
+	if (success)
+		success = camel_folder_synchronize_sync (tofolder, FALSE, NULL, NULL);
+
+	/* Interrupted before this, the batch is copied again on the next
+	 * start, thus messages can be duplicated, but are never lost. */
+	if (success)
+		migrate_journal_add_copied_uids (ms, mail_fname, uids);
+
+	return success;
+}
+
+static gboolean
+copy_folder (struct MigrateStore *ms,
              const gchar *mail_fname,
              const gchar *maildir_fname)
 {
 	CamelFolder *fromfolder, *tofolder;
-	GPtrArray *uids;
+	GHashTable *copied;
+	GPtrArray *uids, *batch;
+	guint ii;
+	gboolean success = TRUE;
 
 	fromfolder = camel_store_get_folder_sync (
-		mail_store, mail_fname, 0, NULL, NULL);
+		ms->mail_store, mail_fname, 0, NULL, NULL);
 	if (fromfolder == NULL) {
 		g_warning ("Cannot find mail folder %s \n", mail_fname);
-		return;
+		return FALSE;
 	}
 
 	tofolder = camel_store_get_folder_sync (
-		maildir_store, maildir_fname,
+		ms->maildir_store, maildir_fname,
 		CAMEL_STORE_FOLDER_CREATE, NULL, NULL);
 	if (tofolder == NULL) {
 		g_warning ("Cannot create maildir folder %s \n", maildir_fname);
 		g_object_unref (fromfolder);
-		return;
+		return FALSE;
 	}
 
+	/* The maildir folder can be changed by the user between the starts,
+	 * thus the messages copied before the conversion was interrupted
+	 * are recognized by their source UIDs recorded in the journal. */
+	copied = migrate_journal_get_copied_uids (ms, mail_fname);
+
 	uids = camel_folder_get_uids (fromfolder);
-	camel_folder_transfer_messages_to_sync (
-		fromfolder, uids, tofolder, FALSE, NULL, NULL, NULL);
+	camel_folder_sort_uids (fromfolder, uids);
+
+	batch = g_ptr_array_sized_new (CONVERT_BATCH_SIZE);
+
+	for (ii = 0; ii < uids->len && success; ii++) {
+		if (!g_hash_table_contains (copied, uids->pdata[ii]))
+			g_ptr_array_add (batch, uids->pdata[ii]);
+
+		if (batch->len == CONVERT_BATCH_SIZE) {
+			success = copy_batch (ms, fromfolder, tofolder, mail_fname, batch);
+			g_ptr_array_set_size (batch, 0);
+		}
+	}
+
+	if (success && batch->len > 0)
+		success = copy_batch (ms, fromfolder, tofolder, mail_fname, batch);
+
+	g_ptr_array_free (batch, TRUE);
 	camel_folder_free_uids (fromfolder, uids);
+	g_hash_table_destroy (copied);
 
 	g_object_unref (fromfolder);
 	g_object_unref (tofolder);
+
+	return success;
 }
 
 static void
-copy_folders (CamelStore *mail_store,
-              CamelStore *maildir_store,
-              CamelFolderInfo *fi,
-              CamelSession *session)
+copy_folder_thread (gpointer data,
+                    gpointer user_data)
 {
-	if (fi) {
-		if (!g_str_has_prefix (fi->full_name, ".#evolution")) {
-			gchar *maildir_folder_name;
-
-			/* sanitize folder names and copy folders */
-			maildir_folder_name =
-				sanitize_maildir_folder_name (fi->full_name);
-			copy_folder (
-				mail_store, maildir_store,
-				fi->full_name, maildir_folder_name);
-			g_free (maildir_folder_name);
-		}
+	gchar *folder_name = data;
+	struct MigrateStore *ms = user_data;
+	gchar *maildir_folder_name;
+
+	/* sanitize folder names and copy folders */
+	maildir_folder_name = sanitize_maildir_folder_name (folder_name);
+
+	if (copy_folder (ms, folder_name, maildir_folder_name))
+		migrate_journal_set_folder_done (ms, folder_name);
+	else
+		migrate_journal_set_folder_failed (ms, folder_name);
+
+	g_free (maildir_folder_name);
+	g_free (folder_name);
+}
+
+static void
+collect_folders (CamelFolderInfo *fi,
+                 GPtrArray *folder_names)
+{
+	while (fi) {
+		if (!g_str_has_prefix (fi->full_name, ".#evolution"))
+			g_ptr_array_add (folder_names, g_strdup (fi->full_name));
 
 		if (fi->child)
-			copy_folders (mail_store, maildir_store, fi->child, session);
+			collect_folders (fi->child, folder_names);
 
-		copy_folders (mail_store, maildir_store, fi->next, session);
+		fi = fi->next;
 	}
 }
 
-struct MigrateStore {
-	CamelSession *session;
-	CamelStore *mail_store;
-	CamelStore *maildir_store;
-	gboolean complete;
-};
-
 static void
 migrate_stores (struct MigrateStore *ms)
 {
 	CamelFolderInfo *mail_fi;
 	CamelStore *mail_store = ms->mail_store;
-	CamelStore *maildir_store = ms->maildir_store;
+	GThreadPool *thread_pool;
+	GPtrArray *folder_names;
+	guint ii;
 
 	mail_fi = camel_store_get_folder_info_sync (
 		mail_store, NULL,
@@ -144,8 +402,29 @@ migrate_stores (struct MigrateStore *ms)
 		CAMEL_STORE_FOLDER_INFO_SUBSCRIBED,
 		NULL, NULL);
 
+	folder_names = g_ptr_array_new ();
+	collect_folders (mail_fi, folder_names);
+	camel_folder_info_free (mail_fi);
+
 	/* FIXME progres dialog */
-	copy_folders (mail_store, maildir_store, mail_fi, ms->session);
+	thread_pool = g_thread_pool_new (copy_folder_thread, ms, CONVERT_MAX_THREADS, FALSE, NULL);
+
+	for (ii = 0; ii < folder_names->len; ii++) {
+		gchar *folder_name = folder_names->pdata[ii];
+
+		/* Converted before the previous conversion was interrupted,
+		 * or given up and reported to the user already */
+		if (migrate_journal_get_folder_done (ms, folder_name) ||
+		    migrate_journal_get_folder_failures (ms, folder_name) >= CONVERT_MAX_ATTEMPTS)
+			g_free (folder_name);
+		else
+			g_thread_pool_push (thread_pool, folder_name, NULL);
+	}
+
+	/* Waits for all the folders to be converted */
+	g_thread_pool_free (thread_pool, FALSE, TRUE);
+	g_ptr_array_free (folder_names, TRUE);
+
 	ms->complete = TRUE;
 }
 
@@ -182,7 +461,9 @@ rename_mbox_dir (ESource *mbox_source,
 static gboolean
 migrate_mbox_to_maildir (EShell *shell,
                          CamelSession *session,
-                         ESource *mbox_source)
+                         ESource *mbox_source,
+                         GKeyFile *journal,
+                         const gchar *journal_filename)
 {
 	ESourceRegistry *registry;
 	ESourceExtension *extension;
@@ -250,7 +531,7 @@ migrate_mbox_to_maildir (EShell *shell,
 
 	path = g_build_filename (data_dir, "local", NULL);
 	g_object_set (settings, "path", path, NULL);
-	if (g_mkdir (path, 0700) == -1)
+	if (g_mkdir (path, 0700) == -1 && errno != EEXIST)
 		g_warning (
 			"%s: Failed to make directory '%s': %s",
 			G_STRFUNC, path, g_strerror (errno));
@@ -262,6 +543,11 @@ migrate_mbox_to_maildir (EShell *shell,
 	ms.maildir_store = CAMEL_STORE (maildir_service);
 	ms.session = session;
 	ms.complete = FALSE;
+	ms.journal = journal;
+	ms.journal_filename = journal_filename;
+	ms.n_failed = 0;
+	ms.given_up = g_ptr_array_new_with_free_func (g_free);
+	g_mutex_init (&ms.journal_lock);
 
 	thread = g_thread_new (NULL, (GThreadFunc) migrate_stores, &ms);
 	/* coverity[loop_condition] */
@@ -271,6 +557,7 @@ migrate_mbox_to_maildir (EShell *shell,
 	g_object_unref (mbox_service);
 	g_object_unref (maildir_service);
 	g_thread_unref (thread);
+	g_mutex_clear (&ms.journal_lock);
 
 	/* Folders can leave notifications in the main loop which would be delivered
 	   on idle, but these can be left in the main loop longer than the temporary
@@ -279,6 +566,27 @@ migrate_mbox_to_maildir (EShell *shell,
 	while (g_main_context_pending (NULL))
 		g_main_context_iteration (NULL, TRUE);
 
+	if (ms.given_up->len > 0) {
+		gchar *folder_names;
+
+		g_ptr_array_add (ms.given_up, NULL);
+		folder_names = g_strjoinv ("\n", (gchar **) ms.given_up->pdata);
+
+		e_alert_run_dialog_for_args (
+			e_shell_get_active_window (NULL),
+			"mail:migrate-store-failed", folder_names, NULL);
+
+		g_free (folder_names);
+	}
+
+	g_ptr_array_free (ms.given_up, TRUE);
+
+	/* Keep the journal, thus the next start converts the failed folders again */
+	if (ms.n_failed > 0) {
+		g_warning ("%s: Failed to convert %u folder(s), will retry on the next start", G_STRFUNC, ms.n_failed);
+		return FALSE;
+	}
+
 	return TRUE;
 }
 
@@ -286,12 +594,15 @@ void
 e_convert_local_mail (EShell *shell)
 {
 	CamelSession *session;
-	ESource *mbox_source;
+	ESource *mbox_source = NULL;
+	GKeyFile *journal;
 	const gchar *user_data_dir;
 	const gchar *user_cache_dir;
 	gchar *mail_data_dir;
 	gchar *mail_cache_dir;
 	gchar *local_store;
+	gchar *journal_filename;
+	gchar *mbox_uid = NULL;
 	gint response;
 
 	user_data_dir = e_get_user_data_dir ();
@@ -299,19 +610,37 @@ e_convert_local_mail (EShell *shell)
 
 	mail_data_dir = g_build_filename (user_data_dir, "mail", NULL);
 	mail_cache_dir = g_build_filename (user_cache_dir, "mail", NULL);
+	journal_filename = g_build_filename (mail_data_dir, CONVERT_JOURNAL_NAME, NULL);
 
-	if (!mail_to_maildir_migration_needed (mail_data_dir))
+	if (!mail_to_maildir_migration_needed (mail_data_dir, journal_filename))
 		goto exit;
 
-	response = e_alert_run_dialog_for_args (
-		e_shell_get_active_window (NULL),
-		"mail:ask-migrate-store", NULL);
+	journal = g_key_file_new ();
 
-	if (response == GTK_RESPONSE_CANCEL)
-		exit (EXIT_SUCCESS);
+	/* Continue an interrupted conversion, the user agreed with it already */
+	if (g_key_file_load_from_file (journal, journal_filename, G_KEY_FILE_NONE, NULL))
+		mbox_uid = g_key_file_get_string (journal, JOURNAL_GROUP_CONVERSION, JOURNAL_KEY_MBOX_UID, NULL);
 
-	mbox_source = e_source_new (NULL, NULL, NULL);
+	if (mbox_uid) {
+		mbox_source = e_source_registry_ref_source (e_shell_get_registry (shell), mbox_uid);
+		if (!mbox_source)
+			mbox_source = e_source_new_with_uid (mbox_uid, NULL, NULL);
+	} else {
+		response = e_alert_run_dialog_for_args (
+			e_shell_get_active_window (NULL),
+			"mail:ask-migrate-store", NULL);
+
+		if (response == GTK_RESPONSE_CANCEL)
+			exit (EXIT_SUCCESS);
+
+		mbox_source = e_source_new (NULL, NULL, NULL);
+
+		/* Remember the mbox store before anything is moved or converted */
+		g_key_file_set_string (journal, JOURNAL_GROUP_CONVERSION, JOURNAL_KEY_MBOX_UID, e_source_get_uid (mbox_source));
+		migrate_journal_save (journal, journal_filename);
+	}
 
+	/* Does nothing when continuing after the mbox directory was renamed */
 	rename_mbox_dir (mbox_source, mail_data_dir);
 
 	local_store = g_build_filename (mail_data_dir, "local", NULL);
@@ -328,13 +657,17 @@ e_convert_local_mail (EShell *shell)
 		"user-cache-dir", mail_cache_dir,
 		NULL);
 
-	migrate_mbox_to_maildir (shell, session, mbox_source);
+	if (migrate_mbox_to_maildir (shell, session, mbox_source, journal, journal_filename))
+		g_unlink (journal_filename);
 
 	g_object_unref (session);
 
 	g_object_unref (mbox_source);
+	g_key_file_free (journal);
+	g_free (mbox_uid);
 
 exit:
 	g_free (mail_data_dir);
 	g_free (mail_cache_dir);
+	g_free (journal_filename);
 }
@@ -392,7 +392,15 @@ create_default_shell (void)
 		g_clear_error (&error);
 	}
 
-	/* Load all shared library modules. */
+	/* Load all shared library modules.
+	 *
+	 * XXX This cannot be deferred per shell backend.  Modules register
+	 *     EExtension types for many extensible classes (EShell, EShellWindow,
+	 *     EMailReader, EAttachmentView, ...) and EExtensible instantiates
+	 *     the extensions only when the extended object is constructed,
+	 *     thus a module loaded later would miss every existing object.
+	 *     The view specific work is deferred by EShellBackendClass.start
+	 *     instead, which runs on the first switch to the view. */
 	module_types = e_module_load_all_in_directory (EVOLUTION_MODULEDIR);
 	g_list_free_full (module_types, (GDestroyNotify) g_type_module_unuse);
 